@@ -5,4 +5,10 @@ namespace base
     const char kV[] = "v";
     const char kVModule[] = "vmodule";
 
+    // Records per-task queue delay and run time, see debug/task_profiler.h.
+    const char kTaskProfiler[] = "task-profiler";
+
+    // Records per-site lock contention, see synchronization/lock_profiler.h.
+    const char kLockProfiler[] = "lock-profiler";
+
 } //namespace base
\ No newline at end of file
@@ -7,6 +7,8 @@ namespace base
 {
     extern const char kV[];
     extern const char kVModule[];
+    extern const char kTaskProfiler[];
+    extern const char kLockProfiler[];
 
 } //namespace base
 
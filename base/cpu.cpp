@@ -1,6 +1,10 @@
 #include "cpu.h"
 
 #include <intrin.h>
+#include <immintrin.h>
+#include <string.h>
+
+#include "build_config.h"
 
 namespace base
 {
@@ -18,6 +22,7 @@ namespace base
         has_ssse3_(false),
         has_sse41_(false),
         has_sse42_(false),
+        has_avx2_(false),
         cpu_vendor_("unknown")
     {
         Initialize();
@@ -54,6 +59,17 @@ namespace base
             has_ssse3_ = (cpu_info[2] & 0x00000200) != 0;
             has_sse41_ = (cpu_info[2] & 0x00080000) != 0;
             has_sse42_ = (cpu_info[2] & 0x00100000) != 0;
+
+            // AVX2 needs the OS to save the YMM state: OSXSAVE and AVX are
+            // set and XCR0 enables both the XMM and YMM registers.
+            bool has_avx = (cpu_info[2] & 0x10000000) != 0;
+            bool has_osxsave = (cpu_info[2] & 0x08000000) != 0;
+            if (num_ids >= 7 && has_avx && has_osxsave &&
+                (_xgetbv(0) & 6) == 6)
+            {
+                __cpuidex(cpu_info, 7, 0);
+                has_avx2_ = (cpu_info[1] & 0x00000020) != 0;
+            }
         }
 #endif
     }
@@ -24,6 +24,8 @@ namespace base
         int has_ssse3() const { return has_ssse3_; }
         int has_sse41() const { return has_sse41_; }
         int has_sse42() const { return has_sse42_; }
+        // AVX2 is only reported if the OS also saves the YMM registers.
+        int has_avx2() const { return has_avx2_; }
 
     private:
         void Initialize();
@@ -41,6 +43,7 @@ namespace base
         bool has_ssse3_;
         bool has_sse41_;
         bool has_sse42_;
+        bool has_avx2_;
         std::string cpu_vendor_;
     };
 
@@ -0,0 +1,259 @@
+#include "task_profiler.h"
+
+#include <vector>
+
+#include "base/base_switches.h"
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/lazy_instance.h"
+#include "base/metric/histogram.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread_local.h"
+
+namespace base
+{
+    namespace debug
+    {
+        // Each thread that runs tasks owns one ThreadBuffer.  Only the owning
+        // thread writes into it; the lock is there so that an export running on
+        // another thread sees whole records.  It is never contended in the
+        // common case, which keeps the per-task cost to a few tens of ns.
+        class TaskProfiler::ThreadBuffer
+        {
+        public:
+            explicit ThreadBuffer(const std::string& thread_name)
+                : thread_name_(thread_name),
+                thread_id_(PlatformThread::CurrentId()),
+                next_index_(0),
+                wrapped_(false),
+                queue_delay_histogram_(NULL),
+                run_time_histogram_(NULL)
+            {
+                records_.resize(kRingBufferSize);
+                if (thread_name_.empty())
+                {
+                    thread_name_ = StringPrintf("Thread %u", thread_id_);
+                }
+                if (StatisticsRecorder::IsActive())
+                {
+                    queue_delay_histogram_ = Histogram::FactoryGet(
+                        "TaskProfiler.QueueDelayUs:" + thread_name_,
+                        1, 10000000, 50, Histogram::kNoFlags);
+                    run_time_histogram_ = Histogram::FactoryGet(
+                        "TaskProfiler.RunTimeUs:" + thread_name_,
+                        1, 10000000, 50, Histogram::kNoFlags);
+                }
+            }
+
+            void Add(const TaskRecord& record)
+            {
+                {
+                    AutoLock locked(lock_);
+                    records_[next_index_] = record;
+                    if (++next_index_ == kRingBufferSize)
+                    {
+                        next_index_ = 0;
+                        wrapped_ = true;
+                    }
+                }
+
+                if (queue_delay_histogram_)
+                {
+                    queue_delay_histogram_->Add(static_cast<int>(
+                        (record.start_time - record.time_posted).InMicroseconds()));
+                    run_time_histogram_->Add(static_cast<int>(
+                        (record.end_time - record.start_time).InMicroseconds()));
+                }
+            }
+
+            // Appends one trace event per record, oldest first.  |first| tracks
+            // whether a separating comma is needed across buffers.
+            void AppendTraceEvents(std::string* output, bool* first)
+            {
+                AutoLock locked(lock_);
+                size_t count = wrapped_ ? kRingBufferSize : next_index_;
+                size_t begin = wrapped_ ? next_index_ : 0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const TaskRecord& record =
+                        records_[(begin + i) % kRingBufferSize];
+                    if (!*first)
+                    {
+                        output->append(",\n");
+                    }
+                    *first = false;
+                    StringAppendF(output,
+                        "{\"name\":\"Task %p\",\"cat\":\"task\",\"ph\":\"X\","
+                        "\"pid\":%u,\"tid\":%u,\"ts\":%I64d,\"dur\":%I64d,"
+                        "\"args\":{\"posted_from\":\"%p\",\"queue_us\":%I64d,"
+                        "\"run_depth\":%d}}",
+                        record.posted_from, GetCurrentProcessId(), thread_id_,
+                        record.start_time.ToInternalValue(),
+                        (record.end_time - record.start_time).InMicroseconds(),
+                        record.posted_from,
+                        (record.start_time - record.time_posted).InMicroseconds(),
+                        record.run_depth);
+                }
+            }
+
+            // Emits the thread_name metadata event so the viewer labels rows.
+            void AppendThreadName(std::string* output, bool* first)
+            {
+                if (!*first)
+                {
+                    output->append(",\n");
+                }
+                *first = false;
+                std::string escaped;
+                for (size_t i = 0; i < thread_name_.size(); ++i)
+                {
+                    char c = thread_name_[i];
+                    if (c == '"' || c == '\\')
+                    {
+                        escaped.push_back('\\');
+                    }
+                    if (static_cast<unsigned char>(c) >= 0x20)
+                    {
+                        escaped.push_back(c);
+                    }
+                }
+                StringAppendF(output,
+                    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,"
+                    "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    GetCurrentProcessId(), thread_id_, escaped.c_str());
+            }
+
+            void Clear()
+            {
+                AutoLock locked(lock_);
+                next_index_ = 0;
+                wrapped_ = false;
+            }
+
+        private:
+            std::string thread_name_;
+            PlatformThreadId thread_id_;
+
+            Lock lock_;
+            std::vector<TaskRecord> records_;
+            size_t next_index_;
+            bool wrapped_;
+
+            Histogram* queue_delay_histogram_;
+            Histogram* run_time_histogram_;
+
+            DISALLOW_COPY_AND_ASSIGN(ThreadBuffer);
+        };
+    } //namespace debug
+} //namespace base
+
+namespace
+{
+    typedef base::debug::TaskProfiler::ThreadBuffer ThreadBuffer;
+    typedef std::vector<ThreadBuffer*> ThreadBuffers;
+
+    // All buffers ever created.  Buffers are leaked on purpose, so that the
+    // records of threads that already exited can still be exported.
+    struct ThreadBufferRegistry
+    {
+        base::Lock lock;
+        ThreadBuffers buffers;
+    };
+
+    base::LazyInstance<ThreadBufferRegistry,
+        base::LeakyLazyInstanceTraits<ThreadBufferRegistry> > g_registry(
+        base::LINKER_INITIALIZED);
+
+    base::LazyInstance<base::ThreadLocalPointer<ThreadBuffer>,
+        base::LeakyLazyInstanceTraits<base::ThreadLocalPointer<ThreadBuffer> > >
+        g_tls_buffer(base::LINKER_INITIALIZED);
+
+}
+
+namespace base
+{
+    namespace debug
+    {
+        volatile subtle::Atomic32 TaskProfiler::enabled_ = 0;
+
+        // static
+        void TaskProfiler::InitFromCommandLine(const CommandLine& command_line)
+        {
+            if (command_line.HasSwitch(kTaskProfiler))
+            {
+                SetEnabled(true);
+            }
+        }
+
+        // static
+        void TaskProfiler::SetEnabled(bool enabled)
+        {
+            subtle::NoBarrier_Store(&enabled_, enabled ? 1 : 0);
+        }
+
+        // static
+        void TaskProfiler::RecordTask(const std::string& thread_name,
+            const TaskRecord& record)
+        {
+            GetThreadBuffer(thread_name)->Add(record);
+        }
+
+        // static
+        void TaskProfiler::WriteTraceJSON(std::string* output)
+        {
+            ThreadBufferRegistry* registry = g_registry.Pointer();
+            AutoLock locked(registry->lock);
+
+            bool first = true;
+            output->append("{\"traceEvents\":[\n");
+            for (size_t i = 0; i < registry->buffers.size(); ++i)
+            {
+                registry->buffers[i]->AppendThreadName(output, &first);
+                registry->buffers[i]->AppendTraceEvents(output, &first);
+            }
+            output->append("\n],\"displayTimeUnit\":\"ms\"}\n");
+        }
+
+        // static
+        bool TaskProfiler::WriteTraceFile(const FilePath& path)
+        {
+            std::string output;
+            WriteTraceJSON(&output);
+            int size = static_cast<int>(output.size());
+            return WriteFile(path, output.data(), size) == size;
+        }
+
+        // static
+        void TaskProfiler::Clear()
+        {
+            ThreadBufferRegistry* registry = g_registry.Pointer();
+            AutoLock locked(registry->lock);
+            for (size_t i = 0; i < registry->buffers.size(); ++i)
+            {
+                registry->buffers[i]->Clear();
+            }
+        }
+
+        // static
+        TaskProfiler::ThreadBuffer* TaskProfiler::GetThreadBuffer(
+            const std::string& thread_name)
+        {
+            ThreadBuffer* buffer = g_tls_buffer.Pointer()->Get();
+            if (buffer)
+            {
+                return buffer;
+            }
+
+            buffer = new ThreadBuffer(thread_name);
+            g_tls_buffer.Pointer()->Set(buffer);
+
+            ThreadBufferRegistry* registry = g_registry.Pointer();
+            AutoLock locked(registry->lock);
+            registry->buffers.push_back(buffer);
+            return buffer;
+        }
+
+    } //namespace debug
+} //namespace base
@@ -0,0 +1,87 @@
+#ifndef __base_task_profiler_h__
+#define __base_task_profiler_h__
+
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/base_time.h"
+
+class CommandLine;
+class FilePath;
+
+namespace base
+{
+    namespace debug
+    {
+        // TaskProfiler records one entry per task run by a MessageLoop: where the
+        // task was posted from, how long it waited in the queue, how long it ran
+        // and the run depth of the loop that ran it.  Entries go into a fixed
+        // size ring buffer owned by the running thread, so recording never
+        // allocates and never contends with other threads.  The buffers can be
+        // exported in the Chrome trace-event JSON format (load the file in
+        // chrome://tracing), and the queue delay and run time are also
+        // accumulated into per-thread Histograms when the StatisticsRecorder is
+        // active.
+        //
+        // Profiling is off by default.  Run with --task-profiler, or call
+        // SetEnabled(), to switch it on at runtime.  When it is off the only
+        // cost to MessageLoop is a load and compare per posted and run task.
+        class TaskProfiler
+        {
+        public:
+            // Number of entries kept per thread.  Older entries are overwritten.
+            static const size_t kRingBufferSize = 8192;
+
+            // Per-thread ring buffer, defined in task_profiler.cpp.
+            class ThreadBuffer;
+
+            struct TaskRecord
+            {
+                // Return address of the Post*Task call that queued the task.
+                const void* posted_from;
+
+                // High resolution times, see TimeTicks::HighResNow().
+                TimeTicks time_posted;
+                TimeTicks start_time;
+                TimeTicks end_time;
+
+                // MessageLoop run depth the task ran at; 1 is the outermost loop.
+                int run_depth;
+            };
+
+            // Enables the profiler if |command_line| carries --task-profiler.
+            static void InitFromCommandLine(const CommandLine& command_line);
+
+            static void SetEnabled(bool enabled);
+
+            static bool IsEnabled()
+            {
+                return subtle::NoBarrier_Load(&enabled_) != 0;
+            }
+
+            // Appends |record| to the ring buffer of the calling thread.
+            // |thread_name| is only read the first time a thread records.
+            static void RecordTask(const std::string& thread_name,
+                const TaskRecord& record);
+
+            // Serializes all recorded entries as a trace-event JSON object.
+            static void WriteTraceJSON(std::string* output);
+
+            // Writes the output of WriteTraceJSON() to |path|.
+            static bool WriteTraceFile(const FilePath& path);
+
+            // Drops all recorded entries; the per-thread buffers stay registered.
+            static void Clear();
+
+        private:
+            static ThreadBuffer* GetThreadBuffer(const std::string& thread_name);
+
+            static volatile subtle::Atomic32 enabled_;
+
+            DISALLOW_IMPLICIT_CONSTRUCTORS(TaskProfiler);
+        };
+
+    } //namespace debug
+} //namespace base
+
+#endif //__base_task_profiler_h__
@@ -1,5 +1,6 @@
 #include "file_util.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "logging.h"
@@ -337,24 +338,70 @@ namespace base
 
     bool ReadFileToString(const FilePath& path, std::string* contents)
     {
-        FILE* file = OpenFile(path, "rb");
+        ThreadRestrictions::AssertIOAllowed();
+        win::ScopedHandle file(CreateFile(path.value().c_str(),
+            GENERIC_READ,
+            kFileShareAll,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN,
+            NULL));
         if (!file)
         {
             return false;
         }
+        if (!contents)
+        {
+            return true;
+        }
 
-        char buf[1 << 16];
-        size_t len;
-        while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+        // Size the string once and read straight into it, in pieces small
+        // enough for a DWORD count.  The size is only a hint: a file that
+        // grows meanwhile, or a device that reports no size, is still read
+        // to the end.
+        const DWORD kMaxReadSize = 32 * 1024 * 1024;
+        size_t length = contents->size();
+        LARGE_INTEGER file_size;
+        if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
         {
-            if (contents)
+            if (static_cast<uint64>(file_size.QuadPart) >
+                contents->max_size() - length)
             {
-                contents->append(buf, len);
+                return false;
             }
+            contents->resize(length + static_cast<size_t>(file_size.QuadPart));
         }
-        CloseFile(file);
 
-        return true;
+        while (length < contents->size())
+        {
+            DWORD bytes_read;
+            DWORD to_read = static_cast<DWORD>(std::min<size_t>(
+                contents->size() - length, kMaxReadSize));
+            if (!::ReadFile(file, &(*contents)[length], to_read, &bytes_read,
+                NULL))
+            {
+                contents->resize(length);
+                return false;
+            }
+            if (bytes_read == 0)
+            {
+                break;
+            }
+            length += bytes_read;
+        }
+        contents->resize(length);
+
+        char buf[1 << 16];
+        DWORD bytes_read;
+        while (::ReadFile(file, buf, sizeof(buf), &bytes_read, NULL))
+        {
+            if (bytes_read == 0)
+            {
+                return true;
+            }
+            contents->append(buf, bytes_read);
+        }
+        return false;
     }
 
     bool Move(const FilePath& from_path, const FilePath& to_path)
@@ -880,11 +927,17 @@ namespace base
     }
 
 
+    // static
+    const size_t MemoryMappedFile::kReadAheadWindow = 8 * 1024 * 1024;
+
     MemoryMappedFile::MemoryMappedFile()
         : file_(INVALID_HANDLE_VALUE),
         file_mapping_(INVALID_HANDLE_VALUE),
         data_(NULL),
-        length_(INVALID_FILE_SIZE) {}
+        length_(INVALID_FILE_SIZE),
+        hint_(ACCESS_NORMAL),
+        prefetched_end_(0),
+        released_end_(0) {}
 
     MemoryMappedFile::~MemoryMappedFile()
     {
@@ -910,30 +963,105 @@ namespace base
     }
 
     bool MemoryMappedFile::Initialize(const FilePath& file_name)
+    {
+        return Initialize(file_name, ACCESS_NORMAL);
+    }
+
+    bool MemoryMappedFile::Initialize(const FilePath& file_name,
+        AccessHint hint)
     {
         if (IsValid())
         {
             return false;
         }
 
-        if (!MapFileToMemory(file_name))
+        if (!MapFileToMemory(file_name, hint))
         {
             CloseHandles();
             return false;
         }
 
+        // Only the first window: prefetching all of a large file would push
+        // its start out of memory again before it is read.
+        hint_ = hint;
+        ReadAhead(0);
         return true;
     }
 
+    void MemoryMappedFile::WillNeed(size_t offset, size_t length)
+    {
+        if (!data_ || offset >= length_)
+        {
+            return;
+        }
+
+        // PrefetchVirtualMemory() is new in Windows 8; without it the pages
+        // are simply faulted in on first touch.
+        // Same layout as WIN32_MEMORY_RANGE_ENTRY, which older SDKs lack.
+        struct MemoryRangeEntry
+        {
+            void* virtual_address;
+            SIZE_T number_of_bytes;
+        };
+        typedef BOOL (WINAPI* PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR,
+            MemoryRangeEntry*, ULONG);
+        static PrefetchVirtualMemoryFunc prefetch_virtual_memory =
+            reinterpret_cast<PrefetchVirtualMemoryFunc>(::GetProcAddress(
+            ::GetModuleHandle(L"kernel32.dll"), "PrefetchVirtualMemory"));
+        if (!prefetch_virtual_memory)
+        {
+            return;
+        }
+
+        MemoryRangeEntry range;
+        range.virtual_address = data_ + offset;
+        range.number_of_bytes = std::min(length, length_ - offset);
+        prefetch_virtual_memory(::GetCurrentProcess(), 1, &range, 0);
+    }
+
+    void MemoryMappedFile::ReadAhead(size_t offset)
+    {
+        if (!data_ || hint_ != ACCESS_SEQUENTIAL)
+        {
+            return;
+        }
+
+        if (prefetched_end_ < length_ &&
+            offset + kReadAheadWindow / 2 >= prefetched_end_)
+        {
+            size_t start = std::max(offset, prefetched_end_);
+            size_t end = std::min(length_, offset + kReadAheadWindow);
+            WillNeed(start, end - start);
+            prefetched_end_ = end;
+        }
+
+        // Unlocking pages that are not locked takes them out of the working
+        // set; they stay cached and come back without I/O if read again.
+        // Released in whole windows, so that this costs a call per window.
+        const size_t kPageMask = 4096 - 1;
+        if (offset >= released_end_ + 2 * kReadAheadWindow)
+        {
+            size_t release_end = (offset - kReadAheadWindow) & ~kPageMask;
+            ::VirtualUnlock(data_ + released_end_,
+                release_end - released_end_);
+            released_end_ = release_end;
+        }
+    }
+
     bool MemoryMappedFile::IsValid()
     {
         return data_ != NULL;
     }
 
-    bool MemoryMappedFile::MapFileToMemory(const FilePath& file_name)
+    bool MemoryMappedFile::MapFileToMemory(const FilePath& file_name,
+        AccessHint hint)
     {
-        file_ = CreatePlatformFile(file_name,
-            PLATFORM_FILE_OPEN | PLATFORM_FILE_READ, NULL, NULL);
+        int flags = PLATFORM_FILE_OPEN | PLATFORM_FILE_READ;
+        if (hint == ACCESS_SEQUENTIAL)
+        {
+            flags |= PLATFORM_FILE_SEQUENTIAL_SCAN;
+        }
+        file_ = CreatePlatformFile(file_name, flags, NULL, NULL);
 
         if (file_ == kInvalidPlatformFileValue)
         {
@@ -958,11 +1086,16 @@ namespace base
             return false;
         }
 
-        length_ = ::GetFileSize(file_, NULL);
-        if (length_ == INVALID_FILE_SIZE)
+        // GetFileSize() cannot tell a 4GB file from an error; views larger
+        // than the address space cannot be mapped anyway.
+        LARGE_INTEGER file_size;
+        if (!::GetFileSizeEx(file_, &file_size) || file_size.QuadPart <= 0 ||
+            static_cast<uint64>(file_size.QuadPart) >
+            std::numeric_limits<size_t>::max())
         {
             return false;
         }
+        length_ = static_cast<size_t>(file_size.QuadPart);
 
         file_mapping_ = ::CreateFileMapping(file_, NULL, PAGE_READONLY | flags,
             0, 0, NULL);
@@ -1003,6 +1136,9 @@ namespace base
         data_ = NULL;
         file_mapping_ = file_ = INVALID_HANDLE_VALUE;
         length_ = INVALID_FILE_SIZE;
+        hint_ = ACCESS_NORMAL;
+        prefetched_end_ = 0;
+        released_end_ = 0;
     }
 
 } //namespace base
@@ -40,6 +40,8 @@ namespace base
 
     FILE* CreateAndOpenTemporaryFileInDir(const FilePath& dir, FilePath* path);
 
+    // Appends the whole file at |path| to |contents|, which may be NULL to
+    // only check that the file can be opened.
     bool ReadFileToString(const FilePath& path, std::string* contents);
 
     int ReadFile(const FilePath& filename, char* data, int size);
@@ -157,19 +159,44 @@ namespace base
     class MemoryMappedFile
     {
     public:
+        // How the mapping is going to be read.
+        enum AccessHint
+        {
+            ACCESS_NORMAL,
+            // Front to back, e.g. to load a document: the file is opened for
+            // sequential scan and a window ahead of the reader, who reports
+            // progress with ReadAhead(), is prefetched.
+            ACCESS_SEQUENTIAL,
+        };
+
+        // How far ahead of the reader ACCESS_SEQUENTIAL prefetches.
+        static const size_t kReadAheadWindow;
+
         MemoryMappedFile();
         ~MemoryMappedFile();
 
         bool Initialize(const FilePath& file_name);
+        bool Initialize(const FilePath& file_name, AccessHint hint);
         bool Initialize(PlatformFile file);
 
+        // Asks the system to page in |length| bytes at |offset| ahead of use.
+        // Does nothing where that is not supported.
+        void WillNeed(size_t offset, size_t length);
+
+        // For ACCESS_SEQUENTIAL: the reader has got to |offset|.  Once it is
+        // half way through the window prefetched last, the next one is
+        // asked for, and pages a window or more behind it leave the working
+        // set, so that a file larger than memory is read with a bounded
+        // footprint.  Does nothing for other hints.
+        void ReadAhead(size_t offset);
+
         const uint8* data() const { return data_; }
         size_t length() const { return length_; }
 
         bool IsValid();
 
     private:
-        bool MapFileToMemory(const FilePath& file_name);
+        bool MapFileToMemory(const FilePath& file_name, AccessHint hint);
 
         bool MapFileToMemoryInternal();
 
@@ -182,6 +209,12 @@ namespace base
         uint8* data_;
         size_t length_;
 
+        // For ACCESS_SEQUENTIAL: the end of the range prefetched so far, and
+        // of the range taken out of the working set.
+        AccessHint hint_;
+        size_t prefetched_end_;
+        size_t released_end_;
+
         DISALLOW_COPY_AND_ASSIGN(MemoryMappedFile);
     };
 
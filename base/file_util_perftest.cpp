@@ -0,0 +1,198 @@
+// Time and working set for reading files of 1 MB to 2 GB in full: with
+// ReadFileToString(), through a MemoryMappedFile read as it comes, and
+// through one opened with ACCESS_SEQUENTIAL whose reader reports progress
+// with ReadAhead().  The working set is trimmed before each read and
+// sampled as it goes; its peak growth is shown.  The files have just been
+// written, so they are mostly in the cache: this measures the copy and the
+// footprint rather than the disk.  Sizes a 32-bit build cannot hold are
+// skipped.
+
+#include <windows.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/platform_file.h"
+#include "base/process_util.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    const int64 kMegabyte = 1024 * 1024;
+    const int64 kFileSizes[] =
+    {
+        kMegabyte, 32 * kMegabyte, 256 * kMegabyte, 2048 * kMegabyte,
+    };
+
+    // The working set is sampled every this many bytes read.
+    const size_t kSampleInterval = 4 * 1024 * 1024;
+
+    bool WriteTestFile(const FilePath& path, int64 size)
+    {
+        base::PlatformFile file = base::CreatePlatformFile(path,
+            base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_WRITE,
+            NULL, NULL);
+        if (file == base::kInvalidPlatformFileValue)
+        {
+            return false;
+        }
+        // Lines of text, as a document would have.
+        std::string block;
+        for (int line = 0; block.length() < kSampleInterval; ++line)
+        {
+            char text[80];
+            _snprintf_s(text, sizeof(text), _TRUNCATE,
+                "line %8d of a large document to be read in full\r\n", line);
+            block += text;
+        }
+        bool written = true;
+        for (int64 offset = 0; written && offset < size;)
+        {
+            int length = static_cast<int>(std::min<int64>(block.length(),
+                size - offset));
+            written = base::WritePlatformFile(file, offset, block.data(),
+                length) == length;
+            offset += length;
+        }
+        base::ClosePlatformFile(file);
+        return written;
+    }
+
+    class WorkingSet
+    {
+    public:
+        WorkingSet()
+            : metrics_(base::ProcessMetrics::CreateProcessMetrics(
+            base::GetCurrentProcessHandle())),
+            start_(0),
+            peak_(0)
+        {
+            // Start from an empty working set.
+            ::SetProcessWorkingSetSize(::GetCurrentProcess(),
+                static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+            start_ = metrics_->GetWorkingSetSize();
+            peak_ = start_;
+        }
+
+        void Sample()
+        {
+            peak_ = std::max(peak_, metrics_->GetWorkingSetSize());
+        }
+
+        double PeakGrowthMegabytes() const
+        {
+            return (peak_ - start_) / static_cast<double>(kMegabyte);
+        }
+
+    private:
+        scoped_ptr<base::ProcessMetrics> metrics_;
+        size_t start_;
+        size_t peak_;
+    };
+
+    // Reads every byte, as a line counter would.
+    size_t CountLines(const char* data, size_t length, WorkingSet* working_set,
+        base::MemoryMappedFile* file)
+    {
+        size_t lines = 0;
+        for (size_t offset = 0; offset < length; offset += kSampleInterval)
+        {
+            if (file)
+            {
+                file->ReadAhead(offset);
+            }
+            size_t end = std::min(length, offset + kSampleInterval);
+            lines += static_cast<size_t>(
+                std::count(data + offset, data + end, '\n'));
+            working_set->Sample();
+        }
+        return lines;
+    }
+
+    void PrintRead(const char* how, int64 size, double ms,
+        const WorkingSet& working_set)
+    {
+        char name[64];
+        _snprintf_s(name, sizeof(name), _TRUNCATE, "%s, %d MB", how,
+            static_cast<int>(size / kMegabyte));
+        base::test::PrintRate(name, ms, size / static_cast<double>(kMegabyte),
+            "MB");
+        printf("  working set grew by %.1f MB at most\n",
+            working_set.PeakGrowthMegabytes());
+    }
+
+    void TimeFile(const FilePath& path, int64 size)
+    {
+        if (static_cast<uint64>(size) >=
+            std::numeric_limits<size_t>::max() / 2)
+        {
+            return;
+        }
+        if (!WriteTestFile(path, size))
+        {
+            fprintf(stderr, "cannot write a %d MB test file\n",
+                static_cast<int>(size / kMegabyte));
+            return;
+        }
+
+        size_t expected_lines = 0;
+        {
+            WorkingSet working_set;
+            base::test::Timer timer;
+            std::string contents;
+            bool read = base::ReadFileToString(path, &contents);
+            expected_lines = CountLines(contents.data(), contents.length(),
+                &working_set, NULL);
+            double ms = timer.ElapsedMs();
+            if (read)
+            {
+                PrintRead("ReadFileToString", size, ms, working_set);
+            }
+        }
+
+        const base::MemoryMappedFile::AccessHint kHints[] =
+        {
+            base::MemoryMappedFile::ACCESS_NORMAL,
+            base::MemoryMappedFile::ACCESS_SEQUENTIAL,
+        };
+        for (size_t i = 0; i < arraysize(kHints); ++i)
+        {
+            WorkingSet working_set;
+            base::test::Timer timer;
+            base::MemoryMappedFile file;
+            if (!file.Initialize(path, kHints[i]))
+            {
+                continue;
+            }
+            size_t lines = CountLines(
+                reinterpret_cast<const char*>(file.data()), file.length(),
+                &working_set, &file);
+            double ms = timer.ElapsedMs();
+            EXPECT(expected_lines == 0 || lines == expected_lines);
+            PrintRead(kHints[i] == base::MemoryMappedFile::ACCESS_SEQUENTIAL ?
+                "mapped, sequential" : "mapped", size, ms, working_set);
+        }
+    }
+
+}
+
+void RunFileUtilPerfTests()
+{
+    FilePath path;
+    if (!base::CreateTemporaryFile(&path))
+    {
+        fprintf(stderr, "cannot create a temporary file\n");
+        return;
+    }
+    for (size_t i = 0; i < arraysize(kFileSizes); ++i)
+    {
+        TimeFile(path, kFileSizes[i]);
+    }
+    base::Delete(path, false);
+}
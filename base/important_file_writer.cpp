@@ -0,0 +1,177 @@
+#include "important_file_writer.h"
+
+#include "file_util.h"
+#include "logging.h"
+#include "message_loop_proxy.h"
+#include "platform_file.h"
+#include "task.h"
+
+namespace
+{
+
+    const int kDefaultCommitIntervalMs = 10000;
+
+    void LogFailure(const FilePath& path, const char* message)
+    {
+        PLOG(WARNING) << "failed to write " << path.value() << ": " << message;
+    }
+
+    void WriteToDiskTask(const FilePath& path, const std::string& data)
+    {
+        base::ImportantFileWriter::WriteFileAtomically(path, data);
+    }
+
+}
+
+namespace base
+{
+
+    ImportantFileWriter::ImportantFileWriter(const FilePath& path,
+        MessageLoopProxy* file_message_loop_proxy)
+        : path_(path),
+        file_message_loop_proxy_(file_message_loop_proxy),
+        serializer_(NULL),
+        commit_interval_(TimeDelta::FromMilliseconds(kDefaultCommitIntervalMs)),
+        scheduled_writes_(0),
+        coalesced_writes_(0),
+        committed_writes_(0)
+    {
+        DCHECK(file_message_loop_proxy_.get());
+    }
+
+    ImportantFileWriter::~ImportantFileWriter()
+    {
+        DCHECK(thread_checker_.CalledOnValidThread());
+        // Do not lose the last edits on shutdown.
+        if (HasPendingWrite())
+        {
+            DoScheduledWrite();
+        }
+    }
+
+    // static
+    bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
+        const std::string& data)
+    {
+        // The temporary file goes next to the target so that the rename stays
+        // on one volume, where it is atomic.
+        FilePath tmp_file_path;
+        if (!CreateTemporaryFileInDir(path.DirName(), &tmp_file_path))
+        {
+            LogFailure(path, "could not create temporary file");
+            return false;
+        }
+
+        PlatformFile tmp_file = CreatePlatformFile(tmp_file_path,
+            PLATFORM_FILE_OPEN | PLATFORM_FILE_WRITE, NULL, NULL);
+        if (tmp_file == kInvalidPlatformFileValue)
+        {
+            LogFailure(path, "could not open temporary file");
+            Delete(tmp_file_path, false);
+            return false;
+        }
+
+        // The data has to be on disk before the rename, or a crash could
+        // leave the target renamed but empty.
+        int bytes_written = WritePlatformFile(tmp_file, 0, data.data(),
+            static_cast<int>(data.length()));
+        bool flushed = FlushPlatformFile(tmp_file);
+        ClosePlatformFile(tmp_file);
+        if (bytes_written != static_cast<int>(data.length()))
+        {
+            LogFailure(path, "error writing temporary file");
+            Delete(tmp_file_path, false);
+            return false;
+        }
+        if (!flushed)
+        {
+            LogFailure(path, "error flushing temporary file");
+            Delete(tmp_file_path, false);
+            return false;
+        }
+
+        if (!Move(tmp_file_path, path))
+        {
+            LogFailure(path, "could not rename temporary file");
+            Delete(tmp_file_path, false);
+            return false;
+        }
+        return true;
+    }
+
+    bool ImportantFileWriter::HasPendingWrite() const
+    {
+        DCHECK(thread_checker_.CalledOnValidThread());
+        return timer_.IsRunning();
+    }
+
+    void ImportantFileWriter::WriteNow(const std::string& data)
+    {
+        DCHECK(thread_checker_.CalledOnValidThread());
+        if (data.length() > static_cast<size_t>(kint32max))
+        {
+            NOTREACHED();
+            return;
+        }
+
+        if (HasPendingWrite())
+        {
+            // The pending write would only repeat this one.
+            timer_.Stop();
+            ++coalesced_writes_;
+        }
+        serializer_ = NULL;
+        ++committed_writes_;
+
+        if (!file_message_loop_proxy_->PostTask(
+            NewRunnableFunction(&WriteToDiskTask, path_, data)))
+        {
+            // Posting fails when the file thread is already gone, as it
+            // can be on shutdown.  Write here rather than lose the data.
+            LOG(WARNING) << "file thread gone, writing " << path_.value()
+                << " on the calling thread";
+            WriteFileAtomically(path_, data);
+        }
+    }
+
+    void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer)
+    {
+        DCHECK(thread_checker_.CalledOnValidThread());
+        DCHECK(serializer);
+
+        ++scheduled_writes_;
+        serializer_ = serializer;
+        if (timer_.IsRunning())
+        {
+            // The pending write will pick up this serializer's data instead;
+            // its deadline is kept so that a steady stream of edits still
+            // gets written every commit_interval().
+            ++coalesced_writes_;
+            return;
+        }
+        timer_.Start(commit_interval_, this,
+            &ImportantFileWriter::DoScheduledWrite);
+    }
+
+    void ImportantFileWriter::DoScheduledWrite()
+    {
+        DCHECK(thread_checker_.CalledOnValidThread());
+        DCHECK(serializer_);
+
+        DataSerializer* serializer = serializer_;
+        timer_.Stop();
+        serializer_ = NULL;
+
+        std::string data;
+        if (serializer->SerializeData(&data))
+        {
+            WriteNow(data);
+        }
+        else
+        {
+            DLOG(WARNING) << "failed to serialize data to be saved in "
+                << path_.value();
+        }
+    }
+
+} //namespace base
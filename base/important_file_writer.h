@@ -0,0 +1,100 @@
+#ifndef __base_important_file_writer_h__
+#define __base_important_file_writer_h__
+
+#include <string>
+
+#include "base_time.h"
+#include "file_path.h"
+#include "memory/ref_counted.h"
+#include "threading/thread_checker.h"
+#include "timer.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+
+    // Writes a file that must survive crashes, such as autosave or session
+    // state, without blocking the calling thread.
+    //
+    // Each write goes to a temporary file in the same directory, is flushed
+    // to disk and then renamed over the target, so readers see either the old
+    // or the new contents, never a mix.  The disk work runs on the thread of
+    // |file_message_loop_proxy|.
+    //
+    // ScheduleWrite() does not write at once: it waits commit_interval() and
+    // then asks the DataSerializer for the data.  A write scheduled while one
+    // is pending replaces it, so a burst of edits costs one write.
+    //
+    // Must be used on the thread it was created on, which needs a
+    // MessageLoop for the timer.  Pending writes are committed on destruction.
+    class ImportantFileWriter
+    {
+    public:
+        // Produces the data when a scheduled write is due.
+        class DataSerializer
+        {
+        public:
+            virtual ~DataSerializer() {}
+
+            // Returns false to skip the write.
+            virtual bool SerializeData(std::string* data) = 0;
+        };
+
+        ImportantFileWriter(const FilePath& path,
+            MessageLoopProxy* file_message_loop_proxy);
+        ~ImportantFileWriter();
+
+        // Writes |path| atomically on the calling thread.
+        static bool WriteFileAtomically(const FilePath& path,
+            const std::string& data);
+
+        const FilePath& path() const { return path_; }
+
+        bool HasPendingWrite() const;
+
+        // Hands |data| to the file thread at once, dropping any pending
+        // scheduled write.
+        void WriteNow(const std::string& data);
+
+        // Writes after commit_interval(), replacing any pending write.
+        // |serializer| must stay alive until the write is done or
+        // replaced, or until the writer is destroyed.
+        void ScheduleWrite(DataSerializer* serializer);
+
+        // Commits the pending scheduled write now.
+        void DoScheduledWrite();
+
+        TimeDelta commit_interval() const { return commit_interval_; }
+        void set_commit_interval(const TimeDelta& interval)
+        {
+            commit_interval_ = interval;
+        }
+
+        // ScheduleWrite() calls so far.
+        int64 scheduled_writes() const { return scheduled_writes_; }
+        // Pending writes made redundant by a later ScheduleWrite() or
+        // WriteNow().
+        int64 coalesced_writes() const { return coalesced_writes_; }
+        // Writes handed to the file thread, scheduled or not.
+        int64 committed_writes() const { return committed_writes_; }
+
+    private:
+        const FilePath path_;
+        scoped_refptr<MessageLoopProxy> file_message_loop_proxy_;
+
+        DataSerializer* serializer_;
+        OneShotTimer<ImportantFileWriter> timer_;
+        TimeDelta commit_interval_;
+
+        int64 scheduled_writes_;
+        int64 coalesced_writes_;
+        int64 committed_writes_;
+
+        ThreadChecker thread_checker_;
+
+        DISALLOW_COPY_AND_ASSIGN(ImportantFileWriter);
+    };
+
+} //namespace base
+
+#endif //__base_important_file_writer_h__
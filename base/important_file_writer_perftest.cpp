@@ -0,0 +1,176 @@
+// What saving through ImportantFileWriter costs.  First the time per write
+// of WriteFileAtomically(), which flushes a temporary file and renames it,
+// next to a plain WriteFile(), for files of 4 KB to 4 MB.  Then the write
+// amplification of autosave: a 256 KB document edited every 5 ms for two
+// seconds, each edit calling ScheduleWrite(), at several commit intervals;
+// for each, the writes that reached the disk and the bytes written per edit.
+// The timers run at the resolution Windows gives them, so the edit rate
+// actually reached is printed too.
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/important_file_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/scoped_temp_dir.h"
+#include "base/test/test_util.h"
+#include "base/threading/thread.h"
+#include "base/timer.h"
+
+namespace
+{
+
+    struct WriteSize
+    {
+        size_t bytes;
+        int repeats;
+    };
+
+    const WriteSize kWriteSizes[] =
+    {
+        { 4 * 1024, 100 },
+        { 256 * 1024, 50 },
+        { 4 * 1024 * 1024, 10 },
+    };
+
+    const size_t kDocumentBytes = 256 * 1024;
+    const int kEditIntervalMs = 5;
+    const int kEdits = 400;
+    const int kCommitIntervalsMs[] = { 0, 50, 500, 2000 };
+
+    void TimeWrites(const FilePath& directory, const WriteSize& size)
+    {
+        FilePath path = directory.Append(L"document.txt");
+        std::string data(size.bytes, 'd');
+        char name[64];
+
+        base::test::Timer atomic_timer;
+        for (int i = 0; i < size.repeats; ++i)
+        {
+            EXPECT(base::ImportantFileWriter::WriteFileAtomically(path, data));
+        }
+        _snprintf_s(name, sizeof(name), _TRUNCATE,
+            "WriteFileAtomically, %d KB", static_cast<int>(size.bytes / 1024));
+        base::test::PrintCost(name, atomic_timer.ElapsedMs(), size.repeats);
+
+        base::test::Timer plain_timer;
+        for (int i = 0; i < size.repeats; ++i)
+        {
+            EXPECT(base::WriteFile(path, data.data(),
+                static_cast<int>(data.size())) ==
+                static_cast<int>(data.size()));
+        }
+        _snprintf_s(name, sizeof(name), _TRUNCATE, "WriteFile, %d KB",
+            static_cast<int>(size.bytes / 1024));
+        base::test::PrintCost(name, plain_timer.ElapsedMs(), size.repeats);
+
+        base::Delete(path, false);
+    }
+
+    // Edits a document every kEditIntervalMs, scheduling a save after each
+    // edit, and quits the loop after kEdits of them.
+    class Editor : public base::ImportantFileWriter::DataSerializer
+    {
+    public:
+        explicit Editor(base::ImportantFileWriter* writer)
+            : writer_(writer), document_(kDocumentBytes, ' '), edits_(0),
+            writes_(0), bytes_written_(0) {}
+
+        void Start()
+        {
+            timer_.Start(base::TimeDelta::FromMilliseconds(kEditIntervalMs),
+                this, &Editor::Edit);
+        }
+
+        virtual bool SerializeData(std::string* data)
+        {
+            *data = document_;
+            ++writes_;
+            bytes_written_ += document_.size();
+            return true;
+        }
+
+        int edits() const { return edits_; }
+        // Every serialization is handed to the file thread and written.
+        int writes() const { return writes_; }
+        int64 bytes_written() const { return bytes_written_; }
+
+    private:
+        void Edit()
+        {
+            document_[(edits_ * 61) % document_.size()] = 'a' + edits_ % 26;
+            writer_->ScheduleWrite(this);
+            if (++edits_ == kEdits)
+            {
+                timer_.Stop();
+                MessageLoop::current()->Quit();
+            }
+        }
+
+        base::ImportantFileWriter* writer_;
+        std::string document_;
+        int edits_;
+        int writes_;
+        int64 bytes_written_;
+        base::RepeatingTimer<Editor> timer_;
+    };
+
+    void TimeAutosave(const FilePath& directory, int commit_interval_ms)
+    {
+        base::Thread file_thread("file");
+        if (!file_thread.Start())
+        {
+            fprintf(stderr, "cannot start the file thread\n");
+            return;
+        }
+
+        scoped_ptr<base::ImportantFileWriter> writer(
+            new base::ImportantFileWriter(directory.Append(L"autosave.txt"),
+            file_thread.message_loop_proxy()));
+        writer->set_commit_interval(
+            base::TimeDelta::FromMilliseconds(commit_interval_ms));
+        Editor editor(writer.get());
+        base::test::Timer timer;
+        editor.Start();
+        MessageLoop::current()->Run();
+        int64 scheduled = writer->scheduled_writes();
+        // The last edits are saved when the writer goes away, and are on
+        // disk once the file thread has stopped.
+        writer.reset();
+        file_thread.Stop();
+        double ms = timer.ElapsedMs();
+
+        EXPECT(scheduled == kEdits);
+        printf("commit every %4d ms: %d edits at %.0f/s, %d writes, "
+            "%.0f bytes written per edit\n", commit_interval_ms,
+            editor.edits(), ms > 0 ? editor.edits() / ms * 1000 : 0.0,
+            editor.writes(), static_cast<double>(editor.bytes_written()) /
+            editor.edits());
+    }
+
+}
+
+void RunImportantFileWriterPerfTests()
+{
+    ScopedTempDir temp_dir;
+    if (!temp_dir.CreateUniqueTempDir())
+    {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return;
+    }
+
+    for (size_t i = 0; i < arraysize(kWriteSizes); ++i)
+    {
+        TimeWrites(temp_dir.path(), kWriteSizes[i]);
+    }
+
+    MessageLoop loop;
+    for (size_t i = 0; i < arraysize(kCommitIntervalsMs); ++i)
+    {
+        TimeAutosave(temp_dir.path(), kCommitIntervalsMs[i]);
+    }
+}
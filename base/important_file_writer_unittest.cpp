@@ -0,0 +1,302 @@
+// Checks that ImportantFileWriter::WriteFileAtomically() replaces a file
+// whole, leaves no temporary file behind whether it succeeds or fails, and
+// never lets a reader on another thread see anything but a complete old or
+// new version; and that scheduled writes are coalesced, replaced by
+// WriteNow(), skipped when the serializer fails, committed on destruction
+// and still written once the file thread is gone, with the counters to
+// match.
+
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/important_file_writer.h"
+#include "base/message_loop.h"
+#include "base/scoped_temp_dir.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
+
+namespace
+{
+
+    std::string ReadFile(const FilePath& path)
+    {
+        std::string contents;
+        if (!base::ReadFileToString(path, &contents))
+        {
+            return "<missing>";
+        }
+        return contents;
+    }
+
+    std::vector<FilePath> ListDirectory(const FilePath& directory)
+    {
+        std::vector<FilePath> paths;
+        base::FileEnumerator enumerator(directory, false,
+            static_cast<base::FileEnumerator::FileType>(
+            base::FileEnumerator::FILES | base::FileEnumerator::DIRECTORIES));
+        for (FilePath path = enumerator.Next(); !path.empty();
+            path = enumerator.Next())
+        {
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    void TestWriteFileAtomically(const FilePath& directory)
+    {
+        FilePath path = directory.Append(L"state.json");
+        EXPECT(base::ImportantFileWriter::WriteFileAtomically(path, "first"));
+        EXPECT(ReadFile(path) == "first");
+
+        // Replacing with larger and then smaller contents leaves no tail of
+        // the old ones.
+        std::string large(3 * 1024 * 1024 + 17, 'L');
+        EXPECT(base::ImportantFileWriter::WriteFileAtomically(path, large));
+        EXPECT(ReadFile(path) == large);
+        EXPECT(base::ImportantFileWriter::WriteFileAtomically(path, "s"));
+        EXPECT(ReadFile(path) == "s");
+        EXPECT(base::ImportantFileWriter::WriteFileAtomically(path,
+            std::string()));
+        EXPECT(ReadFile(path).empty());
+
+        // A missing directory is not created.
+        FilePath missing = directory.Append(L"missing");
+        EXPECT(!base::ImportantFileWriter::WriteFileAtomically(
+            missing.Append(L"state.json"), "data"));
+        EXPECT(!base::PathExists(missing));
+
+        // A directory in the way fails the rename; the temporary file goes.
+        FilePath folder = directory.Append(L"folder");
+        EXPECT(base::CreateDirectory(folder));
+        EXPECT(!base::ImportantFileWriter::WriteFileAtomically(folder,
+            "data"));
+        EXPECT(base::DirectoryExists(folder));
+
+        std::vector<FilePath> paths = ListDirectory(directory);
+        EXPECT(paths.size() == 2);
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            EXPECT(paths[i] == path || paths[i] == folder);
+        }
+        base::Delete(folder, false);
+        base::Delete(path, false);
+    }
+
+    // Reads |path| over and over until told to stop, counting reads that
+    // are neither of two versions.
+    class Reader : public base::PlatformThread::Delegate
+    {
+    public:
+        Reader(const FilePath& path, const std::string& first,
+            const std::string& second)
+            : path_(path), first_(first), second_(second), stop_(false),
+            reads_(0), torn_reads_(0) {}
+
+        virtual void ThreadMain()
+        {
+            while (!stop_)
+            {
+                std::string contents;
+                // Opening fails now and then while the file is replaced.
+                if (base::ReadFileToString(path_, &contents))
+                {
+                    ++reads_;
+                    if (contents != first_ && contents != second_)
+                    {
+                        ++torn_reads_;
+                    }
+                }
+            }
+        }
+
+        void Stop() { stop_ = true; }
+        int reads() const { return reads_; }
+        int torn_reads() const { return torn_reads_; }
+
+    private:
+        const FilePath path_;
+        const std::string first_;
+        const std::string second_;
+        volatile bool stop_;
+        int reads_;
+        int torn_reads_;
+    };
+
+    void TestConcurrentReader(const FilePath& directory)
+    {
+        // Versions of different lengths and contents, so that a mix of the
+        // two or a partly written file shows.
+        FilePath path = directory.Append(L"session.dat");
+        std::string first(256 * 1024, '1');
+        std::string second(200 * 1024, '2');
+        EXPECT(base::ImportantFileWriter::WriteFileAtomically(path, first));
+
+        Reader reader(path, first, second);
+        base::PlatformThreadHandle handle;
+        EXPECT(base::PlatformThread::Create(0, &reader, &handle));
+        int written = 0;
+        for (int i = 0; i < 200; ++i)
+        {
+            // The rename fails while the reader has the file open; that
+            // leaves the old version, which is what atomic means.
+            if (base::ImportantFileWriter::WriteFileAtomically(path,
+                i % 2 ? first : second))
+            {
+                ++written;
+            }
+        }
+        reader.Stop();
+        base::PlatformThread::Join(handle);
+
+        EXPECT(written > 0);
+        EXPECT(reader.reads() > 0);
+        EXPECT(reader.torn_reads() == 0);
+        EXPECT(ListDirectory(directory).size() == 1);
+        base::Delete(path, false);
+    }
+
+    class Serializer : public base::ImportantFileWriter::DataSerializer
+    {
+    public:
+        explicit Serializer(const std::string& data)
+            : data_(data), succeed_(true), calls_(0) {}
+
+        virtual bool SerializeData(std::string* data)
+        {
+            ++calls_;
+            *data = data_;
+            return succeed_;
+        }
+
+        void set_data(const std::string& data) { data_ = data; }
+        void set_succeed(bool succeed) { succeed_ = succeed; }
+        int calls() const { return calls_; }
+
+    private:
+        std::string data_;
+        bool succeed_;
+        int calls_;
+    };
+
+    // Runs the current loop until the scheduled writes are due.
+    void RunFor(int ms)
+    {
+        MessageLoop::current()->PostDelayedTask(new MessageLoop::QuitTask,
+            ms);
+        MessageLoop::current()->Run();
+    }
+
+    void TestScheduledWrites(const FilePath& directory)
+    {
+        FilePath path = directory.Append(L"autosave.txt");
+
+        // A burst of edits is written once, with the last data.
+        {
+            base::Thread file_thread("file");
+            EXPECT(file_thread.Start());
+            Serializer serializer("edit 0");
+            base::ImportantFileWriter writer(path,
+                file_thread.message_loop_proxy());
+            writer.set_commit_interval(base::TimeDelta::FromMilliseconds(20));
+            for (int i = 1; i <= 5; ++i)
+            {
+                serializer.set_data(i == 5 ? "edit 5" : "older edit");
+                writer.ScheduleWrite(&serializer);
+            }
+            EXPECT(writer.HasPendingWrite());
+            EXPECT(writer.scheduled_writes() == 5);
+            EXPECT(writer.coalesced_writes() == 4);
+            EXPECT(writer.committed_writes() == 0);
+
+            RunFor(200);
+            EXPECT(!writer.HasPendingWrite());
+            EXPECT(serializer.calls() == 1);
+            EXPECT(writer.committed_writes() == 1);
+            file_thread.Stop();
+        }
+        EXPECT(ReadFile(path) == "edit 5");
+
+        // WriteNow() replaces the pending write.
+        {
+            base::Thread file_thread("file");
+            EXPECT(file_thread.Start());
+            Serializer serializer("scheduled");
+            base::ImportantFileWriter writer(path,
+                file_thread.message_loop_proxy());
+            writer.ScheduleWrite(&serializer);
+            writer.WriteNow("now");
+            EXPECT(!writer.HasPendingWrite());
+            EXPECT(writer.coalesced_writes() == 1);
+            EXPECT(writer.committed_writes() == 1);
+            file_thread.Stop();
+            EXPECT(serializer.calls() == 0);
+        }
+        EXPECT(ReadFile(path) == "now");
+
+        // A failing serializer writes nothing.
+        {
+            base::Thread file_thread("file");
+            EXPECT(file_thread.Start());
+            Serializer serializer("never");
+            serializer.set_succeed(false);
+            base::ImportantFileWriter writer(path,
+                file_thread.message_loop_proxy());
+            writer.set_commit_interval(base::TimeDelta::FromMilliseconds(1));
+            writer.ScheduleWrite(&serializer);
+            RunFor(100);
+            EXPECT(serializer.calls() == 1);
+            EXPECT(writer.committed_writes() == 0);
+            file_thread.Stop();
+        }
+        EXPECT(ReadFile(path) == "now");
+
+        // Destruction commits the pending write however far off it is.
+        {
+            base::Thread file_thread("file");
+            EXPECT(file_thread.Start());
+            Serializer serializer("on exit");
+            {
+                base::ImportantFileWriter writer(path,
+                    file_thread.message_loop_proxy());
+                writer.set_commit_interval(base::TimeDelta::FromHours(1));
+                writer.ScheduleWrite(&serializer);
+            }
+            file_thread.Stop();
+            EXPECT(serializer.calls() == 1);
+        }
+        EXPECT(ReadFile(path) == "on exit");
+
+        // With the file thread gone the write happens on the calling thread.
+        {
+            base::Thread file_thread("file");
+            EXPECT(file_thread.Start());
+            base::ImportantFileWriter writer(path,
+                file_thread.message_loop_proxy());
+            file_thread.Stop();
+            writer.WriteNow("late");
+            EXPECT(ReadFile(path) == "late");
+        }
+
+        EXPECT(ListDirectory(directory).size() == 1);
+        base::Delete(path, false);
+    }
+
+}
+
+void RunImportantFileWriterTests()
+{
+    ScopedTempDir temp_dir;
+    EXPECT(temp_dir.CreateUniqueTempDir());
+    if (!temp_dir.IsValid())
+    {
+        return;
+    }
+
+    MessageLoop loop;
+    TestWriteFileAtomically(temp_dir.path());
+    TestConcurrentReader(temp_dir.path());
+    TestScheduledWrites(temp_dir.path());
+}
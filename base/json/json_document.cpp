@@ -0,0 +1,486 @@
+#include "json_document.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/logging.h"
+
+namespace
+{
+
+    // First pass: records how many children each container has, in the order
+    // the containers begin, and how much room the whole document needs.
+    class JSONSizeCounter : public base::JSONParserDelegate
+    {
+    public:
+        JSONSizeCounter() : list_items_(0), members_(0), string_bytes_(0) {}
+
+        const std::vector<uint32>& child_counts() const { return child_counts_; }
+        size_t list_items() const { return list_items_; }
+        size_t members() const { return members_; }
+        size_t string_bytes() const { return string_bytes_; }
+
+        virtual bool OnNull() { return AddValue(); }
+        virtual bool OnBoolean(bool value) { return AddValue(); }
+        virtual bool OnInteger(int value) { return AddValue(); }
+        virtual bool OnDouble(double value) { return AddValue(); }
+
+        virtual bool OnString(const base::StringPiece& value)
+        {
+            string_bytes_ += value.size() + 1;
+            return AddValue();
+        }
+
+        virtual bool OnDictionaryBegin()
+        {
+            AddValue();
+            open_.push_back(Container(child_counts_.size(), false));
+            child_counts_.push_back(0);
+            return true;
+        }
+
+        virtual bool OnDictionaryKey(const base::StringPiece& key)
+        {
+            string_bytes_ += key.size() + 1;
+            return true;
+        }
+
+        virtual bool OnDictionaryEnd()
+        {
+            open_.pop_back();
+            return true;
+        }
+
+        virtual bool OnListBegin()
+        {
+            AddValue();
+            open_.push_back(Container(child_counts_.size(), true));
+            child_counts_.push_back(0);
+            return true;
+        }
+
+        virtual bool OnListEnd()
+        {
+            open_.pop_back();
+            return true;
+        }
+
+    private:
+        // Index into |child_counts_| and whether the container is a list.
+        typedef std::pair<size_t, bool> Container;
+
+        bool AddValue()
+        {
+            if (!open_.empty())
+            {
+                ++child_counts_[open_.back().first];
+                if (open_.back().second)
+                {
+                    ++list_items_;
+                }
+                else
+                {
+                    ++members_;
+                }
+            }
+            return true;
+        }
+
+        std::vector<uint32> child_counts_;
+        std::vector<Container> open_;
+        size_t list_items_;
+        size_t members_;
+        size_t string_bytes_;
+
+        DISALLOW_COPY_AND_ASSIGN(JSONSizeCounter);
+    };
+
+    bool MemberKeyLess(const base::JSONMember& a, const base::JSONMember& b)
+    {
+        return base::StringPiece(a.key, a.key_length) <
+            base::StringPiece(b.key, b.key_length);
+    }
+
+    bool MemberKeyEquals(const base::JSONMember& a, const base::JSONMember& b)
+    {
+        return base::StringPiece(a.key, a.key_length) ==
+            base::StringPiece(b.key, b.key_length);
+    }
+
+}
+
+namespace base
+{
+
+    // Second pass: carves nodes, members and strings out of the arena sized
+    // by JSONSizeCounter.  Parsing is deterministic, so the layout matches
+    // the counts exactly.
+    class JSONDocumentBuilder : public JSONParserDelegate
+    {
+    public:
+        JSONDocumentBuilder(const std::vector<uint32>& child_counts,
+            JSONNode* root, JSONNode* items, JSONMember* members, char* strings)
+            : child_counts_(child_counts),
+            next_container_(0),
+            root_(root),
+            items_(items),
+            members_(members),
+            strings_(strings) {}
+
+        virtual bool OnNull()
+        {
+            NewNode(Value::TYPE_NULL);
+            return true;
+        }
+
+        virtual bool OnBoolean(bool value)
+        {
+            NewNode(Value::TYPE_BOOLEAN)->boolean_value_ = value;
+            return true;
+        }
+
+        virtual bool OnInteger(int value)
+        {
+            NewNode(Value::TYPE_INTEGER)->integer_value_ = value;
+            return true;
+        }
+
+        virtual bool OnDouble(double value)
+        {
+            NewNode(Value::TYPE_DOUBLE)->double_value_ = value;
+            return true;
+        }
+
+        virtual bool OnString(const StringPiece& value)
+        {
+            JSONNode* node = NewNode(Value::TYPE_STRING);
+            node->string_value_ = CopyString(value);
+            node->size_ = static_cast<uint32>(value.size());
+            return true;
+        }
+
+        virtual bool OnDictionaryBegin()
+        {
+            JSONNode* node = NewNode(Value::TYPE_DICTIONARY);
+            node->members_ = members_;
+            members_ += child_counts_[next_container_++];
+            open_.push_back(node);
+            return true;
+        }
+
+        virtual bool OnDictionaryKey(const StringPiece& key)
+        {
+            JSONNode* node = open_.back();
+            JSONMember* member = const_cast<JSONMember*>(
+                node->members_ + node->size_);
+            member->key = CopyString(key);
+            member->key_length = static_cast<uint32>(key.size());
+            return true;
+        }
+
+        virtual bool OnDictionaryEnd()
+        {
+            JSONNode* node = open_.back();
+            open_.pop_back();
+
+            // Order the members by key.  The sort is stable, so among equal
+            // keys the last one in the input comes last and is the one kept.
+            JSONMember* begin = const_cast<JSONMember*>(node->members_);
+            JSONMember* end = begin + node->size_;
+            std::stable_sort(begin, end, MemberKeyLess);
+            JSONMember* out = begin;
+            for (JSONMember* it = begin; it != end; ++it)
+            {
+                if (it + 1 != end && MemberKeyEquals(*it, *(it + 1)))
+                {
+                    continue;
+                }
+                *out++ = *it;
+            }
+            node->size_ = static_cast<uint32>(out - begin);
+            return true;
+        }
+
+        virtual bool OnListBegin()
+        {
+            JSONNode* node = NewNode(Value::TYPE_LIST);
+            node->items_ = items_;
+            items_ += child_counts_[next_container_++];
+            open_.push_back(node);
+            return true;
+        }
+
+        virtual bool OnListEnd()
+        {
+            open_.pop_back();
+            return true;
+        }
+
+    private:
+        // Returns the slot for the next value: the root, the next list item
+        // or the value of the member whose key was just seen.
+        JSONNode* NewNode(Value::Type type)
+        {
+            JSONNode* node;
+            if (open_.empty())
+            {
+                node = root_;
+            }
+            else
+            {
+                JSONNode* parent = open_.back();
+                if (parent->type_ == Value::TYPE_LIST)
+                {
+                    node = const_cast<JSONNode*>(parent->items_ + parent->size_);
+                }
+                else
+                {
+                    node = const_cast<JSONNode*>(
+                        &parent->members_[parent->size_].value);
+                }
+                ++parent->size_;
+            }
+            node->type_ = static_cast<uint8>(type);
+            node->size_ = 0;
+            return node;
+        }
+
+        const char* CopyString(const StringPiece& value)
+        {
+            char* copy = strings_;
+            memcpy(copy, value.data(), value.size());
+            copy[value.size()] = '\0';
+            strings_ += value.size() + 1;
+            return copy;
+        }
+
+        const std::vector<uint32>& child_counts_;
+        size_t next_container_;
+
+        JSONNode* root_;
+        JSONNode* items_;
+        JSONMember* members_;
+        char* strings_;
+
+        std::vector<JSONNode*> open_;
+
+        DISALLOW_COPY_AND_ASSIGN(JSONDocumentBuilder);
+    };
+
+    bool JSONNode::GetAsBoolean(bool* out_value) const
+    {
+        if (type_ != Value::TYPE_BOOLEAN)
+        {
+            return false;
+        }
+        if (out_value)
+        {
+            *out_value = boolean_value_;
+        }
+        return true;
+    }
+
+    bool JSONNode::GetAsInteger(int* out_value) const
+    {
+        if (type_ != Value::TYPE_INTEGER)
+        {
+            return false;
+        }
+        if (out_value)
+        {
+            *out_value = integer_value_;
+        }
+        return true;
+    }
+
+    bool JSONNode::GetAsDouble(double* out_value) const
+    {
+        if (type_ == Value::TYPE_INTEGER)
+        {
+            if (out_value)
+            {
+                *out_value = integer_value_;
+            }
+            return true;
+        }
+        if (type_ != Value::TYPE_DOUBLE)
+        {
+            return false;
+        }
+        if (out_value)
+        {
+            *out_value = double_value_;
+        }
+        return true;
+    }
+
+    bool JSONNode::GetAsString(StringPiece* out_value) const
+    {
+        if (type_ != Value::TYPE_STRING)
+        {
+            return false;
+        }
+        if (out_value)
+        {
+            out_value->set(string_value_, size_);
+        }
+        return true;
+    }
+
+    const JSONNode* JSONNode::GetListItem(size_t index) const
+    {
+        DCHECK_EQ(type_, Value::TYPE_LIST);
+        DCHECK_LT(index, size_);
+        return &items_[index];
+    }
+
+    const JSONNode* JSONNode::FindKey(const StringPiece& key) const
+    {
+        if (type_ != Value::TYPE_DICTIONARY)
+        {
+            return NULL;
+        }
+
+        size_t low = 0;
+        size_t high = size_;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            int result = StringPiece(members_[middle].key,
+                members_[middle].key_length).compare(key);
+            if (result == 0)
+            {
+                return &members_[middle].value;
+            }
+            if (result < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return NULL;
+    }
+
+    StringPiece JSONNode::GetKey(size_t index) const
+    {
+        DCHECK_EQ(type_, Value::TYPE_DICTIONARY);
+        DCHECK_LT(index, size_);
+        return StringPiece(members_[index].key, members_[index].key_length);
+    }
+
+    const JSONNode* JSONNode::GetMemberValue(size_t index) const
+    {
+        DCHECK_EQ(type_, Value::TYPE_DICTIONARY);
+        DCHECK_LT(index, size_);
+        return &members_[index].value;
+    }
+
+    Value* JSONNode::ToValue() const
+    {
+        switch (type_)
+        {
+        case Value::TYPE_NULL:
+            return Value::CreateNullValue();
+
+        case Value::TYPE_BOOLEAN:
+            return Value::CreateBooleanValue(boolean_value_);
+
+        case Value::TYPE_INTEGER:
+            return Value::CreateIntegerValue(integer_value_);
+
+        case Value::TYPE_DOUBLE:
+            return Value::CreateDoubleValue(double_value_);
+
+        case Value::TYPE_STRING:
+            return Value::CreateStringValue(
+                std::string(string_value_, size_));
+
+        case Value::TYPE_LIST:
+        {
+            ListValue* list = new ListValue;
+            for (size_t i = 0; i < size_; ++i)
+            {
+                list->Append(items_[i].ToValue());
+            }
+            return list;
+        }
+
+        case Value::TYPE_DICTIONARY:
+        {
+            DictionaryValue* dictionary = new DictionaryValue;
+            for (size_t i = 0; i < size_; ++i)
+            {
+                dictionary->SetWithoutPathExpansion(
+                    std::string(members_[i].key, members_[i].key_length),
+                    members_[i].value.ToValue());
+            }
+            return dictionary;
+        }
+
+        default:
+            NOTREACHED();
+            return NULL;
+        }
+    }
+
+    JSONDocument::JSONDocument()
+        : arena_(NULL),
+        arena_size_(0),
+        root_(NULL),
+        error_code_(JSONParser::JSON_NO_ERROR) {}
+
+    JSONDocument::~JSONDocument()
+    {
+        Clear();
+    }
+
+    bool JSONDocument::Parse(const StringPiece& json, bool allow_trailing_comma)
+    {
+        Clear();
+
+        JSONParser parser(allow_trailing_comma);
+        JSONSizeCounter counter;
+        if (!parser.Parse(json, &counter))
+        {
+            error_code_ = parser.error_code();
+            error_message_ = parser.GetErrorMessage();
+            return false;
+        }
+
+        // Nodes first so that everything with a double in it stays aligned,
+        // then the strings.
+        size_t items_offset = sizeof(JSONNode);
+        size_t members_offset = items_offset +
+            counter.list_items() * sizeof(JSONNode);
+        size_t strings_offset = members_offset +
+            counter.members() * sizeof(JSONMember);
+        arena_size_ = strings_offset + counter.string_bytes();
+        arena_ = new char[arena_size_];
+
+        JSONNode* root = reinterpret_cast<JSONNode*>(arena_);
+        JSONDocumentBuilder builder(counter.child_counts(), root,
+            reinterpret_cast<JSONNode*>(arena_ + items_offset),
+            reinterpret_cast<JSONMember*>(arena_ + members_offset),
+            arena_ + strings_offset);
+        bool result = parser.Parse(json, &builder);
+        DCHECK(result);
+        root_ = root;
+        return true;
+    }
+
+    void JSONDocument::Clear()
+    {
+        delete[] arena_;
+        arena_ = NULL;
+        arena_size_ = 0;
+        root_ = NULL;
+        error_code_ = JSONParser::JSON_NO_ERROR;
+        error_message_.clear();
+    }
+
+} //namespace base
@@ -0,0 +1,115 @@
+#ifndef __base_json_document_h__
+#define __base_json_document_h__
+
+#include <string>
+
+#include "base/json/json_reader.h"
+#include "base/value.h"
+
+// JSONDocument is a read-only alternative to the Value tree for large inputs.
+// Parsing runs JSONParser twice: the first pass only counts containers, items
+// and string bytes, the second fills a single allocation with fixed size nodes
+// followed by the NUL terminated strings.  There is no per-node heap traffic,
+// nodes of a container are contiguous, and dictionary members are sorted by
+// key so lookups are binary searches.
+//
+//   base::JSONDocument document;
+//   if (document.Parse(json, false))
+//   {
+//       const base::JSONNode* name = document.root()->FindKey("name");
+//       ...
+//   }
+//
+// Nodes point into the document and are only valid while it is alive.
+
+namespace base
+{
+    class JSONDocumentBuilder;
+    struct JSONMember;
+
+    class JSONNode
+    {
+    public:
+        Value::Type type() const { return static_cast<Value::Type>(type_); }
+        bool IsType(Value::Type type) const { return type_ == type; }
+
+        // These return false if the node is of another type.
+        bool GetAsBoolean(bool* out_value) const;
+        bool GetAsInteger(int* out_value) const;
+        // Integers convert to doubles.
+        bool GetAsDouble(double* out_value) const;
+        bool GetAsString(StringPiece* out_value) const;
+
+        // Number of items of a list or members of a dictionary, 0 otherwise.
+        size_t size() const { return size_; }
+
+        // Lists only.
+        const JSONNode* GetListItem(size_t index) const;
+
+        // Dictionaries only.  Members are ordered by key; if the input had a
+        // key more than once, the last value wins.  FindKey() returns NULL if
+        // there is no such member.
+        const JSONNode* FindKey(const StringPiece& key) const;
+        StringPiece GetKey(size_t index) const;
+        const JSONNode* GetMemberValue(size_t index) const;
+
+        // Deep copies the node into a Value tree.  The caller owns the result.
+        Value* ToValue() const;
+
+    private:
+        friend class JSONDocumentBuilder;
+
+        uint8 type_;
+        uint32 size_;
+        union
+        {
+            bool boolean_value_;
+            int integer_value_;
+            double double_value_;
+            const char* string_value_;
+            const JSONNode* items_;
+            const JSONMember* members_;
+        };
+    };
+
+    struct JSONMember
+    {
+        const char* key;
+        uint32 key_length;
+        JSONNode value;
+    };
+
+    class JSONDocument
+    {
+    public:
+        JSONDocument();
+        ~JSONDocument();
+
+        // Parses |json|, replacing any previous content.  On failure root()
+        // is NULL and error_code()/error_message() describe the problem.
+        bool Parse(const StringPiece& json, bool allow_trailing_comma);
+
+        const JSONNode* root() const { return root_; }
+
+        JSONParser::JsonParseError error_code() const { return error_code_; }
+        const std::string& error_message() const { return error_message_; }
+
+        // Bytes held by the document.
+        size_t memory_usage() const { return arena_size_; }
+
+    private:
+        void Clear();
+
+        char* arena_;
+        size_t arena_size_;
+        const JSONNode* root_;
+
+        JSONParser::JsonParseError error_code_;
+        std::string error_message_;
+
+        DISALLOW_COPY_AND_ASSIGN(JSONDocument);
+    };
+
+} //namespace base
+
+#endif //__base_json_document_h__
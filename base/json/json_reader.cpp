@@ -0,0 +1,929 @@
+#include "json_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversion_utils.h"
+#include "base/value.h"
+
+namespace
+{
+
+    bool IsHexDigit(char c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+            (c >= 'A' && c <= 'F');
+    }
+
+    int HexDigitToInt(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        return c - 'A' + 10;
+    }
+
+    bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // No token needs the input before this offset.
+    const size_t kKeepNothing = static_cast<size_t>(-1);
+
+    // Builds a Value tree.  Containers are linked into their parent as soon
+    // as they begin, so |stack_| only needs to remember where to add next.
+    class ValueBuilder : public base::JSONParserDelegate
+    {
+    public:
+        ValueBuilder() : root_(NULL) {}
+
+        virtual ~ValueBuilder()
+        {
+            delete root_;
+        }
+
+        base::Value* Release()
+        {
+            base::Value* root = root_;
+            root_ = NULL;
+            return root;
+        }
+
+        virtual bool OnNull()
+        {
+            return Add(base::Value::CreateNullValue());
+        }
+
+        virtual bool OnBoolean(bool value)
+        {
+            return Add(base::Value::CreateBooleanValue(value));
+        }
+
+        virtual bool OnInteger(int value)
+        {
+            return Add(base::Value::CreateIntegerValue(value));
+        }
+
+        virtual bool OnDouble(double value)
+        {
+            return Add(base::Value::CreateDoubleValue(value));
+        }
+
+        virtual bool OnString(const base::StringPiece& value)
+        {
+            return Add(base::Value::CreateStringValue(value.as_string()));
+        }
+
+        virtual bool OnDictionaryBegin()
+        {
+            base::DictionaryValue* dictionary = new base::DictionaryValue;
+            Add(dictionary);
+            stack_.push_back(dictionary);
+            return true;
+        }
+
+        virtual bool OnDictionaryKey(const base::StringPiece& key)
+        {
+            key.CopyToString(key_);
+            return true;
+        }
+
+        virtual bool OnDictionaryEnd()
+        {
+            stack_.pop_back();
+            return true;
+        }
+
+        virtual bool OnListBegin()
+        {
+            base::ListValue* list = new base::ListValue;
+            Add(list);
+            stack_.push_back(list);
+            return true;
+        }
+
+        virtual bool OnListEnd()
+        {
+            stack_.pop_back();
+            return true;
+        }
+
+    private:
+        bool Add(base::Value* value)
+        {
+            if (stack_.empty())
+            {
+                DCHECK(!root_);
+                root_ = value;
+            }
+            else if (stack_.back()->IsType(base::Value::TYPE_LIST))
+            {
+                static_cast<base::ListValue*>(stack_.back())->Append(value);
+            }
+            else
+            {
+                static_cast<base::DictionaryValue*>(stack_.back())->
+                    SetWithoutPathExpansion(key_, value);
+            }
+            return true;
+        }
+
+        base::Value* root_;
+        std::vector<base::Value*> stack_;
+        std::string key_;
+
+        DISALLOW_COPY_AND_ASSIGN(ValueBuilder);
+    };
+
+}
+
+namespace base
+{
+
+    JSONParser::JSONParser(bool allow_trailing_comma)
+        : allow_trailing_comma_(allow_trailing_comma),
+        delegate_(NULL),
+        source_(NULL),
+        source_ended_(false),
+        window_(NULL),
+        pos_(NULL),
+        end_(NULL),
+        window_offset_(0),
+        window_line_(1),
+        window_column_(1),
+        keep_(kKeepNothing),
+        error_code_(JSON_NO_ERROR),
+        error_line_(0),
+        error_column_(0) {}
+
+    JSONParser::~JSONParser() {}
+
+    bool JSONParser::Parse(const StringPiece& json,
+        JSONParserDelegate* delegate)
+    {
+        delegate_ = delegate;
+        source_ = NULL;
+        window_ = json.data();
+        pos_ = window_;
+        end_ = window_ + json.size();
+        return ParseRoot();
+    }
+
+    bool JSONParser::Parse(JSONChunkSource* source,
+        JSONParserDelegate* delegate)
+    {
+        delegate_ = delegate;
+        source_ = source;
+        source_ended_ = false;
+        buffer_.clear();
+        window_ = buffer_.data();
+        pos_ = window_;
+        end_ = window_;
+        bool result = ParseRoot();
+
+        // Do not hold on to the last chunks.
+        source_ = NULL;
+        std::string().swap(buffer_);
+        window_ = NULL;
+        pos_ = NULL;
+        end_ = NULL;
+        return result;
+    }
+
+    bool JSONParser::ParseRoot()
+    {
+        window_offset_ = 0;
+        window_line_ = 1;
+        window_column_ = 1;
+        keep_ = kKeepNothing;
+        error_code_ = JSON_NO_ERROR;
+        error_line_ = 0;
+        error_column_ = 0;
+
+        // Skip a UTF-8 byte order mark.
+        if (Ensure(3) && memcmp(pos_, "\xEF\xBB\xBF", 3) == 0)
+        {
+            pos_ += 3;
+        }
+
+        if (!ParseValue(0) || !SkipWhitespace())
+        {
+            return false;
+        }
+        if (More())
+        {
+            return SetError(JSON_UNEXPECTED_DATA_AFTER_ROOT, pos_);
+        }
+        return true;
+    }
+
+    std::string JSONParser::GetErrorMessage() const
+    {
+        if (error_code_ == JSON_NO_ERROR)
+        {
+            return std::string();
+        }
+        return StringPrintf("Line: %i, column: %i, %s", error_line_,
+            error_column_, ErrorCodeToString(error_code_));
+    }
+
+    // static
+    const char* JSONParser::ErrorCodeToString(JsonParseError error_code)
+    {
+        switch (error_code)
+        {
+        case JSON_NO_ERROR:
+            return "";
+        case JSON_SYNTAX_ERROR:
+            return "Syntax error.";
+        case JSON_INVALID_ESCAPE:
+            return "Invalid escape sequence.";
+        case JSON_INVALID_NUMBER:
+            return "Invalid number.";
+        case JSON_TRAILING_COMMA:
+            return "Trailing comma not allowed.";
+        case JSON_TOO_MUCH_NESTING:
+            return "Too much nesting.";
+        case JSON_UNEXPECTED_DATA_AFTER_ROOT:
+            return "Unexpected data after root element.";
+        case JSON_UNQUOTED_DICTIONARY_KEY:
+            return "Dictionary keys must be quoted.";
+        case JSON_ABORTED:
+            return "Parsing was aborted.";
+        }
+        NOTREACHED();
+        return "";
+    }
+
+    bool JSONParser::ParseValue(int depth)
+    {
+        if (!SkipWhitespace())
+        {
+            return false;
+        }
+        if (!More())
+        {
+            return SetError(JSON_SYNTAX_ERROR, pos_);
+        }
+
+        bool handled;
+        switch (*pos_)
+        {
+        case '{':
+            return ParseDictionary(depth + 1);
+
+        case '[':
+            return ParseList(depth + 1);
+
+        case '"':
+        {
+            StringPiece value;
+            if (!ParseString(&value))
+            {
+                return false;
+            }
+            handled = delegate_->OnString(value);
+            break;
+        }
+
+        case 't':
+            if (!ParseLiteral("true", 4))
+            {
+                return false;
+            }
+            handled = delegate_->OnBoolean(true);
+            break;
+
+        case 'f':
+            if (!ParseLiteral("false", 5))
+            {
+                return false;
+            }
+            handled = delegate_->OnBoolean(false);
+            break;
+
+        case 'n':
+            if (!ParseLiteral("null", 4))
+            {
+                return false;
+            }
+            handled = delegate_->OnNull();
+            break;
+
+        default:
+            if (*pos_ == '-' || IsDigit(*pos_))
+            {
+                return ParseNumber();
+            }
+            return SetError(JSON_SYNTAX_ERROR, pos_);
+        }
+
+        return handled || SetError(JSON_ABORTED, pos_);
+    }
+
+    bool JSONParser::ParseDictionary(int depth)
+    {
+        if (depth > kStackMaxDepth)
+        {
+            return SetError(JSON_TOO_MUCH_NESTING, pos_);
+        }
+        ++pos_; // '{'
+        if (!delegate_->OnDictionaryBegin())
+        {
+            return SetError(JSON_ABORTED, pos_);
+        }
+        if (!SkipWhitespace())
+        {
+            return false;
+        }
+        if (More() && *pos_ == '}')
+        {
+            ++pos_;
+            return delegate_->OnDictionaryEnd() || SetError(JSON_ABORTED, pos_);
+        }
+
+        for (;;)
+        {
+            if (!More())
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            if (*pos_ != '"')
+            {
+                return SetError(JSON_UNQUOTED_DICTIONARY_KEY, pos_);
+            }
+            StringPiece key;
+            if (!ParseString(&key))
+            {
+                return false;
+            }
+            if (!delegate_->OnDictionaryKey(key))
+            {
+                return SetError(JSON_ABORTED, pos_);
+            }
+
+            if (!SkipWhitespace())
+            {
+                return false;
+            }
+            if (!More() || *pos_ != ':')
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            ++pos_;
+
+            if (!ParseValue(depth) || !SkipWhitespace())
+            {
+                return false;
+            }
+            if (!More())
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            if (*pos_ == '}')
+            {
+                ++pos_;
+                return delegate_->OnDictionaryEnd() ||
+                    SetError(JSON_ABORTED, pos_);
+            }
+            if (*pos_ != ',')
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+
+            // The comma is kept for the error message until it is known
+            // not to be a trailing one.
+            size_t comma = Offset(pos_++);
+            size_t saved_keep = keep_;
+            keep_ = std::min(keep_, comma);
+            if (!SkipWhitespace())
+            {
+                return false;
+            }
+            if (More() && *pos_ == '}')
+            {
+                if (!allow_trailing_comma_)
+                {
+                    return SetError(JSON_TRAILING_COMMA, comma);
+                }
+                ++pos_;
+                keep_ = saved_keep;
+                return delegate_->OnDictionaryEnd() ||
+                    SetError(JSON_ABORTED, pos_);
+            }
+            keep_ = saved_keep;
+        }
+    }
+
+    bool JSONParser::ParseList(int depth)
+    {
+        if (depth > kStackMaxDepth)
+        {
+            return SetError(JSON_TOO_MUCH_NESTING, pos_);
+        }
+        ++pos_; // '['
+        if (!delegate_->OnListBegin())
+        {
+            return SetError(JSON_ABORTED, pos_);
+        }
+        if (!SkipWhitespace())
+        {
+            return false;
+        }
+        if (More() && *pos_ == ']')
+        {
+            ++pos_;
+            return delegate_->OnListEnd() || SetError(JSON_ABORTED, pos_);
+        }
+
+        for (;;)
+        {
+            if (!ParseValue(depth) || !SkipWhitespace())
+            {
+                return false;
+            }
+            if (!More())
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            if (*pos_ == ']')
+            {
+                ++pos_;
+                return delegate_->OnListEnd() || SetError(JSON_ABORTED, pos_);
+            }
+            if (*pos_ != ',')
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+
+            size_t comma = Offset(pos_++);
+            size_t saved_keep = keep_;
+            keep_ = std::min(keep_, comma);
+            if (!SkipWhitespace())
+            {
+                return false;
+            }
+            if (More() && *pos_ == ']')
+            {
+                if (!allow_trailing_comma_)
+                {
+                    return SetError(JSON_TRAILING_COMMA, comma);
+                }
+                ++pos_;
+                keep_ = saved_keep;
+                return delegate_->OnListEnd() || SetError(JSON_ABORTED, pos_);
+            }
+            keep_ = saved_keep;
+        }
+    }
+
+    bool JSONParser::ParseNumber()
+    {
+        // The whole token stays in memory so that it can be converted at once.
+        size_t begin = Offset(pos_);
+        size_t saved_keep = keep_;
+        keep_ = std::min(keep_, begin);
+        if (*pos_ == '-')
+        {
+            ++pos_;
+        }
+
+        // Integer part: a single 0, or digits without a leading 0.
+        if (!More() || !IsDigit(*pos_))
+        {
+            return SetError(JSON_INVALID_NUMBER, begin);
+        }
+        if (*pos_ == '0')
+        {
+            ++pos_;
+        }
+        else
+        {
+            while (More() && IsDigit(*pos_))
+            {
+                ++pos_;
+            }
+        }
+
+        bool is_integer = true;
+        if (More() && *pos_ == '.')
+        {
+            is_integer = false;
+            ++pos_;
+            if (!More() || !IsDigit(*pos_))
+            {
+                return SetError(JSON_INVALID_NUMBER, begin);
+            }
+            while (More() && IsDigit(*pos_))
+            {
+                ++pos_;
+            }
+        }
+        if (More() && (*pos_ == 'e' || *pos_ == 'E'))
+        {
+            is_integer = false;
+            ++pos_;
+            if (More() && (*pos_ == '+' || *pos_ == '-'))
+            {
+                ++pos_;
+            }
+            if (!More() || !IsDigit(*pos_))
+            {
+                return SetError(JSON_INVALID_NUMBER, begin);
+            }
+            while (More() && IsDigit(*pos_))
+            {
+                ++pos_;
+            }
+        }
+        keep_ = saved_keep;
+
+        const char* number = At(begin);
+        size_t length = pos_ - number;
+        bool handled;
+        int integer_value;
+        if (is_integer && StringToInt(number, pos_, &integer_value))
+        {
+            handled = delegate_->OnInteger(integer_value);
+        }
+        else
+        {
+            // strtod() needs a terminated copy, which fits on the stack for
+            // any number a writer produces.  The token has been validated
+            // above, so strtod() consumes all of it; the C locale makes it
+            // read the '.' whatever locale the process has set.
+            char buffer[64];
+            std::string long_number;
+            const char* terminated = buffer;
+            if (length < sizeof(buffer))
+            {
+                memcpy(buffer, number, length);
+                buffer[length] = '\0';
+            }
+            else
+            {
+                long_number.assign(number, length);
+                terminated = long_number.c_str();
+            }
+            handled = delegate_->OnDouble(
+                _strtod_l(terminated, NULL, CLocale()));
+        }
+        return handled || SetError(JSON_ABORTED, pos_);
+    }
+
+    bool JSONParser::ParseLiteral(const char* literal, size_t length)
+    {
+        if (!Ensure(length) || memcmp(pos_, literal, length) != 0)
+        {
+            return SetError(JSON_SYNTAX_ERROR, pos_);
+        }
+        pos_ += length;
+        return true;
+    }
+
+    bool JSONParser::ParseString(StringPiece* value)
+    {
+        // The string is kept in memory from its quote on, so that the piece
+        // handed out below is contiguous, and for the error message.
+        size_t quote = Offset(pos_++);
+        size_t saved_keep = keep_;
+        keep_ = std::min(keep_, quote);
+
+        // Common case: no escapes, hand out a piece of the input.
+        while (More() && *pos_ != '"' && *pos_ != '\\')
+        {
+            if (static_cast<unsigned char>(*pos_) < 0x20)
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            ++pos_;
+        }
+        if (!More())
+        {
+            return SetError(JSON_SYNTAX_ERROR, quote);
+        }
+        const char* begin = At(quote + 1);
+        if (*pos_ == '"')
+        {
+            value->set(begin, pos_ - begin);
+            ++pos_;
+            keep_ = saved_keep;
+            return true;
+        }
+
+        string_buffer_.assign(begin, pos_);
+        while (More() && *pos_ != '"')
+        {
+            if (*pos_ == '\\')
+            {
+                if (!DecodeEscape(&string_buffer_))
+                {
+                    return false;
+                }
+            }
+            else if (static_cast<unsigned char>(*pos_) < 0x20)
+            {
+                return SetError(JSON_SYNTAX_ERROR, pos_);
+            }
+            else
+            {
+                string_buffer_.push_back(*pos_++);
+            }
+        }
+        if (!More())
+        {
+            return SetError(JSON_SYNTAX_ERROR, quote);
+        }
+        ++pos_;
+        keep_ = saved_keep;
+        value->set(string_buffer_.data(), string_buffer_.size());
+        return true;
+    }
+
+    bool JSONParser::DecodeEscape(std::string* output)
+    {
+        size_t escape = Offset(pos_++);
+        if (!More())
+        {
+            return SetError(JSON_INVALID_ESCAPE, escape);
+        }
+
+        char c = *pos_++;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            output->push_back(c);
+            return true;
+        case 'b':
+            output->push_back('\b');
+            return true;
+        case 'f':
+            output->push_back('\f');
+            return true;
+        case 'n':
+            output->push_back('\n');
+            return true;
+        case 'r':
+            output->push_back('\r');
+            return true;
+        case 't':
+            output->push_back('\t');
+            return true;
+        case 'u':
+            break;
+        default:
+            return SetError(JSON_INVALID_ESCAPE, escape);
+        }
+
+        uint32 code_point;
+        if (!ReadHexDigits(&code_point))
+        {
+            return SetError(JSON_INVALID_ESCAPE, escape);
+        }
+        if (code_point >= 0xD800 && code_point <= 0xDBFF)
+        {
+            // A lead surrogate must be followed by an escaped trail surrogate.
+            uint32 trail;
+            if (!Ensure(2) || pos_[0] != '\\' || pos_[1] != 'u')
+            {
+                return SetError(JSON_INVALID_ESCAPE, escape);
+            }
+            pos_ += 2;
+            if (!ReadHexDigits(&trail) || trail < 0xDC00 || trail > 0xDFFF)
+            {
+                return SetError(JSON_INVALID_ESCAPE, escape);
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                (trail - 0xDC00);
+        }
+        else if (code_point >= 0xDC00 && code_point <= 0xDFFF)
+        {
+            return SetError(JSON_INVALID_ESCAPE, escape);
+        }
+
+        WriteUnicodeCharacter(code_point, output);
+        return true;
+    }
+
+    bool JSONParser::ReadHexDigits(uint32* code_unit)
+    {
+        if (!Ensure(4))
+        {
+            return false;
+        }
+        uint32 value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!IsHexDigit(pos_[i]))
+            {
+                return false;
+            }
+            value = (value << 4) | HexDigitToInt(pos_[i]);
+        }
+        pos_ += 4;
+        *code_unit = value;
+        return true;
+    }
+
+    bool JSONParser::SkipWhitespace()
+    {
+        while (More())
+        {
+            switch (*pos_)
+            {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                ++pos_;
+                break;
+
+            case '/':
+                if (Ensure(2) && pos_[1] == '/')
+                {
+                    pos_ += 2;
+                    while (More() && *pos_ != '\n' && *pos_ != '\r')
+                    {
+                        ++pos_;
+                    }
+                }
+                else if (Ensure(2) && pos_[1] == '*')
+                {
+                    size_t comment = Offset(pos_);
+                    size_t saved_keep = keep_;
+                    keep_ = std::min(keep_, comment);
+                    pos_ += 2;
+                    while (Ensure(2) && !(pos_[0] == '*' && pos_[1] == '/'))
+                    {
+                        ++pos_;
+                    }
+                    if (!Ensure(2))
+                    {
+                        return SetError(JSON_SYNTAX_ERROR, comment);
+                    }
+                    pos_ += 2;
+                    keep_ = saved_keep;
+                }
+                else
+                {
+                    return SetError(JSON_SYNTAX_ERROR, pos_);
+                }
+                break;
+
+            default:
+                return true;
+            }
+        }
+        return true;
+    }
+
+    bool JSONParser::Refill(size_t count)
+    {
+        if (!source_)
+        {
+            return false;
+        }
+
+        // Drop what no token needs any more, moving the line and column of
+        // the window on past it.  |window_| points into |buffer_| here.
+        size_t pos = Offset(pos_);
+        size_t keep = std::min(keep_, pos);
+        const char* drop_end = At(keep);
+        CountLines(window_, drop_end);
+        buffer_.erase(0, drop_end - window_);
+        window_offset_ = keep;
+
+        while (buffer_.size() - (pos - window_offset_) < count &&
+            !source_ended_)
+        {
+            StringPiece chunk = source_->NextChunk();
+            if (chunk.empty())
+            {
+                source_ended_ = true;
+            }
+            else
+            {
+                chunk.AppendToString(&buffer_);
+            }
+        }
+
+        window_ = buffer_.data();
+        pos_ = At(pos);
+        end_ = window_ + buffer_.size();
+        return static_cast<size_t>(end_ - pos_) >= count;
+    }
+
+    void JSONParser::CountLines(const char* from, const char* to)
+    {
+        const char* line_start = NULL;
+        for (const char* p = from; p < to;)
+        {
+            const char* newline = static_cast<const char*>(
+                memchr(p, '\n', to - p));
+            if (!newline)
+            {
+                break;
+            }
+            ++window_line_;
+            line_start = newline + 1;
+            p = line_start;
+        }
+        if (line_start)
+        {
+            window_column_ = 1 + static_cast<int>(to - line_start);
+        }
+        else
+        {
+            window_column_ += static_cast<int>(to - from);
+        }
+    }
+
+    bool JSONParser::SetError(JsonParseError error_code, const char* position)
+    {
+        return SetError(error_code, Offset(position));
+    }
+
+    bool JSONParser::SetError(JsonParseError error_code, size_t offset)
+    {
+        // Whatever an error can point at is kept in memory, so the window
+        // still starts at or before |offset|.
+        DCHECK(offset >= window_offset_);
+        int saved_line = window_line_;
+        int saved_column = window_column_;
+        CountLines(window_, At(offset));
+        error_code_ = error_code;
+        error_line_ = window_line_;
+        error_column_ = window_column_;
+        window_line_ = saved_line;
+        window_column_ = saved_column;
+        return false;
+    }
+
+    // static
+    Value* JSONReader::Read(const StringPiece& json, bool allow_trailing_comma)
+    {
+        return ReadAndReturnError(json, allow_trailing_comma, NULL, NULL);
+    }
+
+    // static
+    Value* JSONReader::ReadAndReturnError(const StringPiece& json,
+        bool allow_trailing_comma,
+        int* error_code_out,
+        std::string* error_msg_out)
+    {
+        JSONParser parser(allow_trailing_comma);
+        ValueBuilder builder;
+        if (parser.Parse(json, &builder))
+        {
+            return builder.Release();
+        }
+
+        if (error_code_out)
+        {
+            *error_code_out = parser.error_code();
+        }
+        if (error_msg_out)
+        {
+            *error_msg_out = parser.GetErrorMessage();
+        }
+        return NULL;
+    }
+
+    // static
+    Value* JSONReader::ReadAndReturnError(JSONChunkSource* source,
+        bool allow_trailing_comma,
+        int* error_code_out,
+        std::string* error_msg_out)
+    {
+        JSONParser parser(allow_trailing_comma);
+        ValueBuilder builder;
+        if (parser.Parse(source, &builder))
+        {
+            return builder.Release();
+        }
+
+        if (error_code_out)
+        {
+            *error_code_out = parser.error_code();
+        }
+        if (error_msg_out)
+        {
+            *error_msg_out = parser.GetErrorMessage();
+        }
+        return NULL;
+    }
+
+} //namespace base
@@ -0,0 +1,222 @@
+#ifndef __base_json_reader_h__
+#define __base_json_reader_h__
+
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/string_piece.h"
+
+// A JSON parser in two layers.  JSONParser is a SAX-style parser: it walks the
+// input once and reports each token to a JSONParserDelegate, without building
+// anything itself.  JSONReader plugs in a delegate that builds a Value tree,
+// and JSONDocument (json_document.h) one that builds a compact read-only DOM.
+//
+// The grammar is RFC 4627 JSON with a few relaxations that make hand edited
+// settings files easier to live with: any value may be the root, /* */ and //
+// comments are skipped, and trailing commas in lists and dictionaries can be
+// allowed.  Strings are passed on as UTF-8; \uXXXX escapes, including
+// surrogate pairs, are decoded.
+//
+// The input is either one piece in memory or a JSONChunkSource, which hands
+// it over a chunk at a time, so that a large file can be parsed while it is
+// read without holding all of it.  Numbers are read and written the same
+// way whatever the C locale is.
+
+namespace base
+{
+    class Value;
+
+    class JSONParserDelegate
+    {
+    public:
+        virtual ~JSONParserDelegate() {}
+
+        // Each callback returns false to stop parsing, in which case the
+        // parser reports JSON_ABORTED.  String pieces are only valid for the
+        // duration of the call.
+        virtual bool OnNull() = 0;
+        virtual bool OnBoolean(bool value) = 0;
+        // Numbers without fraction or exponent that fit in an int.
+        virtual bool OnInteger(int value) = 0;
+        virtual bool OnDouble(double value) = 0;
+        virtual bool OnString(const StringPiece& value) = 0;
+
+        virtual bool OnDictionaryBegin() = 0;
+        // Called before the value of each dictionary member.
+        virtual bool OnDictionaryKey(const StringPiece& key) = 0;
+        virtual bool OnDictionaryEnd() = 0;
+
+        virtual bool OnListBegin() = 0;
+        virtual bool OnListEnd() = 0;
+    };
+
+    class JSONChunkSource
+    {
+    public:
+        virtual ~JSONChunkSource() {}
+
+        // Returns the next chunk of the input, or an empty piece at its end.
+        // The chunk only needs to stay valid until the next call.
+        virtual StringPiece NextChunk() = 0;
+    };
+
+    class JSONParser
+    {
+    public:
+        enum JsonParseError
+        {
+            JSON_NO_ERROR = 0,
+            JSON_SYNTAX_ERROR,
+            JSON_INVALID_ESCAPE,
+            JSON_INVALID_NUMBER,
+            JSON_TRAILING_COMMA,
+            JSON_TOO_MUCH_NESTING,
+            JSON_UNEXPECTED_DATA_AFTER_ROOT,
+            JSON_UNQUOTED_DICTIONARY_KEY,
+            JSON_ABORTED,
+        };
+
+        // Containers may not nest deeper than this.
+        static const int kStackMaxDepth = 100;
+
+        explicit JSONParser(bool allow_trailing_comma);
+        ~JSONParser();
+
+        // Parses |json|, which must hold exactly one value, calling |delegate|
+        // for every token.  Returns false on error; see error_code() then.
+        bool Parse(const StringPiece& json, JSONParserDelegate* delegate);
+
+        // The same for input read from |source| chunk by chunk.  Only the
+        // part of the input that the current token spans is kept, and a token
+        // cut by the end of a chunk is continued from the next one.
+        bool Parse(JSONChunkSource* source, JSONParserDelegate* delegate);
+
+        JsonParseError error_code() const { return error_code_; }
+
+        // 1-based position of the error in the input.
+        int error_line() const { return error_line_; }
+        int error_column() const { return error_column_; }
+
+        // "Line: 2, column: 5, Syntax error." or an empty string.
+        std::string GetErrorMessage() const;
+
+        static const char* ErrorCodeToString(JsonParseError error_code);
+
+    private:
+        bool ParseRoot();
+        bool ParseValue(int depth);
+        bool ParseDictionary(int depth);
+        bool ParseList(int depth);
+        bool ParseNumber();
+        bool ParseLiteral(const char* literal, size_t length);
+
+        // Parses the string starting at the opening quote into |value|, which
+        // points either into the input or, when there are escapes, into
+        // |string_buffer_|.
+        bool ParseString(StringPiece* value);
+        bool DecodeEscape(std::string* output);
+        bool ReadHexDigits(uint32* code_unit);
+
+        // Skips whitespace and comments.  Returns false on a broken comment.
+        bool SkipWhitespace();
+
+        // Offset of |position| from the start of the input, and back.
+        size_t Offset(const char* position) const
+        {
+            return window_offset_ + (position - window_);
+        }
+        const char* At(size_t offset) const
+        {
+            return window_ + (offset - window_offset_);
+        }
+
+        // True if there is input left at |pos_|, reading the next chunk if
+        // need be.
+        bool More()
+        {
+            return pos_ != end_ || Refill(1);
+        }
+
+        // True if at least |count| bytes are left at |pos_|.
+        bool Ensure(size_t count)
+        {
+            return static_cast<size_t>(end_ - pos_) >= count || Refill(count);
+        }
+
+        // Drops the input before |keep_| and |pos_| and reads chunks until
+        // |count| bytes follow |pos_| or the input ends.  Pointers into the
+        // input are invalid afterwards; positions are kept as offsets.
+        bool Refill(size_t count);
+
+        // Moves the line and column of |window_| on past [from, to).
+        void CountLines(const char* from, const char* to);
+
+        bool SetError(JsonParseError error_code, const char* position);
+        bool SetError(JsonParseError error_code, size_t offset);
+
+        bool allow_trailing_comma_;
+        JSONParserDelegate* delegate_;
+
+        // NULL for input in one piece.  Otherwise |buffer_| holds the part
+        // of the input that is still needed, and |window_| points into it.
+        JSONChunkSource* source_;
+        bool source_ended_;
+        std::string buffer_;
+
+        // The input in memory starts at offset |window_offset_|, which is on
+        // line |window_line_| and column |window_column_|.
+        const char* window_;
+        const char* pos_;
+        const char* end_;
+        size_t window_offset_;
+        int window_line_;
+        int window_column_;
+
+        // Offset of the earliest byte a token in progress still needs, such
+        // as its start or where an error would be reported.
+        size_t keep_;
+
+        // Reused across strings so that decoding escapes rarely allocates.
+        std::string string_buffer_;
+
+        JsonParseError error_code_;
+        int error_line_;
+        int error_column_;
+
+        DISALLOW_COPY_AND_ASSIGN(JSONParser);
+    };
+
+    class JSONReader
+    {
+    public:
+        // Reads and parses |json|, returning a Value.  The caller owns the
+        // returned instance.  If |json| is not a properly formed JSON string,
+        // returns NULL.  If |allow_trailing_comma| is true, we will ignore
+        // trailing commas in objects and arrays even though this goes against
+        // the RFC.
+        static Value* Read(const StringPiece& json, bool allow_trailing_comma);
+
+        // Reads and parses |json| like Read().  |error_code_out| and
+        // |error_msg_out| are optional.  If specified and NULL is returned,
+        // they will be populated an error code and a formatted error message
+        // (including error location if appropriate).  Otherwise, they will be
+        // unmodified.
+        static Value* ReadAndReturnError(const StringPiece& json,
+            bool allow_trailing_comma,
+            int* error_code_out,
+            std::string* error_msg_out);
+
+        // The same for input read from |source| chunk by chunk.
+        static Value* ReadAndReturnError(JSONChunkSource* source,
+            bool allow_trailing_comma,
+            int* error_code_out,
+            std::string* error_msg_out);
+
+    private:
+        DISALLOW_IMPLICIT_CONSTRUCTORS(JSONReader);
+    };
+
+} //namespace base
+
+#endif //__base_json_reader_h__
@@ -0,0 +1,237 @@
+// Throughput of JSONParser on a 16 MB settings-like document: with a
+// delegate that does nothing, building a Value tree, building a JSONDocument,
+// and read from 64 KB chunks; and of JSONWriter writing it back.  Then the
+// memory each representation takes: the private bytes a Value tree adds,
+// JSONDocument::memory_usage(), and what parsing from chunks adds next to
+// holding the input in memory.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/json/json_document.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process_util.h"
+#include "base/test/test_util.h"
+#include "base/value.h"
+
+namespace
+{
+
+    const size_t kDocumentBytes = 16 * 1024 * 1024;
+    const size_t kChunkBytes = 64 * 1024;
+    const int kRepeats = 5;
+
+    class NullDelegate : public base::JSONParserDelegate
+    {
+    public:
+        NullDelegate() : tokens_(0) {}
+
+        virtual bool OnNull() { return Count(); }
+        virtual bool OnBoolean(bool value) { return Count(); }
+        virtual bool OnInteger(int value) { return Count(); }
+        virtual bool OnDouble(double value) { return Count(); }
+        virtual bool OnString(const base::StringPiece& value)
+        {
+            return Count();
+        }
+        virtual bool OnDictionaryBegin() { return Count(); }
+        virtual bool OnDictionaryKey(const base::StringPiece& key)
+        {
+            return Count();
+        }
+        virtual bool OnDictionaryEnd() { return Count(); }
+        virtual bool OnListBegin() { return Count(); }
+        virtual bool OnListEnd() { return Count(); }
+
+        size_t tokens() const { return tokens_; }
+
+    private:
+        bool Count()
+        {
+            ++tokens_;
+            return true;
+        }
+
+        size_t tokens_;
+    };
+
+    // Hands out the document |kChunkBytes| at a time, copied into a buffer
+    // of its own as a file reader would.
+    class ChunkSource : public base::JSONChunkSource
+    {
+    public:
+        explicit ChunkSource(const std::string& json)
+            : json_(json), offset_(0), chunk_(kChunkBytes, '\0') {}
+
+        virtual base::StringPiece NextChunk()
+        {
+            size_t length = std::min(kChunkBytes, json_.length() - offset_);
+            json_.copy(&chunk_[0], length, offset_);
+            offset_ += length;
+            return base::StringPiece(chunk_.data(), length);
+        }
+
+    private:
+        const std::string& json_;
+        size_t offset_;
+        std::string chunk_;
+    };
+
+    size_t PrivateBytes(base::ProcessMetrics* metrics)
+    {
+        size_t private_bytes = 0;
+        metrics->GetMemoryBytes(&private_bytes, NULL);
+        return private_bytes;
+    }
+
+    // Samples the private bytes before each chunk.
+    class SampledSource : public ChunkSource
+    {
+    public:
+        SampledSource(const std::string& json, base::ProcessMetrics* metrics,
+            size_t* peak)
+            : ChunkSource(json), metrics_(metrics), peak_(peak) {}
+
+        virtual base::StringPiece NextChunk()
+        {
+            *peak_ = std::max(*peak_, PrivateBytes(metrics_));
+            return ChunkSource::NextChunk();
+        }
+
+    private:
+        base::ProcessMetrics* metrics_;
+        size_t* peak_;
+    };
+
+    std::string MakeDocument()
+    {
+        std::string json = "{\"entries\": [\n";
+        char entry[512];
+        for (int i = 0; json.length() < kDocumentBytes; ++i)
+        {
+            _snprintf_s(entry, sizeof(entry), _TRUNCATE,
+                "  {\"id\": %d, \"name\": \"entry %d\", \"path\": "
+                "\"C:\\\\Users\\\\user\\\\Documents\\\\file%d.txt\", "
+                "\"size\": %d.%03d, \"enabled\": %s, \"tags\": "
+                "[\"alpha\", \"beta\", null], \"note\": \"caf\\u00e9\"},\n",
+                i, i, i, i * 7, i % 1000, i % 3 ? "true" : "false");
+            json += entry;
+        }
+        json += "  {}\n]}\n";
+        return json;
+    }
+
+    void PrintMegabytes(const char* name, double ms, size_t bytes)
+    {
+        base::test::PrintRate(name, ms, kRepeats * bytes / (1024.0 * 1024.0),
+            "MB");
+    }
+
+    void PrintMemory(const char* name, size_t bytes, size_t tokens)
+    {
+        printf("%-36s %10.1f MB %12.1f bytes/token\n", name,
+            bytes / (1024.0 * 1024.0), static_cast<double>(bytes) / tokens);
+    }
+
+}
+
+void RunJSONReaderPerfTests()
+{
+    std::string json = MakeDocument();
+
+    NullDelegate null_delegate;
+    base::test::Timer null_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        base::JSONParser parser(false);
+        EXPECT(parser.Parse(json, &null_delegate));
+    }
+    PrintMegabytes("parse, no delegate", null_timer.ElapsedMs(),
+        json.length());
+    size_t tokens = null_delegate.tokens() / kRepeats;
+
+    base::test::Timer chunked_null_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        ChunkSource source(json);
+        base::JSONParser parser(false);
+        EXPECT(parser.Parse(&source, &null_delegate));
+    }
+    PrintMegabytes("parse 64 KB chunks, no delegate",
+        chunked_null_timer.ElapsedMs(), json.length());
+
+    base::test::Timer value_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        scoped_ptr<base::Value> value(base::JSONReader::Read(json, false));
+        EXPECT(value.get() != NULL);
+    }
+    PrintMegabytes("JSONReader::Read", value_timer.ElapsedMs(), json.length());
+
+    base::test::Timer chunked_value_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        ChunkSource source(json);
+        scoped_ptr<base::Value> value(base::JSONReader::ReadAndReturnError(
+            &source, false, NULL, NULL));
+        EXPECT(value.get() != NULL);
+    }
+    PrintMegabytes("JSONReader, 64 KB chunks",
+        chunked_value_timer.ElapsedMs(), json.length());
+
+    base::test::Timer document_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        base::JSONDocument document;
+        EXPECT(document.Parse(json, false));
+    }
+    PrintMegabytes("JSONDocument::Parse", document_timer.ElapsedMs(),
+        json.length());
+
+    scoped_ptr<base::Value> value(base::JSONReader::Read(json, false));
+    std::string written;
+    base::test::Timer write_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        written.clear();
+        base::JSONWriter::Write(value.get(), false, &written);
+    }
+    PrintMegabytes("JSONWriter::Write", write_timer.ElapsedMs(),
+        written.length());
+    value.reset();
+
+    // Memory.  Private bytes are those the process has committed, so the
+    // heap has to give back what the timings above freed for the deltas
+    // to mean much; they are rounded to pages either way.
+    scoped_ptr<base::ProcessMetrics> metrics(
+        base::ProcessMetrics::CreateProcessMetrics(
+        base::GetCurrentProcessHandle()));
+    printf("%-36s %10.1f MB %12.0f tokens\n", "input",
+        json.length() / (1024.0 * 1024.0), static_cast<double>(tokens));
+
+    size_t before_value = PrivateBytes(metrics.get());
+    value.reset(base::JSONReader::Read(json, false));
+    PrintMemory("Value tree, private bytes",
+        PrivateBytes(metrics.get()) - before_value, tokens);
+    value.reset();
+
+    base::JSONDocument document;
+    document.Parse(json, false);
+    PrintMemory("JSONDocument::memory_usage", document.memory_usage(),
+        tokens);
+
+    size_t before_chunked = PrivateBytes(metrics.get());
+    size_t peak_chunked = before_chunked;
+    {
+        // The parser holds no more than the token in progress and one chunk.
+        SampledSource source(json, metrics.get(), &peak_chunked);
+        base::JSONParser parser(false);
+        EXPECT(parser.Parse(&source, &null_delegate));
+    }
+    PrintMemory("64 KB chunks, peak private bytes",
+        peak_chunked - before_chunked, tokens);
+}
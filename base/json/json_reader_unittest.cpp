@@ -0,0 +1,242 @@
+// Checks that JSONParser reads input handed over in chunks exactly as it
+// reads the same input in one piece, at every chunk size, including where
+// errors are reported; that numbers are read and written with a '.' under a
+// locale with a decimal comma; and that doubles survive JSONWriter and
+// JSONReader bit for bit.
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/test/test_util.h"
+#include "base/value.h"
+
+namespace
+{
+
+    // Hands out |json| |chunk_size| bytes at a time, from a buffer that is
+    // overwritten by the next chunk, so that the parser may not hold on to
+    // a chunk.
+    class SplitSource : public base::JSONChunkSource
+    {
+    public:
+        SplitSource(const std::string& json, size_t chunk_size)
+            : json_(json), chunk_size_(chunk_size), offset_(0) {}
+
+        virtual base::StringPiece NextChunk()
+        {
+            size_t length = std::min(chunk_size_, json_.length() - offset_);
+            chunk_.assign(json_, offset_, length);
+            offset_ += length;
+            return chunk_;
+        }
+
+    private:
+        const std::string& json_;
+        size_t chunk_size_;
+        size_t offset_;
+        std::string chunk_;
+    };
+
+    const char* const kDocuments[] =
+    {
+        "{\"a\": [1, 2.5, -3e4, true, false, null], \"b\": {}}",
+        "\xEF\xBB\xBF [\"x\\u00E9\\uD83D\\uDE00y\", \"tab\\tquote\\\"\"]",
+        "/* a comment\n over two lines */ // and one more\n[1 , \"abc\\n\"]\n",
+        "{\"key\"\n:\n\"value\"\n,\n}",
+        "[1, 2, ]",
+        "[1,\n2,\n 3x]",
+        "[\"line\nbreak\"]",
+        "[\"unterminated",
+        "/* never closed",
+        "[01]",
+        "[1.]",
+        "[-]",
+        "{key: 1}",
+        "[\"\\uD800\"]",
+        "[\"\\q\"]",
+        "[1e400, 12345678901234567890, 0.1, -0]",
+        "tru",
+        "[true] x",
+        "",
+        "/",
+    };
+
+    void ExpectSameResult(const std::string& json, bool allow_trailing_comma)
+    {
+        int whole_error = 0;
+        std::string whole_message;
+        scoped_ptr<base::Value> whole(base::JSONReader::ReadAndReturnError(
+            json, allow_trailing_comma, &whole_error, &whole_message));
+
+        for (size_t chunk_size = 1; chunk_size <= json.length() + 1;
+            ++chunk_size)
+        {
+            SplitSource source(json, chunk_size);
+            int chunked_error = 0;
+            std::string chunked_message;
+            scoped_ptr<base::Value> chunked(
+                base::JSONReader::ReadAndReturnError(&source,
+                allow_trailing_comma, &chunked_error, &chunked_message));
+            EXPECT(base::Value::Equals(whole.get(), chunked.get()));
+            EXPECT(chunked_error == whole_error);
+            EXPECT(chunked_message == whole_message);
+        }
+    }
+
+    void TestChunks()
+    {
+        for (size_t i = 0; i < arraysize(kDocuments); ++i)
+        {
+            ExpectSameResult(kDocuments[i], false);
+            ExpectSameResult(kDocuments[i], true);
+        }
+
+        // A document much larger than its chunks, with tokens of every kind
+        // cut at every offset.
+        std::string large = "[";
+        for (int i = 0; i < 500; ++i)
+        {
+            large += "{\"name\": \"item\\u0020with an escape\", \"value\": ";
+            large += i % 2 ? "-12.5e-3" : "123456";
+            large += ", \"flag\": true, /* note */ \"list\": [null, false]},\n";
+        }
+        large += "\"end\"]";
+        scoped_ptr<base::Value> whole(base::JSONReader::Read(large, false));
+        EXPECT(whole.get() != NULL);
+        const size_t kChunkSizes[] = { 1, 7, 64, 4096 };
+        for (size_t i = 0; i < arraysize(kChunkSizes); ++i)
+        {
+            SplitSource source(large, kChunkSizes[i]);
+            scoped_ptr<base::Value> chunked(
+                base::JSONReader::ReadAndReturnError(&source, false, NULL,
+                NULL));
+            EXPECT(base::Value::Equals(whole.get(), chunked.get()));
+        }
+    }
+
+    void TestErrorPositions()
+    {
+        struct Case
+        {
+            const char* json;
+            base::JSONParser::JsonParseError error;
+            int line;
+            int column;
+        };
+        const Case kCases[] =
+        {
+            { "[1,\n2,\n 3x]", base::JSONParser::JSON_SYNTAX_ERROR, 3, 3 },
+            { "[1, 2, ]", base::JSONParser::JSON_TRAILING_COMMA, 1, 6 },
+            { "\n  [\"abc", base::JSONParser::JSON_SYNTAX_ERROR, 2, 4 },
+            { "[1]\n\n x", base::JSONParser::JSON_UNEXPECTED_DATA_AFTER_ROOT,
+                3, 2 },
+            { "[\"\\x\"]", base::JSONParser::JSON_INVALID_ESCAPE, 1, 3 },
+        };
+        for (size_t i = 0; i < arraysize(kCases); ++i)
+        {
+            for (size_t chunk_size = 1; chunk_size <= 3; ++chunk_size)
+            {
+                std::string json(kCases[i].json);
+                SplitSource source(json, chunk_size);
+                int error;
+                std::string message;
+                scoped_ptr<base::Value> value(
+                    base::JSONReader::ReadAndReturnError(&source, false,
+                    &error, &message));
+                EXPECT(value.get() == NULL);
+                EXPECT(error == kCases[i].error);
+                char expected[64];
+                _snprintf_s(expected, sizeof(expected), _TRUNCATE,
+                    "Line: %d, column: %d, ", kCases[i].line,
+                    kCases[i].column);
+                EXPECT(message.compare(0, strlen(expected), expected) == 0);
+            }
+        }
+    }
+
+    void TestDecimalCommaLocale()
+    {
+        // The CRT formats and reads numbers with a decimal comma under this
+        // locale; skip if it is not installed.
+        if (!setlocale(LC_NUMERIC, "German"))
+        {
+            return;
+        }
+
+        scoped_ptr<base::Value> value(
+            base::JSONReader::Read("[0.5, 1.25e2]", false));
+        EXPECT(value.get() && value->IsType(base::Value::TYPE_LIST));
+        double first = 0;
+        double second = 0;
+        base::ListValue* list = static_cast<base::ListValue*>(value.get());
+        EXPECT(list->GetDouble(0, &first) && first == 0.5);
+        EXPECT(list->GetDouble(1, &second) && second == 125);
+
+        std::string json;
+        base::JSONWriter::Write(value.get(), false, &json);
+        EXPECT(json == "[0.5,125.0]");
+
+        setlocale(LC_NUMERIC, "C");
+    }
+
+    unsigned int random_state = 1;
+
+    unsigned int Random()
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return random_state >> 8;
+    }
+
+    void TestDoubleRoundTrip()
+    {
+        // Finite doubles of every magnitude, with random mantissas.
+        base::ListValue list;
+        for (int i = 0; i < 10000; ++i)
+        {
+            uint64 bits = (static_cast<uint64>(Random()) << 40) ^
+                (static_cast<uint64>(Random()) << 20) ^ Random();
+            bits &= (GG_UINT64_C(1) << 52) - 1;
+            bits |= static_cast<uint64>(Random() % 2047) << 52;
+            bits |= static_cast<uint64>(i % 2) << 63;
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            list.Append(base::Value::CreateDoubleValue(value));
+        }
+
+        std::string json;
+        base::JSONWriter::Write(&list, false, &json);
+        scoped_ptr<base::Value> read(base::JSONReader::Read(json, false));
+        EXPECT(read.get() && read->IsType(base::Value::TYPE_LIST));
+        if (!read.get() || !read->IsType(base::Value::TYPE_LIST))
+        {
+            return;
+        }
+        base::ListValue* read_list = static_cast<base::ListValue*>(read.get());
+        EXPECT(read_list->GetSize() == list.GetSize());
+        for (size_t i = 0; i < list.GetSize() && i < read_list->GetSize();
+            ++i)
+        {
+            double expected = 0;
+            double actual = 1;
+            list.GetDouble(i, &expected);
+            read_list->GetDouble(i, &actual);
+            EXPECT(memcmp(&expected, &actual, sizeof(double)) == 0);
+        }
+    }
+
+}
+
+void RunJSONReaderTests()
+{
+    TestChunks();
+    TestErrorPositions();
+    TestDecimalCommaLocale();
+    TestDoubleRoundTrip();
+}
@@ -0,0 +1,394 @@
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/float_util.h"
+#include "base/json/json_document.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/value.h"
+
+namespace
+{
+
+    const char kPrettyPrintLineEnding[] = "\r\n";
+    const size_t kIndentWidth = 3;
+
+    // Shortest of %.15g and %.17g that reads back as |value|, with a ".0"
+    // added where needed so that the reader sees a double again.  Both are
+    // done in the C locale; a locale with a decimal comma would otherwise
+    // write JSON that no reader accepts.
+    std::string FormatDouble(double value)
+    {
+        _locale_t c_locale = base::CLocale();
+        char buffer[32];
+        _snprintf_s_l(buffer, sizeof(buffer), _TRUNCATE, "%.15g", c_locale,
+            value);
+        if (_strtod_l(buffer, NULL, c_locale) != value)
+        {
+            _snprintf_s_l(buffer, sizeof(buffer), _TRUNCATE, "%.17g", c_locale,
+                value);
+        }
+
+        std::string result(buffer);
+        if (result.find_first_of(".eE") == std::string::npos)
+        {
+            result.append(".0");
+        }
+        return result;
+    }
+
+    void WriteValue(const base::Value* node, base::JSONStreamWriter* writer)
+    {
+        switch (node->GetType())
+        {
+        case base::Value::TYPE_NULL:
+            writer->WriteNull();
+            break;
+
+        case base::Value::TYPE_BOOLEAN:
+        {
+            bool value;
+            bool result = node->GetAsBoolean(&value);
+            DCHECK(result);
+            writer->WriteBoolean(value);
+            break;
+        }
+
+        case base::Value::TYPE_INTEGER:
+        {
+            int value;
+            bool result = node->GetAsInteger(&value);
+            DCHECK(result);
+            writer->WriteInteger(value);
+            break;
+        }
+
+        case base::Value::TYPE_DOUBLE:
+        {
+            double value;
+            bool result = node->GetAsDouble(&value);
+            DCHECK(result);
+            writer->WriteDouble(value);
+            break;
+        }
+
+        case base::Value::TYPE_STRING:
+        {
+            std::string value;
+            bool result = node->GetAsString(&value);
+            DCHECK(result);
+            writer->WriteString(value);
+            break;
+        }
+
+        case base::Value::TYPE_LIST:
+        {
+            const base::ListValue* list =
+                static_cast<const base::ListValue*>(node);
+            writer->BeginList();
+            for (base::ListValue::const_iterator it = list->begin();
+                it != list->end(); ++it)
+            {
+                if (!(*it)->IsType(base::Value::TYPE_BINARY))
+                {
+                    WriteValue(*it, writer);
+                }
+            }
+            writer->EndList();
+            break;
+        }
+
+        case base::Value::TYPE_DICTIONARY:
+        {
+            const base::DictionaryValue* dictionary =
+                static_cast<const base::DictionaryValue*>(node);
+            writer->BeginDictionary();
+            for (base::DictionaryValue::key_iterator it =
+                dictionary->begin_keys(); it != dictionary->end_keys(); ++it)
+            {
+                base::Value* value = NULL;
+                bool result = dictionary->GetWithoutPathExpansion(*it, &value);
+                DCHECK(result);
+                if (!value->IsType(base::Value::TYPE_BINARY))
+                {
+                    writer->WriteKey(*it);
+                    WriteValue(value, writer);
+                }
+            }
+            writer->EndDictionary();
+            break;
+        }
+
+        default:
+            NOTREACHED() << "unknown json type";
+        }
+    }
+
+    void WriteNode(const base::JSONNode& node, base::JSONStreamWriter* writer)
+    {
+        switch (node.type())
+        {
+        case base::Value::TYPE_NULL:
+            writer->WriteNull();
+            break;
+
+        case base::Value::TYPE_BOOLEAN:
+        {
+            bool value = false;
+            node.GetAsBoolean(&value);
+            writer->WriteBoolean(value);
+            break;
+        }
+
+        case base::Value::TYPE_INTEGER:
+        {
+            int value = 0;
+            node.GetAsInteger(&value);
+            writer->WriteInteger(value);
+            break;
+        }
+
+        case base::Value::TYPE_DOUBLE:
+        {
+            double value = 0;
+            node.GetAsDouble(&value);
+            writer->WriteDouble(value);
+            break;
+        }
+
+        case base::Value::TYPE_STRING:
+        {
+            base::StringPiece value;
+            node.GetAsString(&value);
+            writer->WriteString(value);
+            break;
+        }
+
+        case base::Value::TYPE_LIST:
+            writer->BeginList();
+            for (size_t i = 0; i < node.size(); ++i)
+            {
+                WriteNode(*node.GetListItem(i), writer);
+            }
+            writer->EndList();
+            break;
+
+        case base::Value::TYPE_DICTIONARY:
+            writer->BeginDictionary();
+            for (size_t i = 0; i < node.size(); ++i)
+            {
+                writer->WriteKey(node.GetKey(i));
+                WriteNode(*node.GetMemberValue(i), writer);
+            }
+            writer->EndDictionary();
+            break;
+
+        default:
+            NOTREACHED() << "unknown json type";
+        }
+    }
+
+}
+
+namespace base
+{
+
+    JSONStreamWriter::JSONStreamWriter(std::string* output, bool pretty_print)
+        : output_(output),
+        pretty_print_(pretty_print),
+        after_key_(false) {}
+
+    JSONStreamWriter::~JSONStreamWriter()
+    {
+        DCHECK(item_counts_.empty());
+    }
+
+    void JSONStreamWriter::WriteNull()
+    {
+        BeginItem();
+        output_->append("null");
+    }
+
+    void JSONStreamWriter::WriteBoolean(bool value)
+    {
+        BeginItem();
+        output_->append(value ? "true" : "false");
+    }
+
+    void JSONStreamWriter::WriteInteger(int value)
+    {
+        BeginItem();
+        output_->append(IntToString(value));
+    }
+
+    void JSONStreamWriter::WriteDouble(double value)
+    {
+        BeginItem();
+        if (!IsFinite(value))
+        {
+            output_->append("null");
+            return;
+        }
+        output_->append(FormatDouble(value));
+    }
+
+    void JSONStreamWriter::WriteString(const StringPiece& value)
+    {
+        BeginItem();
+
+        static const char kHexDigits[] = "0123456789ABCDEF";
+        output_->reserve(output_->size() + value.size() + 2);
+        output_->push_back('"');
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            unsigned char c = static_cast<unsigned char>(value[i]);
+            switch (c)
+            {
+            case '"':
+                output_->append("\\\"");
+                break;
+            case '\\':
+                output_->append("\\\\");
+                break;
+            case '\b':
+                output_->append("\\b");
+                break;
+            case '\f':
+                output_->append("\\f");
+                break;
+            case '\n':
+                output_->append("\\n");
+                break;
+            case '\r':
+                output_->append("\\r");
+                break;
+            case '\t':
+                output_->append("\\t");
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    output_->append("\\u00");
+                    output_->push_back(kHexDigits[c >> 4]);
+                    output_->push_back(kHexDigits[c & 0xF]);
+                }
+                else
+                {
+                    output_->push_back(c);
+                }
+            }
+        }
+        output_->push_back('"');
+    }
+
+    void JSONStreamWriter::BeginDictionary()
+    {
+        BeginItem();
+        output_->push_back('{');
+        item_counts_.push_back(0);
+    }
+
+    void JSONStreamWriter::WriteKey(const StringPiece& key)
+    {
+        DCHECK(!after_key_);
+        BeginItem();
+        // WriteString() would start another item.
+        after_key_ = true;
+        WriteString(key);
+        output_->append(pretty_print_ ? ": " : ":");
+        after_key_ = true;
+    }
+
+    void JSONStreamWriter::EndDictionary()
+    {
+        EndContainer('}');
+    }
+
+    void JSONStreamWriter::BeginList()
+    {
+        BeginItem();
+        output_->push_back('[');
+        item_counts_.push_back(0);
+    }
+
+    void JSONStreamWriter::EndList()
+    {
+        EndContainer(']');
+    }
+
+    void JSONStreamWriter::BeginItem()
+    {
+        if (after_key_)
+        {
+            // The value of a dictionary member follows its key directly.
+            after_key_ = false;
+            return;
+        }
+        if (item_counts_.empty())
+        {
+            return;
+        }
+        if (item_counts_.back()++ > 0)
+        {
+            output_->push_back(',');
+        }
+        if (pretty_print_)
+        {
+            output_->append(kPrettyPrintLineEnding);
+            Indent(item_counts_.size());
+        }
+    }
+
+    void JSONStreamWriter::EndContainer(char close)
+    {
+        DCHECK(!item_counts_.empty());
+        DCHECK(!after_key_);
+        size_t items = item_counts_.back();
+        item_counts_.pop_back();
+        if (pretty_print_ && items > 0)
+        {
+            output_->append(kPrettyPrintLineEnding);
+            Indent(item_counts_.size());
+        }
+        output_->push_back(close);
+    }
+
+    void JSONStreamWriter::Indent(size_t depth)
+    {
+        output_->append(depth * kIndentWidth, ' ');
+    }
+
+    const char* JSONWriter::kEmptyArray = "[]";
+
+    // static
+    void JSONWriter::Write(const Value* const node, bool pretty_print,
+        std::string* json)
+    {
+        json->clear();
+        // Is there a better way to estimate the size of the output?
+        json->reserve(1024);
+        JSONStreamWriter writer(json, pretty_print);
+        WriteValue(node, &writer);
+        if (pretty_print)
+        {
+            json->append(kPrettyPrintLineEnding);
+        }
+    }
+
+    // static
+    void JSONWriter::Write(const JSONNode& node, bool pretty_print,
+        std::string* json)
+    {
+        json->clear();
+        json->reserve(1024);
+        JSONStreamWriter writer(json, pretty_print);
+        WriteNode(node, &writer);
+        if (pretty_print)
+        {
+            json->append(kPrettyPrintLineEnding);
+        }
+    }
+
+} //namespace base
@@ -0,0 +1,84 @@
+#ifndef __base_json_writer_h__
+#define __base_json_writer_h__
+
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/string_piece.h"
+
+namespace base
+{
+    class JSONNode;
+    class Value;
+
+    // Writes JSON token by token into a string, taking care of separators,
+    // quoting and indentation, so that callers can serialize their own data
+    // without building a Value tree first.  The caller is responsible for
+    // balancing Begin/End calls and for calling WriteKey() before each value
+    // in a dictionary.
+    class JSONStreamWriter
+    {
+    public:
+        // Appends to |output|, which must outlive the writer.
+        JSONStreamWriter(std::string* output, bool pretty_print);
+        ~JSONStreamWriter();
+
+        void WriteNull();
+        void WriteBoolean(bool value);
+        void WriteInteger(int value);
+        // Non-finite values cannot be represented and are written as null.
+        void WriteDouble(double value);
+        // |value| is UTF-8.
+        void WriteString(const StringPiece& value);
+
+        void BeginDictionary();
+        void WriteKey(const StringPiece& key);
+        void EndDictionary();
+
+        void BeginList();
+        void EndList();
+
+    private:
+        // Emits the separator and indentation due before a list item or key.
+        void BeginItem();
+        void EndContainer(char close);
+        void Indent(size_t depth);
+
+        std::string* output_;
+        bool pretty_print_;
+
+        // Number of items written so far in each open container.
+        std::vector<size_t> item_counts_;
+
+        // The next value completes a dictionary member.
+        bool after_key_;
+
+        DISALLOW_COPY_AND_ASSIGN(JSONStreamWriter);
+    };
+
+    class JSONWriter
+    {
+    public:
+        // Given a root node, generates a JSON string and puts it into |json|.
+        // If |pretty_print| is true, return a slightly nicer formated json
+        // string (pads with whitespace to help readability).  Binary values
+        // are not representable and are skipped.
+        static void Write(const Value* const node, bool pretty_print,
+            std::string* json);
+
+        // Same for a node of a JSONDocument.
+        static void Write(const JSONNode& node, bool pretty_print,
+            std::string* json);
+
+        // A static, constant JSON string representing an empty array.  Useful
+        // for empty JSON argument passing.
+        static const char* kEmptyArray;
+
+    private:
+        DISALLOW_IMPLICIT_CONSTRUCTORS(JSONWriter);
+    };
+
+} //namespace base
+
+#endif //__base_json_writer_h__
@@ -1,6 +1,7 @@
 #include "logging.h"
 
 #include <io.h>
+#include <stdlib.h>
 #include <windows.h>
 
 #define write(fd, buf, count) _write(fd, buf, static_cast<unsigned int>(count))
@@ -10,13 +11,16 @@
 #include <algorithm>
 #include <ctime>
 #include <iomanip>
+#include <vector>
 
+#include "atomicops.h"
 #include "base_switches.h"
 #include "command_line.h"
 #include "debug/debugger.h"
 #include "debug/stack_trace.h"
 #include "string_piece.h"
 #include "synchronization/lock_impl.h"
+#include "threading/platform_thread.h"
 #include "utf_string_conversions.h"
 #include "vlog.h"
 
@@ -25,6 +29,14 @@ namespace base
 
     DcheckState g_dcheck_state = DISABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS;
     VlogInfo* g_vlog_info = NULL;
+    volatile int g_vlog_generation = 1;
+
+    // Every VLOG_IS_ON slot filled so far, so that they can all be cleared
+    // when the generation wraps around.  Filling a slot and changing the
+    // generation both hold |vlog_slots_lock|, a spin lock that needs no
+    // constructor and so works from static initializers too.
+    std::vector<volatile int*>* vlog_slots = NULL;
+    volatile subtle::Atomic32 vlog_slots_lock = 0;
 
     const char* const log_severity_names[LOG_NUM_SEVERITIES] =
     {
@@ -53,6 +65,12 @@ namespace base
     LogReportHandlerFunction log_report_handler = NULL;
     LogMessageHandlerFunction log_message_handler = NULL;
 
+    class AsyncLogWriter;
+    LogWriteMode log_write_mode = LOG_WRITE_SYNCHRONOUSLY;
+    AsyncLogWriter* async_log_writer = NULL;
+    bool async_log_writer_stopped = false;
+    LPTOP_LEVEL_EXCEPTION_FILTER previous_exception_filter = NULL;
+
     int32 CurrentProcessId()
     {
         return GetCurrentProcessId();
@@ -159,7 +177,7 @@ namespace base
             }
             else
             {
-                log_lock->Lock();
+                log_lock->Lock(NULL);
             }
         }
 
@@ -226,11 +244,295 @@ namespace base
         return true;
     }
 
+    void WriteToLogFile(const std::string& data)
+    {
+        LoggingLock logging_lock;
+
+        if (InitializeLogFileHandle())
+        {
+            SetFilePointer(log_file, 0, 0, SEEK_END);
+            DWORD num_written;
+            WriteFile(log_file, static_cast<const void*>(data.c_str()),
+                static_cast<DWORD>(data.length()), &num_written, NULL);
+        }
+    }
+
+    // Bounded multi-producer queue of formatted messages, drained by a writer
+    // thread.  Producers claim a slot with one compare-and-swap and never
+    // block; each slot carries a sequence number telling whether it is free
+    // for the producer of a given lap or filled for the consumer.  Draining is
+    // serialized by |drain_lock_|, so the consumer side needs no atomics.
+    class AsyncLogWriter : public PlatformThread::Delegate
+    {
+    public:
+        AsyncLogWriter()
+            : enqueue_position_(0),
+            dequeue_position_(0),
+            writer_waiting_(0),
+            dropped_(0),
+            dropped_total_(0),
+            stopping_(0),
+            wake_event_(NULL),
+            thread_(NULL)
+        {
+            for (int i = 0; i < kQueueSize; ++i)
+            {
+                slots_[i].sequence = i;
+                slots_[i].message = NULL;
+            }
+        }
+
+        bool Start()
+        {
+            wake_event_ = CreateEvent(NULL, FALSE, FALSE, NULL);
+            if (!wake_event_)
+            {
+                return false;
+            }
+            return PlatformThread::Create(0, this, &thread_);
+        }
+
+        // Stops the writer thread and writes out what it left queued.  Waits
+        // at most about a second for the thread, and no more for the queue,
+        // in case the process is exiting with the thread already gone.
+        void Stop()
+        {
+            subtle::Release_Store(&stopping_, 1);
+            SetEvent(wake_event_);
+            WaitForSingleObject(thread_, kStopTimeoutMs);
+            CloseHandle(thread_);
+            thread_ = NULL;
+            FlushForCrash();
+        }
+
+        // Takes ownership of |message|.
+        void Enqueue(std::string* message)
+        {
+            subtle::Atomic32 position = subtle::NoBarrier_Load(&enqueue_position_);
+            for (;;)
+            {
+                Slot& slot = slots_[position & (kQueueSize - 1)];
+                subtle::Atomic32 lap = subtle::Acquire_Load(&slot.sequence) - position;
+                if (lap == 0)
+                {
+                    subtle::Atomic32 previous = subtle::NoBarrier_CompareAndSwap(
+                        &enqueue_position_, position, position + 1);
+                    if (previous == position)
+                    {
+                        slot.message = message;
+                        subtle::Release_Store(&slot.sequence, position + 1);
+                        break;
+                    }
+                    position = previous;
+                }
+                else if (lap < 0)
+                {
+                    // The writer is a full queue behind; drop the message.
+                    subtle::NoBarrier_AtomicIncrement(&dropped_, 1);
+                    subtle::NoBarrier_AtomicIncrement(&dropped_total_, 1);
+                    delete message;
+                    return;
+                }
+                else
+                {
+                    position = subtle::NoBarrier_Load(&enqueue_position_);
+                }
+            }
+
+            // Only pay for SetEvent() when the writer went to sleep.
+            subtle::MemoryBarrier();
+            if (subtle::NoBarrier_Load(&writer_waiting_) &&
+                subtle::NoBarrier_AtomicExchange(&writer_waiting_, 0))
+            {
+                SetEvent(wake_event_);
+            }
+        }
+
+        // Writes out everything queued so far.  Safe to call from any thread.
+        void Flush()
+        {
+            drain_lock_.Lock(NULL);
+            Drain();
+            drain_lock_.Unlock();
+        }
+
+        // Like Flush(), but gives up if the queue cannot be taken over within
+        // about a second, as the thread holding it may be the one crashing.
+        void FlushForCrash()
+        {
+            for (int attempt = 0; attempt < 1000; ++attempt)
+            {
+                if (drain_lock_.Try(NULL))
+                {
+                    Drain();
+                    drain_lock_.Unlock();
+                    return;
+                }
+                ::Sleep(1);
+            }
+        }
+
+        int dropped_total() const
+        {
+            return subtle::NoBarrier_Load(&dropped_total_);
+        }
+
+        virtual void ThreadMain()
+        {
+            PlatformThread::SetName("LogWriter");
+            while (!subtle::Acquire_Load(&stopping_))
+            {
+                Flush();
+
+                subtle::NoBarrier_Store(&writer_waiting_, 1);
+                subtle::MemoryBarrier();
+                if (!HasQueuedMessage())
+                {
+                    WaitForSingleObject(wake_event_, kIdleWakeMs);
+                }
+                subtle::NoBarrier_Store(&writer_waiting_, 0);
+            }
+        }
+
+    private:
+        // Must be a power of 2.
+        static const int kQueueSize = 4096;
+        // Messages are written in chunks of about this many bytes.
+        static const size_t kMaxBatchSize = 64 * 1024;
+        // The writer also wakes up on its own, in case a wake-up was missed.
+        static const DWORD kIdleWakeMs = 100;
+        static const DWORD kStopTimeoutMs = 1000;
+
+        struct Slot
+        {
+            volatile subtle::Atomic32 sequence;
+            std::string* message;
+        };
+
+        bool HasQueuedMessage() const
+        {
+            subtle::Atomic32 position = subtle::NoBarrier_Load(&dequeue_position_);
+            const Slot& slot = slots_[position & (kQueueSize - 1)];
+            return subtle::Acquire_Load(&slot.sequence) == position + 1;
+        }
+
+        // Must hold |drain_lock_|.
+        std::string* Dequeue()
+        {
+            if (!HasQueuedMessage())
+            {
+                return NULL;
+            }
+            subtle::Atomic32 position = dequeue_position_;
+            Slot& slot = slots_[position & (kQueueSize - 1)];
+            std::string* message = slot.message;
+            subtle::Release_Store(&slot.sequence, position + kQueueSize);
+            subtle::NoBarrier_Store(&dequeue_position_, position + 1);
+            return message;
+        }
+
+        // Must hold |drain_lock_|.
+        void Drain()
+        {
+            std::string batch;
+            subtle::Atomic32 dropped = subtle::NoBarrier_AtomicExchange(&dropped_, 0);
+            if (dropped)
+            {
+                std::ostringstream notice;
+                notice << "[" << dropped << " log messages dropped]" << std::endl;
+                batch = notice.str();
+            }
+
+            std::string* message;
+            while ((message = Dequeue()) != NULL)
+            {
+                batch.append(*message);
+                delete message;
+                if (batch.size() >= kMaxBatchSize)
+                {
+                    WriteToLogFile(batch);
+                    batch.clear();
+                }
+            }
+            if (!batch.empty())
+            {
+                WriteToLogFile(batch);
+            }
+        }
+
+        Slot slots_[kQueueSize];
+
+        // Producers and the consumer update these; keep them on separate
+        // cache lines.
+        char padding0_[64];
+        volatile subtle::Atomic32 enqueue_position_;
+        char padding1_[64];
+        volatile subtle::Atomic32 dequeue_position_;
+        char padding2_[64];
+
+        volatile subtle::Atomic32 writer_waiting_;
+        volatile subtle::Atomic32 dropped_;
+        volatile subtle::Atomic32 dropped_total_;
+        volatile subtle::Atomic32 stopping_;
+        HANDLE wake_event_;
+        PlatformThreadHandle thread_;
+        internal::LockImpl drain_lock_;
+    };
+
+    long WINAPI LogFlushExceptionFilter(EXCEPTION_POINTERS* info)
+    {
+        if (async_log_writer)
+        {
+            async_log_writer->FlushForCrash();
+        }
+        if (previous_exception_filter)
+        {
+            return previous_exception_filter(info);
+        }
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    // Registered with atexit(), so that the messages still queued when the
+    // process exits are written rather than lost with the writer thread.
+    // Anything logged later, by other exit handlers or static destructors,
+    // is written synchronously.
+    void __cdecl StopAsyncLogWriter()
+    {
+        log_write_mode = LOG_WRITE_SYNCHRONOUSLY;
+        async_log_writer_stopped = true;
+        async_log_writer->Stop();
+    }
+
+    void SetLogWriteMode(LogWriteMode write_mode)
+    {
+        if (write_mode == LOG_WRITE_ASYNCHRONOUSLY && async_log_writer_stopped)
+        {
+            return;
+        }
+        if (write_mode == LOG_WRITE_ASYNCHRONOUSLY && !async_log_writer)
+        {
+            // Leaked on purpose; the writer thread runs until the process
+            // exits, when StopAsyncLogWriter() drains it.
+            AsyncLogWriter* writer = new AsyncLogWriter();
+            if (!writer->Start())
+            {
+                delete writer;
+                return;
+            }
+            async_log_writer = writer;
+            atexit(&StopAsyncLogWriter);
+            previous_exception_filter =
+                SetUnhandledExceptionFilter(&LogFlushExceptionFilter);
+        }
+        log_write_mode = write_mode;
+    }
+
     void BaseInitLoggingImpl(const PathChar* new_log_file,
         LoggingDestination logging_dest,
         LogLockingState lock_log,
         OldFileDeletionState delete_old,
-        DcheckState dcheck_state)
+        DcheckState dcheck_state,
+        LogWriteMode write_mode)
     {
         CommandLine* command_line = CommandLine::ForCurrentProcess();
         g_dcheck_state = dcheck_state;
@@ -242,9 +544,14 @@ namespace base
             g_vlog_info = new VlogInfo(command_line->GetSwitchValueASCII(kV),
                 command_line->GetSwitchValueASCII(kVModule), &min_log_level);
         }
+        InvalidateVlogLevelCaches();
 
         LoggingLock::Init(lock_log, new_log_file);
 
+        // Queued messages still belong to the old log file.
+        FlushLogFile();
+        SetLogWriteMode(write_mode);
+
         LoggingLock logging_lock;
 
         if (log_file)
@@ -280,6 +587,7 @@ namespace base
     void SetMinLogLevel(int level)
     {
         min_log_level = std::min(LOG_ERROR_REPORT, level);
+        InvalidateVlogLevelCaches();
     }
 
     int GetMinLogLevel()
@@ -299,6 +607,61 @@ namespace base
             : GetVlogVerbosity();
     }
 
+    class VlogSlotsAutoLock
+    {
+    public:
+        VlogSlotsAutoLock()
+        {
+            while (subtle::Acquire_CompareAndSwap(&vlog_slots_lock, 0, 1))
+            {
+                PlatformThread::YieldCurrentThread();
+            }
+        }
+
+        ~VlogSlotsAutoLock()
+        {
+            subtle::Release_Store(&vlog_slots_lock, 0);
+        }
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(VlogSlotsAutoLock);
+    };
+
+    void InvalidateVlogLevelCaches()
+    {
+        VlogSlotsAutoLock lock;
+        int next = g_vlog_generation % 0x7FFF + 1;
+
+        // Slots last filled 0x7FFF generations ago would match again.
+        if (next == 1 && vlog_slots)
+        {
+            for (size_t i = 0; i < vlog_slots->size(); ++i)
+            {
+                subtle::NoBarrier_Store((*vlog_slots)[i], 0);
+            }
+        }
+        subtle::Release_Store(&g_vlog_generation, next);
+    }
+
+    int UpdateVlogLevelCache(const char* file, size_t N, volatile int* cache)
+    {
+        VlogSlotsAutoLock lock;
+        if (*cache == 0)
+        {
+            if (!vlog_slots)
+            {
+                vlog_slots = new std::vector<volatile int*>;
+            }
+            vlog_slots->push_back(cache);
+        }
+
+        int level = GetVlogLevelHelper(file, N);
+        int clamped = std::max(-0x8000, std::min(0x7FFF, level));
+        subtle::NoBarrier_Store(cache,
+            (g_vlog_generation << 16) | (clamped & 0xFFFF));
+        return level;
+    }
+
     void SetLogItems(bool enable_process_id, bool enable_thread_id,
         bool enable_timestamp, bool enable_tickcount)
     {
@@ -489,6 +852,12 @@ namespace base
         if (log_message_handler && log_message_handler(severity_, file_, line_,
             message_start_, str_newline))
         {
+            // The handler owns a FATAL message, but the process is still
+            // going down; do not lose what was queued before it.
+            if (severity_ == LOG_FATAL)
+            {
+                FlushLogFile();
+            }
             return;
         }
 
@@ -509,14 +878,18 @@ namespace base
         if (logging_destination != LOG_NONE &&
             logging_destination != LOG_ONLY_TO_SYSTEM_DEBUG_LOG)
         {
-            LoggingLock logging_lock;
-
-            if (InitializeLogFileHandle())
+            if (log_write_mode == LOG_WRITE_ASYNCHRONOUSLY && severity_ < LOG_FATAL)
+            {
+                std::string* message = new std::string;
+                message->swap(str_newline);
+                async_log_writer->Enqueue(message);
+            }
+            else
             {
-                SetFilePointer(log_file, 0, 0, SEEK_END);
-                DWORD num_written;
-                WriteFile(log_file, static_cast<const void*>(str_newline.c_str()),
-                    static_cast<DWORD>(str_newline.length()), &num_written, NULL);
+                // A FATAL message is the last thing written before the crash,
+                // so get everything queued before it out first.
+                FlushLogFile();
+                WriteToLogFile(str_newline);
             }
         }
 
@@ -612,6 +985,8 @@ namespace base
 
     void CloseLogFile()
     {
+        FlushLogFile();
+
         LoggingLock logging_lock;
 
         if (!log_file)
@@ -623,6 +998,19 @@ namespace base
         log_file = NULL;
     }
 
+    void FlushLogFile()
+    {
+        if (async_log_writer)
+        {
+            async_log_writer->Flush();
+        }
+    }
+
+    int GetDroppedLogMessageCount()
+    {
+        return async_log_writer ? async_log_writer->dropped_total() : 0;
+    }
+
     void RawLog(int level, const char* message)
     {
         if (level >= min_log_level)
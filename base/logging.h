@@ -26,6 +26,14 @@ namespace base
         ENABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS
     };
 
+    // With LOG_WRITE_ASYNCHRONOUSLY, messages bound for the log file are put
+    // on a bounded lock-free queue and written in batches by a background
+    // thread, so a LOG() never waits for the disk.  When the queue is full new
+    // messages are dropped and counted.  FATAL messages, CloseLogFile() and
+    // crashes flush the queue first, and at exit the writer thread is stopped
+    // and the queue drained.
+    enum LogWriteMode { LOG_WRITE_SYNCHRONOUSLY, LOG_WRITE_ASYNCHRONOUSLY };
+
     typedef wchar_t PathChar;
 
 #if NDEBUG
@@ -38,7 +46,8 @@ namespace base
         LoggingDestination logging_dest,
         LogLockingState lock_log,
         OldFileDeletionState delete_old,
-        DcheckState dcheck_state);
+        DcheckState dcheck_state,
+        LogWriteMode write_mode = LOG_WRITE_SYNCHRONOUSLY);
 
     void SetMinLogLevel(int level);
 
@@ -54,6 +63,30 @@ namespace base
         return GetVlogLevelHelper(file, N);
     }
 
+    // VLOG_IS_ON caches the level resolved for each call site in a static
+    // slot holding (generation << 16 | level).  Changing the log level or the
+    // vmodule patterns bumps g_vlog_generation, which makes every slot stale,
+    // so a VLOG normally costs two loads and a compare.  The generation stays
+    // in [1, 0x7FFF]; an unused slot holds 0 and never matches, and every
+    // slot is cleared back to 0 when the generation wraps around.
+    extern volatile int g_vlog_generation;
+
+    void InvalidateVlogLevelCaches();
+
+    int UpdateVlogLevelCache(const char* file_start, size_t N,
+        volatile int* cache);
+
+    template<size_t N>
+    int GetVlogLevel(const char(&file)[N], volatile int* cache)
+    {
+        int cached = *cache;
+        if ((cached >> 16) == g_vlog_generation)
+        {
+            return static_cast<short>(cached & 0xFFFF);
+        }
+        return UpdateVlogLevelCache(file, N, cache);
+    }
+
     void SetLogItems(bool enable_process_id, bool enable_thread_id,
         bool enable_timestamp, bool enable_tickcount);
 
@@ -111,7 +144,15 @@ namespace base
 
 #define LOG_IS_ON(severity)                 ((base::LOG_ ## severity) >= base::GetMinLogLevel())
 
-#define VLOG_IS_ON(verboselevel)            ((verboselevel) <= base::GetVlogLevel(__FILE__))
+// The slot is a static local of a lambda, one per expansion.  In an inline
+// function or a template it is shared by every translation unit, as the
+// one definition rule wants.
+#define VLOG_IS_ON(verboselevel)            ((verboselevel) <= base::GetVlogLevel(__FILE__, \
+                                                []() -> volatile int* \
+                                                { \
+                                                    static volatile int cached_level = 0; \
+                                                    return &cached_level; \
+                                                }()))
 
 #define LAZY_STREAM(stream, condition) \
     !(condition) ? (void)0 : base::LogMessageVoidify()&(stream)
@@ -363,6 +404,13 @@ namespace base
 
     void CloseLogFile();
 
+    // Writes out the messages queued by asynchronous logging.
+    void FlushLogFile();
+
+    // Number of messages asynchronous logging dropped because its queue was
+    // full.
+    int GetDroppedLogMessageCount();
+
     void RawLog(int level, const char* message);
 
 #define RAW_LOG(level, message) base::RawLog(base::LOG_ ## level, message)
@@ -0,0 +1,49 @@
+// Checks that a VLOG_IS_ON call site caches its level only until the level
+// changes, including after the generation of the caches wraps around.
+
+#include "base/logging.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    // One call site, whose cached level the tests leave behind on purpose.
+    bool IsVerbose()
+    {
+        return VLOG_IS_ON(1);
+    }
+
+    void TestLevelChange()
+    {
+        base::SetMinLogLevel(-1);
+        EXPECT(IsVerbose());
+        base::SetMinLogLevel(0);
+        EXPECT(!IsVerbose());
+        base::SetMinLogLevel(-1);
+        EXPECT(IsVerbose());
+    }
+
+    void TestGenerationWrap()
+    {
+        // Cache "verbose" at this generation, turn verbose logging off without
+        // touching the call site, and bump the generation all the way around
+        // to where the slot was filled.
+        base::SetMinLogLevel(-1);
+        EXPECT(IsVerbose());
+        int filled = base::g_vlog_generation;
+        base::SetMinLogLevel(0);
+        while (base::g_vlog_generation != filled)
+        {
+            base::InvalidateVlogLevelCaches();
+        }
+        EXPECT(!IsVerbose());
+    }
+
+}
+
+void RunLoggingTests()
+{
+    TestLevelChange();
+    TestGenerationWrap();
+    base::SetMinLogLevel(0);
+}
@@ -1,6 +1,9 @@
 #include "message_loop.h"
 
+#include <intrin.h>
+
 #include "bind.h"
+#include "debug/task_profiler.h"
 #include "lazy_instance.h"
 #include "message_loop_proxy_impl.h"
 #include "message_pump_default.h"
@@ -59,6 +62,8 @@ namespace
 
 }
 
+#pragma intrinsic(_ReturnAddress)
+
 static int SEHFilter(LPTOP_LEVEL_EXCEPTION_FILTER old_filter)
 {
     ::SetUnhandledExceptionFilter(old_filter);
@@ -191,73 +196,51 @@ void MessageLoop::RemoveDestructionObserver(
     destruction_observers_.RemoveObserver(destruction_observer);
 }
 
-void MessageLoop::PostTask(Task* task)
+// The Post*Task() functions are not inlined so that _ReturnAddress() is
+// the site that posted.
+__declspec(noinline) void MessageLoop::PostTask(Task* task)
 {
-    CHECK(task);
-    PendingTask pending_task(
-        base::Bind(&base::subtle::TaskClosureAdapter::Run,
-            new base::subtle::TaskClosureAdapter(task, &should_leak_tasks_)),
-        CalculateDelayedRuntime(0), true);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, 0, true);
 }
 
-void MessageLoop::PostDelayedTask(Task* task, int64 delay_ms)
+__declspec(noinline) void MessageLoop::PostDelayedTask(Task* task,
+    int64 delay_ms)
 {
-    CHECK(task);
-    PendingTask pending_task(
-        base::Bind(&base::subtle::TaskClosureAdapter::Run,
-            new base::subtle::TaskClosureAdapter(task, &should_leak_tasks_)),
-        CalculateDelayedRuntime(delay_ms), true);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, delay_ms, true);
 }
 
-void MessageLoop::PostNonNestableTask(Task* task)
+__declspec(noinline) void MessageLoop::PostNonNestableTask(Task* task)
 {
-    CHECK(task);
-    PendingTask pending_task(
-        base::Bind(&base::subtle::TaskClosureAdapter::Run,
-            new base::subtle::TaskClosureAdapter(task, &should_leak_tasks_)),
-        CalculateDelayedRuntime(0), false);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, 0, false);
 }
 
-void MessageLoop::PostNonNestableDelayedTask(Task* task, int64 delay_ms)
+__declspec(noinline) void MessageLoop::PostNonNestableDelayedTask(Task* task,
+    int64 delay_ms)
 {
-    CHECK(task);
-    PendingTask pending_task(
-        base::Bind(&base::subtle::TaskClosureAdapter::Run,
-            new base::subtle::TaskClosureAdapter(task, &should_leak_tasks_)),
-        CalculateDelayedRuntime(delay_ms), false);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, delay_ms, false);
 }
 
-void MessageLoop::PostTask(const base::Closure& task)
+__declspec(noinline) void MessageLoop::PostTask(const base::Closure& task)
 {
-    CHECK(!task.is_null());
-    PendingTask pending_task(task, CalculateDelayedRuntime(0), true);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, 0, true);
 }
 
-void MessageLoop::PostDelayedTask(const base::Closure& task, int64 delay_ms)
+__declspec(noinline) void MessageLoop::PostDelayedTask(
+    const base::Closure& task, int64 delay_ms)
 {
-    CHECK(!task.is_null());
-    PendingTask pending_task(task, CalculateDelayedRuntime(delay_ms), true);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, delay_ms, true);
 }
 
-void MessageLoop::PostNonNestableTask(const base::Closure& task)
+__declspec(noinline) void MessageLoop::PostNonNestableTask(
+    const base::Closure& task)
 {
-    CHECK(!task.is_null());
-    PendingTask pending_task(task, CalculateDelayedRuntime(0), false);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, 0, false);
 }
 
-void MessageLoop::PostNonNestableDelayedTask(const base::Closure& task,
-    int64 delay_ms)
+__declspec(noinline) void MessageLoop::PostNonNestableDelayedTask(
+    const base::Closure& task, int64 delay_ms)
 {
-    CHECK(!task.is_null());
-    PendingTask pending_task(task, CalculateDelayedRuntime(delay_ms), false);
-    AddToIncomingQueue(&pending_task);
+    PostTaskHelper(_ReturnAddress(), task, delay_ms, false);
 }
 
 void MessageLoop::Run()
@@ -409,7 +392,25 @@ void MessageLoop::RunTask(const PendingTask& pending_task)
     HistogramEvent(kTaskRunEvent);
     FOR_EACH_OBSERVER(TaskObserver, task_observers_,
         WillProcessTask(pending_task.time_posted));
-    pending_task.task.Run();
+
+    // Tasks posted before the profiler was enabled carry no high resolution
+    // post time and are not recorded.
+    if (!pending_task.time_posted_high_res.is_null() &&
+        base::debug::TaskProfiler::IsEnabled())
+    {
+        base::debug::TaskProfiler::TaskRecord record;
+        record.posted_from = pending_task.posted_from;
+        record.time_posted = pending_task.time_posted_high_res;
+        record.run_depth = state_->run_depth;
+        record.start_time = base::TimeTicks::HighResNow();
+        pending_task.task.Run();
+        record.end_time = base::TimeTicks::HighResNow();
+        base::debug::TaskProfiler::RecordTask(thread_name_, record);
+    }
+    else
+    {
+        pending_task.task.Run();
+    }
     FOR_EACH_OBSERVER(TaskObserver, task_observers_,
         DidProcessTask(pending_task.time_posted));
 
@@ -530,6 +531,29 @@ base::TimeTicks MessageLoop::CalculateDelayedRuntime(int64 delay_ms)
     return delayed_run_time;
 }
 
+// Possibly called on a background thread!
+void MessageLoop::PostTaskHelper(const void* posted_from, Task* task,
+    int64 delay_ms, bool nestable)
+{
+    CHECK(task);
+    PendingTask pending_task(
+        base::Bind(&base::subtle::TaskClosureAdapter::Run,
+            new base::subtle::TaskClosureAdapter(task, &should_leak_tasks_)),
+        CalculateDelayedRuntime(delay_ms), nestable);
+    pending_task.posted_from = posted_from;
+    AddToIncomingQueue(&pending_task);
+}
+
+// Possibly called on a background thread!
+void MessageLoop::PostTaskHelper(const void* posted_from,
+    const base::Closure& task, int64 delay_ms, bool nestable)
+{
+    CHECK(!task.is_null());
+    PendingTask pending_task(task, CalculateDelayedRuntime(delay_ms), nestable);
+    pending_task.posted_from = posted_from;
+    AddToIncomingQueue(&pending_task);
+}
+
 // Possibly called on a background thread!
 void MessageLoop::AddToIncomingQueue(PendingTask* pending_task)
 {
@@ -702,9 +726,16 @@ MessageLoop::PendingTask::PendingTask(const base::Closure& task,
     bool nestable)
     : task(task),
     time_posted(base::TimeTicks::Now()),
+    posted_from(NULL),
     delayed_run_time(delayed_run_time),
     sequence_num(0),
-    nestable(nestable) {}
+    nestable(nestable)
+{
+    if (base::debug::TaskProfiler::IsEnabled())
+    {
+        time_posted_high_res = base::TimeTicks::HighResNow();
+    }
+}
 
 MessageLoop::PendingTask::~PendingTask() {}
 
@@ -13,6 +13,7 @@
 namespace base
 {
     class Histogram;
+    class MessageLoopProxyImpl;
 }
 
 class MessageLoop : public base::MessagePump::Delegate
@@ -213,6 +214,13 @@ protected:
         // Time this PendingTask was posted.
         base::TimeTicks time_posted;
 
+        // High resolution post time, only set while the TaskProfiler is
+        // enabled.  TimeTicks::Now() is too coarse to measure queue delay.
+        base::TimeTicks time_posted_high_res;
+
+        // Return address of the Post*Task call, for the TaskProfiler.
+        const void* posted_from;
+
         // The time when the task should be run.
         base::TimeTicks delayed_run_time;
 
@@ -326,6 +334,16 @@ protected:
     scoped_refptr<base::MessageLoopProxy> message_loop_proxy_;
 
 private:
+    friend class base::MessageLoopProxyImpl;
+
+    // Post*Task() with |posted_from| as the post site the TaskProfiler
+    // records.  The public functions pass their own return address; the
+    // MessageLoopProxy passes the one of its caller.
+    void PostTaskHelper(const void* posted_from, Task* task, int64 delay_ms,
+        bool nestable);
+    void PostTaskHelper(const void* posted_from, const base::Closure& task,
+        int64 delay_ms, bool nestable);
+
     DISALLOW_COPY_AND_ASSIGN(MessageLoop);
 };
 
@@ -0,0 +1,75 @@
+// Timings of posting and running tasks, with the TaskProfiler off and on,
+// to check what recording costs.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/debug/task_profiler.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    const int kTasks = 1000000;
+
+    void Increment(int* count)
+    {
+        ++*count;
+    }
+
+    // Posts |kTasks| tasks to the current loop, directly or through its
+    // proxy, and runs them.  Returns the time taken.
+    double PostAndRun(bool through_proxy)
+    {
+        MessageLoop* loop = MessageLoop::current();
+        scoped_refptr<base::MessageLoopProxy> proxy =
+            base::MessageLoopProxy::current();
+        int count = 0;
+        base::Closure task = base::Bind(&Increment, &count);
+        base::test::Timer timer;
+        for (int i = 0; i < kTasks; ++i)
+        {
+            if (through_proxy)
+            {
+                proxy->PostTask(task);
+            }
+            else
+            {
+                loop->PostTask(task);
+            }
+        }
+        loop->RunAllPending();
+        double ms = timer.ElapsedMs();
+        EXPECT(count == kTasks);
+        return ms;
+    }
+
+    void TimePosting(const char* name, bool through_proxy)
+    {
+        // Once first, so that neither timing pays for growing the queues.
+        base::debug::TaskProfiler::SetEnabled(false);
+        PostAndRun(through_proxy);
+        double off_ms = PostAndRun(through_proxy);
+        base::debug::TaskProfiler::SetEnabled(true);
+        double on_ms = PostAndRun(through_proxy);
+        base::debug::TaskProfiler::SetEnabled(false);
+        base::debug::TaskProfiler::Clear();
+
+        std::string off_name = std::string(name) + ", profiler off";
+        std::string on_name = std::string(name) + ", profiler on";
+        base::test::PrintCost(off_name.c_str(), off_ms, kTasks);
+        base::test::PrintCost(on_name.c_str(), on_ms, kTasks);
+        printf("%-36s %10.1f %%\n", "profiler overhead",
+            off_ms > 0 ? (on_ms - off_ms) / off_ms * 100 : 0.0);
+    }
+
+}
+
+void RunMessageLoopPerfTests()
+{
+    MessageLoop loop;
+    TimePosting("post and run", false);
+    TimePosting("post through proxy and run", true);
+}
@@ -1,7 +1,11 @@
 #include "message_loop_proxy_impl.h"
 
+#include <intrin.h>
+
 #include "threading/thread_restrictions.h"
 
+#pragma intrinsic(_ReturnAddress)
+
 namespace base
 {
 
@@ -10,47 +14,52 @@ namespace base
 
     MessageLoopProxyImpl::~MessageLoopProxyImpl() {}
 
-    bool MessageLoopProxyImpl::PostTask(Task* task)
+    // Not inlined so that _ReturnAddress() is the site that posted.
+    __declspec(noinline) bool MessageLoopProxyImpl::PostTask(Task* task)
     {
-        return PostTaskHelper(task, 0, true);
+        return PostTaskHelper(_ReturnAddress(), task, 0, true);
     }
 
-    bool MessageLoopProxyImpl::PostDelayedTask(Task* task, int64 delay_ms)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostDelayedTask(Task* task,
+        int64 delay_ms)
     {
-        return PostTaskHelper(task, delay_ms, true);
+        return PostTaskHelper(_ReturnAddress(), task, delay_ms, true);
     }
 
-    bool MessageLoopProxyImpl::PostNonNestableTask(Task* task)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostNonNestableTask(
+        Task* task)
     {
-        return PostTaskHelper(task, 0, false);
+        return PostTaskHelper(_ReturnAddress(), task, 0, false);
     }
 
-    bool MessageLoopProxyImpl::PostNonNestableDelayedTask(Task* task,
-        int64 delay_ms)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostNonNestableDelayedTask(
+        Task* task, int64 delay_ms)
     {
-        return PostTaskHelper(task, delay_ms, false);
+        return PostTaskHelper(_ReturnAddress(), task, delay_ms, false);
     }
 
-    bool MessageLoopProxyImpl::PostTask(const base::Closure& task)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostTask(
+        const base::Closure& task)
     {
-        return PostTaskHelper(task, 0, true);
+        return PostTaskHelper(_ReturnAddress(), task, 0, true);
     }
 
-    bool MessageLoopProxyImpl::PostDelayedTask(const base::Closure& task,
-        int64 delay_ms)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostDelayedTask(
+        const base::Closure& task, int64 delay_ms)
     {
-        return PostTaskHelper(task, delay_ms, true);
+        return PostTaskHelper(_ReturnAddress(), task, delay_ms, true);
     }
 
-    bool MessageLoopProxyImpl::PostNonNestableTask(const base::Closure& task)
+    __declspec(noinline) bool MessageLoopProxyImpl::PostNonNestableTask(
+        const base::Closure& task)
     {
-        return PostTaskHelper(task, 0, false);
+        return PostTaskHelper(_ReturnAddress(), task, 0, false);
     }
 
-    bool MessageLoopProxyImpl::PostNonNestableDelayedTask(
+    __declspec(noinline) bool MessageLoopProxyImpl::PostNonNestableDelayedTask(
         const base::Closure& task, int64 delay_ms)
     {
-        return PostTaskHelper(task, delay_ms, false);
+        return PostTaskHelper(_ReturnAddress(), task, delay_ms, false);
     }
 
     bool MessageLoopProxyImpl::BelongsToCurrentThread()
@@ -62,23 +71,16 @@ namespace base
             (MessageLoop::current() == target_message_loop_));
     }
 
-    bool MessageLoopProxyImpl::PostTaskHelper(Task* task, int64 delay_ms,
-        bool nestable)
+    bool MessageLoopProxyImpl::PostTaskHelper(const void* posted_from,
+        Task* task, int64 delay_ms, bool nestable)
     {
         bool ret = false;
         {
             AutoLock lock(message_loop_lock_);
             if (target_message_loop_)
             {
-                if (nestable)
-                {
-                    target_message_loop_->PostDelayedTask(task, delay_ms);
-                }
-                else
-                {
-                    target_message_loop_->PostNonNestableDelayedTask(
-                        task, delay_ms);
-                }
+                target_message_loop_->PostTaskHelper(posted_from, task,
+                    delay_ms, nestable);
                 ret = true;
             }
         }
@@ -89,20 +91,14 @@ namespace base
         return ret;
     }
 
-    bool MessageLoopProxyImpl::PostTaskHelper(const base::Closure& task,
-        int64 delay_ms, bool nestable)
+    bool MessageLoopProxyImpl::PostTaskHelper(const void* posted_from,
+        const base::Closure& task, int64 delay_ms, bool nestable)
     {
         AutoLock lock(message_loop_lock_);
         if (target_message_loop_)
         {
-            if (nestable)
-            {
-                target_message_loop_->PostDelayedTask(task, delay_ms);
-            }
-            else
-            {
-                target_message_loop_->PostNonNestableDelayedTask(task, delay_ms);
-            }
+            target_message_loop_->PostTaskHelper(posted_from, task, delay_ms,
+                nestable);
             return true;
         }
         return false;
@@ -34,9 +34,13 @@ namespace base
         // Called directly by MessageLoop::~MessageLoop.
         virtual void WillDestroyCurrentMessageLoop();
 
+        // |posted_from| is the caller of the public Post*Task(), passed on as
+        // the post site the TaskProfiler records.
         // TODO(ajwong): Remove this after we've fully migrated to base::Closure.
-        bool PostTaskHelper(Task* task, int64 delay_ms, bool nestable);
-        bool PostTaskHelper(const base::Closure& task, int64 delay_ms, bool nestable);
+        bool PostTaskHelper(const void* posted_from, Task* task, int64 delay_ms,
+            bool nestable);
+        bool PostTaskHelper(const void* posted_from, const base::Closure& task,
+            int64 delay_ms, bool nestable);
 
         // Allow the messageLoop to create a MessageLoopProxyImpl.
         friend class MessageLoop;
@@ -229,7 +229,7 @@ namespace base
 
     FieldTrialList::~FieldTrialList()
     {
-        AutoLock auto_lock(lock_);
+        AutoWriteLock auto_lock(lock_);
         while (!registered_.empty())
         {
             RegistrationList::iterator it = registered_.begin();
@@ -248,7 +248,7 @@ namespace base
             used_without_global_ = true;
             return;
         }
-        AutoLock auto_lock(global_->lock_);
+        AutoWriteLock auto_lock(global_->lock_);
         DCHECK(!global_->PreLockedFind(trial->name()));
         trial->AddRef();
         global_->registered_[trial->name()] = trial;
@@ -261,7 +261,7 @@ namespace base
         {
             return NULL;
         }
-        AutoLock auto_lock(global_->lock_);
+        AutoReadLock auto_lock(global_->lock_);
         return global_->PreLockedFind(name);
     }
 
@@ -301,7 +301,7 @@ namespace base
             return;
         }
         DCHECK(output->empty());
-        AutoLock auto_lock(global_->lock_);
+        AutoReadLock auto_lock(global_->lock_);
 
         for (RegistrationList::iterator it = global_->registered_.begin();
             it != global_->registered_.end(); ++it)
@@ -431,7 +431,7 @@ namespace base
         {
             return 0;
         }
-        AutoLock auto_lock(global_->lock_);
+        AutoReadLock auto_lock(global_->lock_);
         return global_->registered_.size();
     }
 
@@ -75,7 +75,7 @@
 
 #include "base/memory/ref_counted.h"
 #include "base/observer_list.h"
-#include "base/synchronization/lock.h"
+#include "base/synchronization/read_write_lock.h"
 #include "base/base_time.h"
 
 namespace base
@@ -355,8 +355,9 @@ namespace base
         // good approximation to the start of the process.
         TimeTicks application_start_time_;
 
-        // Lock for access to registered_.
-        base::Lock lock_;
+        // Lock for access to registered_.  Lookups vastly outnumber
+        // registrations, so readers share it.
+        base::ReadWriteLock lock_;
         RegistrationList registered_;
 
         // An opaque, diverse ID for this client that does not change
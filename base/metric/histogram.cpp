@@ -1,5 +1,6 @@
 #include "histogram.h"
 
+#include <intrin.h>
 #include <math.h>
 
 #include <algorithm>
@@ -7,7 +8,27 @@
 #include "base/logging.h"
 #include "base/pickle.h"
 #include "base/stringprintf.h"
-#include "base/synchronization/lock.h"
+#include "base/synchronization/read_write_lock.h"
+#include "base/threading/platform_thread.h"
+
+#pragma intrinsic(_BitScanReverse)
+
+namespace
+{
+
+    // FNV-1a, used to place histograms in the lock free lookup table.
+    size_t HashHistogramName(const std::string& name)
+    {
+        uint32 hash = 2166136261u;
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            hash ^= static_cast<unsigned char>(name[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+}
 
 namespace base
 {
@@ -65,6 +86,64 @@ namespace base
     // static
     const size_t Histogram::kBucketCount_MAX = 16384u;
 
+    // One slice of the sample data of a histogram.  Threads pick a shard by
+    // thread id, so a shard is normally written by a single thread and its
+    // cache lines stay put; the interlocked updates keep it correct when more
+    // threads than shards record into the same histogram.
+    class Histogram::SampleShard
+    {
+    public:
+        explicit SampleShard(size_t bucket_count)
+            : counts_(new subtle::Atomic32[bucket_count]),
+            sum_(0),
+            redundant_count_(0)
+        {
+            for (size_t i = 0; i < bucket_count; ++i)
+            {
+                counts_[i] = 0;
+            }
+        }
+
+        ~SampleShard()
+        {
+            delete[] counts_;
+        }
+
+        void Accumulate(Sample value, Count count, size_t index)
+        {
+            subtle::NoBarrier_AtomicIncrement(&counts_[index], count);
+            subtle::NoBarrier_AtomicIncrement(&redundant_count_, count);
+            InterlockedExchangeAdd64(&sum_, static_cast<LONGLONG>(count) * value);
+        }
+
+        Count counts(size_t i) const
+        {
+            return subtle::NoBarrier_Load(&counts_[i]);
+        }
+
+        int64 sum() const
+        {
+            // A 64 bit read is not atomic on 32 bit x86.
+            return InterlockedCompareExchange64(
+                const_cast<volatile LONGLONG*>(&sum_), 0, 0);
+        }
+
+        Count redundant_count() const
+        {
+            return subtle::NoBarrier_Load(&redundant_count_);
+        }
+
+    private:
+        volatile subtle::Atomic32* counts_;
+        volatile LONGLONG sum_;
+        volatile subtle::Atomic32 redundant_count_;
+
+        // Keep the next allocation off the line holding the totals.
+        char padding_[64];
+
+        DISALLOW_COPY_AND_ASSIGN(SampleShard);
+    };
+
     Histogram* Histogram::FactoryGet(const std::string& name,
         Sample minimum,
         Sample maximum,
@@ -135,6 +214,7 @@ namespace base
 
     void Histogram::AddSampleSet(const SampleSet& sample)
     {
+        AutoLock locked(sample_lock_);
         sample_.Add(sample);
     }
 
@@ -423,12 +503,31 @@ namespace base
         return bucket_count_;
     }
 
-    // Do a safe atomic snapshot of sample data.
-    // This implementation assumes we are on a safe single thread.
+    // Sum up the merged samples and every shard.  Shards are read bucket by
+    // bucket while other threads may still be adding to them, so the tallies
+    // can be off by the samples that raced with us (see FindCorruption()).
     void Histogram::SnapshotSample(SampleSet* sample) const
     {
-        // Note locking not done in this version!!!
-        *sample = sample_;
+        {
+            AutoLock locked(sample_lock_);
+            *sample = sample_;
+        }
+
+        for (size_t i = 0; i < kShardCount; ++i)
+        {
+            const SampleShard* shard = reinterpret_cast<const SampleShard*>(
+                subtle::Acquire_Load(&shards_[i]));
+            if (!shard)
+            {
+                continue;
+            }
+            for (size_t index = 0; index < bucket_count(); ++index)
+            {
+                sample->counts_[index] += shard->counts(index);
+            }
+            sample->sum_ += shard->sum();
+            sample->redundant_count_ += shard->redundant_count();
+        }
     }
 
     bool Histogram::HasConstructorArguments(Sample minimum,
@@ -490,6 +589,12 @@ namespace base
 
         // Just to make sure most derived class did this properly...
         DCHECK(ValidateBucketRanges());
+
+        for (size_t i = 0; i < kShardCount; ++i)
+        {
+            delete reinterpret_cast<SampleShard*>(
+                subtle::NoBarrier_Load(&shards_[i]));
+        }
     }
 
     // Calculate what range of values are held in each bucket.
@@ -540,12 +645,26 @@ namespace base
 
     size_t Histogram::BucketIndex(Sample value) const
     {
-        // Use simple binary search.  This is very general, but there are better
-        // approaches if we knew that the buckets were linearly distributed.
         DCHECK_LE(ranges(0), value);
         DCHECK_GT(ranges(bucket_count()), value);
-        size_t under = 0;
-        size_t over = bucket_count();
+        if (value <= 0)
+        {
+            return 0;
+        }
+
+        // Go straight to the buckets covering [2^bit, 2^(bit + 1)).  With
+        // exponential buckets that leaves one or two probes, and it is never
+        // worse than a search over all the buckets.
+        unsigned long bit;
+        _BitScanReverse(&bit, static_cast<unsigned long>(value));
+        return FindBucket(value, bucket_index_table_[bit],
+            bucket_index_table_[bit + 1] + 1);
+    }
+
+    size_t Histogram::FindBucket(Sample value, size_t under, size_t over) const
+    {
+        // Use simple binary search.  This is very general, but there are better
+        // approaches if we knew that the buckets were linearly distributed.
         size_t mid;
 
         do
@@ -590,7 +709,9 @@ namespace base
 
     void Histogram::ResetRangeChecksum()
     {
+        // Every layout calls this once its ranges_ are final.
         range_checksum_ = CalculateRangeChecksum();
+        BuildBucketIndexTable();
     }
 
     const std::string Histogram::GetAsciiBucketRange(size_t i) const
@@ -610,8 +731,43 @@ namespace base
     // Update histogram data with new sample.
     void Histogram::Accumulate(Sample value, Count count, size_t index)
     {
-        // Note locking not done in this version!!!
-        sample_.Accumulate(value, count, index);
+        DCHECK(count == 1 || count == -1);
+        GetShard()->Accumulate(value, count, index);
+    }
+
+    Histogram::SampleShard* Histogram::GetShard()
+    {
+        // Windows thread ids are multiples of 4.
+        volatile subtle::AtomicWord* slot =
+            &shards_[(PlatformThread::CurrentId() >> 2) % kShardCount];
+        SampleShard* shard =
+            reinterpret_cast<SampleShard*>(subtle::Acquire_Load(slot));
+        if (shard)
+        {
+            return shard;
+        }
+
+        shard = new SampleShard(bucket_count());
+        subtle::AtomicWord existing = subtle::Release_CompareAndSwap(slot, 0,
+            reinterpret_cast<subtle::AtomicWord>(shard));
+        if (existing)
+        {
+            // Another thread sharing the slot got there first.
+            delete shard;
+            shard = reinterpret_cast<SampleShard*>(existing);
+        }
+        return shard;
+    }
+
+    void Histogram::BuildBucketIndexTable()
+    {
+        const size_t kTableSize = arraysize(bucket_index_table_);
+        for (size_t bit = 0; bit < kTableSize - 1; ++bit)
+        {
+            bucket_index_table_[bit] =
+                FindBucket(static_cast<Sample>(1u << bit), 0, bucket_count());
+        }
+        bucket_index_table_[kTableSize - 1] = bucket_count() - 1;
     }
 
     void Histogram::SetBucketRange(size_t i, Sample value)
@@ -660,6 +816,12 @@ namespace base
         DCHECK_LE(bucket_count_, maximal_bucket_count);
         DCHECK_EQ(0, ranges_[0]);
         ranges_[bucket_count_] = kSampleType_MAX;
+
+        for (size_t i = 0; i < kShardCount; ++i)
+        {
+            shards_[i] = 0;
+        }
+        BuildBucketIndexTable();
     }
 
     // We generate the CRC-32 using the low order bits to select whether to XOR in
@@ -1143,9 +1305,9 @@ namespace base
             // during the termination phase. Since it's a static data member, we will
             // leak one per process, which would be similar to the instance allocated
             // during static initialization and released only on  process termination.
-            lock_ = new Lock;
+            lock_ = new ReadWriteLock;
         }
-        AutoLock auto_lock(*lock_);
+        AutoWriteLock auto_lock(*lock_);
         histograms_ = new HistogramMap;
     }
 
@@ -1162,9 +1324,10 @@ namespace base
         // Clean up.
         HistogramMap* histograms = NULL;
         {
-            AutoLock auto_lock(*lock_);
+            AutoWriteLock auto_lock(*lock_);
             histograms = histograms_;
             histograms_ = NULL;
+            ClearLookupTable();
         }
         delete histograms;
         // We don't delete lock_ on purpose to avoid having to properly protect
@@ -1178,7 +1341,7 @@ namespace base
         {
             return false;
         }
-        AutoLock auto_lock(*lock_);
+        AutoReadLock auto_lock(*lock_);
         return NULL != histograms_;
     }
 
@@ -1189,7 +1352,7 @@ namespace base
         {
             return histogram;
         }
-        AutoLock auto_lock(*lock_);
+        AutoWriteLock auto_lock(*lock_);
         if (!histograms_)
         {
             return histogram;
@@ -1200,6 +1363,7 @@ namespace base
         if (histograms_->end() == it)
         {
             (*histograms_)[name] = histogram;
+            AddToLookupTable(histogram);
         }
         else
         {
@@ -1260,7 +1424,7 @@ namespace base
         {
             return;
         }
-        AutoLock auto_lock(*lock_);
+        AutoReadLock auto_lock(*lock_);
         if (!histograms_)
         {
             return;
@@ -1280,7 +1444,14 @@ namespace base
         {
             return false;
         }
-        AutoLock auto_lock(*lock_);
+        Histogram* found = LookupWithoutLock(name);
+        if (found)
+        {
+            *histogram = found;
+            return true;
+        }
+
+        AutoReadLock auto_lock(*lock_);
         if (!histograms_)
         {
             return false;
@@ -1302,7 +1473,7 @@ namespace base
         {
             return;
         }
-        AutoLock auto_lock(*lock_);
+        AutoReadLock auto_lock(*lock_);
         if (!histograms_)
         {
             return;
@@ -1317,10 +1488,67 @@ namespace base
         }
     }
 
+    // static
+    Histogram* StatisticsRecorder::LookupWithoutLock(const std::string& name)
+    {
+        size_t slot = HashHistogramName(name) % kLookupTableSize;
+        for (size_t probes = 0; probes < kLookupTableSize; ++probes)
+        {
+            Histogram* histogram = reinterpret_cast<Histogram*>(
+                subtle::Acquire_Load(&lookup_table_[slot]));
+            if (!histogram)
+            {
+                return NULL;
+            }
+            if (histogram->histogram_name() == name)
+            {
+                return histogram;
+            }
+            slot = (slot + 1) % kLookupTableSize;
+        }
+        return NULL;
+    }
+
+    // static
+    void StatisticsRecorder::AddToLookupTable(Histogram* histogram)
+    {
+        // Called with the write lock held, so there is a single writer.
+        if (lookup_table_count_ >= kLookupTableSize / 4 * 3)
+        {
+            return;
+        }
+        size_t slot = HashHistogramName(histogram->histogram_name()) %
+            kLookupTableSize;
+        while (subtle::NoBarrier_Load(&lookup_table_[slot]))
+        {
+            slot = (slot + 1) % kLookupTableSize;
+        }
+        subtle::Release_Store(&lookup_table_[slot],
+            reinterpret_cast<subtle::AtomicWord>(histogram));
+        ++lookup_table_count_;
+    }
+
+    // static
+    void StatisticsRecorder::ClearLookupTable()
+    {
+        // Histograms are leaked, so a reader still probing the table only
+        // ever sees live objects.
+        for (size_t i = 0; i < kLookupTableSize; ++i)
+        {
+            subtle::NoBarrier_Store(&lookup_table_[i], 0);
+        }
+        lookup_table_count_ = 0;
+    }
+
     // static
     StatisticsRecorder::HistogramMap* StatisticsRecorder::histograms_ = NULL;
     // static
-    Lock* StatisticsRecorder::lock_ = NULL;
+    volatile subtle::AtomicWord
+        StatisticsRecorder::lookup_table_[kLookupTableSize];
+    // static
+    size_t StatisticsRecorder::lookup_table_count_ = 0;
+    // static
+    ReadWriteLock* StatisticsRecorder::lock_ = NULL;
     // static
     bool StatisticsRecorder::dump_on_exit_ = false;
 
@@ -43,13 +43,14 @@
 #include "base/atomicops.h"
 #include "base/logging.h"
 #include "base/base_time.h"
+#include "base/synchronization/lock.h"
 
 class Pickle;
 
 namespace base
 {
 
-    class Lock;
+    class ReadWriteLock;
     //------------------------------------------------------------------------------
     // Histograms are often put in areas where they are called many many times, and
     // performance is critical.  As a result, they are designed to have a very low
@@ -378,6 +379,8 @@ namespace base
             int64 sum_; // sum of samples.
 
         private:
+            friend class Histogram; // To merge the per-thread shards.
+
             // To help identify memory corruption, we reduntantly save the number of
             // samples we've accumulated into all of our buckets.  We can compare this
             // count to the sum of the counts in all buckets, and detect problems.  Note
@@ -462,8 +465,8 @@ namespace base
         virtual Sample ranges(size_t i) const;
         uint32 range_checksum() const { return range_checksum_; }
         virtual size_t bucket_count() const;
-        // Snapshot the current complete set of sample data.
-        // Override with atomic/locked snapshot if needed.
+        // Snapshot the current complete set of sample data, merging the
+        // per-thread shards.  This is safe to call while other threads record.
         virtual void SnapshotSample(SampleSet* sample) const;
 
         virtual bool HasConstructorArguments(Sample minimum, Sample maximum,
@@ -508,7 +511,8 @@ namespace base
         //----------------------------------------------------------------------------
         // Methods to override to create thread safe histogram.
         //----------------------------------------------------------------------------
-        // Update all our internal data, including histogram
+        // Update all our internal data, including histogram.  The default
+        // implementation is thread safe; it adds into the calling thread's shard.
         virtual void Accumulate(Sample value, Count count, size_t index);
 
         //----------------------------------------------------------------------------
@@ -525,9 +529,23 @@ namespace base
     private:
         friend class StatisticsRecorder; // To allow it to delete duplicates.
 
+        // Samples are recorded into one of kShardCount shards, picked by thread
+        // id, and only summed up when a snapshot is taken.
+        class SampleShard;
+        static const size_t kShardCount = 16;
+
         // Post constructor initialization.
         void Initialize();
 
+        // Binary search for the bucket of |value| among buckets [under, over).
+        size_t FindBucket(Sample value, size_t under, size_t over) const;
+
+        // Fill bucket_index_table_ from the current ranges_.
+        void BuildBucketIndexTable();
+
+        // Return the shard of the calling thread, creating it on first use.
+        SampleShard* GetShard();
+
         // Checksum function for accumulating range values into a checksum.
         static uint32 Crc32(uint32 sum, Sample range);
 
@@ -583,8 +601,17 @@ namespace base
         // have been corrupted.
         uint32 range_checksum_;
 
+        // bucket_index_table_[i] is the bucket holding the value 2^i (the last
+        // entry is the overflow bucket), so a value whose highest set bit is i
+        // lies in [bucket_index_table_[i], bucket_index_table_[i + 1]].  For
+        // exponential buckets that span holds a handful of buckets at most.
+        size_t bucket_index_table_[32];
+
         // Finally, provide the state that changes with the addition of each new
-        // sample.
+        // sample.  Recorded samples live in the shards; sample_ only holds the
+        // sets merged in through AddSampleSet().
+        volatile base::subtle::AtomicWord shards_[kShardCount];
+        mutable base::Lock sample_lock_; // Protects sample_.
         SampleSet sample_;
 
         DISALLOW_COPY_AND_ASSIGN(Histogram);
@@ -732,8 +759,8 @@ namespace base
         static void GetHistograms(Histograms* output);
 
         // Find a histogram by name. It matches the exact name. This method is thread
-        // safe.  If a matching histogram is not found, then the |histogram| is
-        // not changed.
+        // safe, and does not lock once the histogram has been registered.  If a
+        // matching histogram is not found, then the |histogram| is not changed.
         static bool FindHistogram(const std::string& query, Histogram** histogram);
 
         static bool dump_on_exit() { return dump_on_exit_; }
@@ -753,8 +780,21 @@ namespace base
 
         static HistogramMap* histograms_;
 
-        // lock protects access to the above map.
-        static base::Lock* lock_;
+        // Open addressed hash table mirroring histograms_, so that lookups of
+        // registered histograms need no lock.  Slots are only ever filled (under
+        // the write lock) while the recorder is alive; once the table is 3/4
+        // full further histograms are found through histograms_ only.
+        static const size_t kLookupTableSize = 4096;
+        static volatile base::subtle::AtomicWord lookup_table_[kLookupTableSize];
+        static size_t lookup_table_count_;
+
+        static Histogram* LookupWithoutLock(const std::string& name);
+        static void AddToLookupTable(Histogram* histogram);
+        static void ClearLookupTable();
+
+        // lock protects access to the above map.  Lookups far outnumber
+        // registrations, so readers share it.
+        static base::ReadWriteLock* lock_;
 
         // Dump all known histograms to log.
         static bool dump_on_exit_;
@@ -0,0 +1,91 @@
+// Timings of Histogram::Add() with several threads recording into the same
+// histogram at once, and of taking a snapshot across the shards.
+
+#include <stdio.h>
+
+#include "base/metric/histogram.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+
+namespace
+{
+
+    const int kSamplesPerThread = 2000000;
+    const int kMaxThreads = 32;
+    const int kSnapshots = 10000;
+
+    class Recorder : public base::PlatformThread::Delegate
+    {
+    public:
+        explicit Recorder(base::Histogram* histogram) : histogram_(histogram) {}
+
+        virtual void ThreadMain()
+        {
+            for (int i = 0; i < kSamplesPerThread; ++i)
+            {
+                histogram_->Add(i & 0xFFFF);
+            }
+        }
+
+    private:
+        base::Histogram* histogram_;
+    };
+
+    void TimeAdd(int thread_count)
+    {
+        char name[64];
+        _snprintf_s(name, sizeof(name), _TRUNCATE,
+            "HistogramPerfTest.Add%d", thread_count);
+        base::Histogram* histogram = base::Histogram::FactoryGet(name, 1,
+            100000, 50, base::Histogram::kNoFlags);
+
+        Recorder recorder(histogram);
+        base::PlatformThreadHandle handles[kMaxThreads];
+        base::test::Timer timer;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            base::PlatformThread::Create(0, &recorder, &handles[i]);
+        }
+        for (int i = 0; i < thread_count; ++i)
+        {
+            base::PlatformThread::Join(handles[i]);
+        }
+        double ms = timer.ElapsedMs();
+
+        base::Histogram::SampleSet snapshot;
+        histogram->SnapshotSample(&snapshot);
+        EXPECT(snapshot.TotalCount() == thread_count * kSamplesPerThread);
+
+        // Threads run in parallel, so this is wall time per sample; it stays
+        // flat as threads are added as long as the shards do not contend.
+        _snprintf_s(name, sizeof(name), _TRUNCATE, "Add, %d threads",
+            thread_count);
+        base::test::PrintCost(name, ms, kSamplesPerThread);
+    }
+
+    void TimeSnapshot()
+    {
+        base::Histogram* histogram = base::Histogram::FactoryGet(
+            "HistogramPerfTest.Add32", 1, 100000, 50, base::Histogram::kNoFlags);
+        base::Histogram::SampleSet snapshot;
+        base::test::Timer timer;
+        for (int i = 0; i < kSnapshots; ++i)
+        {
+            histogram->SnapshotSample(&snapshot);
+        }
+        base::test::PrintCost("SnapshotSample, 16 shards", timer.ElapsedMs(),
+            kSnapshots);
+    }
+
+}
+
+void RunHistogramPerfTests()
+{
+    base::StatisticsRecorder recorder;
+    TimeAdd(1);
+    TimeAdd(2);
+    TimeAdd(4);
+    TimeAdd(8);
+    TimeAdd(kMaxThreads);
+    TimeSnapshot();
+}
@@ -0,0 +1,184 @@
+// Checks that the per-thread shards of a Histogram add up to exactly what
+// was recorded, with one thread, with more threads than shards, and with
+// sample sets merged in through AddSampleSet().
+
+#include <vector>
+
+#include "base/metric/histogram.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+
+namespace
+{
+
+    const int kMaximum = 100000;
+    const size_t kBuckets = 50;
+
+    // More threads than Histogram has shards, so that some shards are
+    // written by several threads at once.
+    const int kThreads = 32;
+    const int kSamplesPerThread = 20000;
+
+    // The bucket of |value|, found by a linear scan of the ranges.
+    size_t ExpectedBucket(const base::Histogram& histogram, int value)
+    {
+        size_t index = 0;
+        while (index + 1 < histogram.bucket_count() &&
+            histogram.ranges(index + 1) <= value)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+    // The sample recorded as number |i| by thread |thread|.
+    int SampleValue(int thread, int i)
+    {
+        return (i * 7919 + thread * 104729) % (kMaximum + 10);
+    }
+
+    // Checks |histogram| against counts tallied the slow way.
+    void ExpectSnapshotEquals(const base::Histogram& histogram,
+        const std::vector<base::Histogram::Count>& counts, int64 sum)
+    {
+        base::Histogram::SampleSet snapshot;
+        histogram.SnapshotSample(&snapshot);
+
+        int64 total = 0;
+        bool counts_match = true;
+        for (size_t i = 0; i < histogram.bucket_count(); ++i)
+        {
+            counts_match = counts_match && snapshot.counts(i) == counts[i];
+            total += counts[i];
+        }
+        EXPECT(counts_match);
+        EXPECT(snapshot.sum() == sum);
+        EXPECT(snapshot.TotalCount() == total);
+        EXPECT(snapshot.redundant_count() == total);
+        EXPECT(histogram.FindCorruption(snapshot) ==
+            base::Histogram::NO_INCONSISTENCIES);
+    }
+
+    void TestBucketIndex()
+    {
+        base::Histogram* histogram = base::Histogram::FactoryGet(
+            "HistogramTest.BucketIndex", 1, kMaximum, kBuckets,
+            base::Histogram::kNoFlags);
+
+        // Every bucket edge and its neighbours, which is where the octave
+        // table could pick the wrong bucket.
+        std::vector<base::Histogram::Count> counts(histogram->bucket_count(), 0);
+        int64 sum = 0;
+        for (size_t i = 0; i < histogram->bucket_count(); ++i)
+        {
+            int edge = histogram->ranges(i);
+            for (int value = edge - 1; value <= edge + 1; ++value)
+            {
+                if (value < 0 || value >= kMaximum + 10)
+                {
+                    continue;
+                }
+                histogram->Add(value);
+                ++counts[ExpectedBucket(*histogram, value)];
+                sum += value;
+            }
+        }
+        ExpectSnapshotEquals(*histogram, counts, sum);
+    }
+
+    class Recorder : public base::PlatformThread::Delegate
+    {
+    public:
+        Recorder(base::Histogram* histogram, int thread)
+            : histogram_(histogram), thread_(thread) {}
+
+        virtual void ThreadMain()
+        {
+            for (int i = 0; i < kSamplesPerThread; ++i)
+            {
+                histogram_->Add(SampleValue(thread_, i));
+            }
+        }
+
+    private:
+        base::Histogram* histogram_;
+        int thread_;
+    };
+
+    void TestShardMerge()
+    {
+        base::Histogram* histogram = base::Histogram::FactoryGet(
+            "HistogramTest.ShardMerge", 1, kMaximum, kBuckets,
+            base::Histogram::kNoFlags);
+
+        std::vector<Recorder*> recorders;
+        std::vector<base::PlatformThreadHandle> handles(kThreads);
+        for (int thread = 0; thread < kThreads; ++thread)
+        {
+            recorders.push_back(new Recorder(histogram, thread));
+            base::PlatformThread::Create(0, recorders[thread], &handles[thread]);
+        }
+
+        // A snapshot taken while the threads record must stay consistent
+        // apart from the samples that raced with it.
+        base::Histogram::SampleSet racing;
+        histogram->SnapshotSample(&racing);
+        EXPECT(racing.TotalCount() <= kThreads * kSamplesPerThread);
+
+        for (int thread = 0; thread < kThreads; ++thread)
+        {
+            base::PlatformThread::Join(handles[thread]);
+            delete recorders[thread];
+        }
+
+        std::vector<base::Histogram::Count> counts(histogram->bucket_count(), 0);
+        int64 sum = 0;
+        for (int thread = 0; thread < kThreads; ++thread)
+        {
+            for (int i = 0; i < kSamplesPerThread; ++i)
+            {
+                int value = SampleValue(thread, i);
+                ++counts[ExpectedBucket(*histogram, value)];
+                sum += value;
+            }
+        }
+        ExpectSnapshotEquals(*histogram, counts, sum);
+    }
+
+    void TestAddSampleSet()
+    {
+        base::Histogram* histogram = base::Histogram::FactoryGet(
+            "HistogramTest.AddSampleSet", 1, kMaximum, kBuckets,
+            base::Histogram::kNoFlags);
+
+        std::vector<base::Histogram::Count> counts(histogram->bucket_count(), 0);
+        int64 sum = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            int value = SampleValue(0, i);
+            histogram->Add(value);
+            ++counts[ExpectedBucket(*histogram, value)];
+            sum += value;
+        }
+
+        // Merging a snapshot of itself doubles every bucket, the sum and the
+        // redundant count, as the browser does with renderer histograms.
+        base::Histogram::SampleSet snapshot;
+        histogram->SnapshotSample(&snapshot);
+        histogram->AddSampleSet(snapshot);
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            counts[i] *= 2;
+        }
+        ExpectSnapshotEquals(*histogram, counts, sum * 2);
+    }
+
+}
+
+void RunHistogramTests()
+{
+    base::StatisticsRecorder recorder;
+    TestBucketIndex();
+    TestShardMerge();
+    TestAddSampleSet();
+}
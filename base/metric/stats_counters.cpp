@@ -1,5 +1,7 @@
 #include "stats_counters.h"
 
+#include "base/atomicops.h"
+
 namespace base
 {
     StatsCounter::StatsCounter(const std::string& name) : counter_id_(-1)
@@ -21,16 +23,19 @@ namespace base
         int* loc = GetPtr();
         if (loc)
         {
-            *loc = value;
+            subtle::NoBarrier_Store(loc, value);
         }
     }
 
     void StatsCounter::Add(int value)
     {
+        // Only this thread writes to its slot, so the add needs no interlocked
+        // instruction; readers in other threads or processes see either the
+        // old or the new value.
         int* loc = GetPtr();
         if (loc)
         {
-            (*loc) += value;
+            subtle::NoBarrier_Store(loc, subtle::NoBarrier_Load(loc) + value);
         }
     }
 
@@ -0,0 +1,778 @@
+#include "stats_table.h"
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process_util.h"
+#include "base/shared_memory.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/threading/platform_thread.h"
+
+// The StatsTable uses a shared memory segment that is laid out as follows
+//
+// +-------------------------------------------------------+
+// | Version | Size | MaxCounters | MaxThreads | SlotStride |
+// +-------------------------------------------------------+
+// | Thread names table                                    |
+// +-------------------------------------------------------+
+// | Thread TID table                                      |
+// +-------------------------------------------------------+
+// | Thread PID table                                      |
+// +-------------------------------------------------------+
+// | Counter names table                                   |
+// +-------------------------------------------------------+
+// | Data for slot 1: one int per counter, padded          |
+// +-------------------------------------------------------+
+// | Data for slot 2 ...                                   |
+// +-------------------------------------------------------+
+//
+// The data is stored column-major: all the counters of one thread slot are
+// contiguous and each slot starts on its own cache line, so threads that bump
+// the same counter never write to the same line.  A slot is only ever written
+// by the thread that owns it, which lets an increment be a plain load and store
+// with no interlocked instruction, and lets any process that maps the segment
+// read the values while they are being updated.
+//
+// The section headers are all aligned to kTableAlignment bytes, and the
+// layout only depends on the header, so a reader that knows nothing but the
+// table name can map it and find every row.
+
+namespace
+{
+    // The version number stored in the shared memory.  When the version or
+    // layout changes, bump this so that stale tables are reinitialized.
+    const int kTableVersion = 0x13131314;
+
+    // The name for un-named counters and threads in the table.
+    const char kUnknownName[] = "<unknown>";
+
+    // Every section, and every slot's data, starts on its own cache line.
+    const int kTableAlignment = 64;
+
+    // Calculates the size of a section including the alignment padding.
+    inline int AlignedSize(int size)
+    {
+        return (size + kTableAlignment - 1) & ~(kTableAlignment - 1);
+    }
+
+    // Number of ints reserved for one slot's counters.
+    inline int SlotStride(int max_counters)
+    {
+        return AlignedSize(max_counters * sizeof(int)) / sizeof(int);
+    }
+
+}
+
+namespace base
+{
+    // The StatsTable::Private maintains convenience pointers into the shared
+    // memory segment.  Use this class to keep the data structure clean and
+    // accessible.
+    class StatsTable::Private
+    {
+    public:
+        // Various header information contained in the memory mapped segment.
+        struct TableHeader
+        {
+            int version;
+            int size;
+            int max_counters;
+            int max_threads;
+            int slot_stride;
+        };
+
+        // Construct a new Private based on expected size parameters, or
+        // return NULL on failure.
+        static Private* New(const std::string& name, int size,
+            int max_threads, int max_counters);
+
+        // Size of the segment for a table of the given dimensions.
+        static int ComputeSize(int max_threads, int max_counters)
+        {
+            return AlignedSize(sizeof(TableHeader)) +
+                AlignedSize(max_threads * StatsTable::kMaxThreadNameLength) +
+                AlignedSize(max_threads * sizeof(PlatformThreadId)) +
+                AlignedSize(max_threads * sizeof(int)) +
+                AlignedSize(max_counters * StatsTable::kMaxCounterNameLength) +
+                max_threads * SlotStride(max_counters) * sizeof(int);
+        }
+
+        // Maps an existing table read-only, or returns NULL if there is no
+        // valid table by that name.
+        static Private* OpenReadOnly(const std::string& name);
+
+        SharedMemory* shared_memory() { return &shared_memory_; }
+
+        // Accessors for our header pointers
+        TableHeader* table_header() const { return table_header_; }
+        int version() const { return table_header_->version; }
+        int size() const { return table_header_->size; }
+        int max_counters() const { return table_header_->max_counters; }
+        int max_threads() const { return table_header_->max_threads; }
+
+        // Accessors for our tables
+        char* thread_name(int slot_id) const
+        {
+            return &thread_names_table_[
+                (slot_id - 1) * (StatsTable::kMaxThreadNameLength)];
+        }
+        PlatformThreadId* thread_tid(int slot_id) const
+        {
+            return &(thread_tid_table_[slot_id - 1]);
+        }
+        int* thread_pid(int slot_id) const
+        {
+            return &(thread_pid_table_[slot_id - 1]);
+        }
+        char* counter_name(int counter_id) const
+        {
+            return &counter_names_table_[
+                (counter_id - 1) * (StatsTable::kMaxCounterNameLength)];
+        }
+        int* slot_data(int slot_id) const
+        {
+            return &data_table_[(slot_id - 1) * table_header_->slot_stride];
+        }
+        int* location(int counter_id, int slot_id) const
+        {
+            return &slot_data(slot_id)[counter_id - 1];
+        }
+
+    private:
+        // Constructor is private because you should use New() instead.
+        Private()
+            : table_header_(NULL),
+            thread_names_table_(NULL),
+            thread_tid_table_(NULL),
+            thread_pid_table_(NULL),
+            counter_names_table_(NULL),
+            data_table_(NULL) {}
+
+        // Initializes the table on first access.  Sets header values
+        // appropriately and zeroes all counters.
+        void InitializeTable(void* memory, int size, int max_counters,
+            int max_threads);
+
+        // Initializes our in-memory pointers into a pre-created StatsTable.
+        void ComputeMappedPointers(void* memory);
+
+        SharedMemory shared_memory_;
+        TableHeader* table_header_;
+        char* thread_names_table_;
+        PlatformThreadId* thread_tid_table_;
+        int* thread_pid_table_;
+        char* counter_names_table_;
+        int* data_table_;
+    };
+
+    // static
+    StatsTable::Private* StatsTable::Private::New(const std::string& name,
+        int size, int max_threads, int max_counters)
+    {
+        scoped_ptr<Private> priv(new Private());
+        if (!priv->shared_memory_.CreateNamed(name, true, size))
+        {
+            return NULL;
+        }
+        if (!priv->shared_memory_.Map(size))
+        {
+            return NULL;
+        }
+        void* memory = priv->shared_memory_.memory();
+
+        // If the version does not match, then assume the table needs to be
+        // initialized.  Hold the segment lock so that two processes starting
+        // together do not both zero it.
+        {
+            SharedMemoryAutoLock lock(&priv->shared_memory_);
+            TableHeader* header = static_cast<TableHeader*>(memory);
+            if (header->version != kTableVersion)
+            {
+                priv->InitializeTable(memory, size, max_counters, max_threads);
+            }
+        }
+
+        // We have a valid table, so compute our pointers.
+        priv->ComputeMappedPointers(memory);
+
+        return priv.release();
+    }
+
+    // static
+    StatsTable::Private* StatsTable::Private::OpenReadOnly(
+        const std::string& name)
+    {
+        scoped_ptr<Private> priv(new Private());
+        if (!priv->shared_memory_.Open(name, true))
+        {
+            return NULL;
+        }
+        // Map the whole section; its size is recorded in the header.
+        if (!priv->shared_memory_.Map(0))
+        {
+            return NULL;
+        }
+        void* memory = priv->shared_memory_.memory();
+        const TableHeader* header = static_cast<const TableHeader*>(memory);
+        if (header->version != kTableVersion ||
+            header->slot_stride != SlotStride(header->max_counters) ||
+            header->size != ComputeSize(header->max_threads,
+                header->max_counters))
+        {
+            return NULL;
+        }
+
+        priv->ComputeMappedPointers(memory);
+        return priv.release();
+    }
+
+    void StatsTable::Private::InitializeTable(void* memory, int size,
+        int max_counters, int max_threads)
+    {
+        // Zero everything.
+        memset(memory, 0, size);
+
+        // Initialize the header.
+        TableHeader* header = static_cast<TableHeader*>(memory);
+        header->size = size;
+        header->max_counters = max_counters;
+        header->max_threads = max_threads;
+        header->slot_stride = SlotStride(max_counters);
+
+        // Publish the version last so that a concurrent reader never sees a
+        // valid version with an incomplete header.
+        subtle::Release_Store(
+            reinterpret_cast<volatile subtle::Atomic32*>(&header->version),
+            kTableVersion);
+    }
+
+    void StatsTable::Private::ComputeMappedPointers(void* memory)
+    {
+        char* data = static_cast<char*>(memory);
+        int offset = 0;
+
+        table_header_ = reinterpret_cast<TableHeader*>(data);
+        offset += AlignedSize(sizeof(TableHeader));
+        thread_names_table_ = reinterpret_cast<char*>(data + offset);
+        offset += AlignedSize(max_threads() *
+            StatsTable::kMaxThreadNameLength);
+        thread_tid_table_ = reinterpret_cast<PlatformThreadId*>(data + offset);
+        offset += AlignedSize(max_threads() * sizeof(PlatformThreadId));
+        thread_pid_table_ = reinterpret_cast<int*>(data + offset);
+        offset += AlignedSize(max_threads() * sizeof(int));
+        counter_names_table_ = reinterpret_cast<char*>(data + offset);
+        offset += AlignedSize(max_counters() *
+            StatsTable::kMaxCounterNameLength);
+        data_table_ = reinterpret_cast<int*>(data + offset);
+        offset += max_threads() * table_header_->slot_stride * sizeof(int);
+
+        DCHECK_EQ(offset, size());
+    }
+
+    // TLSData carries the data stored in the TLS slots for the
+    // StatsTable.  This is used so that we can properly cleanup when the
+    // thread exits and return the table slot.
+    //
+    // Each thread that calls RegisterThread in the StatsTable will have
+    // a TLSData stored in its TLS.
+    struct StatsTable::TLSData
+    {
+        StatsTable* table;
+        int slot;
+    };
+
+    // We keep a singleton table which can be easily accessed.
+    StatsTable* StatsTable::global_table_ = NULL;
+
+    StatsTable::StatsTable(const std::string& name, int max_threads,
+        int max_counters)
+        : impl_(NULL),
+        tls_index_(SlotReturnFunction)
+    {
+        int table_size = Private::ComputeSize(max_threads, max_counters);
+
+        impl_ = Private::New(name, table_size, max_threads, max_counters);
+
+        if (!impl_)
+        {
+            LOG(ERROR) << "StatsTable did not initialize:" << GetLastError();
+        }
+    }
+
+    StatsTable::~StatsTable()
+    {
+        // Before we tear down our copy of the table, be sure to
+        // unregister our thread.
+        UnregisterThread();
+
+        // Return ThreadLocalStorage.  At this point, if any registered threads
+        // still exist, they cannot Unregister.
+        tls_index_.Free();
+
+        // Cleanup our shared memory.
+        delete impl_;
+
+        // If we are the global table, unregister ourselves.
+        if (global_table_ == this)
+        {
+            global_table_ = NULL;
+        }
+    }
+
+    int StatsTable::GetSlot() const
+    {
+        TLSData* data = GetTLSData();
+        if (!data)
+        {
+            return 0;
+        }
+        return data->slot;
+    }
+
+    int StatsTable::RegisterThread(const std::string& name)
+    {
+        int slot = 0;
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        // Registering a thread requires that we lock the shared memory
+        // so that two threads don't grab the same slot.  Fortunately,
+        // thread creation shouldn't happen in inner loops.
+        {
+            SharedMemoryAutoLock lock(impl_->shared_memory());
+            slot = FindEmptyThread();
+            if (!slot)
+            {
+                return 0;
+            }
+
+            // We have space, so consume a column in the table.
+            std::string thread_name = name;
+            if (name.empty())
+            {
+                thread_name = kUnknownName;
+            }
+            strlcpy(impl_->thread_name(slot), thread_name.c_str(),
+                kMaxThreadNameLength);
+            *(impl_->thread_tid(slot)) = PlatformThread::CurrentId();
+            *(impl_->thread_pid(slot)) = GetCurrentProcId();
+        }
+
+        // Set our thread local storage.
+        TLSData* data = new TLSData;
+        data->table = this;
+        data->slot = slot;
+        tls_index_.Set(data);
+        return slot;
+    }
+
+    int StatsTable::CountThreadsRegistered() const
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        // Loop through the shared memory and count the threads that are active.
+        // We intentionally do not lock the table during the operation.
+        int count = 0;
+        for (int index = 1; index <= impl_->max_threads(); index++)
+        {
+            char* name = impl_->thread_name(index);
+            if (*name != '\0')
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    int StatsTable::FindCounter(const std::string& name)
+    {
+        // Note: the API returns counters numbered from 1..N, although
+        // internally, the array is 0..N-1.  This is so that we can return
+        // zero as "not found".
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        // Create a scope for our auto-lock.
+        {
+            AutoLock scoped_lock(counters_lock_);
+
+            // Attempt to find the counter.
+            CountersMap::const_iterator iter;
+            iter = counters_.find(name);
+            if (iter != counters_.end())
+            {
+                return iter->second;
+            }
+        }
+
+        // Counter does not exist, so add it.
+        return AddCounter(name);
+    }
+
+    int* StatsTable::GetLocation(int counter_id, int slot_id) const
+    {
+        if (!impl_)
+        {
+            return NULL;
+        }
+        if (slot_id < 1 || slot_id > impl_->max_threads())
+        {
+            return NULL;
+        }
+        if (counter_id < 1 || counter_id > impl_->max_counters())
+        {
+            return NULL;
+        }
+
+        return impl_->location(counter_id, slot_id);
+    }
+
+    const char* StatsTable::GetRowName(int index) const
+    {
+        if (!impl_)
+        {
+            return NULL;
+        }
+
+        return impl_->counter_name(index);
+    }
+
+    int StatsTable::GetRowValue(int index) const
+    {
+        return GetRowValue(index, 0);
+    }
+
+    int StatsTable::GetRowValue(int index, int pid) const
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        int rv = 0;
+        for (int slot_id = 1; slot_id <= impl_->max_threads(); slot_id++)
+        {
+            if (pid == 0 || *impl_->thread_pid(slot_id) == pid)
+            {
+                rv += subtle::NoBarrier_Load(impl_->location(index, slot_id));
+            }
+        }
+        return rv;
+    }
+
+    int StatsTable::GetCounterValue(const std::string& name)
+    {
+        return GetCounterValue(name, 0);
+    }
+
+    int StatsTable::GetCounterValue(const std::string& name, int pid)
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        int row = FindCounter(name);
+        if (!row)
+        {
+            return 0;
+        }
+        return GetRowValue(row, pid);
+    }
+
+    int StatsTable::GetMaxCounters() const
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+        return impl_->max_counters();
+    }
+
+    int StatsTable::GetMaxThreads() const
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+        return impl_->max_threads();
+    }
+
+    // static
+    int* StatsTable::FindLocation(const char* name)
+    {
+        // Get the static StatsTable
+        StatsTable* table = StatsTable::current();
+        if (!table)
+        {
+            return NULL;
+        }
+
+        // Get the slot for this thread.  Try to register
+        // it if none exists.
+        int slot = table->GetSlot();
+        if (!slot && !(slot = table->RegisterThread("")))
+        {
+            return NULL;
+        }
+
+        // Find the counter id for the counter.
+        std::string str_name(name);
+        int counter = table->FindCounter(str_name);
+
+        // Now we can find the location in the table.
+        return table->GetLocation(counter, slot);
+    }
+
+    void StatsTable::UnregisterThread()
+    {
+        UnregisterThread(GetTLSData());
+    }
+
+    void StatsTable::UnregisterThread(TLSData* data)
+    {
+        if (!data)
+        {
+            return;
+        }
+        DCHECK(impl_);
+
+        // Zero the slot so that its next owner starts from clean counters, and
+        // free it last by clearing the thread name.  A reader summing a row
+        // meanwhile sees each value either before or after it was cleared.
+        {
+            SharedMemoryAutoLock lock(impl_->shared_memory());
+            int* slot_data = impl_->slot_data(data->slot);
+            for (int i = 0; i < impl_->max_counters(); ++i)
+            {
+                subtle::NoBarrier_Store(&slot_data[i], 0);
+            }
+            *impl_->thread_tid(data->slot) = 0;
+            *impl_->thread_pid(data->slot) = 0;
+            subtle::MemoryBarrier();
+            *impl_->thread_name(data->slot) = '\0';
+        }
+
+        // Remove the calling thread's TLS so that it cannot use the slot.
+        tls_index_.Set(NULL);
+        delete data;
+    }
+
+    // static
+    void StatsTable::SlotReturnFunction(void* data)
+    {
+        // This is called by the TLS destructor, which on some platforms has
+        // already cleared the TLS info, so use the tls_data argument
+        // rather than trying to fetch it ourselves.
+        TLSData* tls_data = static_cast<TLSData*>(data);
+        if (tls_data)
+        {
+            DCHECK(tls_data->table);
+            tls_data->table->UnregisterThread(tls_data);
+        }
+    }
+
+    int StatsTable::FindEmptyThread() const
+    {
+        // Note: the API returns slots numbered from 1..N, although
+        // internally, the array is 0..N-1.  This is so that we can return
+        // zero as "not found".
+        //
+        // The reason for doing this is because the thread 'slot' is stored
+        // in TLS, which is always initialized to zero, not -1.  If 0 were
+        // returned as a valid slot number, it would be confused with the
+        // uninitialized state.
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        int index = 1;
+        for (; index <= impl_->max_threads(); index++)
+        {
+            char* name = impl_->thread_name(index);
+            if (!*name)
+            {
+                break;
+            }
+        }
+        if (index > impl_->max_threads())
+        {
+            return 0; // The table is full.
+        }
+        return index;
+    }
+
+    int StatsTable::FindCounterOrEmptyRow(const std::string& name) const
+    {
+        // Note: the API returns slots numbered from 1..N, although
+        // internally, the array is 0..N-1.  This is so that we can return
+        // zero as "not found".
+        //
+        // There isn't much reason for this other than to be consistent
+        // with the way we track columns for thread slots.  (See comments
+        // in FindEmptyThread for why it is done this way).
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        int free_slot = 0;
+        for (int index = 1; index <= impl_->max_counters(); index++)
+        {
+            char* row_name = impl_->counter_name(index);
+            if (!*row_name && !free_slot)
+            {
+                free_slot = index; // save that we found a free slot
+            }
+            else if (!strncmp(row_name, name.c_str(), kMaxCounterNameLength))
+            {
+                return index;
+            }
+        }
+        return free_slot;
+    }
+
+    int StatsTable::AddCounter(const std::string& name)
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+
+        int counter_id = 0;
+        {
+            // To add a counter to the shared memory, we need the
+            // shared memory lock.
+            SharedMemoryAutoLock lock(impl_->shared_memory());
+
+            // We have space, so create a new counter.
+            counter_id = FindCounterOrEmptyRow(name);
+            if (!counter_id)
+            {
+                return 0;
+            }
+
+            std::string counter_name = name;
+            if (name.empty())
+            {
+                counter_name = kUnknownName;
+            }
+            strlcpy(impl_->counter_name(counter_id), counter_name.c_str(),
+                kMaxCounterNameLength);
+        }
+
+        // now add to our in-memory cache
+        {
+            AutoLock lock(counters_lock_);
+            counters_[name] = counter_id;
+        }
+        return counter_id;
+    }
+
+    StatsTable::TLSData* StatsTable::GetTLSData() const
+    {
+        TLSData* data =
+            static_cast<TLSData*>(tls_index_.Get());
+        if (!data)
+        {
+            return NULL;
+        }
+
+        DCHECK(data->slot);
+        DCHECK_EQ(data->table, this);
+        return data;
+    }
+
+    //------------------------------------------------------------------------------
+    // StatsTableReader
+
+    StatsTableReader::StatsTableReader() : impl_(NULL) {}
+
+    StatsTableReader::~StatsTableReader()
+    {
+        delete impl_;
+    }
+
+    bool StatsTableReader::Open(const std::string& name)
+    {
+        DCHECK(!impl_);
+        impl_ = StatsTable::Private::OpenReadOnly(name);
+        return impl_ != NULL;
+    }
+
+    int StatsTableReader::GetMaxCounters() const
+    {
+        return impl_ ? impl_->max_counters() : 0;
+    }
+
+    int StatsTableReader::GetMaxThreads() const
+    {
+        return impl_ ? impl_->max_threads() : 0;
+    }
+
+    const char* StatsTableReader::GetRowName(int index) const
+    {
+        if (!impl_ || index < 1 || index > impl_->max_counters())
+        {
+            return NULL;
+        }
+        return impl_->counter_name(index);
+    }
+
+    int StatsTableReader::GetRowValue(int index, int pid) const
+    {
+        if (!impl_ || index < 1 || index > impl_->max_counters())
+        {
+            return 0;
+        }
+
+        int rv = 0;
+        for (int slot_id = 1; slot_id <= impl_->max_threads(); slot_id++)
+        {
+            if (pid == 0 || *impl_->thread_pid(slot_id) == pid)
+            {
+                rv += subtle::NoBarrier_Load(impl_->location(index, slot_id));
+            }
+        }
+        return rv;
+    }
+
+    void StatsTableReader::WriteSnapshot(std::string* output) const
+    {
+        if (!impl_)
+        {
+            return;
+        }
+
+        output->append("Threads:\n");
+        for (int slot_id = 1; slot_id <= impl_->max_threads(); slot_id++)
+        {
+            const char* name = impl_->thread_name(slot_id);
+            if (*name)
+            {
+                StringAppendF(output, "  %-32.31s pid %-6d tid %u\n", name,
+                    *impl_->thread_pid(slot_id), *impl_->thread_tid(slot_id));
+            }
+        }
+
+        output->append("Counters:\n");
+        for (int index = 1; index <= impl_->max_counters(); index++)
+        {
+            const char* name = impl_->counter_name(index);
+            if (*name)
+            {
+                StringAppendF(output, "  %-64.63s %d\n", name,
+                    GetRowValue(index, 0));
+            }
+        }
+    }
+
+} //namespace base
@@ -11,6 +11,11 @@
 // the data for the counters.  Upon creation, it has a specific size
 // which governs the maximum number of counters and concurrent
 // threads/processes which can use it.
+//
+// Each thread writes only to its own cache-line aligned column of the table,
+// so updating a counter is a plain add with no interlocked instruction.  Other
+// processes can map the same segment read-only with a StatsTableReader and
+// watch the values live without stopping the writers.
 
 #ifndef __base_stats_table_h__
 #define __base_stats_table_h__
@@ -124,13 +129,15 @@ namespace base
         static int* FindLocation(const char* name);
 
     private:
+        friend class StatsTableReader;
+
         class Private;
         struct TLSData;
         typedef stdext::hash_map<std::string, int> CountersMap;
 
         // Returns the space occupied by a thread in the table.  Generally used
-        // if a thread terminates but the process continues.  This function
-        // does not zero out the thread's counters.
+        // if a thread terminates but the process continues.  The thread's
+        // counters are zeroed, so they drop out of the row totals.
         // Cannot be used inside a posix tls destructor.
         void UnregisterThread();
 
@@ -184,6 +191,42 @@ namespace base
         DISALLOW_COPY_AND_ASSIGN(StatsTable);
     };
 
+    // StatsTableReader maps an existing StatsTable read-only, typically from
+    // another process such as the stats_dump tool (base/tools/stats_dump.cpp).  It never registers a thread
+    // or a counter and never takes the table lock, so reading does not slow
+    // down the process that writes the counters.  Values read while a writer is
+    // updating them are each consistent, but the set of values is not a
+    // snapshot.
+    class StatsTableReader
+    {
+    public:
+        StatsTableReader();
+        ~StatsTableReader();
+
+        // Maps the table named |name|.  Returns false if there is no table by
+        // that name or its layout is not one this build understands.
+        bool Open(const std::string& name);
+
+        int GetMaxCounters() const;
+        int GetMaxThreads() const;
+
+        // Gets the counter name at a particular row (1-based).  If the row is
+        // empty, returns an empty string; if it is out of range, NULL.
+        const char* GetRowName(int index) const;
+
+        // Gets the sum of the values for a row, over all threads of process
+        // |pid|, or over all threads if |pid| is 0.
+        int GetRowValue(int index, int pid) const;
+
+        // Appends a text dump of the registered threads and non-empty counters.
+        void WriteSnapshot(std::string* output) const;
+
+    private:
+        StatsTable::Private* impl_;
+
+        DISALLOW_COPY_AND_ASSIGN(StatsTableReader);
+    };
+
 } //namespace base
 
 #endif //__base_stats_table_h__
\ No newline at end of file
@@ -0,0 +1,114 @@
+// Timings of StatsTable counters: a cached StatsCounter, the STATS_COUNTER
+// macro that looks the counter up every time, several threads bumping the
+// same counter in their own slots, and summing a row as a reader does.
+
+#include <stdio.h>
+
+#include "base/metric/stats_counters.h"
+#include "base/metric/stats_table.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+
+namespace
+{
+
+    const char kTableName[] = "stats_table_perftest";
+    const int kMaxThreads = 16;
+    const int kMaxCounters = 64;
+    const int kIncrements = 10000000;
+    const int kLookups = 1000000;
+    const int kRowSums = 1000000;
+    const int kThreads = 4;
+
+    void TimeCachedCounter()
+    {
+        base::StatsCounter counter("perftest.cached");
+        base::test::Timer timer;
+        for (int i = 0; i < kIncrements; ++i)
+        {
+            counter.Increment();
+        }
+        base::test::PrintCost("StatsCounter::Increment", timer.ElapsedMs(),
+            kIncrements);
+        EXPECT(counter.value() == kIncrements);
+    }
+
+    void TimeMacro()
+    {
+        base::test::Timer timer;
+        for (int i = 0; i < kLookups; ++i)
+        {
+            SIMPLE_STATS_COUNTER("perftest.macro");
+        }
+        base::test::PrintCost("SIMPLE_STATS_COUNTER", timer.ElapsedMs(),
+            kLookups);
+        EXPECT(base::StatsTable::current()->GetCounterValue("c:perftest.macro") ==
+            kLookups);
+    }
+
+    // Bumps the shared counter from its own slot, then checks that nobody
+    // else wrote there.
+    class Incrementer : public base::PlatformThread::Delegate
+    {
+    public:
+        virtual void ThreadMain()
+        {
+            base::StatsCounter counter("perftest.shared");
+            for (int i = 0; i < kIncrements; ++i)
+            {
+                counter.Increment();
+            }
+            EXPECT(counter.value() == kIncrements);
+        }
+    };
+
+    void TimeThreads()
+    {
+        Incrementer incrementer;
+        base::PlatformThreadHandle handles[kThreads];
+        base::test::Timer timer;
+        for (int i = 0; i < kThreads; ++i)
+        {
+            base::PlatformThread::Create(0, &incrementer, &handles[i]);
+        }
+        for (int i = 0; i < kThreads; ++i)
+        {
+            base::PlatformThread::Join(handles[i]);
+        }
+        base::test::PrintCost("Increment, 4 threads", timer.ElapsedMs(),
+            kThreads * kIncrements);
+
+        // The threads have exited and given back their slots.
+        EXPECT(base::StatsTable::current()->GetCounterValue("c:perftest.shared") ==
+            0);
+    }
+
+    void TimeRowSum()
+    {
+        base::StatsTable* table = base::StatsTable::current();
+        int row = table->FindCounter("c:perftest.cached");
+        int sum = 0;
+        base::test::Timer timer;
+        for (int i = 0; i < kRowSums; ++i)
+        {
+            sum += table->GetRowValue(row) != 0;
+        }
+        base::test::PrintCost("GetRowValue, 16 slots", timer.ElapsedMs(),
+            kRowSums);
+        EXPECT(sum == kRowSums);
+    }
+
+}
+
+void RunStatsTablePerfTests()
+{
+    base::StatsTable table(kTableName, kMaxThreads, kMaxCounters);
+    base::StatsTable::set_current(&table);
+
+    TimeCachedCounter();
+    TimeMacro();
+    TimeThreads();
+    TimeRowSum();
+
+    base::StatsTable::set_current(NULL);
+}
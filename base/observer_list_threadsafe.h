@@ -2,14 +2,41 @@
 #define __base_observer_list_threadsafe_h__
 
 #include <algorithm>
-#include <map>
+#include <vector>
 
+#include "atomicops.h"
 #include "callback_old.h"
+#include "memory/ref_counted.h"
 #include "message_loop.h"
 #include "message_loop_proxy.h"
 #include "observer_list.h"
 #include "task.h"
+#include "threading/platform_thread.h"
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// OVERVIEW:
+//
+//   A thread-safe container for a list of observers.
+//   This is similar to the observer_list (see observer_list.h), but it
+//   is more robust for multi-threaded situations.
+//
+//   Each MessageLoop that has registered observers owns an
+//   ObserverListContext holding a plain ObserverList, which is only ever
+//   touched on that loop.  The set of contexts is published as an immutable
+//   snapshot: AddObserver/RemoveObserver copy it and swap in a new one when a
+//   loop gains its first or loses its last observer, while Notify() only
+//   reads the current snapshot and never takes |list_lock_|.  Readers count
+//   themselves in one of two slots chosen by an epoch; a writer flips the
+//   epoch and waits for the old slot to drain before freeing the snapshot it
+//   replaced, so at most one snapshot is ever retired.
+//
+//   Notifications for a loop are pushed onto a lock-free list on its context
+//   and drained by a single task, so a burst of broadcasts costs one posted
+//   task per target loop rather than one per broadcast.  Observers added or removed while a
+//   notification is being delivered behave as with ObserverList.
+//
+///////////////////////////////////////////////////////////////////////////////
 
 template<class ObserverType>
 class ObserverListThreadSafe;
@@ -34,58 +61,71 @@ public:
         NotificationType;
 
     ObserverListThreadSafe()
-        : type_(ObserverListBase<ObserverType>::NOTIFY_ALL) {}
-    explicit ObserverListThreadSafe(NotificationType type) : type_(type) {}
+        : type_(ObserverListBase<ObserverType>::NOTIFY_ALL),
+        snapshot_(reinterpret_cast<base::subtle::AtomicWord>(
+            new ContextSnapshot)),
+        epoch_(0)
+    {
+        readers_[0] = readers_[1] = 0;
+    }
+    explicit ObserverListThreadSafe(NotificationType type)
+        : type_(type),
+        snapshot_(reinterpret_cast<base::subtle::AtomicWord>(
+            new ContextSnapshot)),
+        epoch_(0)
+    {
+        readers_[0] = readers_[1] = 0;
+    }
 
     void AddObserver(ObserverType* obs)
     {
-        ObserverList<ObserverType>* list = NULL;
         MessageLoop* loop = MessageLoop::current();
+        scoped_refptr<ObserverListContext> context;
+        {
+            SnapshotReader reader(this);
+            context = reader.snapshot()->Find(loop);
+        }
+        if (!context)
         {
             base::AutoLock lock(list_lock_);
-            if (observer_lists_.find(loop) == observer_lists_.end())
-            {
-                observer_lists_[loop] = new ObserverListContext(type_);
-            }
-            list = &(observer_lists_[loop]->list);
+            // Only this thread adds contexts for |loop|, so the current
+            // snapshot cannot have gained one since the lookup above.
+            context = new ObserverListContext(loop, type_);
+            ContextSnapshot* snapshot = new ContextSnapshot(*CurrentSnapshot());
+            snapshot->contexts.push_back(context);
+            PublishSnapshot(snapshot);
         }
-        list->AddObserver(obs);
+        context->list.AddObserver(obs);
     }
 
     void RemoveObserver(ObserverType* obs)
     {
-        ObserverListContext* context = NULL;
-        ObserverList<ObserverType>* list = NULL;
         MessageLoop* loop = MessageLoop::current();
         if (!loop)
         {
-            return; 
+            return;
         }
 
+        scoped_refptr<ObserverListContext> context;
         {
-            base::AutoLock lock(list_lock_);
-            typename ObserversListMap::iterator it = observer_lists_.find(loop);
-            if (it == observer_lists_.end())
-            {
-                // This will happen if we try to remove an observer on a thread
-                // we never added an observer for.
-                return;
-            }
-            context = it->second;
-            list = &context->list;
-
-            // If we're about to remove the last observer from the list,
-            // then we can remove this observer_list entirely.
-            if (list->HasObserver(obs) && list->size() == 1)
-            {
-                observer_lists_.erase(it);
-            }
+            SnapshotReader reader(this);
+            context = reader.snapshot()->Find(loop);
+        }
+        if (!context)
+        {
+            // This will happen if we try to remove an observer on a thread
+            // we never added an observer for.
+            return;
         }
-        list->RemoveObserver(obs);
 
-        if (list->size() == 0)
+        context->list.RemoveObserver(obs);
+
+        // If we removed the last observer, drop this loop from the snapshot
+        // right away.  A drain task already posted finds the context detached
+        // and delivers nothing more.
+        if (context->list.size() == 0)
         {
-            delete context;
+            DetachContext(context);
         }
     }
 
@@ -106,89 +146,286 @@ public:
 private:
     friend struct ObserverListThreadSafeTraits<ObserverType>;
 
+    // One broadcast, shared by all the contexts it is queued on.
+    class Notification : public base::RefCountedThreadSafe<Notification>
+    {
+    public:
+        virtual void Run(ObserverType* obs) const = 0;
+
+    protected:
+        friend class base::RefCountedThreadSafe<Notification>;
+        virtual ~Notification() {}
+    };
+
+    template<class Method, class Params>
+    class NotificationImpl : public Notification
+    {
+    public:
+        explicit NotificationImpl(
+            const UnboundMethod<ObserverType, Method, Params>& method)
+            : method_(method) {}
+
+        virtual void Run(ObserverType* obs) const
+        {
+            method_.Run(obs);
+        }
+
+    private:
+        UnboundMethod<ObserverType, Method, Params> method_;
+    };
+
+    struct PendingNotification
+    {
+        scoped_refptr<Notification> notification;
+        PendingNotification* next;
+    };
+
     struct ObserverListContext
+        : public base::RefCountedThreadSafe<ObserverListContext>
     {
-        explicit ObserverListContext(NotificationType type)
-            : loop(base::MessageLoopProxy::current()),
-            list(type) {}
+        ObserverListContext(MessageLoop* message_loop, NotificationType type)
+            : message_loop(message_loop),
+            loop(base::MessageLoopProxy::current()),
+            list(type),
+            detached(false),
+            pending_head(0) {}
+
+        // Queues |notification| and returns true if the queue was empty, in
+        // which case the caller must post a task to drain it.  Any thread.
+        bool Enqueue(Notification* notification)
+        {
+            PendingNotification* node = new PendingNotification;
+            node->notification = notification;
+            base::subtle::AtomicWord head;
+            do
+            {
+                head = base::subtle::NoBarrier_Load(&pending_head);
+                node->next = reinterpret_cast<PendingNotification*>(head);
+            } while (base::subtle::Release_CompareAndSwap(&pending_head, head,
+                reinterpret_cast<base::subtle::AtomicWord>(node)) != head);
+            return head == 0;
+        }
 
+        // Empties the queue and returns its notifications oldest first.
+        // Since nodes are only ever pushed one at a time and taken all at
+        // once, the list cannot suffer from ABA.
+        PendingNotification* TakePending()
+        {
+            PendingNotification* node = reinterpret_cast<PendingNotification*>(
+                base::subtle::NoBarrier_AtomicExchange(&pending_head, 0));
+            PendingNotification* ordered = NULL;
+            while (node)
+            {
+                PendingNotification* next = node->next;
+                node->next = ordered;
+                ordered = node;
+                node = next;
+            }
+            return ordered;
+        }
+
+        MessageLoop* const message_loop;
         scoped_refptr<base::MessageLoopProxy> loop;
+
+        // Only used on |message_loop|.
         ObserverList<ObserverType> list;
+        bool detached;
+
+        // Newest PendingNotification first.
+        volatile base::subtle::AtomicWord pending_head;
+
+    private:
+        friend class base::RefCountedThreadSafe<ObserverListContext>;
+        ~ObserverListContext()
+        {
+            PendingNotification* node = TakePending();
+            while (node)
+            {
+                PendingNotification* next = node->next;
+                delete node;
+                node = next;
+            }
+        }
 
         DISALLOW_COPY_AND_ASSIGN(ObserverListContext);
     };
 
-    ~ObserverListThreadSafe()
+    // Immutable once published.
+    struct ContextSnapshot
     {
-        typename ObserversListMap::const_iterator it;
-        for (it = observer_lists_.begin(); it != observer_lists_.end(); ++it)
+        ObserverListContext* Find(MessageLoop* loop) const
         {
-            delete (*it).second;
+            for (size_t i = 0; i < contexts.size(); ++i)
+            {
+                if (contexts[i]->message_loop == loop)
+                {
+                    return contexts[i].get();
+                }
+            }
+            return NULL;
         }
-        observer_lists_.clear();
+
+        std::vector<scoped_refptr<ObserverListContext> > contexts;
+    };
+
+    // Pins the current snapshot for the lifetime of the reader.  It counts
+    // itself in the slot of the epoch it saw, and retries if the epoch moved
+    // on before it was counted, so a writer waiting on the old slot cannot
+    // miss it.  Must not be held across PublishSnapshot().
+    class SnapshotReader
+    {
+    public:
+        explicit SnapshotReader(ObserverListThreadSafe* owner) : owner_(owner)
+        {
+            for (;;)
+            {
+                base::subtle::Atomic32 epoch =
+                    base::subtle::Acquire_Load(&owner_->epoch_);
+                slot_ = epoch & 1;
+                base::subtle::Barrier_AtomicIncrement(&owner_->readers_[slot_], 1);
+                if (base::subtle::Acquire_Load(&owner_->epoch_) == epoch)
+                {
+                    break;
+                }
+                base::subtle::Barrier_AtomicIncrement(&owner_->readers_[slot_], -1);
+            }
+            snapshot_ = reinterpret_cast<const ContextSnapshot*>(
+                base::subtle::Acquire_Load(&owner_->snapshot_));
+        }
+
+        ~SnapshotReader()
+        {
+            base::subtle::Barrier_AtomicIncrement(&owner_->readers_[slot_], -1);
+        }
+
+        const ContextSnapshot* snapshot() const { return snapshot_; }
+
+    private:
+        ObserverListThreadSafe* owner_;
+        const ContextSnapshot* snapshot_;
+        int slot_;
+
+        DISALLOW_COPY_AND_ASSIGN(SnapshotReader);
+    };
+
+    ~ObserverListThreadSafe()
+    {
+        delete reinterpret_cast<const ContextSnapshot*>(
+            base::subtle::NoBarrier_Load(&snapshot_));
     }
 
-    template<class Method, class Params>
-    void Notify(const UnboundMethod<ObserverType, Method, Params>& method)
+    // Must hold |list_lock_|.
+    const ContextSnapshot* CurrentSnapshot() const
     {
-        base::AutoLock lock(list_lock_);
-        typename ObserversListMap::iterator it;
-        for (it = observer_lists_.begin(); it != observer_lists_.end(); ++it)
+        list_lock_.AssertAcquired();
+        return reinterpret_cast<const ContextSnapshot*>(
+            base::subtle::NoBarrier_Load(&snapshot_));
+    }
+
+    // Must hold |list_lock_|.  Swaps in |snapshot| and frees the one it
+    // replaces.  Readers counted under the new epoch load the new snapshot,
+    // so only the old epoch's slot has to drain; readers hold it just long
+    // enough to post, so the wait is short.
+    void PublishSnapshot(ContextSnapshot* snapshot)
+    {
+        const ContextSnapshot* old_snapshot = CurrentSnapshot();
+        base::subtle::Release_Store(&snapshot_,
+            reinterpret_cast<base::subtle::AtomicWord>(snapshot));
+        base::subtle::Atomic32 old_epoch = base::subtle::NoBarrier_Load(&epoch_);
+        base::subtle::Release_Store(&epoch_, old_epoch + 1);
+        base::subtle::MemoryBarrier();
+        while (base::subtle::Acquire_Load(&readers_[old_epoch & 1]) != 0)
         {
-            ObserverListContext* context = (*it).second;
-            context->loop->PostTask(
-                NewRunnableMethod(this,
-                    &ObserverListThreadSafe<ObserverType>::
-                    template NotifyWrapper<Method, Params>, context, method));
+            base::PlatformThread::YieldCurrentThread();
         }
+        delete old_snapshot;
     }
 
-    template<class Method, class Params>
-    void NotifyWrapper(ObserverListContext* context,
-        const UnboundMethod<ObserverType, Method, Params>& method)
+    // Called on the context's own loop once its list is empty.
+    void DetachContext(ObserverListContext* context)
     {
+        DCHECK_EQ(context->message_loop, MessageLoop::current());
+        if (context->detached)
         {
-            base::AutoLock lock(list_lock_);
-            typename ObserversListMap::iterator it =
-                observer_lists_.find(MessageLoop::current());
+            return;
+        }
+        context->detached = true;
 
-            if (it == observer_lists_.end() || it->second != context)
+        base::AutoLock lock(list_lock_);
+        const ContextSnapshot* current = CurrentSnapshot();
+        ContextSnapshot* snapshot = new ContextSnapshot;
+        for (size_t i = 0; i < current->contexts.size(); ++i)
+        {
+            if (current->contexts[i] != context)
             {
-                return;
+                snapshot->contexts.push_back(current->contexts[i]);
             }
         }
+        PublishSnapshot(snapshot);
+    }
 
+    template<class Method, class Params>
+    void Notify(const UnboundMethod<ObserverType, Method, Params>& method)
+    {
+        scoped_refptr<Notification> notification(
+            new NotificationImpl<Method, Params>(method));
+
+        SnapshotReader reader(this);
+        const ContextSnapshot* snapshot = reader.snapshot();
+        for (size_t i = 0; i < snapshot->contexts.size(); ++i)
         {
-            typename ObserverList<ObserverType>::Iterator it(context->list);
-            ObserverType* obs;
-            while ((obs = it.GetNext()) != NULL)
+            ObserverListContext* context = snapshot->contexts[i].get();
+            if (context->Enqueue(notification.get()))
             {
-                method.Run(obs);
+                context->loop->PostTask(
+                    NewRunnableMethod(this,
+                        &ObserverListThreadSafe<ObserverType>::NotifyWrapper,
+                        snapshot->contexts[i]));
             }
         }
+    }
 
-        if (context->list.size() == 0)
+    void NotifyWrapper(scoped_refptr<ObserverListContext> context)
+    {
+        PendingNotification* pending = context->TakePending();
+        while (pending)
         {
+            if (!context->detached)
             {
-                base::AutoLock lock(list_lock_);
-                typename ObserversListMap::iterator it =
-                    observer_lists_.find(MessageLoop::current());
-                if (it != observer_lists_.end() && it->second == context)
                 {
-                    observer_lists_.erase(it);
+                    typename ObserverList<ObserverType>::Iterator it(context->list);
+                    ObserverType* obs;
+                    while ((obs = it.GetNext()) != NULL)
+                    {
+                        pending->notification->Run(obs);
+                    }
+                }
+
+                if (context->list.size() == 0)
+                {
+                    DetachContext(context.get());
                 }
             }
-            delete context;
+
+            PendingNotification* next = pending->next;
+            delete pending;
+            pending = next;
         }
     }
 
-    typedef std::map<MessageLoop*, ObserverListContext*> ObserversListMap;
-
-    base::Lock list_lock_; 
-    ObserversListMap observer_lists_;
+    mutable base::Lock list_lock_;
     const NotificationType type_;
 
+    // The published ContextSnapshot.  Written under |list_lock_|, read
+    // without it.
+    volatile base::subtle::AtomicWord snapshot_;
+
+    // Bumped by every PublishSnapshot(); SnapshotReaders are counted in
+    // |readers_[epoch & 1]|.
+    volatile base::subtle::Atomic32 epoch_;
+    volatile base::subtle::Atomic32 readers_[2];
+
     DISALLOW_COPY_AND_ASSIGN(ObserverListThreadSafe);
 };
 
-#endif //__base_observer_list_threadsafe_h__
\ No newline at end of file
+#endif //__base_observer_list_threadsafe_h__
@@ -0,0 +1,142 @@
+// Timings of ObserverListThreadSafe with 1000 observers spread over four
+// threads: what Notify() costs the caller, and how long it takes until every
+// observer has seen every notification.
+
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/observer_list_threadsafe.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_util.h"
+#include "base/threading/thread.h"
+
+namespace
+{
+
+    const int kThreads = 4;
+    const int kObserversPerThread = 250;
+    const int kNotifications = 1000;
+
+    class CountingObserver
+    {
+    public:
+        void OnEvent(int value);
+    };
+
+    typedef ObserverListThreadSafe<CountingObserver> CountingObserverList;
+
+    volatile base::subtle::Atomic32 g_deliveries = 0;
+    base::subtle::Atomic32 g_expected_deliveries = 0;
+    base::WaitableEvent* g_all_delivered = NULL;
+
+    void CountingObserver::OnEvent(int value)
+    {
+        if (base::subtle::Barrier_AtomicIncrement(&g_deliveries, 1) ==
+            g_expected_deliveries)
+        {
+            g_all_delivered->Signal();
+        }
+    }
+
+    // The observers that live on one thread.
+    struct ThreadObservers
+    {
+        CountingObserverList* list;
+        CountingObserver observers[kObserversPerThread];
+        base::WaitableEvent* done;
+    };
+
+    void AddObservers(ThreadObservers* group)
+    {
+        for (int i = 0; i < kObserversPerThread; ++i)
+        {
+            group->list->AddObserver(&group->observers[i]);
+        }
+        group->done->Signal();
+    }
+
+    void RemoveObservers(ThreadObservers* group)
+    {
+        for (int i = 0; i < kObserversPerThread; ++i)
+        {
+            group->list->RemoveObserver(&group->observers[i]);
+        }
+        group->done->Signal();
+    }
+
+    // Runs |task| on every thread and waits until all of them are done.
+    void RunOnThreads(base::Thread* threads[], ThreadObservers groups[],
+        void (*task)(ThreadObservers*))
+    {
+        for (int i = 0; i < kThreads; ++i)
+        {
+            threads[i]->message_loop_proxy()->PostTask(
+                base::Bind(task, &groups[i]));
+        }
+        for (int i = 0; i < kThreads; ++i)
+        {
+            groups[i].done->Wait();
+        }
+    }
+
+    // Broadcasts |kNotifications| times and reports the time spent in
+    // Notify() and the time until the last observer was called.
+    void TimeBroadcast(const char* name, CountingObserverList* list)
+    {
+        base::subtle::NoBarrier_Store(&g_deliveries, 0);
+        g_expected_deliveries = kNotifications * kThreads * kObserversPerThread;
+        g_all_delivered->Reset();
+
+        base::test::Timer timer;
+        for (int i = 0; i < kNotifications; ++i)
+        {
+            list->Notify(&CountingObserver::OnEvent, i);
+        }
+        double notify_ms = timer.ElapsedMs();
+        g_all_delivered->Wait();
+        double delivered_ms = timer.ElapsedMs();
+        EXPECT(base::subtle::Acquire_Load(&g_deliveries) ==
+            g_expected_deliveries);
+
+        std::string notify_name = std::string(name) + ", Notify()";
+        std::string delivered_name = std::string(name) + ", delivered";
+        base::test::PrintCost(notify_name.c_str(), notify_ms, kNotifications);
+        base::test::PrintRate(delivered_name.c_str(), delivered_ms,
+            g_expected_deliveries, "calls");
+    }
+
+}
+
+void RunObserverListThreadSafePerfTests()
+{
+    scoped_refptr<CountingObserverList> list(new CountingObserverList);
+    base::WaitableEvent all_delivered(false, false);
+    g_all_delivered = &all_delivered;
+
+    base::Thread* threads[kThreads];
+    ThreadObservers groups[kThreads];
+    base::WaitableEvent* done[kThreads];
+    for (int i = 0; i < kThreads; ++i)
+    {
+        threads[i] = new base::Thread("observer thread");
+        threads[i]->Start();
+        done[i] = new base::WaitableEvent(false, false);
+        groups[i].list = list.get();
+        groups[i].done = done[i];
+    }
+
+    RunOnThreads(threads, groups, &AddObservers);
+    // Once first, so that the timing does not pay for growing the queues.
+    TimeBroadcast("1000 observers x 4 threads, warm-up", list.get());
+    TimeBroadcast("1000 observers x 4 threads", list.get());
+    RunOnThreads(threads, groups, &RemoveObservers);
+
+    for (int i = 0; i < kThreads; ++i)
+    {
+        threads[i]->Stop();
+        delete threads[i];
+        delete done[i];
+    }
+    g_all_delivered = NULL;
+}
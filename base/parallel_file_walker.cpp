@@ -0,0 +1,313 @@
+#include "parallel_file_walker.h"
+
+#include <algorithm>
+
+#include "logging.h"
+#include "sys_info.h"
+#include "threading/platform_thread.h"
+#include "threading/thread_restrictions.h"
+
+namespace
+{
+
+    const int kMaxThreadCount = 8;
+
+    bool EntryPathLess(const base::ParallelFileWalker::Entry& a,
+        const base::ParallelFileWalker::Entry& b)
+    {
+        return a.path < b.path;
+    }
+
+}
+
+namespace base
+{
+
+    struct ParallelFileWalker::Directory
+    {
+        explicit Directory(const FilePath& path) : path(path), listed(false) {}
+
+        static bool PathLess(const Directory* a, const Directory* b)
+        {
+            return a->path < b->path;
+        }
+
+        FilePath path;
+        std::vector<Entry> entries;
+        // Subdirectories to walk, sorted by name in SORTED order.
+        std::vector<Directory*> children;
+        bool listed;
+    };
+
+    class ParallelFileWalker::Worker : public PlatformThread::Delegate
+    {
+    public:
+        explicit Worker(ParallelFileWalker* walker)
+            : walker_(walker), handle_(NULL) {}
+
+        virtual void ThreadMain()
+        {
+            PlatformThread::SetName("FileWalker");
+            walker_->RunWorker();
+        }
+
+        PlatformThreadHandle* handle() { return &handle_; }
+
+    private:
+        ParallelFileWalker* walker_;
+        PlatformThreadHandle handle_;
+
+        DISALLOW_COPY_AND_ASSIGN(Worker);
+    };
+
+    ParallelFileWalker::Entry::Entry() : is_directory(false), size(0) {}
+
+    ParallelFileWalker::Entry::~Entry() {}
+
+    ParallelFileWalker::ParallelFileWalker(const FilePath& root,
+        int entry_types, Order order)
+        : root_(root),
+        entry_types_(entry_types),
+        order_(order),
+        filter_(NULL),
+        thread_count_(std::min(SysInfo::NumberOfProcessors(), kMaxThreadCount)),
+        cv_(&lock_),
+        pending_(0),
+        cancelled_(false) {}
+
+    ParallelFileWalker::~ParallelFileWalker() {}
+
+    void ParallelFileWalker::set_thread_count(int thread_count)
+    {
+        thread_count_ = std::max(thread_count, 1);
+    }
+
+    bool ParallelFileWalker::Walk(Sink* sink)
+    {
+        ThreadRestrictions::AssertIOAllowed();
+        DCHECK(sink);
+
+        Directory* root = new Directory(root_);
+        {
+            AutoLock lock(lock_);
+            directories_.push_back(root);
+            queued_.push_back(root);
+            pending_ = 1;
+            cancelled_ = false;
+        }
+
+        ScopedVector<Worker> workers;
+        for (int i = 0; i < thread_count_; ++i)
+        {
+            Worker* worker = new Worker(this);
+            if (PlatformThread::Create(0, worker, worker->handle()))
+            {
+                workers.push_back(worker);
+            }
+            else
+            {
+                delete worker;
+            }
+        }
+        if (workers.empty())
+        {
+            // No threads to be had; list everything first.
+            RunWorker();
+        }
+
+        bool completed = (order_ == SORTED) ? DeliverSorted(sink, root) :
+            DeliverUnordered(sink);
+        if (!completed)
+        {
+            AutoLock lock(lock_);
+            cancelled_ = true;
+            cv_.Broadcast();
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            PlatformThread::Join(*workers[i]->handle());
+        }
+
+        AutoLock lock(lock_);
+        queued_.clear();
+        listed_.clear();
+        directories_.reset();
+        return completed;
+    }
+
+    void ParallelFileWalker::RunWorker()
+    {
+        AutoLock lock(lock_);
+        for (;;)
+        {
+            while (queued_.empty() && pending_ > 0 && !cancelled_)
+            {
+                cv_.Wait();
+            }
+            if (queued_.empty() || cancelled_)
+            {
+                break;
+            }
+
+            // In SORTED order take the most recently found directory, which
+            // keeps listing close to the depth first delivery order and the
+            // listed but undelivered directories few.
+            Directory* directory;
+            if (order_ == SORTED)
+            {
+                directory = queued_.back();
+                queued_.pop_back();
+            }
+            else
+            {
+                directory = queued_.front();
+                queued_.pop_front();
+            }
+
+            {
+                AutoUnlock unlock(lock_);
+                ListDirectory(directory);
+            }
+
+            if (order_ == SORTED)
+            {
+                queued_.insert(queued_.end(), directory->children.rbegin(),
+                    directory->children.rend());
+            }
+            else
+            {
+                queued_.insert(queued_.end(), directory->children.begin(),
+                    directory->children.end());
+                listed_.push_back(directory);
+            }
+            directories_->insert(directories_->end(),
+                directory->children.begin(), directory->children.end());
+            pending_ += static_cast<int>(directory->children.size()) - 1;
+            directory->listed = true;
+            cv_.Broadcast();
+        }
+    }
+
+    void ParallelFileWalker::ListDirectory(Directory* directory)
+    {
+        FilePath pattern = directory->path.Append(L"*");
+        WIN32_FIND_DATA find_data;
+        HANDLE find_handle = ::FindFirstFileEx(pattern.value().c_str(),
+            FindExInfoBasic, &find_data, FindExSearchNameMatch, NULL,
+            FIND_FIRST_EX_LARGE_FETCH);
+        if (find_handle == INVALID_HANDLE_VALUE &&
+            ::GetLastError() == ERROR_INVALID_PARAMETER)
+        {
+            // FindExInfoBasic and FIND_FIRST_EX_LARGE_FETCH are new in
+            // Windows 7.
+            find_handle = ::FindFirstFile(pattern.value().c_str(), &find_data);
+        }
+        if (find_handle == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        do
+        {
+            const wchar_t* name = find_data.cFileName;
+            if (name[0] == L'.' && (name[1] == L'\0' ||
+                (name[1] == L'.' && name[2] == L'\0')))
+            {
+                continue;
+            }
+
+            Entry entry;
+            entry.path = directory->path.Append(name);
+            entry.is_directory =
+                (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+            ULARGE_INTEGER size;
+            size.HighPart = find_data.nFileSizeHigh;
+            size.LowPart = find_data.nFileSizeLow;
+            entry.size = static_cast<int64>(size.QuadPart);
+            entry.last_modified = Time::FromFileTime(find_data.ftLastWriteTime);
+
+            // Junctions and directory links are reported but not followed,
+            // so that the walk cannot loop.
+            if (entry.is_directory &&
+                !(find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+                (!filter_ || filter_->ShouldEnterDirectory(entry.path)))
+            {
+                directory->children.push_back(new Directory(entry.path));
+            }
+
+            int entry_type = entry.is_directory ? DIRECTORIES : FILES;
+            if ((entry_types_ & entry_type) &&
+                (!filter_ || filter_->ShouldReport(entry)))
+            {
+                directory->entries.push_back(entry);
+            }
+        } while (::FindNextFile(find_handle, &find_data));
+        ::FindClose(find_handle);
+
+        if (order_ == SORTED)
+        {
+            std::sort(directory->entries.begin(), directory->entries.end(),
+                EntryPathLess);
+            std::sort(directory->children.begin(), directory->children.end(),
+                Directory::PathLess);
+        }
+    }
+
+    bool ParallelFileWalker::DeliverUnordered(Sink* sink)
+    {
+        for (;;)
+        {
+            Directory* directory;
+            {
+                AutoLock lock(lock_);
+                while (listed_.empty() && pending_ > 0)
+                {
+                    cv_.Wait();
+                }
+                if (listed_.empty())
+                {
+                    return true;
+                }
+                directory = listed_.front();
+                listed_.pop_front();
+            }
+
+            // Listed directories are no longer touched by the workers.
+            std::vector<Entry> entries;
+            entries.swap(directory->entries);
+            if (!entries.empty() && !sink->OnEntries(entries))
+            {
+                return false;
+            }
+        }
+    }
+
+    bool ParallelFileWalker::DeliverSorted(Sink* sink, Directory* root)
+    {
+        std::vector<Directory*> stack(1, root);
+        while (!stack.empty())
+        {
+            Directory* directory = stack.back();
+            stack.pop_back();
+            {
+                AutoLock lock(lock_);
+                while (!directory->listed)
+                {
+                    cv_.Wait();
+                }
+            }
+
+            std::vector<Entry> entries;
+            entries.swap(directory->entries);
+            if (!entries.empty() && !sink->OnEntries(entries))
+            {
+                return false;
+            }
+            stack.insert(stack.end(), directory->children.rbegin(),
+                directory->children.rend());
+        }
+        return true;
+    }
+
+} //namespace base
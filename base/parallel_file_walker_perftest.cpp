@@ -0,0 +1,155 @@
+// Files listed per second over a tree of about 100,000 files in 4,700
+// directories: by FileEnumerator, recursive, and by ParallelFileWalker in
+// both orders at 1 to 8 threads.  The tree has just been written, so its
+// directories are in the cache and this measures the listing itself; to
+// time a cold walk, set PARALLEL_FILE_WALKER_ROOT to a tree of your own and
+// run this first thing after a restart, walker first.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/environment.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/parallel_file_walker.h"
+#include "base/scoped_temp_dir.h"
+#include "base/test/test_util.h"
+#include "base/utf_string_conversions.h"
+
+namespace
+{
+
+    const char kRootVariable[] = "PARALLEL_FILE_WALKER_ROOT";
+
+    // 1 + 8 + 64 + 512 + 4096 directories of 20 files each.
+    const int kDepth = 4;
+    const int kDirectoriesPerDirectory = 8;
+    const int kFilesPerDirectory = 20;
+
+    const int kThreadCounts[] = { 1, 2, 4, 8 };
+
+    bool MakeTree(const FilePath& path, int depth)
+    {
+        for (int i = 0; i < kFilesPerDirectory; ++i)
+        {
+            wchar_t name[32];
+            swprintf_s(name, arraysize(name), L"source%d.cpp", i);
+            if (base::WriteFile(path.Append(name), "//\n", 3) != 3)
+            {
+                return false;
+            }
+        }
+        for (int i = 0; depth > 0 && i < kDirectoriesPerDirectory; ++i)
+        {
+            wchar_t name[32];
+            swprintf_s(name, arraysize(name), L"module%d", i);
+            FilePath child = path.Append(name);
+            if (!base::CreateDirectory(child) || !MakeTree(child, depth - 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    class CountingSink : public base::ParallelFileWalker::Sink
+    {
+    public:
+        CountingSink() : count_(0) {}
+
+        virtual bool OnEntries(
+            const std::vector<base::ParallelFileWalker::Entry>& entries)
+        {
+            count_ += entries.size();
+            return true;
+        }
+
+        size_t count() const { return count_; }
+
+    private:
+        size_t count_;
+    };
+
+    size_t TimeFileEnumerator(const FilePath& root)
+    {
+        base::test::Timer timer;
+        size_t count = 0;
+        base::FileEnumerator enumerator(root, true,
+            base::FileEnumerator::FILES);
+        for (FilePath path = enumerator.Next(); !path.empty();
+            path = enumerator.Next())
+        {
+            ++count;
+        }
+        base::test::PrintRate("FileEnumerator", timer.ElapsedMs(),
+            static_cast<double>(count), "file");
+        return count;
+    }
+
+    size_t TimeWalker(const FilePath& root,
+        base::ParallelFileWalker::Order order, int thread_count)
+    {
+        base::test::Timer timer;
+        base::ParallelFileWalker walker(root, base::ParallelFileWalker::FILES,
+            order);
+        walker.set_thread_count(thread_count);
+        CountingSink sink;
+        EXPECT(walker.Walk(&sink));
+        double ms = timer.ElapsedMs();
+
+        char name[64];
+        _snprintf_s(name, sizeof(name), _TRUNCATE,
+            "ParallelFileWalker, %s, %d thread%s",
+            order == base::ParallelFileWalker::SORTED ? "sorted" : "unordered",
+            thread_count, thread_count == 1 ? "" : "s");
+        base::test::PrintRate(name, ms, static_cast<double>(sink.count()),
+            "file");
+        return sink.count();
+    }
+
+    void TimeWalks(const FilePath& root)
+    {
+        // The walker goes first, at the most threads, so that a cold tree
+        // is cold for it.
+        std::vector<size_t> counts;
+        for (size_t i = 0; i < arraysize(kThreadCounts); ++i)
+        {
+            counts.push_back(TimeWalker(root,
+                base::ParallelFileWalker::UNORDERED,
+                kThreadCounts[arraysize(kThreadCounts) - 1 - i]));
+        }
+        size_t count = TimeFileEnumerator(root);
+        for (size_t i = 0; i < arraysize(kThreadCounts); ++i)
+        {
+            counts.push_back(TimeWalker(root,
+                base::ParallelFileWalker::SORTED, kThreadCounts[i]));
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            EXPECT(counts[i] == count);
+        }
+    }
+
+}
+
+void RunParallelFileWalkerPerfTests()
+{
+    scoped_ptr<base::Environment> environment(base::Environment::Create());
+    std::string root;
+    if (environment->GetVar(kRootVariable, &root) && !root.empty())
+    {
+        TimeWalks(FilePath(UTF8ToWide(root)));
+        return;
+    }
+
+    ScopedTempDir temp_dir;
+    if (!temp_dir.CreateUniqueTempDir() || !MakeTree(temp_dir.path(), kDepth))
+    {
+        fprintf(stderr, "cannot write the test tree\n");
+        return;
+    }
+    TimeWalks(temp_dir.path());
+}
@@ -0,0 +1,362 @@
+// Checks that ParallelFileWalker in SORTED order hands out the same batches
+// in the same order at every thread count, and the order documented: each
+// directory's entries sorted by name, then its subdirectories depth first;
+// that UNORDERED finds the same entries as SORTED and as FileEnumerator;
+// that filters and entry types are honoured; and that a sink returning false
+// stops the walk there, leaving the walker usable.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/parallel_file_walker.h"
+#include "base/scoped_temp_dir.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+
+namespace
+{
+
+    typedef base::ParallelFileWalker::Entry Entry;
+    typedef std::vector<std::vector<Entry> > Batches;
+
+    const int kDepth = 3;
+    const int kFilesPerDirectory = 5;
+    const int kDirectoriesPerDirectory = 3;
+    const int kThreadCounts[] = { 1, 2, 8 };
+
+    FilePath FileName(int index)
+    {
+        wchar_t name[32];
+        swprintf_s(name, arraysize(name), L"file%d.txt", index);
+        return FilePath(name);
+    }
+
+    FilePath DirectoryName(int index)
+    {
+        wchar_t name[32];
+        swprintf_s(name, arraysize(name), L"dir%d", index);
+        return FilePath(name);
+    }
+
+    int FileSize(int depth, int index)
+    {
+        return depth * 100 + index;
+    }
+
+    // Written in reverse name order, so that a listing in creation order is
+    // not sorted by accident.
+    bool MakeTree(const FilePath& path, int depth)
+    {
+        for (int i = kFilesPerDirectory - 1; i >= 0; --i)
+        {
+            std::string contents(FileSize(depth, i), 'x');
+            int size = static_cast<int>(contents.length());
+            if (base::WriteFile(path.Append(FileName(i)), contents.data(),
+                size) != size)
+            {
+                return false;
+            }
+        }
+        for (int i = kDirectoriesPerDirectory - 1; depth > 0 && i >= 0; --i)
+        {
+            FilePath child = path.Append(DirectoryName(i));
+            if (!base::CreateDirectory(child) || !MakeTree(child, depth - 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool EntryPathLess(const Entry& a, const Entry& b)
+    {
+        return a.path < b.path;
+    }
+
+    // The batches a SORTED walk of the tree MakeTree() wrote must produce,
+    // leaving out directories named |skipped| as a filter would.
+    void ExpectedBatches(const FilePath& path, int depth, int entry_types,
+        const FilePath& skipped, bool is_root, Batches* batches)
+    {
+        std::vector<Entry> entries;
+        std::vector<FilePath> children;
+        if (entry_types & base::ParallelFileWalker::FILES)
+        {
+            for (int i = 0; i < kFilesPerDirectory; ++i)
+            {
+                Entry entry;
+                entry.path = path.Append(FileName(i));
+                entry.size = FileSize(depth, i);
+                entries.push_back(entry);
+            }
+        }
+        for (int i = 0; depth > 0 && i < kDirectoriesPerDirectory; ++i)
+        {
+            FilePath child = path.Append(DirectoryName(i));
+            if (DirectoryName(i) != skipped)
+            {
+                children.push_back(child);
+            }
+            if (entry_types & base::ParallelFileWalker::DIRECTORIES)
+            {
+                Entry entry;
+                entry.path = child;
+                entry.is_directory = true;
+                entries.push_back(entry);
+            }
+        }
+        // The empty directory at the root has no batch of its own.
+        if (is_root && (entry_types & base::ParallelFileWalker::DIRECTORIES))
+        {
+            Entry entry;
+            entry.path = path.Append(L"empty");
+            entry.is_directory = true;
+            entries.push_back(entry);
+        }
+
+        std::sort(entries.begin(), entries.end(), EntryPathLess);
+        if (!entries.empty())
+        {
+            batches->push_back(entries);
+        }
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            ExpectedBatches(children[i], depth - 1, entry_types, skipped,
+                false, batches);
+        }
+    }
+
+    bool SameEntry(const Entry& a, const Entry& b)
+    {
+        return a.path == b.path && a.is_directory == b.is_directory &&
+            (a.is_directory || a.size == b.size);
+    }
+
+    bool SameBatches(const Batches& a, const Batches& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].size() != b[i].size() ||
+                !std::equal(a[i].begin(), a[i].end(), b[i].begin(),
+                SameEntry))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<FilePath> SortedPaths(const Batches& batches)
+    {
+        std::vector<FilePath> paths;
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            for (size_t j = 0; j < batches[i].size(); ++j)
+            {
+                paths.push_back(batches[i][j].path);
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    // Records the batches, stopping the walk after |stop_after| of them.
+    class RecordingSink : public base::ParallelFileWalker::Sink
+    {
+    public:
+        explicit RecordingSink(size_t stop_after = 0)
+            : stop_after_(stop_after),
+            thread_id_(base::PlatformThread::CurrentId()) {}
+
+        virtual bool OnEntries(const std::vector<Entry>& entries)
+        {
+            // Always on the thread that called Walk().
+            EXPECT(base::PlatformThread::CurrentId() == thread_id_);
+            EXPECT(!entries.empty());
+            batches_.push_back(entries);
+            return stop_after_ == 0 || batches_.size() < stop_after_;
+        }
+
+        const Batches& batches() const { return batches_; }
+
+    private:
+        size_t stop_after_;
+        base::PlatformThreadId thread_id_;
+        Batches batches_;
+    };
+
+    class SkippingFilter : public base::ParallelFileWalker::Filter
+    {
+    public:
+        explicit SkippingFilter(const FilePath& skipped) : skipped_(skipped) {}
+
+        virtual bool ShouldEnterDirectory(const FilePath& directory)
+        {
+            return directory.BaseName() != skipped_;
+        }
+
+        virtual bool ShouldReport(const Entry& entry)
+        {
+            return true;
+        }
+
+    private:
+        FilePath skipped_;
+    };
+
+    void TestSorted(const FilePath& root)
+    {
+        const int kEntryTypes[] =
+        {
+            base::ParallelFileWalker::FILES,
+            base::ParallelFileWalker::DIRECTORIES,
+            base::ParallelFileWalker::FILES |
+                base::ParallelFileWalker::DIRECTORIES,
+        };
+        for (size_t i = 0; i < arraysize(kEntryTypes); ++i)
+        {
+            Batches expected;
+            ExpectedBatches(root, kDepth, kEntryTypes[i], FilePath(), true,
+                &expected);
+            for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+            {
+                // Twice each, as the listing races differ from run to run.
+                for (int run = 0; run < 2; ++run)
+                {
+                    base::ParallelFileWalker walker(root, kEntryTypes[i],
+                        base::ParallelFileWalker::SORTED);
+                    walker.set_thread_count(kThreadCounts[j]);
+                    RecordingSink sink;
+                    EXPECT(walker.Walk(&sink));
+                    EXPECT(SameBatches(sink.batches(), expected));
+                }
+            }
+        }
+    }
+
+    void TestUnordered(const FilePath& root)
+    {
+        const int kAll = base::ParallelFileWalker::FILES |
+            base::ParallelFileWalker::DIRECTORIES;
+        Batches expected;
+        ExpectedBatches(root, kDepth, kAll, FilePath(), true, &expected);
+        for (size_t i = 0; i < arraysize(kThreadCounts); ++i)
+        {
+            base::ParallelFileWalker walker(root, kAll,
+                base::ParallelFileWalker::UNORDERED);
+            walker.set_thread_count(kThreadCounts[i]);
+            RecordingSink sink;
+            EXPECT(walker.Walk(&sink));
+            EXPECT(sink.batches().size() == expected.size());
+            EXPECT(SortedPaths(sink.batches()) == SortedPaths(expected));
+        }
+
+        // FileEnumerator finds the same files.
+        std::vector<FilePath> enumerated;
+        base::FileEnumerator enumerator(root, true,
+            base::FileEnumerator::FILES);
+        for (FilePath path = enumerator.Next(); !path.empty();
+            path = enumerator.Next())
+        {
+            enumerated.push_back(path);
+        }
+        std::sort(enumerated.begin(), enumerated.end());
+        base::ParallelFileWalker walker(root, base::ParallelFileWalker::FILES,
+            base::ParallelFileWalker::UNORDERED);
+        RecordingSink sink;
+        EXPECT(walker.Walk(&sink));
+        EXPECT(SortedPaths(sink.batches()) == enumerated);
+    }
+
+    void TestFilter(const FilePath& root)
+    {
+        // dir1 is reported wherever it is but nothing below it is.
+        const int kAll = base::ParallelFileWalker::FILES |
+            base::ParallelFileWalker::DIRECTORIES;
+        Batches expected;
+        ExpectedBatches(root, kDepth, kAll, DirectoryName(1), true,
+            &expected);
+        for (size_t i = 0; i < arraysize(kThreadCounts); ++i)
+        {
+            SkippingFilter filter(DirectoryName(1));
+            base::ParallelFileWalker walker(root, kAll,
+                base::ParallelFileWalker::SORTED);
+            walker.set_filter(&filter);
+            walker.set_thread_count(kThreadCounts[i]);
+            RecordingSink sink;
+            EXPECT(walker.Walk(&sink));
+            EXPECT(SameBatches(sink.batches(), expected));
+        }
+    }
+
+    void TestCancel(const FilePath& root)
+    {
+        Batches expected;
+        ExpectedBatches(root, kDepth, base::ParallelFileWalker::FILES,
+            FilePath(), true, &expected);
+        const base::ParallelFileWalker::Order kOrders[] =
+        {
+            base::ParallelFileWalker::UNORDERED,
+            base::ParallelFileWalker::SORTED,
+        };
+        const size_t kStopAfter[] = { 1, 2, expected.size() };
+        for (size_t i = 0; i < arraysize(kOrders); ++i)
+        {
+            for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+            {
+                for (size_t k = 0; k < arraysize(kStopAfter); ++k)
+                {
+                    base::ParallelFileWalker walker(root,
+                        base::ParallelFileWalker::FILES, kOrders[i]);
+                    walker.set_thread_count(kThreadCounts[j]);
+
+                    // No batch follows the one that stopped the walk, even
+                    // the last.
+                    RecordingSink stopping(kStopAfter[k]);
+                    EXPECT(!walker.Walk(&stopping));
+                    EXPECT(stopping.batches().size() == kStopAfter[k]);
+                    if (kOrders[i] == base::ParallelFileWalker::SORTED)
+                    {
+                        EXPECT(SameBatches(stopping.batches(),
+                            Batches(expected.begin(),
+                            expected.begin() + kStopAfter[k])));
+                    }
+
+                    // The same walker walks again in full.
+                    RecordingSink sink;
+                    EXPECT(walker.Walk(&sink));
+                    EXPECT(SortedPaths(sink.batches()) ==
+                        SortedPaths(expected));
+                }
+            }
+        }
+    }
+
+}
+
+void RunParallelFileWalkerTests()
+{
+    ScopedTempDir temp_dir;
+    bool written = temp_dir.CreateUniqueTempDir() &&
+        MakeTree(temp_dir.path(), kDepth) &&
+        base::CreateDirectory(temp_dir.path().Append(L"empty"));
+    EXPECT(written);
+    if (!written)
+    {
+        return;
+    }
+
+    TestSorted(temp_dir.path());
+    TestUnordered(temp_dir.path());
+    TestFilter(temp_dir.path());
+    TestCancel(temp_dir.path());
+}
@@ -61,6 +61,14 @@ variable_buffer_offset_(other.variable_buffer_offset_)
     memcpy(header_, other.header_, payload_size);
 }
 
+Pickle::Pickle(const PickleBuilder& builder) : header_(NULL),
+header_size_(sizeof(Header)), capacity_(0), variable_buffer_offset_(0)
+{
+    bool resized = Resize(builder.size());
+    CHECK(resized);
+    builder.CopyTo(reinterpret_cast<char*>(header_));
+}
+
 Pickle::~Pickle()
 {
     if (capacity_ != kCapacityReadOnly)
@@ -321,6 +329,51 @@ bool Pickle::ReadString16(void** iter, string16* result) const
     return true;
 }
 
+bool Pickle::ReadStringPiece(void** iter, base::StringPiece* result) const
+{
+    DCHECK(iter);
+
+    int len;
+    if (!ReadLength(iter, &len))
+    {
+        return false;
+    }
+    if (!IteratorHasRoomFor(*iter, len))
+    {
+        return false;
+    }
+
+    result->set(reinterpret_cast<const char*>(*iter), len);
+
+    UpdateIter(iter, len);
+    return true;
+}
+
+bool Pickle::ReadStringPiece16(void** iter, base::StringPiece16* result) const
+{
+    DCHECK(iter);
+
+    int len;
+    if (!ReadLength(iter, &len))
+    {
+        return false;
+    }
+
+    if (len > INT_MAX / static_cast<int>(sizeof(char16)))
+    {
+        return false;
+    }
+    if (!IteratorHasRoomFor(*iter, len * sizeof(char16)))
+    {
+        return false;
+    }
+
+    result->set(reinterpret_cast<const char16*>(*iter), len);
+
+    UpdateIter(iter, len * sizeof(char16));
+    return true;
+}
+
 bool Pickle::ReadBytes(void** iter, const char** data, int length) const
 {
     DCHECK(iter);
@@ -478,6 +531,19 @@ void Pickle::TrimWriteData(int new_length)
     *cur_length = new_length;
 }
 
+bool Pickle::Reserve(size_t length)
+{
+    DCHECK(capacity_ != kCapacityReadOnly) << "oops: pickle is readonly";
+
+    size_t needed_size = header_size_ +
+        AlignInt(header_->payload_size, sizeof(uint32)) + length;
+    if (needed_size <= capacity_)
+    {
+        return true;
+    }
+    return Resize(needed_size);
+}
+
 bool Pickle::Resize(size_t new_capacity)
 {
     new_capacity = AlignInt(new_capacity, kPayloadUnit);
@@ -518,3 +584,164 @@ const char* Pickle::FindNext(size_t header_size,
     return (payload_end > end) ? NULL : payload_end;
 }
 
+
+// static
+const size_t PickleBuilder::kChunkSize = 4096;
+
+// static
+const size_t PickleBuilder::kMinReferenceSize = 256;
+
+PickleBuilder::PickleBuilder() : chunk_pos_(NULL), chunk_end_(NULL),
+bytes_copied_(0), bytes_referenced_(0)
+{
+    header_.payload_size = 0;
+}
+
+PickleBuilder::~PickleBuilder()
+{
+    for (size_t i = 0; i < chunks_.size(); ++i)
+    {
+        free(chunks_[i]);
+    }
+}
+
+bool PickleBuilder::WriteBytes(const void* data, int data_len)
+{
+    if (data_len < 0)
+    {
+        return false;
+    }
+
+    // Every item starts on a uint32 boundary, as in Pickle.
+    size_t length = static_cast<size_t>(data_len);
+    size_t padding = (sizeof(uint32) - (length % sizeof(uint32))) %
+        sizeof(uint32);
+    char* dest = Allocate(length + padding);
+    if (!dest)
+    {
+        return false;
+    }
+
+    memcpy(dest, data, length);
+    memset(dest + length, 0, padding);
+    bytes_copied_ += length;
+    return true;
+}
+
+bool PickleBuilder::WriteString(const base::StringPiece& value)
+{
+    if (!WriteInt(static_cast<int>(value.size())))
+    {
+        return false;
+    }
+
+    return WriteBytes(value.data(), static_cast<int>(value.size()));
+}
+
+bool PickleBuilder::WriteString16(const base::StringPiece16& value)
+{
+    if (!WriteInt(static_cast<int>(value.size())))
+    {
+        return false;
+    }
+
+    return WriteBytes(value.data(),
+        static_cast<int>(value.size()) * sizeof(char16));
+}
+
+bool PickleBuilder::WriteData(const char* data, int length)
+{
+    return length >= 0 && WriteInt(length) && WriteBytes(data, length);
+}
+
+bool PickleBuilder::WriteStringByReference(const base::StringPiece& value)
+{
+    return WriteDataByReference(value.data(), static_cast<int>(value.size()));
+}
+
+bool PickleBuilder::WriteDataByReference(const char* data, int length)
+{
+    if (length < 0 || !WriteInt(length))
+    {
+        return false;
+    }
+
+    if (static_cast<size_t>(length) < kMinReferenceSize)
+    {
+        return WriteBytes(data, length);
+    }
+
+    AppendReference(data, length);
+    size_t padding = (sizeof(uint32) - (length % sizeof(uint32))) %
+        sizeof(uint32);
+    if (padding)
+    {
+        char* dest = Allocate(padding);
+        if (!dest)
+        {
+            return false;
+        }
+        memset(dest, 0, padding);
+    }
+    return true;
+}
+
+void PickleBuilder::GetBuffers(std::vector<base::StringPiece>* buffers) const
+{
+    buffers->reserve(buffers->size() + segments_.size() + 1);
+    buffers->push_back(base::StringPiece(
+        reinterpret_cast<const char*>(&header_), sizeof(header_)));
+    for (size_t i = 0; i < segments_.size(); ++i)
+    {
+        buffers->push_back(base::StringPiece(segments_[i].data,
+            segments_[i].length));
+    }
+}
+
+void PickleBuilder::CopyTo(char* dest) const
+{
+    memcpy(dest, &header_, sizeof(header_));
+    dest += sizeof(header_);
+    for (size_t i = 0; i < segments_.size(); ++i)
+    {
+        memcpy(dest, segments_[i].data, segments_[i].length);
+        dest += segments_[i].length;
+    }
+}
+
+char* PickleBuilder::Allocate(size_t length)
+{
+    if (static_cast<size_t>(chunk_end_ - chunk_pos_) < length)
+    {
+        size_t chunk_size = std::max(kChunkSize, length);
+        char* chunk = static_cast<char*>(malloc(chunk_size));
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunks_.push_back(chunk);
+        chunk_pos_ = chunk;
+        chunk_end_ = chunk + chunk_size;
+    }
+
+    if (segments_.empty() ||
+        segments_.back().data + segments_.back().length != chunk_pos_)
+    {
+        Segment segment = { chunk_pos_, 0 };
+        segments_.push_back(segment);
+    }
+    segments_.back().length += length;
+
+    char* dest = chunk_pos_;
+    chunk_pos_ += length;
+    header_.payload_size += static_cast<uint32>(length);
+    return dest;
+}
+
+void PickleBuilder::AppendReference(const char* data, size_t length)
+{
+    Segment segment = { data, length };
+    segments_.push_back(segment);
+    header_.payload_size += static_cast<uint32>(length);
+    bytes_referenced_ += length;
+}
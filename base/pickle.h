@@ -2,9 +2,13 @@
 #define __base_pickle_h__
 
 #include <string>
+#include <vector>
 
 #include "logging.h"
 #include "string16.h"
+#include "string_piece.h"
+
+class PickleBuilder;
 
 class Pickle
 {
@@ -19,6 +23,9 @@ public:
 
     Pickle(const Pickle& other);
 
+    // Flattens |builder| into a new pickle, copying its payload once.
+    explicit Pickle(const PickleBuilder& builder);
+
     Pickle& operator=(const Pickle& other);
 
     int size() const
@@ -40,6 +47,12 @@ public:
     bool ReadWString(void** iter, std::wstring* result) const;
     bool ReadString16(void** iter, string16* result) const;
     bool ReadData(void** iter, const char** data, int* length) const;
+
+    // Read a value written by WriteString() / WriteString16() without copying
+    // it out: |result| points into the pickle and is valid as long as the
+    // pickle is alive and not written to.
+    bool ReadStringPiece(void** iter, base::StringPiece* result) const;
+    bool ReadStringPiece16(void** iter, base::StringPiece16* result) const;
     bool ReadBytes(void** iter, const char** data, int length) const;
 
     bool ReadLength(void** iter, int* result) const;
@@ -86,6 +99,10 @@ public:
 
     void TrimWriteData(int length);
 
+    // Grows the buffer so that |length| more payload bytes can be written
+    // without reallocating.
+    bool Reserve(size_t length);
+
     struct Header
     {
         uint32 payload_size; 
@@ -168,4 +185,108 @@ private:
     size_t variable_buffer_offset_; 
 };
 
+// Builds the same bytes as a Pickle, but in fixed size chunks instead of one
+// growing buffer, so that writing never moves what was already written.  Large
+// buffers can also be added by reference: the builder then only remembers
+// where they are, and their bytes are copied once when the result is
+// flattened with CopyTo() or Pickle(const PickleBuilder&), or not at all when
+// the pieces from GetBuffers() are handed to a gathering write.
+//
+// Values are read back through Pickle; the builder has no readers.
+class PickleBuilder
+{
+public:
+    PickleBuilder();
+    ~PickleBuilder();
+
+    bool WriteBool(bool value)
+    {
+        return WriteInt(value ? 1 : 0);
+    }
+    bool WriteInt(int value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteLong(long value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteSize(size_t value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteUInt16(uint16 value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteUInt32(uint32 value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteInt64(int64 value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteUInt64(uint64 value)
+    {
+        return WriteBytes(&value, sizeof(value));
+    }
+    bool WriteString(const base::StringPiece& value);
+    bool WriteString16(const base::StringPiece16& value);
+    bool WriteData(const char* data, int length);
+    bool WriteBytes(const void* data, int data_len);
+
+    // Like WriteString() and WriteData(), but |data| is referenced rather than
+    // copied if it is at least kMinReferenceSize bytes long.  It must stay
+    // valid and unchanged for as long as the builder is used.
+    bool WriteStringByReference(const base::StringPiece& value);
+    bool WriteDataByReference(const char* data, int length);
+
+    static const size_t kMinReferenceSize;
+
+    // Size of the flattened pickle, header included.
+    size_t size() const
+    {
+        return sizeof(Pickle::Header) + header_.payload_size;
+    }
+
+    // Appends the pieces that, concatenated, form the pickle.  They point
+    // into the builder and into referenced buffers.
+    void GetBuffers(std::vector<base::StringPiece>* buffers) const;
+
+    // Copies the flattened pickle to |dest|, which must have room for size()
+    // bytes.
+    void CopyTo(char* dest) const;
+
+    // Payload bytes copied into the builder and added by reference so far.
+    size_t bytes_copied() const { return bytes_copied_; }
+    size_t bytes_referenced() const { return bytes_referenced_; }
+
+private:
+    struct Segment
+    {
+        const char* data;
+        size_t length;
+    };
+
+    // Returns room for |length| bytes in the current chunk, extending the
+    // last segment when it ends there.
+    char* Allocate(size_t length);
+    void AppendReference(const char* data, size_t length);
+
+    static const size_t kChunkSize;
+
+    Pickle::Header header_;
+
+    std::vector<char*> chunks_;
+    std::vector<Segment> segments_;
+    char* chunk_pos_;
+    char* chunk_end_;
+
+    size_t bytes_copied_;
+    size_t bytes_referenced_;
+
+    DISALLOW_COPY_AND_ASSIGN(PickleBuilder);
+};
+
 #endif //__base_pickle_h__
\ No newline at end of file
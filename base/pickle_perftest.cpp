@@ -0,0 +1,218 @@
+// Round trips of an undo snapshot, a Value tree of 64 large strings with a
+// few small members each, through PickleValueSerializer: into a growing
+// Pickle, into a Pickle reserved up front, and into a PickleBuilder that is
+// flattened into a Pickle or gathered as an I/O write would.  For each, the
+// time per round trip and the payload bytes copied on the way: when
+// writing, when the Pickle grows (an upper bound, as realloc may grow in
+// place), when flattening, and when reading back into a Value tree.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/pickle_value_serializer.h"
+#include "base/test/test_util.h"
+#include "base/value.h"
+
+namespace
+{
+
+    const int kEntries = 64;
+    const size_t kTextBytes = 64 * 1024;
+    const int kRepeats = 50;
+
+    struct Copies
+    {
+        Copies() : written(0), grown(0), flattened(0), read(0) {}
+
+        size_t written;
+        size_t grown;
+        size_t flattened;
+        size_t read;
+    };
+
+    base::ListValue* MakeSnapshot()
+    {
+        base::ListValue* snapshot = new base::ListValue;
+        for (int i = 0; i < kEntries; ++i)
+        {
+            base::DictionaryValue* entry = new base::DictionaryValue;
+            entry->SetString("text", std::string(kTextBytes, 'a' + i % 26));
+            entry->SetInteger("offset", i * 1000);
+            entry->SetDouble("scroll", i * 0.5);
+            entry->SetString("reason", "typing");
+            snapshot->Append(entry);
+        }
+        return snapshot;
+    }
+
+    // String, binary and key bytes of |value|, which reading copies once
+    // into the new tree.
+    size_t StringBytes(const base::Value& value)
+    {
+        switch (value.GetType())
+        {
+        case base::Value::TYPE_STRING:
+            return static_cast<const base::StringValue&>(value).
+                GetString().size();
+        case base::Value::TYPE_BINARY:
+            return static_cast<const base::BinaryValue&>(value).GetSize();
+        case base::Value::TYPE_LIST:
+        {
+            const base::ListValue& list =
+                static_cast<const base::ListValue&>(value);
+            size_t bytes = 0;
+            for (base::ListValue::const_iterator it = list.begin();
+                it != list.end(); ++it)
+            {
+                bytes += StringBytes(**it);
+            }
+            return bytes;
+        }
+        case base::Value::TYPE_DICTIONARY:
+        {
+            const base::DictionaryValue& dictionary =
+                static_cast<const base::DictionaryValue&>(value);
+            size_t bytes = 0;
+            for (base::DictionaryValue::key_iterator it =
+                dictionary.begin_keys(); it != dictionary.end_keys(); ++it)
+            {
+                base::Value* child = NULL;
+                dictionary.GetWithoutPathExpansion(*it, &child);
+                bytes += it->size() + StringBytes(*child);
+            }
+            return bytes;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    // Writes |snapshot| as WriteValue() would, an entry at a time, so that
+    // growing the pickle can be seen: when the capacity changes, at most
+    // what was written before is moved.
+    void WriteToPickle(const base::ListValue& snapshot, Pickle* pickle,
+        Copies* copies)
+    {
+        size_t start = pickle->size();
+        pickle->WriteInt(base::Value::TYPE_LIST);
+        pickle->WriteInt(static_cast<int>(snapshot.GetSize()));
+        for (base::ListValue::const_iterator it = snapshot.begin();
+            it != snapshot.end(); ++it)
+        {
+            size_t capacity = pickle->capacity();
+            size_t size = pickle->size();
+            base::PickleValueSerializer::WriteValue(**it, pickle);
+            if (pickle->capacity() != capacity)
+            {
+                copies->grown += size;
+            }
+        }
+        copies->written += pickle->size() - start;
+    }
+
+    void ReadBack(const Pickle& pickle, Copies* copies)
+    {
+        void* iter = NULL;
+        scoped_ptr<base::Value> value(
+            base::PickleValueSerializer::ReadValue(pickle, &iter));
+        EXPECT(value.get() != NULL);
+        if (value.get())
+        {
+            copies->read += StringBytes(*value);
+        }
+    }
+
+    void PrintRoundTrip(const char* name, double ms, const Copies& copies,
+        size_t payload)
+    {
+        base::test::PrintRate(name, ms,
+            kRepeats * payload / (1024.0 * 1024.0), "MB");
+        double total = static_cast<double>(copies.written + copies.grown +
+            copies.flattened + copies.read) / kRepeats;
+        printf("  copied per round trip: %.2f x payload (write %.2f, grow "
+            "<= %.2f, flatten %.2f, read %.2f)\n", total / payload,
+            copies.written / static_cast<double>(kRepeats) / payload,
+            copies.grown / static_cast<double>(kRepeats) / payload,
+            copies.flattened / static_cast<double>(kRepeats) / payload,
+            copies.read / static_cast<double>(kRepeats) / payload);
+    }
+
+}
+
+void RunPicklePerfTests()
+{
+    scoped_ptr<base::ListValue> snapshot(MakeSnapshot());
+    Pickle reference;
+    base::PickleValueSerializer::WriteValue(*snapshot, &reference);
+    size_t payload = reference.size();
+    printf("%-36s %10.1f MB\n", "snapshot", payload / (1024.0 * 1024.0));
+
+    Copies grown;
+    base::test::Timer grown_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        Pickle pickle;
+        WriteToPickle(*snapshot, &pickle, &grown);
+        EXPECT(pickle.size() == reference.size());
+        ReadBack(pickle, &grown);
+    }
+    PrintRoundTrip("Pickle, growing", grown_timer.ElapsedMs(), grown,
+        payload);
+
+    Copies reserved;
+    base::test::Timer reserved_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        Pickle pickle;
+        pickle.Reserve(payload);
+        WriteToPickle(*snapshot, &pickle, &reserved);
+        ReadBack(pickle, &reserved);
+    }
+    PrintRoundTrip("Pickle, reserved", reserved_timer.ElapsedMs(), reserved,
+        payload);
+
+    Copies built;
+    base::test::Timer built_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        PickleBuilder builder;
+        base::PickleValueSerializer::WriteValue(*snapshot, &builder);
+        built.written += builder.bytes_copied();
+        Pickle pickle(builder);
+        built.flattened += builder.size();
+        EXPECT(pickle.size() == reference.size());
+        ReadBack(pickle, &built);
+    }
+    PrintRoundTrip("PickleBuilder, flattened", built_timer.ElapsedMs(),
+        built, payload);
+
+    // Written out through a gathering write, the builder's pieces are not
+    // copied again; the reader gets them in one buffer as from a file.
+    size_t gathered_copied = 0;
+    std::vector<base::StringPiece> buffers;
+    base::test::Timer gathered_timer;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        PickleBuilder builder;
+        base::PickleValueSerializer::WriteValue(*snapshot, &builder);
+        gathered_copied += builder.bytes_copied();
+        buffers.clear();
+        builder.GetBuffers(&buffers);
+        EXPECT(buffers.size() > 1);
+    }
+    double gathered_ms = gathered_timer.ElapsedMs();
+    base::test::PrintRate("PickleBuilder, gathered, write only",
+        gathered_ms, kRepeats * payload / (1024.0 * 1024.0), "MB");
+    printf("  copied per write: %.2f x payload\n",
+        gathered_copied / static_cast<double>(kRepeats) / payload);
+
+    // The format read back is the one written, checked outside the timings.
+    void* iter = NULL;
+    scoped_ptr<base::Value> value(
+        base::PickleValueSerializer::ReadValue(reference, &iter));
+    EXPECT(base::Value::Equals(value.get(), snapshot.get()));
+}
@@ -0,0 +1,264 @@
+// Checks that PickleBuilder writes the same bytes as Pickle, whether data is
+// copied or referenced and wherever its chunks end; that its counters add up;
+// that ReadStringPiece() aliases the payload; and that PickleValueSerializer
+// round-trips Value trees and rejects malformed or too deeply nested data.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/pickle_value_serializer.h"
+#include "base/test/test_util.h"
+#include "base/utf_string_conversions.h"
+#include "base/value.h"
+
+namespace
+{
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    std::string Flatten(const PickleBuilder& builder)
+    {
+        std::string flat(builder.size(), '\0');
+        builder.CopyTo(&flat[0]);
+        return flat;
+    }
+
+    std::string Gather(const PickleBuilder& builder)
+    {
+        std::vector<base::StringPiece> buffers;
+        builder.GetBuffers(&buffers);
+        std::string gathered;
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            buffers[i].AppendToString(&gathered);
+        }
+        return gathered;
+    }
+
+    void TestBuilderMatchesPickle()
+    {
+        // Random writes of every kind, with data from a few bytes to several
+        // chunks, copied or by reference.
+        std::string data(3 * 4096 + 17, '\0');
+        for (size_t i = 0; i < data.length(); ++i)
+        {
+            data[i] = static_cast<char>(Random(256));
+        }
+        string16 text16(ASCIIToUTF16("sixteen bit text"));
+
+        for (int round = 0; round < 50; ++round)
+        {
+            Pickle pickle;
+            PickleBuilder builder;
+            size_t expected_copied = 0;
+            size_t expected_referenced = 0;
+            for (int i = 0; i < 200; ++i)
+            {
+                int length = static_cast<int>(Random(Random(4) ?
+                    600 : static_cast<unsigned int>(data.length())));
+                base::StringPiece piece(data.data() + Random(
+                    static_cast<unsigned int>(data.length() - length + 1)),
+                    length);
+                switch (Random(6))
+                {
+                case 0:
+                    EXPECT(pickle.WriteInt(i));
+                    EXPECT(builder.WriteInt(i));
+                    expected_copied += sizeof(int);
+                    break;
+                case 1:
+                    EXPECT(pickle.WriteUInt16(static_cast<uint16>(i)));
+                    EXPECT(builder.WriteUInt16(static_cast<uint16>(i)));
+                    expected_copied += sizeof(uint16);
+                    break;
+                case 2:
+                    EXPECT(pickle.WriteString(piece.as_string()));
+                    EXPECT(builder.WriteString(piece));
+                    expected_copied += sizeof(int) + length;
+                    break;
+                case 3:
+                    EXPECT(pickle.WriteString16(text16));
+                    EXPECT(builder.WriteString16(text16));
+                    expected_copied += sizeof(int) +
+                        text16.length() * sizeof(char16);
+                    break;
+                case 4:
+                    EXPECT(pickle.WriteData(piece.data(), length));
+                    EXPECT(builder.WriteData(piece.data(), length));
+                    expected_copied += sizeof(int) + length;
+                    break;
+                default:
+                    EXPECT(pickle.WriteData(piece.data(), length));
+                    EXPECT(builder.WriteDataByReference(piece.data(), length));
+                    expected_copied += sizeof(int);
+                    if (static_cast<size_t>(length) <
+                        PickleBuilder::kMinReferenceSize)
+                    {
+                        expected_copied += length;
+                    }
+                    else
+                    {
+                        expected_referenced += length;
+                    }
+                    break;
+                }
+            }
+
+            std::string expected(static_cast<const char*>(pickle.data()),
+                pickle.size());
+            EXPECT(builder.size() == expected.length());
+            EXPECT(Flatten(builder) == expected);
+            EXPECT(Gather(builder) == expected);
+            EXPECT(builder.bytes_copied() == expected_copied);
+            EXPECT(builder.bytes_referenced() == expected_referenced);
+
+            Pickle flattened(builder);
+            EXPECT(std::string(static_cast<const char*>(flattened.data()),
+                flattened.size()) == expected);
+        }
+    }
+
+    void TestStringPieceAliases()
+    {
+        Pickle pickle;
+        std::string text(1000, 'x');
+        string16 text16(ASCIIToUTF16("wide"));
+        EXPECT(pickle.WriteString(text));
+        EXPECT(pickle.WriteString16(text16));
+        EXPECT(pickle.WriteString(std::string()));
+
+        const char* begin = static_cast<const char*>(pickle.data());
+        const char* end = begin + pickle.size();
+        void* iter = NULL;
+        base::StringPiece piece;
+        EXPECT(pickle.ReadStringPiece(&iter, &piece));
+        EXPECT(piece == text);
+        EXPECT(piece.data() >= begin && piece.data() + piece.size() <= end);
+
+        base::StringPiece16 piece16;
+        EXPECT(pickle.ReadStringPiece16(&iter, &piece16));
+        EXPECT(piece16.as_string16() == text16);
+        EXPECT(reinterpret_cast<const char*>(piece16.data()) >= begin);
+
+        EXPECT(pickle.ReadStringPiece(&iter, &piece));
+        EXPECT(piece.empty());
+        EXPECT(!pickle.ReadStringPiece(&iter, &piece));
+    }
+
+    base::Value* MakeTree()
+    {
+        base::DictionaryValue* root = new base::DictionaryValue;
+        root->SetWithoutPathExpansion("null", base::Value::CreateNullValue());
+        root->SetBoolean("flag", true);
+        root->SetInteger("count", -42);
+        root->SetDouble("ratio", 0.1);
+        root->SetString("small", "short text");
+        root->SetString("large", std::string(5000, 'L'));
+        std::string bytes(300, '\0');
+        for (size_t i = 0; i < bytes.length(); ++i)
+        {
+            bytes[i] = static_cast<char>(i);
+        }
+        root->SetWithoutPathExpansion("binary",
+            base::BinaryValue::CreateWithCopiedBuffer(bytes.data(),
+            bytes.length()));
+        base::ListValue* list = new base::ListValue;
+        for (int i = 0; i < 100; ++i)
+        {
+            base::DictionaryValue* item = new base::DictionaryValue;
+            item->SetInteger("index", i);
+            item->SetString("text", std::string(i * 7, 'a' + i % 26));
+            list->Append(item);
+        }
+        root->Set("items", list);
+        return root;
+    }
+
+    void TestValueRoundTrip()
+    {
+        scoped_ptr<base::Value> tree(MakeTree());
+
+        Pickle pickle;
+        base::PickleValueSerializer serializer(&pickle);
+        EXPECT(serializer.Serialize(*tree));
+        EXPECT(serializer.Serialize(base::StringValue("second")));
+        scoped_ptr<base::Value> first(serializer.Deserialize(NULL, NULL));
+        scoped_ptr<base::Value> second(serializer.Deserialize(NULL, NULL));
+        EXPECT(base::Value::Equals(first.get(), tree.get()));
+        base::StringValue expected_second("second");
+        EXPECT(base::Value::Equals(second.get(), &expected_second));
+
+        // The builder writes the same bytes, referencing the large strings.
+        PickleBuilder builder;
+        EXPECT(base::PickleValueSerializer::WriteValue(*tree, &builder));
+        EXPECT(builder.bytes_referenced() >= 5000 + 300);
+        Pickle from_builder(builder);
+        Pickle single;
+        EXPECT(base::PickleValueSerializer::WriteValue(*tree, &single));
+        EXPECT(from_builder.size() == single.size());
+        EXPECT(memcmp(from_builder.data(), single.data(), single.size()) == 0);
+        void* iter = NULL;
+        scoped_ptr<base::Value> read(
+            base::PickleValueSerializer::ReadValue(from_builder, &iter));
+        EXPECT(base::Value::Equals(read.get(), tree.get()));
+    }
+
+    void TestMalformed()
+    {
+        scoped_ptr<base::Value> tree(MakeTree());
+        Pickle pickle;
+        EXPECT(base::PickleValueSerializer::WriteValue(*tree, &pickle));
+
+        // Every truncation fails cleanly.
+        const char* data = static_cast<const char*>(pickle.data());
+        for (int size = static_cast<int>(sizeof(Pickle::Header));
+            size < pickle.size(); size += 4)
+        {
+            std::string copy(data, size);
+            reinterpret_cast<Pickle::Header*>(&copy[0])->payload_size =
+                static_cast<uint32>(size - sizeof(Pickle::Header));
+            Pickle truncated(copy.data(), size);
+            base::PickleValueSerializer serializer(&truncated);
+            int error_code = 0;
+            std::string error;
+            scoped_ptr<base::Value> value(
+                serializer.Deserialize(&error_code, &error));
+            EXPECT(value.get() == NULL);
+            EXPECT(error_code ==
+                base::PickleValueSerializer::kErrorMalformedData);
+            EXPECT(!error.empty());
+        }
+
+        // Lists nested one deeper than allowed.
+        Pickle nested;
+        for (int i = 0; i <= base::PickleValueSerializer::kMaxDepth; ++i)
+        {
+            nested.WriteInt(base::Value::TYPE_LIST);
+            nested.WriteInt(1);
+        }
+        nested.WriteInt(base::Value::TYPE_NULL);
+        void* iter = NULL;
+        scoped_ptr<base::Value> value(
+            base::PickleValueSerializer::ReadValue(nested, &iter));
+        EXPECT(value.get() == NULL);
+    }
+
+}
+
+void RunPickleTests()
+{
+    TestBuilderMatchesPickle();
+    TestStringPieceAliases();
+    TestValueRoundTrip();
+    TestMalformed();
+}
@@ -0,0 +1,297 @@
+#include "pickle_value_serializer.h"
+
+#include "memory/scoped_ptr.h"
+#include "pickle.h"
+
+namespace
+{
+
+    bool WriteDouble(double value, Pickle* pickle)
+    {
+        return pickle->WriteBytes(&value, sizeof(value));
+    }
+
+    bool WriteDouble(double value, PickleBuilder* builder)
+    {
+        return builder->WriteBytes(&value, sizeof(value));
+    }
+
+    bool WriteLargeData(const char* data, size_t length, Pickle* pickle)
+    {
+        return pickle->WriteData(data, static_cast<int>(length));
+    }
+
+    bool WriteLargeData(const char* data, size_t length,
+        PickleBuilder* builder)
+    {
+        return builder->WriteDataByReference(data, static_cast<int>(length));
+    }
+
+    // Pickle and PickleBuilder share their writers, so one walk serves both.
+    template<class Writer>
+    bool WriteValueTo(const base::Value& value, Writer* writer)
+    {
+        if (!writer->WriteInt(value.GetType()))
+        {
+            return false;
+        }
+
+        switch (value.GetType())
+        {
+        case base::Value::TYPE_NULL:
+            return true;
+
+        case base::Value::TYPE_BOOLEAN:
+        {
+            bool boolean_value = false;
+            value.GetAsBoolean(&boolean_value);
+            return writer->WriteBool(boolean_value);
+        }
+
+        case base::Value::TYPE_INTEGER:
+        {
+            int integer_value = 0;
+            value.GetAsInteger(&integer_value);
+            return writer->WriteInt(integer_value);
+        }
+
+        case base::Value::TYPE_DOUBLE:
+        {
+            double double_value = 0;
+            value.GetAsDouble(&double_value);
+            return WriteDouble(double_value, writer);
+        }
+
+        case base::Value::TYPE_STRING:
+        {
+            const std::string& string_value =
+                static_cast<const base::StringValue&>(value).GetString();
+            return WriteLargeData(string_value.data(), string_value.size(),
+                writer);
+        }
+
+        case base::Value::TYPE_BINARY:
+        {
+            const base::BinaryValue& binary =
+                static_cast<const base::BinaryValue&>(value);
+            return WriteLargeData(binary.GetBuffer(), binary.GetSize(), writer);
+        }
+
+        case base::Value::TYPE_LIST:
+        {
+            const base::ListValue& list =
+                static_cast<const base::ListValue&>(value);
+            if (!writer->WriteInt(static_cast<int>(list.GetSize())))
+            {
+                return false;
+            }
+            for (base::ListValue::const_iterator it = list.begin();
+                it != list.end(); ++it)
+            {
+                if (!WriteValueTo(**it, writer))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        case base::Value::TYPE_DICTIONARY:
+        {
+            const base::DictionaryValue& dictionary =
+                static_cast<const base::DictionaryValue&>(value);
+            if (!writer->WriteInt(static_cast<int>(dictionary.size())))
+            {
+                return false;
+            }
+            for (base::DictionaryValue::key_iterator it =
+                dictionary.begin_keys(); it != dictionary.end_keys(); ++it)
+            {
+                base::Value* child = NULL;
+                dictionary.GetWithoutPathExpansion(*it, &child);
+                if (!writer->WriteString(*it) || !WriteValueTo(*child, writer))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        default:
+            NOTREACHED();
+            return false;
+        }
+    }
+
+    base::Value* ReadValueFrom(const Pickle& pickle, void** iter, int depth)
+    {
+        int type;
+        if (!pickle.ReadInt(iter, &type))
+        {
+            return NULL;
+        }
+
+        switch (type)
+        {
+        case base::Value::TYPE_NULL:
+            return base::Value::CreateNullValue();
+
+        case base::Value::TYPE_BOOLEAN:
+        {
+            bool value;
+            if (!pickle.ReadBool(iter, &value))
+            {
+                return NULL;
+            }
+            return base::Value::CreateBooleanValue(value);
+        }
+
+        case base::Value::TYPE_INTEGER:
+        {
+            int value;
+            if (!pickle.ReadInt(iter, &value))
+            {
+                return NULL;
+            }
+            return base::Value::CreateIntegerValue(value);
+        }
+
+        case base::Value::TYPE_DOUBLE:
+        {
+            const char* data;
+            if (!pickle.ReadBytes(iter, &data, sizeof(double)))
+            {
+                return NULL;
+            }
+            double value;
+            memcpy(&value, data, sizeof(value));
+            return base::Value::CreateDoubleValue(value);
+        }
+
+        case base::Value::TYPE_STRING:
+        {
+            base::StringPiece value;
+            if (!pickle.ReadStringPiece(iter, &value))
+            {
+                return NULL;
+            }
+            return base::Value::CreateStringValue(value.as_string());
+        }
+
+        case base::Value::TYPE_BINARY:
+        {
+            const char* data;
+            int length;
+            if (!pickle.ReadData(iter, &data, &length))
+            {
+                return NULL;
+            }
+            return base::BinaryValue::CreateWithCopiedBuffer(data, length);
+        }
+
+        case base::Value::TYPE_LIST:
+        {
+            int size;
+            if (depth >= base::PickleValueSerializer::kMaxDepth ||
+                !pickle.ReadLength(iter, &size))
+            {
+                return NULL;
+            }
+            scoped_ptr<base::ListValue> list(new base::ListValue);
+            for (int i = 0; i < size; ++i)
+            {
+                base::Value* item = ReadValueFrom(pickle, iter, depth + 1);
+                if (!item)
+                {
+                    return NULL;
+                }
+                list->Append(item);
+            }
+            return list.release();
+        }
+
+        case base::Value::TYPE_DICTIONARY:
+        {
+            int size;
+            if (depth >= base::PickleValueSerializer::kMaxDepth ||
+                !pickle.ReadLength(iter, &size))
+            {
+                return NULL;
+            }
+            scoped_ptr<base::DictionaryValue> dictionary(
+                new base::DictionaryValue);
+            for (int i = 0; i < size; ++i)
+            {
+                base::StringPiece key;
+                if (!pickle.ReadStringPiece(iter, &key))
+                {
+                    return NULL;
+                }
+                base::Value* value = ReadValueFrom(pickle, iter, depth + 1);
+                if (!value)
+                {
+                    return NULL;
+                }
+                dictionary->SetWithoutPathExpansion(key.as_string(), value);
+            }
+            return dictionary.release();
+        }
+
+        default:
+            return NULL;
+        }
+    }
+
+}
+
+namespace base
+{
+
+    PickleValueSerializer::PickleValueSerializer(Pickle* pickle)
+        : pickle_(pickle), read_iter_(NULL) {}
+
+    PickleValueSerializer::~PickleValueSerializer() {}
+
+    bool PickleValueSerializer::Serialize(const Value& root)
+    {
+        return WriteValue(root, pickle_);
+    }
+
+    Value* PickleValueSerializer::Deserialize(int* error_code,
+        std::string* error_str)
+    {
+        Value* value = ReadValue(*pickle_, &read_iter_);
+        if (!value)
+        {
+            if (error_code)
+            {
+                *error_code = kErrorMalformedData;
+            }
+            if (error_str)
+            {
+                *error_str = "Malformed pickled value.";
+            }
+        }
+        return value;
+    }
+
+    // static
+    bool PickleValueSerializer::WriteValue(const Value& value, Pickle* pickle)
+    {
+        return WriteValueTo(value, pickle);
+    }
+
+    // static
+    bool PickleValueSerializer::WriteValue(const Value& value,
+        PickleBuilder* builder)
+    {
+        return WriteValueTo(value, builder);
+    }
+
+    // static
+    Value* PickleValueSerializer::ReadValue(const Pickle& pickle, void** iter)
+    {
+        return ReadValueFrom(pickle, iter, 0);
+    }
+
+} //namespace base
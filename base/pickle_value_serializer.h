@@ -0,0 +1,57 @@
+#ifndef __base_pickle_value_serializer_h__
+#define __base_pickle_value_serializer_h__
+
+#include <string>
+
+#include "value.h"
+
+class Pickle;
+class PickleBuilder;
+
+namespace base
+{
+
+    // Stores Value trees in pickles in a compact binary form: a type tag per
+    // value, then its contents; lists and dictionaries are prefixed by their
+    // size.  Much cheaper than going through JSON, but only meant for data
+    // that is read back by the same build, e.g. undo snapshots or the
+    // clipboard.
+    class PickleValueSerializer : public ValueSerializer
+    {
+    public:
+        // Error code reported by Deserialize().
+        static const int kErrorMalformedData = 1;
+
+        // Containers may not nest deeper than this on reading.
+        static const int kMaxDepth = 100;
+
+        // Serialize() appends to |pickle| and Deserialize() reads the values
+        // in it one after another.  |pickle| must outlive the serializer.
+        explicit PickleValueSerializer(Pickle* pickle);
+        virtual ~PickleValueSerializer();
+
+        // Overridden from ValueSerializer:
+        virtual bool Serialize(const Value& root);
+        virtual Value* Deserialize(int* error_code, std::string* error_str);
+
+        static bool WriteValue(const Value& value, Pickle* pickle);
+
+        // Strings and binary values of at least
+        // PickleBuilder::kMinReferenceSize bytes are added by reference, so
+        // |value| must outlive the use of |builder|.
+        static bool WriteValue(const Value& value, PickleBuilder* builder);
+
+        // Reads a value written by WriteValue() at |iter|.  Returns NULL if
+        // the data is malformed.  The caller owns the result.
+        static Value* ReadValue(const Pickle& pickle, void** iter);
+
+    private:
+        Pickle* pickle_;
+        void* read_iter_;
+
+        DISALLOW_COPY_AND_ASSIGN(PickleValueSerializer);
+    };
+
+} //namespace base
+
+#endif //__base_pickle_value_serializer_h__
@@ -99,6 +99,10 @@ namespace base
         {
             create_flags |= FILE_FLAG_DELETE_ON_CLOSE;
         }
+        if (flags & PLATFORM_FILE_SEQUENTIAL_SCAN)
+        {
+            create_flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        }
 
         HANDLE file = CreateFile(name.value().c_str(), access, sharing,
             NULL, disposition, create_flags, NULL);
@@ -29,6 +29,8 @@ namespace base
         PLATFORM_FILE_WRITE_ATTRIBUTES = 8192, 
 
         PLATFORM_FILE_SHARE_DELETE = 32768,  
+
+        PLATFORM_FILE_SEQUENTIAL_SCAN = 65536, // Hint: read front to back.
     };
 
     enum PlatformFileError
@@ -1,7 +1,10 @@
 #include "string_number_conversions.h"
 
+#include <locale.h>
+
 #include <limits>
 
+#include "lazy_instance.h"
 #include "logging.h"
 
 namespace base
@@ -417,10 +420,30 @@ namespace base
             IntToString(value);
     }
 
+    namespace
+    {
+
+        struct CLocaleHolder
+        {
+            CLocaleHolder() : locale(_create_locale(LC_NUMERIC, "C")) {}
+
+            _locale_t locale;
+        };
+
+        LazyInstance<CLocaleHolder, LeakyLazyInstanceTraits<CLocaleHolder> >
+            c_locale(LINKER_INITIALIZED);
+
+    }
+
+    _locale_t CLocale()
+    {
+        return c_locale.Get().locale;
+    }
+
     std::string DoubleToString(double value)
     {
         char buffer[32];
-        sprintf_s(buffer, 32, "%f", value);
+        _sprintf_s_l(buffer, 32, "%f", CLocale(), value);
         return std::string(buffer);
     }
 
@@ -508,7 +531,7 @@ namespace base
     {
         errno = 0; // Thread-safe?  It is on at least Mac, Linux, and Windows.
         char* endptr = NULL;
-        *output = strtod(input.c_str(), &endptr);
+        *output = _strtod_l(input.c_str(), &endptr, CLocale());
 
         // Cases to return false:
         //  - If errno is ERANGE, there was an overflow or underflow.
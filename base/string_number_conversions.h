@@ -1,6 +1,8 @@
 #ifndef __base_string_number_conversions_h__
 #define __base_string_number_conversions_h__
 
+#include <stdlib.h>
+
 #include <string>
 #include <vector>
 
@@ -21,6 +23,12 @@ namespace base
     std::string Uint64ToString(uint64 value);
     string16 Uint64ToString16(uint64 value);
 
+    // The "C" locale, for the _l variants of the CRT number functions.
+    // DoubleToString(), StringToDouble() and the JSON reader and writer use
+    // it so that a double is always written and read with a '.', whatever
+    // locale the process has set.
+    _locale_t CLocale();
+
     std::string DoubleToString(double value);
 
     bool StringToInt(const std::string& input, int* output);
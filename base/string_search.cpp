@@ -0,0 +1,527 @@
+#include "string_search.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <intrin.h>
+#include <string.h>
+
+#include <queue>
+
+#include "cpu.h"
+#include "logging.h"
+
+#pragma intrinsic(_BitScanForward)
+
+// The single pattern searches scan with SSE2, which every target of this
+// tree has, or with AVX2 where HasAVX2() has seen the CPU support it.  The
+// AVX2 loops stop where fewer than 32 bytes are left and the SSE2 ones
+// carry on from there.
+
+namespace
+{
+
+    bool HasAVX2()
+    {
+        static const bool has_avx2 = base::CPU().has_avx2() != 0;
+        return has_avx2;
+    }
+
+    template<typename Char>
+    inline Char FoldASCII(Char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<Char>(c + ('a' - 'A')) : c;
+    }
+
+    template<typename Char>
+    inline bool IsLowerASCIILetter(Char c)
+    {
+        return c >= 'a' && c <= 'z';
+    }
+
+    template<typename Char>
+    bool EqualsAt(const Char* a, const Char* b, size_t length,
+        bool ignore_case)
+    {
+        if (!ignore_case)
+        {
+            return memcmp(a, b, length * sizeof(Char)) == 0;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (FoldASCII(a[i]) != FoldASCII(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Checks positions [from, last] one at a time.
+    template<typename Char>
+    size_t FindScalar(const Char* haystack, const Char* needle, size_t length,
+        size_t from, size_t last, bool ignore_case)
+    {
+        for (size_t i = from; i <= last; ++i)
+        {
+            if (EqualsAt(haystack + i, needle, length, ignore_case))
+            {
+                return i;
+            }
+        }
+        return base::StringPiece::npos;
+    }
+
+    // The block loop of FindBytes() 32 positions at a time.  |first| and
+    // |last| are folded already; |first_case| and |last_case| are 0x20 where
+    // they are letters to match in either case.  Returns the match, or npos
+    // with |*from| at the first position left to check.
+    size_t FindBytesAVX2(const char* haystack, size_t haystack_length,
+        const char* needle, size_t length, char first, char last,
+        char first_case, char last_case, bool ignore_case, size_t* from)
+    {
+        const __m256i first_chars = _mm256_set1_epi8(first);
+        const __m256i last_chars = _mm256_set1_epi8(last);
+        const __m256i first_fold = _mm256_set1_epi8(first_case);
+        const __m256i last_fold = _mm256_set1_epi8(last_case);
+
+        size_t i = *from;
+        for (; i + length - 1 + 32 <= haystack_length; i += 32)
+        {
+            __m256i block_first = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(haystack + i));
+            __m256i block_last = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(haystack + i + length - 1));
+            __m256i match = _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_or_si256(block_first, first_fold),
+                first_chars),
+                _mm256_cmpeq_epi8(_mm256_or_si256(block_last, last_fold),
+                last_chars));
+            unsigned int mask =
+                static_cast<unsigned int>(_mm256_movemask_epi8(match));
+            while (mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                if (length <= 2 || EqualsAt(haystack + i + bit + 1, needle + 1,
+                    length - 2, ignore_case))
+                {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        *from = i;
+        return base::StringPiece::npos;
+    }
+
+    // FindBytesAVX2() for UTF-16, 16 positions at a time.
+    size_t FindChar16sAVX2(const char16* haystack, size_t haystack_length,
+        const char16* needle, size_t length, char16 first, char16 last,
+        char16 first_case, char16 last_case, bool ignore_case, size_t* from)
+    {
+        const __m256i first_chars =
+            _mm256_set1_epi16(static_cast<short>(first));
+        const __m256i last_chars = _mm256_set1_epi16(static_cast<short>(last));
+        const __m256i first_fold =
+            _mm256_set1_epi16(static_cast<short>(first_case));
+        const __m256i last_fold =
+            _mm256_set1_epi16(static_cast<short>(last_case));
+
+        size_t i = *from;
+        for (; i + length - 1 + 16 <= haystack_length; i += 16)
+        {
+            __m256i block_first = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(haystack + i));
+            __m256i block_last = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(haystack + i + length - 1));
+            __m256i match = _mm256_and_si256(
+                _mm256_cmpeq_epi16(_mm256_or_si256(block_first, first_fold),
+                first_chars),
+                _mm256_cmpeq_epi16(_mm256_or_si256(block_last, last_fold),
+                last_chars));
+            // Two mask bits per character.
+            unsigned int mask =
+                static_cast<unsigned int>(_mm256_movemask_epi8(match));
+            while (mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                size_t position = i + bit / 2;
+                if (length <= 2 || EqualsAt(haystack + position + 1,
+                    needle + 1, length - 2, ignore_case))
+                {
+                    return position;
+                }
+                mask &= ~(3u << bit);
+            }
+        }
+        *from = i;
+        return base::StringPiece::npos;
+    }
+
+    // For a letter |c| in a-z, (x | 0x20) == c holds exactly for x == c and
+    // x == c - 0x20, which folds case in the comparison itself.  Other
+    // characters are compared as they are.
+    size_t FindBytes(const char* haystack, size_t haystack_length,
+        const char* needle, size_t length, size_t from, bool ignore_case)
+    {
+        if (length == 0)
+        {
+            return from <= haystack_length ? from : base::StringPiece::npos;
+        }
+        if (length > haystack_length || from > haystack_length - length)
+        {
+            return base::StringPiece::npos;
+        }
+
+        char first = needle[0];
+        char last = needle[length - 1];
+        char first_case = 0;
+        char last_case = 0;
+        if (ignore_case)
+        {
+            first = FoldASCII(first);
+            last = FoldASCII(last);
+            first_case = IsLowerASCIILetter(first) ? 0x20 : 0;
+            last_case = IsLowerASCIILetter(last) ? 0x20 : 0;
+        }
+
+        size_t i = from;
+        if (HasAVX2())
+        {
+            size_t found = FindBytesAVX2(haystack, haystack_length, needle,
+                length, first, last, first_case, last_case, ignore_case, &i);
+            if (found != base::StringPiece::npos)
+            {
+                return found;
+            }
+        }
+
+        const __m128i first_chars = _mm_set1_epi8(first);
+        const __m128i last_chars = _mm_set1_epi8(last);
+        const __m128i first_fold = _mm_set1_epi8(first_case);
+        const __m128i last_fold = _mm_set1_epi8(last_case);
+        for (; i + length - 1 + 16 <= haystack_length; i += 16)
+        {
+            __m128i block_first = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(haystack + i));
+            __m128i block_last = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(haystack + i + length - 1));
+            __m128i match = _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_or_si128(block_first, first_fold),
+                first_chars),
+                _mm_cmpeq_epi8(_mm_or_si128(block_last, last_fold),
+                last_chars));
+            unsigned int mask = _mm_movemask_epi8(match);
+            while (mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                if (length <= 2 || EqualsAt(haystack + i + bit + 1, needle + 1,
+                    length - 2, ignore_case))
+                {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return FindScalar(haystack, needle, length, i, haystack_length - length,
+            ignore_case);
+    }
+
+    size_t FindChar16s(const char16* haystack, size_t haystack_length,
+        const char16* needle, size_t length, size_t from, bool ignore_case)
+    {
+        if (length == 0)
+        {
+            return from <= haystack_length ? from : base::StringPiece::npos;
+        }
+        if (length > haystack_length || from > haystack_length - length)
+        {
+            return base::StringPiece::npos;
+        }
+
+        char16 first = needle[0];
+        char16 last = needle[length - 1];
+        char16 first_case = 0;
+        char16 last_case = 0;
+        if (ignore_case)
+        {
+            first = FoldASCII(first);
+            last = FoldASCII(last);
+            first_case = IsLowerASCIILetter(first) ? 0x20 : 0;
+            last_case = IsLowerASCIILetter(last) ? 0x20 : 0;
+        }
+
+        size_t i = from;
+        if (HasAVX2())
+        {
+            size_t found = FindChar16sAVX2(haystack, haystack_length, needle,
+                length, first, last, first_case, last_case, ignore_case, &i);
+            if (found != base::StringPiece::npos)
+            {
+                return found;
+            }
+        }
+
+        const __m128i first_chars = _mm_set1_epi16(static_cast<short>(first));
+        const __m128i last_chars = _mm_set1_epi16(static_cast<short>(last));
+        const __m128i first_fold =
+            _mm_set1_epi16(static_cast<short>(first_case));
+        const __m128i last_fold = _mm_set1_epi16(static_cast<short>(last_case));
+        for (; i + length - 1 + 8 <= haystack_length; i += 8)
+        {
+            __m128i block_first = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(haystack + i));
+            __m128i block_last = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(haystack + i + length - 1));
+            __m128i match = _mm_and_si128(
+                _mm_cmpeq_epi16(_mm_or_si128(block_first, first_fold),
+                first_chars),
+                _mm_cmpeq_epi16(_mm_or_si128(block_last, last_fold),
+                last_chars));
+            // Two mask bits per character.
+            unsigned int mask = _mm_movemask_epi8(match);
+            while (mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                size_t position = i + bit / 2;
+                if (length <= 2 || EqualsAt(haystack + position + 1,
+                    needle + 1, length - 2, ignore_case))
+                {
+                    return position;
+                }
+                mask &= ~(3u << bit);
+            }
+        }
+        return FindScalar(haystack, needle, length, i, haystack_length - length,
+            ignore_case);
+    }
+
+    class CollectMatches
+    {
+    public:
+        explicit CollectMatches(
+            std::vector<base::MultiStringSearcher::Match>* matches)
+            : matches_(matches) {}
+
+        bool OnMatch(const base::MultiStringSearcher::Match& match)
+        {
+            matches_->push_back(match);
+            return true;
+        }
+
+    private:
+        std::vector<base::MultiStringSearcher::Match>* matches_;
+    };
+
+    class FirstMatch
+    {
+    public:
+        explicit FirstMatch(base::MultiStringSearcher::Match* match)
+            : match_(match), found_(false) {}
+
+        bool OnMatch(const base::MultiStringSearcher::Match& match)
+        {
+            *match_ = match;
+            found_ = true;
+            return false;
+        }
+
+        bool found() const { return found_; }
+
+    private:
+        base::MultiStringSearcher::Match* match_;
+        bool found_;
+    };
+
+}
+
+namespace base
+{
+
+    size_t FindString(const StringPiece& haystack, const StringPiece& needle,
+        size_t from)
+    {
+        return FindBytes(haystack.data(), haystack.size(), needle.data(),
+            needle.size(), from, false);
+    }
+
+    size_t FindString(const StringPiece16& haystack,
+        const StringPiece16& needle, size_t from)
+    {
+        return FindChar16s(haystack.data(), haystack.size(), needle.data(),
+            needle.size(), from, false);
+    }
+
+    size_t FindStringIgnoringASCIICase(const StringPiece& haystack,
+        const StringPiece& needle, size_t from)
+    {
+        return FindBytes(haystack.data(), haystack.size(), needle.data(),
+            needle.size(), from, true);
+    }
+
+    size_t FindStringIgnoringASCIICase(const StringPiece16& haystack,
+        const StringPiece16& needle, size_t from)
+    {
+        return FindChar16s(haystack.data(), haystack.size(), needle.data(),
+            needle.size(), from, true);
+    }
+
+    MultiStringSearcher::MultiStringSearcher(
+        const std::vector<std::string>& patterns, bool ignore_ascii_case)
+        : next_(kAlphabetSize, -1),
+        output_(1, -1),
+        output_link_(1, -1)
+    {
+        // Build the trie.
+        for (size_t i = 0; i < patterns.size(); ++i)
+        {
+            const std::string& pattern = patterns[i];
+            pattern_lengths_.push_back(pattern.size());
+            if (pattern.empty())
+            {
+                continue;
+            }
+
+            int32 state = 0;
+            for (size_t j = 0; j < pattern.size(); ++j)
+            {
+                unsigned char c = static_cast<unsigned char>(pattern[j]);
+                if (ignore_ascii_case)
+                {
+                    c = FoldASCII(c);
+                }
+                size_t index = state * kAlphabetSize + c;
+                if (next_[index] < 0)
+                {
+                    next_[index] = static_cast<int32>(output_.size());
+                    next_.resize(next_.size() + kAlphabetSize, -1);
+                    output_.push_back(-1);
+                    output_link_.push_back(-1);
+                }
+                state = next_[index];
+            }
+            if (output_[state] < 0)
+            {
+                output_[state] = static_cast<int32>(i);
+            }
+        }
+
+        // Complete the transitions breadth first, turning the trie into an
+        // automaton: a missing transition goes where the failure state would.
+        std::vector<int32> failure(output_.size(), 0);
+        std::queue<int32> states;
+        for (int c = 0; c < kAlphabetSize; ++c)
+        {
+            int32& next = next_[c];
+            if (next < 0)
+            {
+                next = 0;
+            }
+            else
+            {
+                states.push(next);
+            }
+        }
+        while (!states.empty())
+        {
+            int32 state = states.front();
+            states.pop();
+            int32 fail = failure[state];
+            for (int c = 0; c < kAlphabetSize; ++c)
+            {
+                int32& next = next_[state * kAlphabetSize + c];
+                int32 fail_next = next_[fail * kAlphabetSize + c];
+                if (next < 0)
+                {
+                    next = fail_next;
+                    continue;
+                }
+                failure[next] = fail_next;
+                output_link_[next] = output_[fail_next] >= 0 ? fail_next :
+                    output_link_[fail_next];
+                states.push(next);
+            }
+        }
+
+        // Patterns were added folded; upper case letters move like lower case
+        // ones.
+        if (ignore_ascii_case)
+        {
+            for (size_t state = 0; state < output_.size(); ++state)
+            {
+                int32* row = &next_[state * kAlphabetSize];
+                for (int c = 'A'; c <= 'Z'; ++c)
+                {
+                    row[c] = row[c + ('a' - 'A')];
+                }
+            }
+        }
+
+        for (int c = 0; c < kAlphabetSize; ++c)
+        {
+            starts_pattern_[c] = next_[c] != 0;
+        }
+    }
+
+    MultiStringSearcher::~MultiStringSearcher() {}
+
+    template<typename Callback>
+    void MultiStringSearcher::Search(const StringPiece& text,
+        Callback* callback) const
+    {
+        const unsigned char* data =
+            reinterpret_cast<const unsigned char*>(text.data());
+        size_t size = text.size();
+        int32 state = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (state == 0)
+            {
+                // Most text does not start a pattern; skip it without
+                // touching the table.
+                while (i < size && !starts_pattern_[data[i]])
+                {
+                    ++i;
+                }
+                if (i == size)
+                {
+                    return;
+                }
+            }
+
+            state = next_[state * kAlphabetSize + data[i]];
+            int32 found = output_[state] >= 0 ? state : output_link_[state];
+            while (found >= 0)
+            {
+                Match match;
+                match.pattern = output_[found];
+                match.length = pattern_lengths_[match.pattern];
+                match.offset = i + 1 - match.length;
+                if (!callback->OnMatch(match))
+                {
+                    return;
+                }
+                found = output_link_[found];
+            }
+        }
+    }
+
+    void MultiStringSearcher::FindAll(const StringPiece& text,
+        std::vector<Match>* matches) const
+    {
+        CollectMatches collect(matches);
+        Search(text, &collect);
+    }
+
+    bool MultiStringSearcher::FindFirst(const StringPiece& text,
+        Match* match) const
+    {
+        FirstMatch first(match);
+        Search(text, &first);
+        return first.found();
+    }
+
+} //namespace base
@@ -0,0 +1,86 @@
+#ifndef __base_string_search_h__
+#define __base_string_search_h__
+
+#include <string>
+#include <vector>
+
+#include "basic_types.h"
+#include "string_piece.h"
+
+// Substring search for find/replace and find in files.  The single pattern
+// searches scan 16 bytes at a time with SSE2, or 32 with AVX2 where the CPU
+// has it, comparing the first and the last character of the needle at every
+// position at once and only checking the rest where both match.  The IgnoringASCIICase variants fold A-Z to a-z
+// on the fly instead of lowering copies of the strings; all other characters,
+// including every byte of a UTF-8 multibyte sequence, must match exactly.
+//
+// All of them return the offset of the first match at or after |from|, or
+// StringPiece::npos.  An empty needle matches at |from|.
+
+namespace base
+{
+
+    size_t FindString(const StringPiece& haystack, const StringPiece& needle,
+        size_t from);
+    size_t FindString(const StringPiece16& haystack,
+        const StringPiece16& needle, size_t from);
+
+    size_t FindStringIgnoringASCIICase(const StringPiece& haystack,
+        const StringPiece& needle, size_t from);
+    size_t FindStringIgnoringASCIICase(const StringPiece16& haystack,
+        const StringPiece16& needle, size_t from);
+
+    // Searches UTF-8 text for many patterns in one pass (Aho-Corasick), so
+    // the cost does not grow with the number of patterns.  The automaton is
+    // built once in the constructor; searching is const and may run on
+    // several threads at once.
+    class MultiStringSearcher
+    {
+    public:
+        struct Match
+        {
+            size_t offset;
+            size_t length;
+            // Index into the patterns given to the constructor.
+            size_t pattern;
+        };
+
+        // Empty patterns never match.  Of identical patterns only the first
+        // is reported.
+        MultiStringSearcher(const std::vector<std::string>& patterns,
+            bool ignore_ascii_case);
+        ~MultiStringSearcher();
+
+        // Appends every occurrence of every pattern in |text|, overlapping
+        // ones included, ordered by where they end; longer matches first
+        // among those ending at the same offset.
+        void FindAll(const StringPiece& text, std::vector<Match>* matches) const;
+
+        // Finds the match that ends first.  Returns false if there is none.
+        bool FindFirst(const StringPiece& text, Match* match) const;
+
+    private:
+        static const int kAlphabetSize = 256;
+
+        // Runs the automaton over |text|, reporting matches until |callback|
+        // returns false.
+        template<typename Callback>
+        void Search(const StringPiece& text, Callback* callback) const;
+
+        // Transition table, kAlphabetSize entries per state; state 0 is the
+        // root.  It is complete, so the search never follows failure links.
+        std::vector<int32> next_;
+        // Pattern recognized in each state, or -1.
+        std::vector<int32> output_;
+        // Next state along the failure chain that recognizes a pattern, or -1.
+        std::vector<int32> output_link_;
+        std::vector<size_t> pattern_lengths_;
+        // Bytes that leave the root state.
+        bool starts_pattern_[kAlphabetSize];
+
+        DISALLOW_COPY_AND_ASSIGN(MultiStringSearcher);
+    };
+
+} //namespace base
+
+#endif //__base_string_search_h__
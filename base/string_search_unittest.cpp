@@ -0,0 +1,234 @@
+// Checks FindString() and FindStringIgnoringASCIICase() in both widths
+// against a search one position at a time, on random text long enough to
+// go through the AVX2, the SSE2 and the scalar loops and with matches
+// placed across every block edge and at the very end of the text; that
+// case folding is limited to A-Z; and that MultiStringSearcher reports
+// every match, in the documented order, as a search per pattern would.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/string16.h"
+#include "base/string_search.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    // Letters in both cases, the characters either side of them that
+    // differ from a letter only in bit 0x20, and a UTF-8 lead byte.
+    const char kAlphabet[] = "abAB@`[{\xC3\xE3";
+
+    std::string RandomText(size_t length)
+    {
+        std::string text;
+        for (size_t i = 0; i < length; ++i)
+        {
+            text += kAlphabet[Random(arraysize(kAlphabet) - 1)];
+        }
+        return text;
+    }
+
+    template<typename Char>
+    Char Fold(Char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<Char>(c + ('a' - 'A')) : c;
+    }
+
+    template<typename String>
+    size_t ReferenceFind(const String& haystack, const String& needle,
+        size_t from, bool ignore_case)
+    {
+        if (needle.empty())
+        {
+            return from <= haystack.size() ? from : base::StringPiece::npos;
+        }
+        for (size_t i = from; i + needle.size() <= haystack.size(); ++i)
+        {
+            size_t j = 0;
+            while (j < needle.size() && (ignore_case ?
+                Fold(haystack[i + j]) == Fold(needle[j]) :
+                haystack[i + j] == needle[j]))
+            {
+                ++j;
+            }
+            if (j == needle.size())
+            {
+                return i;
+            }
+        }
+        return base::StringPiece::npos;
+    }
+
+    string16 Widen(const std::string& text)
+    {
+        string16 wide;
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            wide += static_cast<char16>(static_cast<unsigned char>(text[i]));
+        }
+        return wide;
+    }
+
+    // Both widths, both cases, from every offset up to |haystack| ends.
+    void ExpectSameAsReference(const std::string& haystack,
+        const std::string& needle)
+    {
+        string16 haystack16 = Widen(haystack);
+        string16 needle16 = Widen(needle);
+        for (size_t from = 0; from <= haystack.size() + 1; ++from)
+        {
+            EXPECT(base::FindString(haystack, needle, from) ==
+                ReferenceFind(haystack, needle, from, false));
+            EXPECT(base::FindStringIgnoringASCIICase(haystack, needle, from) ==
+                ReferenceFind(haystack, needle, from, true));
+            EXPECT(base::FindString(base::StringPiece16(haystack16),
+                base::StringPiece16(needle16), from) ==
+                ReferenceFind(haystack16, needle16, from, false));
+            EXPECT(base::FindStringIgnoringASCIICase(
+                base::StringPiece16(haystack16),
+                base::StringPiece16(needle16), from) ==
+                ReferenceFind(haystack16, needle16, from, true));
+        }
+    }
+
+    void TestRandom()
+    {
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string haystack = RandomText(Random(160));
+            std::string needle = RandomText(Random(6));
+            ExpectSameAsReference(haystack, needle);
+        }
+    }
+
+    void TestBlockEdges()
+    {
+        // A needle that occurs once, starting at every offset of a text that
+        // is otherwise filler, and ending exactly at its end, so that the
+        // last block checked is the one with the match.
+        const char* const kNeedles[] = { "x", "xy", "xyz", "xQQQQQQQQQQQQy" };
+        for (size_t i = 0; i < arraysize(kNeedles); ++i)
+        {
+            std::string needle(kNeedles[i]);
+            for (size_t length = needle.size(); length <= 100; ++length)
+            {
+                for (size_t at = 0; at + needle.size() <= length; ++at)
+                {
+                    std::string haystack(length, '.');
+                    haystack.replace(at, needle.size(), needle);
+                    EXPECT(base::FindString(haystack, needle, 0) == at);
+                    EXPECT(base::FindString(base::StringPiece16(
+                        Widen(haystack)), base::StringPiece16(Widen(needle)),
+                        0) == at);
+                }
+            }
+        }
+    }
+
+    void TestCaseFolding()
+    {
+        EXPECT(base::FindStringIgnoringASCIICase("xxHeLLo", "hello", 0) == 2);
+        // Characters that differ from a letter in bit 0x20 only.
+        EXPECT(base::FindStringIgnoringASCIICase("@[\\]^_", "`{|}~\x7F", 0) ==
+            base::StringPiece::npos);
+        // UTF-8 bytes must match exactly: no folding of U+00C9 to U+00E9.
+        EXPECT(base::FindStringIgnoringASCIICase("caf\xC3\x89", "caf\xC3\xA9",
+            0) == base::StringPiece::npos);
+        EXPECT(base::FindStringIgnoringASCIICase("CAF\xC3\xA9", "caf\xC3\xA9",
+            0) == 0);
+    }
+
+    struct MatchLess
+    {
+        bool operator()(const base::MultiStringSearcher::Match& a,
+            const base::MultiStringSearcher::Match& b) const
+        {
+            size_t a_end = a.offset + a.length;
+            size_t b_end = b.offset + b.length;
+            return a_end != b_end ? a_end < b_end : a.length > b.length;
+        }
+    };
+
+    void TestMultiStringSearcher()
+    {
+        for (int round = 0; round < 500; ++round)
+        {
+            bool ignore_case = round % 2 != 0;
+            std::vector<std::string> patterns;
+            for (unsigned int i = Random(20); i > 0; --i)
+            {
+                patterns.push_back(RandomText(Random(5)));
+            }
+            std::string text = RandomText(Random(300));
+
+            // Each pattern found on its own, skipping repeats of an earlier
+            // pattern.
+            std::vector<base::MultiStringSearcher::Match> expected;
+            for (size_t i = 0; i < patterns.size(); ++i)
+            {
+                bool repeat = patterns[i].empty();
+                for (size_t j = 0; j < i && !repeat; ++j)
+                {
+                    repeat = ignore_case ?
+                        base::FindStringIgnoringASCIICase(patterns[j],
+                        patterns[i], 0) == 0 &&
+                        patterns[j].size() == patterns[i].size() :
+                        patterns[j] == patterns[i];
+                }
+                for (size_t at = 0; !repeat; ++at)
+                {
+                    at = ReferenceFind(text, patterns[i], at, ignore_case);
+                    if (at == base::StringPiece::npos)
+                    {
+                        break;
+                    }
+                    base::MultiStringSearcher::Match match;
+                    match.offset = at;
+                    match.length = patterns[i].size();
+                    match.pattern = i;
+                    expected.push_back(match);
+                }
+            }
+            std::stable_sort(expected.begin(), expected.end(), MatchLess());
+
+            base::MultiStringSearcher searcher(patterns, ignore_case);
+            std::vector<base::MultiStringSearcher::Match> matches;
+            searcher.FindAll(text, &matches);
+            EXPECT(matches.size() == expected.size());
+            for (size_t i = 0; i < matches.size() && i < expected.size(); ++i)
+            {
+                EXPECT(matches[i].offset == expected[i].offset);
+                EXPECT(matches[i].length == expected[i].length);
+                EXPECT(matches[i].pattern == expected[i].pattern);
+            }
+
+            base::MultiStringSearcher::Match first;
+            bool found = searcher.FindFirst(text, &first);
+            EXPECT(found == !expected.empty());
+            if (found && !expected.empty())
+            {
+                EXPECT(first.offset == expected[0].offset);
+                EXPECT(first.pattern == expected[0].pattern);
+            }
+        }
+    }
+
+}
+
+void RunStringSearchTests()
+{
+    TestRandom();
+    TestBlockEdges();
+    TestCaseFolding();
+    TestMultiStringSearcher();
+}
@@ -2,6 +2,10 @@
 
 //#include "third_party/icu_base/icu_utf.h"
 
+#include <emmintrin.h>
+#include <intrin.h>
+#include <string.h>
+
 #include "logging.h"
 #include "string_util.h"
 
@@ -21,50 +25,138 @@
  */
 #define CBU16_IS_SINGLE(c) !CBU_IS_SURROGATE(c)
 
-namespace base
+#pragma intrinsic(_BitScanForward)
+
+namespace
 {
 
+    // The same sets TrimWhitespace() uses for each string type.
+    inline bool IsTrimmedWhitespace(char c)
+    {
+        return c != '\0' && strchr(kWhitespaceASCII, c) != NULL;
+    }
+
+    inline bool IsTrimmedWhitespace(wchar_t c)
+    {
+        return c != L'\0' && wcschr(kWhitespaceWide, c) != NULL;
+    }
+
     template<typename STR>
-    static void SplitStringT(const STR& str,
-        const typename STR::value_type s,
-        bool trim_whitespace,
+    STR TrimPiece(const STR& piece)
+    {
+        typename STR::const_iterator begin = piece.begin();
+        typename STR::const_iterator end = piece.end();
+        while (begin != end && IsTrimmedWhitespace(*begin))
+        {
+            ++begin;
+        }
+        while (end != begin && IsTrimmedWhitespace(*(end - 1)))
+        {
+            --end;
+        }
+        return STR(begin, end - begin);
+    }
+
+    template<typename STR, typename PIECE>
+    void AppendPiece(const PIECE& piece, bool trim_whitespace,
         std::vector<STR>* r)
     {
-        size_t last = 0;
-        size_t i;
-        size_t c = str.size();
-        for (i = 0; i <= c; ++i)
+        PIECE trimmed = trim_whitespace ? TrimPiece(piece) : piece;
+        r->push_back(STR(trimmed.begin(), trimmed.end()));
+    }
+
+    // Splits "key<delimiters>value" without copying.  |key| is set even
+    // when there is no value.
+    bool SplitKeyValuePiece(const base::StringPiece& line, char delimiter,
+        base::StringPiece* key, base::StringPiece* value)
+    {
+        const char* end = line.end();
+        const char* end_key = std::find(line.begin(), end, delimiter);
+        if (end_key == end)
         {
-            if (i == c || str[i] == s)
+            key->clear();
+            value->clear();
+            return false;
+        }
+        key->set(line.begin(), end_key - line.begin());
+
+        const char* begin_value = end_key;
+        while (begin_value != end && *begin_value == delimiter)
+        {
+            ++begin_value;
+        }
+        value->set(begin_value, end - begin_value);
+        return begin_value != end;
+    }
+
+    // Returns the offset of the first '\n' at or after |from|, or |size|.
+    size_t FindNewline(const char* data, size_t size, size_t from)
+    {
+        const __m128i newlines = _mm_set1_epi8('\n');
+        size_t i = from;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i));
+            unsigned int mask = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(block, newlines));
+            if (mask)
             {
-                size_t len = i - last;
-                STR tmp = str.substr(last, len);
-                if (trim_whitespace)
-                {
-                    STR t_tmp;
-                    TrimWhitespace(tmp, TRIM_ALL, &t_tmp);
-                    r->push_back(t_tmp);
-                }
-                else
-                {
-                    r->push_back(tmp);
-                }
-                last = i + 1;
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                return i + bit;
             }
         }
+        const void* found = memchr(data + i, '\n', size - i);
+        return found ? static_cast<const char*>(found) - data : size;
+    }
+
+}
+
+namespace base
+{
+
+    bool LineSplitter::Next()
+    {
+        if (next_ >= text_.size())
+        {
+            return false;
+        }
+        size_t end = FindNewline(text_.data(), text_.size(), next_);
+        size_t length = end - next_;
+        if (end < text_.size() && length > 0 && text_[end - 1] == '\r')
+        {
+            --length;
+        }
+        line_.set(text_.data() + next_, length);
+        next_ = end + 1;
+        return true;
+    }
+
+    template<typename PIECE, typename STR>
+    static void SplitStringT(const PIECE& str,
+        const typename STR::value_type s,
+        bool trim_whitespace,
+        std::vector<STR>* r)
+    {
+        StringPieceSplitterT<PIECE> splitter(str, s);
+        while (splitter.Next())
+        {
+            AppendPiece(splitter.piece(), trim_whitespace, r);
+        }
     }
 
     void SplitString(const std::wstring& str,
         wchar_t c, std::vector<std::wstring>* r)
     {
-        SplitStringT(str, c, true, r);
+        SplitStringT(StringPiece16(str), c, true, r);
     }
 
     void SplitString(const std::string& str,
         char c, std::vector<std::string>* r)
     {
         DCHECK(c >= 0 && c < 0x7F);
-        SplitStringT(str, c, true, r);
+        SplitStringT(StringPiece(str), c, true, r);
     }
 
     bool SplitStringIntoKeyValues(
@@ -76,25 +168,25 @@ namespace base
         key->clear();
         values->clear();
 
-        size_t end_key_pos = line.find_first_of(key_value_delimiter);
-        if (end_key_pos == std::string::npos)
+        StringPiece key_piece;
+        StringPiece value_piece;
+        bool success = SplitKeyValuePiece(line, key_value_delimiter,
+            &key_piece, &value_piece);
+        key_piece.CopyToString(*key);
+        if (!success)
         {
-            DVLOG(1) << "cannot parse key from line: " << line;
-            return false; 
-        }
-        key->assign(line, 0, end_key_pos);
-
-        std::string remains(line, end_key_pos, line.size() - end_key_pos);
-        size_t begin_values_pos = remains.find_first_not_of(key_value_delimiter);
-        if (begin_values_pos == std::string::npos)
-        {
-            DVLOG(1) << "cannot parse value from line: " << line;
-            return false; 
+            if (line.find(key_value_delimiter) == std::string::npos)
+            {
+                DVLOG(1) << "cannot parse key from line: " << line;
+            }
+            else
+            {
+                DVLOG(1) << "cannot parse value from line: " << line;
+            }
+            return false;
         }
-        std::string values_string(remains, begin_values_pos,
-            remains.size() - begin_values_pos);
 
-        values->push_back(values_string);
+        values->push_back(value_piece.as_string());
         return true;
     }
 
@@ -106,71 +198,58 @@ namespace base
     {
         kv_pairs->clear();
 
-        std::vector<std::string> pairs;
-        SplitString(line, key_value_pair_delimiter, &pairs);
-
         bool success = true;
-        for (size_t i = 0; i < pairs.size(); ++i)
+        StringPieceSplitter pairs(line, key_value_pair_delimiter);
+        while (pairs.Next())
         {
-            if (pairs[i].empty())
+            StringPiece pair = TrimPiece(pairs.piece());
+            if (pair.empty())
             {
                 continue;
             }
 
-            std::string key;
-            std::vector<std::string> value;
-            if (!SplitStringIntoKeyValues(pairs[i],
-                key_value_delimiter, &key, &value))
+            StringPiece key;
+            StringPiece value;
+            if (!SplitKeyValuePiece(pair, key_value_delimiter, &key, &value))
             {
+                DVLOG(1) << "cannot parse key value pair: " << pair.as_string();
+                value.clear();
                 success = false;
             }
-            DCHECK_LE(value.size(), 1U);
-            kv_pairs->push_back(make_pair(key, value.empty() ? "" : value[0]));
+            kv_pairs->push_back(std::make_pair(key.as_string(),
+                value.as_string()));
         }
         return success;
     }
 
-    template<typename STR>
-    static void SplitStringUsingSubstrT(const STR& str,
-        const STR& s, std::vector<STR>* r)
+    template<typename PIECE, typename STR>
+    static void SplitStringUsingSubstrT(const PIECE& str,
+        const PIECE& s, std::vector<STR>* r)
     {
-        typename STR::size_type begin_index = 0;
-        while (true)
+        StringPieceSubstrSplitterT<PIECE> splitter(str, s);
+        while (splitter.Next())
         {
-            const typename STR::size_type end_index = str.find(s, begin_index);
-            if (end_index == STR::npos)
-            {
-                const STR term = str.substr(begin_index);
-                STR tmp;
-                TrimWhitespace(term, TRIM_ALL, &tmp);
-                r->push_back(tmp);
-                return;
-            }
-            const STR term = str.substr(begin_index, end_index - begin_index);
-            STR tmp;
-            TrimWhitespace(term, TRIM_ALL, &tmp);
-            r->push_back(tmp);
-            begin_index = end_index + s.size();
+            AppendPiece(splitter.piece(), true, r);
         }
     }
 
     void SplitStringUsingSubstr(const string16& str,
         const string16& s, std::vector<string16>* r)
     {
-        SplitStringUsingSubstrT(str, s, r);
+        SplitStringUsingSubstrT(StringPiece16(str), StringPiece16(s), r);
     }
 
     void SplitStringUsingSubstr(const std::string& str,
         const std::string& s, std::vector<std::string>* r)
     {
-        SplitStringUsingSubstrT(str, s, r);
+        SplitStringUsingSubstrT(StringPiece(str), StringPiece(s), r);
     }
 
     void SplitStringDontTrim(const string16& str,
         char16 c, std::vector<string16>* r)
     {
         DCHECK(CBU16_IS_SINGLE(c));
-        SplitStringT(str, c, false, r);
+        SplitStringT(StringPiece16(str), c, false, r);
     }
 
     void SplitStringDontTrim(const std::string& str,
@@ -178,7 +257,7 @@ namespace base
     {
         DCHECK(IsStringUTF8(str));
         DCHECK(c >= 0 && c < 0x7F);
-        SplitStringT(str, c, false, r);
+        SplitStringT(StringPiece(str), c, false, r);
     }
 
 } //namespace base
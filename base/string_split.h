@@ -1,11 +1,181 @@
 #ifndef __base_string_split_h__
 #define __base_string_split_h__
 
+#include <algorithm>
 #include <vector>
+
 #include "string16.h"
+#include "string_piece.h"
+#include "string_search.h"
+
+// The SplitString family copies every piece into a new string.  The classes
+// below walk the same pieces as StringPiece or StringPiece16 views into the
+// input instead, without allocating:
+//
+//   base::StringPieceSplitter it(line, ',');
+//   while (it.Next())
+//   {
+//       Use(it.piece());
+//   }
+//
+// The pieces are only valid as long as the input is.
 
 namespace base
 {
+    // Pieces of |input| between occurrences of |delimiter|.  N delimiters
+    // give N + 1 pieces, empty ones included, like SplitStringDontTrim().
+    template<typename STR>
+    class StringPieceSplitterT
+    {
+    public:
+        typedef typename STR::value_type char_type;
+
+        StringPieceSplitterT(const STR& input, char_type delimiter)
+            : input_(input), delimiter_(delimiter), next_(0), done_(false) {}
+
+        bool Next()
+        {
+            if (done_)
+            {
+                return false;
+            }
+            const char_type* begin = input_.begin() + next_;
+            const char_type* found = std::find(begin, input_.end(), delimiter_);
+            piece_.set(begin, found - begin);
+            if (found == input_.end())
+            {
+                done_ = true;
+            }
+            else
+            {
+                next_ = found - input_.begin() + 1;
+            }
+            return true;
+        }
+
+        const STR& piece() const { return piece_; }
+
+    private:
+        STR input_;
+        char_type delimiter_;
+        size_t next_;
+        bool done_;
+        STR piece_;
+    };
+
+    // Pieces of |input| between occurrences of |separator|, like
+    // SplitStringUsingSubstr() without the trimming.  An empty separator
+    // gives the whole input as one piece.
+    template<typename STR>
+    class StringPieceSubstrSplitterT
+    {
+    public:
+        StringPieceSubstrSplitterT(const STR& input, const STR& separator)
+            : input_(input), separator_(separator), next_(0), done_(false) {}
+
+        bool Next()
+        {
+            if (done_)
+            {
+                return false;
+            }
+            size_t found = separator_.empty() ? StringPiece::npos :
+                FindString(input_, separator_, next_);
+            if (found == StringPiece::npos)
+            {
+                piece_.set(input_.begin() + next_, input_.size() - next_);
+                done_ = true;
+            }
+            else
+            {
+                piece_.set(input_.begin() + next_, found - next_);
+                next_ = found + separator_.size();
+            }
+            return true;
+        }
+
+        const STR& piece() const { return piece_; }
+
+    private:
+        STR input_;
+        STR separator_;
+        size_t next_;
+        bool done_;
+        STR piece_;
+    };
+
+    // Non-empty runs of |input| free of any character in |delimiters|, as
+    // strtok() finds them, but without modifying anything.
+    template<typename STR>
+    class StringPieceTokenizerT
+    {
+    public:
+        typedef typename STR::value_type char_type;
+
+        StringPieceTokenizerT(const STR& input, const STR& delimiters)
+            : input_(input), delimiters_(delimiters), pos_(input.begin()) {}
+
+        bool Next()
+        {
+            while (pos_ != input_.end() && IsDelimiter(*pos_))
+            {
+                ++pos_;
+            }
+            if (pos_ == input_.end())
+            {
+                return false;
+            }
+            const char_type* begin = pos_;
+            while (pos_ != input_.end() && !IsDelimiter(*pos_))
+            {
+                ++pos_;
+            }
+            token_.set(begin, pos_ - begin);
+            return true;
+        }
+
+        const STR& token() const { return token_; }
+
+    private:
+        bool IsDelimiter(char_type c) const
+        {
+            return std::find(delimiters_.begin(), delimiters_.end(), c) !=
+                delimiters_.end();
+        }
+
+        STR input_;
+        STR delimiters_;
+        const char_type* pos_;
+        STR token_;
+    };
+
+    typedef StringPieceSplitterT<StringPiece> StringPieceSplitter;
+    typedef StringPieceSplitterT<StringPiece16> StringPieceSplitter16;
+    typedef StringPieceSubstrSplitterT<StringPiece> StringPieceSubstrSplitter;
+    typedef StringPieceSubstrSplitterT<StringPiece16>
+        StringPieceSubstrSplitter16;
+    typedef StringPieceTokenizerT<StringPiece> StringPieceTokenizer;
+    typedef StringPieceTokenizerT<StringPiece16> StringPieceTokenizer16;
+
+    // Lines of |text|, which may end in "\n" or "\r\n"; the line breaks are
+    // not part of the lines, and a final line break does not start another,
+    // empty line.  Line ends are found with SSE2, 16 bytes at a time.
+    class LineSplitter
+    {
+    public:
+        explicit LineSplitter(const StringPiece& text)
+            : text_(text), next_(0) {}
+
+        bool Next();
+
+        const StringPiece& line() const { return line_; }
+
+    private:
+        StringPiece text_;
+        size_t next_;
+        StringPiece line_;
+    };
+
     void SplitString(const std::wstring& str,
         wchar_t c, std::vector<std::wstring>* r);
 
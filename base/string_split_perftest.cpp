@@ -0,0 +1,177 @@
+// Throughput of splitting 16 MB of comma separated lines: SplitString()
+// into a vector of strings, the same with substr() and TrimWhitespace() as
+// it was done before the splitters, and StringPieceSplitter handing out
+// views; SplitStringUsingSubstr() against StringPieceSubstrSplitter; and
+// LineSplitter against a memchr() loop and SplitString() on '\n' for
+// breaking the text into lines.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "base/string_split.h"
+#include "base/string_util.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    const size_t kTextBytes = 16 * 1024 * 1024;
+    const int kRepeats = 5;
+
+    std::string MakeText()
+    {
+        std::string text;
+        text.reserve(kTextBytes + 128);
+        char line[128];
+        for (int i = 0; text.length() < kTextBytes; ++i)
+        {
+            _snprintf_s(line, sizeof(line), _TRUNCATE,
+                "%d, name %d , C:\\path\\to\\file%d.txt,  %d.%02d ,yes\r\n",
+                i, i % 977, i, i * 3, i % 100);
+            text += line;
+        }
+        return text;
+    }
+
+    // SplitString() as it was before the splitters.
+    void SplitStringBefore(const std::string& str, char s,
+        std::vector<std::string>* r)
+    {
+        size_t last = 0;
+        for (size_t i = 0; i <= str.size(); ++i)
+        {
+            if (i == str.size() || str[i] == s)
+            {
+                std::string tmp = str.substr(last, i - last);
+                std::string trimmed;
+                TrimWhitespace(tmp, TRIM_ALL, &trimmed);
+                r->push_back(trimmed);
+                last = i + 1;
+            }
+        }
+    }
+
+    void PrintMegabytes(const char* name, double ms, size_t bytes)
+    {
+        base::test::PrintRate(name, ms, kRepeats * bytes / (1024.0 * 1024.0),
+            "MB");
+    }
+
+    void TimeFields(const std::string& text)
+    {
+        std::vector<std::string> fields;
+        base::test::Timer split_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            fields.clear();
+            base::SplitString(text, ',', &fields);
+        }
+        PrintMegabytes("SplitString", split_timer.ElapsedMs(), text.size());
+        size_t expected = fields.size();
+
+        base::test::Timer before_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            fields.clear();
+            SplitStringBefore(text, ',', &fields);
+        }
+        PrintMegabytes("SplitString, substr and trim", before_timer.ElapsedMs(),
+            text.size());
+        EXPECT(fields.size() == expected);
+
+        size_t pieces = 0;
+        base::test::Timer splitter_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            base::StringPieceSplitter splitter(text, ',');
+            while (splitter.Next())
+            {
+                ++pieces;
+            }
+        }
+        PrintMegabytes("StringPieceSplitter", splitter_timer.ElapsedMs(),
+            text.size());
+        EXPECT(pieces == kRepeats * expected);
+
+        base::test::Timer substr_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            fields.clear();
+            base::SplitStringUsingSubstr(text, ", ", &fields);
+        }
+        PrintMegabytes("SplitStringUsingSubstr", substr_timer.ElapsedMs(),
+            text.size());
+        size_t expected_substr = fields.size();
+
+        pieces = 0;
+        base::test::Timer substr_splitter_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            base::StringPieceSubstrSplitter splitter(text, ", ");
+            while (splitter.Next())
+            {
+                ++pieces;
+            }
+        }
+        PrintMegabytes("StringPieceSubstrSplitter",
+            substr_splitter_timer.ElapsedMs(), text.size());
+        EXPECT(pieces == kRepeats * expected_substr);
+    }
+
+    void TimeLines(const std::string& text)
+    {
+        size_t lines = 0;
+        base::test::Timer splitter_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            base::LineSplitter splitter(text);
+            while (splitter.Next())
+            {
+                ++lines;
+            }
+        }
+        PrintMegabytes("LineSplitter", splitter_timer.ElapsedMs(),
+            text.size());
+        size_t expected = lines / kRepeats;
+
+        lines = 0;
+        base::test::Timer memchr_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            const char* begin = text.data();
+            const char* end = begin + text.size();
+            while (begin < end)
+            {
+                const char* found = static_cast<const char*>(
+                    memchr(begin, '\n', end - begin));
+                ++lines;
+                begin = found ? found + 1 : end;
+            }
+        }
+        PrintMegabytes("memchr loop", memchr_timer.ElapsedMs(), text.size());
+        EXPECT(lines == kRepeats * expected);
+
+        std::vector<std::string> split;
+        base::test::Timer split_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            split.clear();
+            base::SplitStringDontTrim(text, '\n', &split);
+        }
+        PrintMegabytes("SplitStringDontTrim on '\\n'", split_timer.ElapsedMs(),
+            text.size());
+        // The final line break leaves an empty last piece.
+        EXPECT(split.size() == expected + 1);
+    }
+
+}
+
+void RunStringSplitPerfTests()
+{
+    std::string text = MakeText();
+    TimeFields(text);
+    TimeLines(text);
+}
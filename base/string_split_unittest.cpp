@@ -0,0 +1,288 @@
+// Checks that SplitString(), SplitStringDontTrim() and
+// SplitStringUsingSubstr() give what splitting with substr() and
+// TrimWhitespace() gave before they ran on the StringPiece splitters, on
+// fixed and random input; the key/value helpers; that the splitters hand
+// out views into their input; and that LineSplitter breaks lines at "\n"
+// and "\r\n" only, wherever they fall in its 16 byte blocks.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/string_split.h"
+#include "base/string_util.h"
+#include "base/test/test_util.h"
+
+namespace
+{
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    // Splitting as it was done before the splitters.
+    template<typename STR>
+    std::vector<STR> ReferenceSplit(const STR& str,
+        typename STR::value_type s, bool trim_whitespace)
+    {
+        std::vector<STR> r;
+        size_t last = 0;
+        for (size_t i = 0; i <= str.size(); ++i)
+        {
+            if (i == str.size() || str[i] == s)
+            {
+                STR piece = str.substr(last, i - last);
+                STR trimmed;
+                if (trim_whitespace)
+                {
+                    TrimWhitespace(piece, TRIM_ALL, &trimmed);
+                    piece.swap(trimmed);
+                }
+                r.push_back(piece);
+                last = i + 1;
+            }
+        }
+        return r;
+    }
+
+    template<typename STR>
+    std::vector<STR> ReferenceSplitUsingSubstr(const STR& str, const STR& s)
+    {
+        std::vector<STR> r;
+        size_t begin = 0;
+        for (;;)
+        {
+            size_t end = s.empty() ? STR::npos : str.find(s, begin);
+            STR piece = str.substr(begin,
+                end == STR::npos ? STR::npos : end - begin);
+            STR trimmed;
+            TrimWhitespace(piece, TRIM_ALL, &trimmed);
+            r.push_back(trimmed);
+            if (end == STR::npos)
+            {
+                return r;
+            }
+            begin = end + s.size();
+        }
+    }
+
+    std::string RandomText(size_t length)
+    {
+        const char kAlphabet[] = "ab,; \t\r\n";
+        std::string text;
+        for (size_t i = 0; i < length; ++i)
+        {
+            text += kAlphabet[Random(arraysize(kAlphabet) - 1)];
+        }
+        return text;
+    }
+
+    void TestSplitString()
+    {
+        std::vector<std::string> r;
+        base::SplitString(" a , b,,c\t", ',', &r);
+        EXPECT(r.size() == 4 && r[0] == "a" && r[1] == "b" && r[2].empty() &&
+            r[3] == "c");
+
+        r.clear();
+        base::SplitString("", ',', &r);
+        EXPECT(r.size() == 1 && r[0].empty());
+
+        r.clear();
+        base::SplitStringDontTrim(" a ,", ',', &r);
+        EXPECT(r.size() == 2 && r[0] == " a " && r[1].empty());
+
+        std::vector<std::wstring> wide;
+        base::SplitString(L" x ;y", L';', &wide);
+        EXPECT(wide.size() == 2 && wide[0] == L"x" && wide[1] == L"y");
+
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string text = RandomText(Random(80));
+            char delimiter = Random(2) ? ',' : ';';
+
+            r.clear();
+            base::SplitString(text, delimiter, &r);
+            EXPECT(r == ReferenceSplit(text, delimiter, true));
+
+            r.clear();
+            base::SplitStringDontTrim(text, delimiter, &r);
+            EXPECT(r == ReferenceSplit(text, delimiter, false));
+
+            std::wstring text16(text.begin(), text.end());
+            wide.clear();
+            base::SplitString(text16, static_cast<wchar_t>(delimiter), &wide);
+            EXPECT(wide == ReferenceSplit(text16,
+                static_cast<wchar_t>(delimiter), true));
+        }
+    }
+
+    void TestSplitStringUsingSubstr()
+    {
+        std::vector<std::string> r;
+        base::SplitStringUsingSubstr("a::b :: c::", "::", &r);
+        EXPECT(r.size() == 4 && r[0] == "a" && r[1] == "b" && r[2] == "c" &&
+            r[3].empty());
+
+        // Separators do not overlap.
+        r.clear();
+        base::SplitStringUsingSubstr("aaaaa", "aa", &r);
+        EXPECT(r.size() == 3 && r[0].empty() && r[1].empty() && r[2] == "a");
+
+        // An empty separator gives the whole input, trimmed.
+        r.clear();
+        base::SplitStringUsingSubstr(" whole ", "", &r);
+        EXPECT(r.size() == 1 && r[0] == "whole");
+
+        const char* const kSeparators[] = { ",", ", ", ";;", "a,b" };
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string text = RandomText(Random(80));
+            std::string separator = kSeparators[Random(
+                arraysize(kSeparators))];
+            r.clear();
+            base::SplitStringUsingSubstr(text, separator, &r);
+            EXPECT(r == ReferenceSplitUsingSubstr(text, separator));
+
+            string16 text16(text.begin(), text.end());
+            string16 separator16(separator.begin(), separator.end());
+            std::vector<string16> r16;
+            base::SplitStringUsingSubstr(text16, separator16, &r16);
+            EXPECT(r16 == ReferenceSplitUsingSubstr(text16, separator16));
+        }
+    }
+
+    void TestKeyValues()
+    {
+        std::string key;
+        std::vector<std::string> values;
+        EXPECT(base::SplitStringIntoKeyValues("key==value=x", '=', &key,
+            &values));
+        EXPECT(key == "key" && values.size() == 1 && values[0] == "value=x");
+
+        EXPECT(!base::SplitStringIntoKeyValues("key==", '=', &key, &values));
+        EXPECT(key == "key" && values.empty());
+
+        EXPECT(!base::SplitStringIntoKeyValues("novalue", '=', &key,
+            &values));
+        EXPECT(key.empty() && values.empty());
+
+        std::vector<std::pair<std::string, std::string> > pairs;
+        EXPECT(base::SplitStringIntoKeyValuePairs(" a:1, b::2 ,,c:3", ':', ',',
+            &pairs));
+        EXPECT(pairs.size() == 3 && pairs[0].first == "a" &&
+            pairs[0].second == "1" && pairs[1].first == "b" &&
+            pairs[1].second == "2" && pairs[2].first == "c" &&
+            pairs[2].second == "3");
+
+        // A pair without a value fails the whole line but is still listed.
+        EXPECT(!base::SplitStringIntoKeyValuePairs("a:1,b,c:", ':', ',',
+            &pairs));
+        EXPECT(pairs.size() == 3 && pairs[1].first.empty() &&
+            pairs[1].second.empty() && pairs[2].first == "c" &&
+            pairs[2].second.empty());
+    }
+
+    void TestSplitters()
+    {
+        // Pieces point into the input.
+        std::string text("one,,three,");
+        base::StringPieceSplitter splitter(text, ',');
+        std::vector<base::StringPiece> pieces;
+        while (splitter.Next())
+        {
+            pieces.push_back(splitter.piece());
+        }
+        EXPECT(pieces.size() == 4 && pieces[0] == "one" && pieces[1].empty() &&
+            pieces[2] == "three" && pieces[3].empty());
+        EXPECT(pieces.size() == 4 && pieces[2].data() == text.data() + 5);
+
+        base::StringPieceSubstrSplitter substr_splitter("a<>b<>", "<>");
+        pieces.clear();
+        while (substr_splitter.Next())
+        {
+            pieces.push_back(substr_splitter.piece());
+        }
+        EXPECT(pieces.size() == 3 && pieces[0] == "a" && pieces[1] == "b" &&
+            pieces[2].empty());
+
+        base::StringPieceTokenizer tokenizer(" ,a,, b c, ", ", ");
+        pieces.clear();
+        while (tokenizer.Next())
+        {
+            pieces.push_back(tokenizer.token());
+        }
+        EXPECT(pieces.size() == 3 && pieces[0] == "a" && pieces[1] == "b" &&
+            pieces[2] == "c");
+
+        base::StringPieceTokenizer empty("", ",");
+        EXPECT(!empty.Next());
+        base::StringPieceTokenizer only_delimiters(",,,", ",");
+        EXPECT(!only_delimiters.Next());
+    }
+
+    std::vector<std::string> Lines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        base::LineSplitter splitter(text);
+        while (splitter.Next())
+        {
+            lines.push_back(splitter.line().as_string());
+        }
+        return lines;
+    }
+
+    void TestLineSplitter()
+    {
+        EXPECT(Lines("").empty());
+        std::vector<std::string> lines = Lines("a");
+        EXPECT(lines.size() == 1 && lines[0] == "a");
+        lines = Lines("a\n");
+        EXPECT(lines.size() == 1 && lines[0] == "a");
+        lines = Lines("a\r\nb\n\nc");
+        EXPECT(lines.size() == 4 && lines[0] == "a" && lines[1] == "b" &&
+            lines[2].empty() && lines[3] == "c");
+        // A lone '\r' is part of the line.
+        lines = Lines("a\rb\r");
+        EXPECT(lines.size() == 1 && lines[0] == "a\rb\r");
+
+        // Line breaks at every offset of texts up to a few blocks long.
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string text = RandomText(Random(70));
+            std::vector<std::string> expected;
+            size_t begin = 0;
+            while (begin < text.size())
+            {
+                size_t end = text.find('\n', begin);
+                if (end == std::string::npos)
+                {
+                    expected.push_back(text.substr(begin));
+                    break;
+                }
+                size_t length = end - begin;
+                if (length > 0 && text[end - 1] == '\r')
+                {
+                    --length;
+                }
+                expected.push_back(text.substr(begin, length));
+                begin = end + 1;
+            }
+            EXPECT(Lines(text) == expected);
+        }
+    }
+
+}
+
+void RunStringSplitTests()
+{
+    TestSplitString();
+    TestSplitStringUsingSubstr();
+    TestKeyValues();
+    TestSplitters();
+    TestLineSplitter();
+}
@@ -423,31 +423,17 @@ bool WideToLatin1(const std::wstring& wide, std::string* latin1)
     return true;
 }
 
-template<class STR>
-static bool DoIsStringASCII(const STR& str)
-{
-    for (size_t i = 0; i < str.length(); ++i)
-    {
-        typename ToUnsigned<typename STR::value_type>::Unsigned c = str[i];
-        if (c > 0x7F)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
 bool IsStringASCII(const std::wstring& str)
 {
-    return DoIsStringASCII(str);
+    return base::CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 bool IsStringASCII(const base::StringPiece& str)
 {
-    return DoIsStringASCII(str);
+    return base::CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
-bool IsStringUTF8(const std::string& str)
+bool IsStringUTF8(const base::StringPiece& str)
 {
     const char* src = str.data();
     int32 src_len = static_cast<int32>(str.length());
@@ -455,6 +441,15 @@ bool IsStringUTF8(const std::string& str)
 
     while (char_index < src_len)
     {
+        // Skip what the SIMD validator accepts, and check the character it
+        // stopped at, if any, one code point at a time.
+        char_index += static_cast<int32>(base::CountLeadingValidUTF8(
+            src + char_index, static_cast<size_t>(src_len - char_index), true));
+        if (char_index == src_len)
+        {
+            break;
+        }
+
         int32 code_point;
         CBU8_NEXT(src, char_index, src_len, code_point);
         if (!base::IsValidCharacter(code_point))
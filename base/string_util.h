@@ -156,7 +156,7 @@ std::string UTF16ToASCII(const string16& utf16);
 
 bool WideToLatin1(const std::wstring& wide, std::string* latin1);
 
-bool IsStringUTF8(const std::string& str);
+bool IsStringUTF8(const base::StringPiece& str);
 bool IsStringASCII(const std::wstring& str);
 bool IsStringASCII(const base::StringPiece& str);
 bool IsStringASCII(const string16& str);
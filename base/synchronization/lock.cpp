@@ -1,10 +1,41 @@
 #include "lock.h"
 
+#include <intrin.h>
+
 #include "base/logging.h"
 
+#pragma intrinsic(_ReturnAddress)
+
 namespace base
 {
 
+    // Only called from the inline Acquire() and Try(), so the return
+    // address lies in the function that took the lock.
+    __declspec(noinline) void Lock::AcquireSlow()
+    {
+#if !defined(NDEBUG)
+        // A recursive acquire always ends up here, since the lock is held.
+        DCHECK(!owned_by_thread_ ||
+            owning_thread_id_ != PlatformThread::CurrentId());
+#endif //NDEBUG
+        lock_.Lock(_ReturnAddress());
+#if !defined(NDEBUG)
+        CheckUnheldAndMark();
+#endif //NDEBUG
+    }
+
+    __declspec(noinline) bool Lock::TryProfiled()
+    {
+        bool rv = lock_.Try(_ReturnAddress());
+#if !defined(NDEBUG)
+        if (rv)
+        {
+            CheckUnheldAndMark();
+        }
+#endif //NDEBUG
+        return rv;
+    }
+
 #if !defined(NDEBUG)
     Lock::Lock() : lock_()
     {
@@ -3,50 +3,71 @@
 
 #include "base/threading/platform_thread.h"
 #include "lock_impl.h"
+#include "lock_profiler.h"
 
 namespace base
 {
+    // A mutex.  It is not recursive: a thread that acquires a Lock it already
+    // holds deadlocks, and debug builds DCHECK on it.
+    //
+    // The uncontended Acquire(), Try(), AutoLock and AutoUnlock are inline.
+    // Waiting, and every acquire while the LockProfiler is enabled, go
+    // through AcquireSlow() and TryProfiled(), which are not inlined, so
+    // their return address is the site that took the lock.
     class Lock
     {
     public:
 #if defined(NDEBUG)
         Lock() : lock_() {}
         ~Lock() {}
-        void Acquire() { lock_.Lock(); }
         void Release() { lock_.Unlock(); }
 
-        bool Try() { return lock_.Try(); }
-
         void AssertAcquired() const {}
 #else //!NDEBUG
         Lock();
         ~Lock() {}
 
-        void Acquire()
-        {
-            lock_.Lock();
-            CheckUnheldAndMark();
-        }
         void Release()
         {
             CheckHeldAndUnmark();
             lock_.Unlock();
         }
 
+        void AssertAcquired() const;
+#endif //NDEBUG
+
+        void Acquire()
+        {
+            if (LockProfiler::IsEnabled() || !lock_.TryFast())
+            {
+                AcquireSlow();
+                return;
+            }
+#if !defined(NDEBUG)
+            CheckUnheldAndMark();
+#endif //NDEBUG
+        }
+
         bool Try()
         {
-            bool rv = lock_.Try();
+            if (LockProfiler::IsEnabled())
+            {
+                return TryProfiled();
+            }
+            bool rv = lock_.TryFast();
+#if !defined(NDEBUG)
             if (rv)
             {
                 CheckUnheldAndMark();
             }
+#endif //NDEBUG
             return rv;
         }
 
-        void AssertAcquired() const;
-#endif //NDEBUG
-
     private:
+        void AcquireSlow();
+        bool TryProfiled();
+
 #if !defined(NDEBUG)
         void CheckHeldAndUnmark();
         void CheckUnheldAndMark();
@@ -100,4 +121,4 @@ namespace base
 
 } //namespace base
 
-#endif //__base_lock_h__
\ No newline at end of file
+#endif //__base_lock_h__
@@ -1,39 +1,226 @@
 #include "lock_impl.h"
 
+#include <algorithm>
+
+#include "lock_profiler.h"
+
+namespace
+{
+    // Upper bound for the adaptive spin phase.  A context switch costs a few
+    // microseconds, so spinning longer than that is never worth it.
+    const int kMaxSpinCount = 2000;
+
+    // WaitOnAddress() and WakeByAddressSingle() are new in Windows 8, where
+    // kernelbase.dll exports them; they are looked up at runtime so that the
+    // binary still loads on older systems.  There a waiter sleeps on one of
+    // a fixed set of condition variables instead, picked by the address of
+    // the lock word.  Unrelated locks may share one, which only costs them a
+    // spurious wake.
+    typedef BOOL (WINAPI* WaitOnAddressFunc)(volatile VOID*, PVOID, SIZE_T,
+        DWORD);
+    typedef VOID (WINAPI* WakeByAddressSingleFunc)(PVOID);
+
+    enum WaitMode
+    {
+        WAIT_MODE_UNKNOWN = 0,
+        WAIT_MODE_ADDRESS,
+        WAIT_MODE_CONDITION_VARIABLE
+    };
+
+    volatile base::subtle::Atomic32 wait_mode = WAIT_MODE_UNKNOWN;
+    WaitOnAddressFunc wait_on_address = NULL;
+    WakeByAddressSingleFunc wake_by_address_single = NULL;
+
+    // Zero is SRWLOCK_INIT and CONDITION_VARIABLE_INIT, so the buckets need
+    // no constructor and are usable before any static initializer runs.
+    struct ParkingBucket
+    {
+        SRWLOCK lock;
+        CONDITION_VARIABLE condition;
+    };
+
+    const int kParkingBucketCount = 64;
+    ParkingBucket parking_buckets[kParkingBucketCount];
+
+    // Threads racing here all find the same functions, so the worst that
+    // can happen is that they are looked up more than once.  The mode is
+    // published last, so a thread never waits one way and wakes the other.
+    WaitMode GetWaitMode()
+    {
+        base::subtle::Atomic32 mode = base::subtle::Acquire_Load(&wait_mode);
+        if (mode != WAIT_MODE_UNKNOWN)
+        {
+            return static_cast<WaitMode>(mode);
+        }
+
+        HMODULE kernelbase = ::GetModuleHandle(L"kernelbase.dll");
+        if (kernelbase)
+        {
+            wait_on_address = reinterpret_cast<WaitOnAddressFunc>(
+                ::GetProcAddress(kernelbase, "WaitOnAddress"));
+            wake_by_address_single = reinterpret_cast<WakeByAddressSingleFunc>(
+                ::GetProcAddress(kernelbase, "WakeByAddressSingle"));
+        }
+        mode = wait_on_address && wake_by_address_single ?
+            WAIT_MODE_ADDRESS : WAIT_MODE_CONDITION_VARIABLE;
+        base::subtle::Release_Store(&wait_mode, mode);
+        return static_cast<WaitMode>(mode);
+    }
+
+    ParkingBucket* GetParkingBucket(volatile base::subtle::Atomic32* word)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(word);
+        return &parking_buckets[(address >> 4) % kParkingBucketCount];
+    }
+
+    // Returns once |*word| may no longer be |expected|; spurious returns are
+    // allowed, as with WaitOnAddress().
+    void WaitOnLockWord(volatile base::subtle::Atomic32* word,
+        base::subtle::Atomic32 expected)
+    {
+        if (GetWaitMode() == WAIT_MODE_ADDRESS)
+        {
+            wait_on_address(word, &expected, sizeof(expected), INFINITE);
+            return;
+        }
+
+        // The waker changes the word before it takes the bucket lock, so
+        // checking the word under the lock cannot miss its wake.
+        ParkingBucket* bucket = GetParkingBucket(word);
+        ::AcquireSRWLockExclusive(&bucket->lock);
+        while (base::subtle::NoBarrier_Load(word) == expected)
+        {
+            ::SleepConditionVariableSRW(&bucket->condition, &bucket->lock,
+                INFINITE, 0);
+        }
+        ::ReleaseSRWLockExclusive(&bucket->lock);
+    }
+
+    void WakeOneWaiter(volatile base::subtle::Atomic32* word)
+    {
+        if (GetWaitMode() == WAIT_MODE_ADDRESS)
+        {
+            wake_by_address_single(const_cast<base::subtle::Atomic32*>(word));
+            return;
+        }
+
+        // The bucket is shared, so wake them all; waiters on other words go
+        // back to sleep.  Taking the lock orders the wake after any waiter
+        // that saw the old value has gone to sleep.
+        ParkingBucket* bucket = GetParkingBucket(word);
+        ::AcquireSRWLockExclusive(&bucket->lock);
+        ::ReleaseSRWLockExclusive(&bucket->lock);
+        ::WakeAllConditionVariable(&bucket->condition);
+    }
+
+}
+
 namespace base
 {
     namespace internal
     {
 
         LockImpl::LockImpl()
-        {
-            InitializeCriticalSectionAndSpinCount(&os_lock_, 2000);
-        }
+            : state_(kUnlocked),
+            spin_count_(0),
+            acquire_site_(NULL),
+            acquire_ticks_(0) {}
+
+        LockImpl::~LockImpl() {}
 
-        LockImpl::~LockImpl()
+        bool LockImpl::Try(const void* site)
         {
-            DeleteCriticalSection(&os_lock_);
+            if (!TryFast())
+            {
+                return false;
+            }
+            if (site && LockProfiler::IsEnabled())
+            {
+                acquire_site_ = site;
+                acquire_ticks_ = LockProfiler::Now();
+                LockProfiler::RecordAcquire(site, false, 0);
+            }
+            return true;
         }
 
-        bool LockImpl::Try()
+        void LockImpl::Lock(const void* site)
         {
-            if (TryEnterCriticalSection(&os_lock_) != FALSE)
+            if (site && LockProfiler::IsEnabled())
             {
-                return true;
+                LockProfiled(site);
+                return;
+            }
+
+            if (subtle::Acquire_CompareAndSwap(&state_, kUnlocked, kLocked) !=
+                kUnlocked)
+            {
+                LockSlow();
             }
-            return false;
         }
 
-        void LockImpl::Lock()
+        void LockImpl::RecordHold()
         {
-            EnterCriticalSection(&os_lock_);
+            LockProfiler::RecordHold(acquire_site_,
+                LockProfiler::Now() - acquire_ticks_);
+            acquire_site_ = NULL;
         }
 
-        void LockImpl::Unlock()
+        void LockImpl::WakeWaiter()
         {
-            LeaveCriticalSection(&os_lock_);
+            WakeOneWaiter(&state_);
+        }
+
+        void LockImpl::LockSlow()
+        {
+            subtle::Atomic32 average = subtle::NoBarrier_Load(&spin_count_);
+            int max_spins = std::min(kMaxSpinCount, average * 2 + 10);
+            int spins = 0;
+            bool acquired = false;
+            while (spins < max_spins)
+            {
+                if (subtle::NoBarrier_Load(&state_) == kUnlocked &&
+                    subtle::Acquire_CompareAndSwap(&state_, kUnlocked, kLocked) ==
+                    kUnlocked)
+                {
+                    acquired = true;
+                    break;
+                }
+                YieldProcessor();
+                ++spins;
+            }
+            subtle::NoBarrier_Store(&spin_count_,
+                average + (spins - average) / 8);
+            if (acquired)
+            {
+                return;
+            }
+
+            // Mark the lock as having waiters so that Unlock() wakes us.  If the
+            // exchange finds it unlocked we own it, in the kLockedWithWaiters
+            // state, which at worst costs the next Unlock() a spurious wake.
+            while (subtle::NoBarrier_AtomicExchange(&state_, kLockedWithWaiters) !=
+                kUnlocked)
+            {
+                WaitOnLockWord(&state_, kLockedWithWaiters);
+            }
+        }
+
+        void LockImpl::LockProfiled(const void* site)
+        {
+            bool contended = false;
+            int64 wait_ticks = 0;
+            if (subtle::Acquire_CompareAndSwap(&state_, kUnlocked, kLocked) !=
+                kUnlocked)
+            {
+                int64 start = LockProfiler::Now();
+                LockSlow();
+                contended = true;
+                wait_ticks = LockProfiler::Now() - start;
+            }
+            acquire_site_ = site;
+            acquire_ticks_ = LockProfiler::Now();
+            LockProfiler::RecordAcquire(site, contended, wait_ticks);
         }
 
     } //namespace internal
 } //namespace base
-
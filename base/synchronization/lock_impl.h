@@ -3,26 +3,83 @@
 
 #include <windows.h>
 
+#include "base/atomicops.h"
 #include "base/basic_types.h"
 
 namespace base
 {
     namespace internal
     {
+        // A futex style mutex.  The uncontended acquire and release are a
+        // single interlocked operation each.  A contended acquire first spins
+        // for an adaptively tuned number of iterations, then parks the thread
+        // on the lock word with WaitOnAddress(), or a condition variable
+        // before Windows 8, until the owner wakes it.
+        //
+        // While the LockProfiler is enabled every acquire is attributed to the
+        // call site passed in, see lock_profiler.h.
         class LockImpl
         {
         public:
-            typedef CRITICAL_SECTION OSLockType;
-
             LockImpl();
             ~LockImpl();
 
-            bool Try();
-            void Lock();
-            void Unlock();
+            // |site| is where the lock is taken, for the LockProfiler; NULL
+            // leaves the acquire out of the profile.
+            bool Try(const void* site);
+            void Lock(const void* site);
+
+            // Try() without the profiler, for the inline fast path of
+            // base::Lock.
+            bool TryFast()
+            {
+                return subtle::Acquire_CompareAndSwap(&state_, kUnlocked,
+                    kLocked) == kUnlocked;
+            }
+
+            void Unlock()
+            {
+                if (acquire_site_)
+                {
+                    RecordHold();
+                }
+
+                // The exchange is a full barrier, so it also releases
+                // everything written while the lock was held.
+                if (subtle::NoBarrier_AtomicExchange(&state_, kUnlocked) ==
+                    kLockedWithWaiters)
+                {
+                    WakeWaiter();
+                }
+            }
 
         private:
-            OSLockType os_lock_;
+            enum
+            {
+                kUnlocked = 0,
+                kLocked = 1,
+                kLockedWithWaiters = 2
+            };
+
+            // Contended acquire: spin, then park until the lock is handed over.
+            void LockSlow();
+
+            // Lock() while the LockProfiler is enabled.
+            void LockProfiled(const void* site);
+
+            // The out of line parts of Unlock().
+            void RecordHold();
+            void WakeWaiter();
+
+            volatile subtle::Atomic32 state_;
+
+            // Running average of the spins a contended acquire needed.  Only a
+            // heuristic, so updates may race.
+            volatile subtle::Atomic32 spin_count_;
+
+            // Set by the owner while profiling, read back in Unlock().
+            const void* acquire_site_;
+            int64 acquire_ticks_;
 
             DISALLOW_COPY_AND_ASSIGN(LockImpl);
         };
@@ -30,4 +87,4 @@ namespace base
     } //namespace internal
 } //namespace base
 
-#endif //__base_lock_impl_h__
\ No newline at end of file
+#endif //__base_lock_impl_h__
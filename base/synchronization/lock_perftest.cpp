@@ -0,0 +1,110 @@
+// Timings of base::Lock: the uncontended inline paths on one thread, and a
+// counter incremented under one lock by several threads at once.
+
+#include <stdio.h>
+
+#include "base/synchronization/lock.h"
+#include "base/test/test_util.h"
+#include "base/threading/platform_thread.h"
+
+namespace
+{
+
+    const int kUncontendedAcquires = 10000000;
+    const int kContendedAcquiresPerThread = 1000000;
+    const int kMaxThreads = 8;
+
+    void TimeUncontended()
+    {
+        base::Lock lock;
+        int count = 0;
+
+        base::test::Timer acquire_timer;
+        for (int i = 0; i < kUncontendedAcquires; ++i)
+        {
+            lock.Acquire();
+            ++count;
+            lock.Release();
+        }
+        base::test::PrintCost("Acquire/Release", acquire_timer.ElapsedMs(),
+            kUncontendedAcquires);
+
+        base::test::Timer auto_lock_timer;
+        for (int i = 0; i < kUncontendedAcquires; ++i)
+        {
+            base::AutoLock auto_lock(lock);
+            ++count;
+        }
+        base::test::PrintCost("AutoLock", auto_lock_timer.ElapsedMs(),
+            kUncontendedAcquires);
+
+        base::test::Timer try_timer;
+        for (int i = 0; i < kUncontendedAcquires; ++i)
+        {
+            if (lock.Try())
+            {
+                ++count;
+                lock.Release();
+            }
+        }
+        base::test::PrintCost("Try/Release", try_timer.ElapsedMs(),
+            kUncontendedAcquires);
+
+        EXPECT(count == 3 * kUncontendedAcquires);
+    }
+
+    class Incrementer : public base::PlatformThread::Delegate
+    {
+    public:
+        Incrementer(base::Lock* lock, int* count)
+            : lock_(lock), count_(count) {}
+
+        virtual void ThreadMain()
+        {
+            for (int i = 0; i < kContendedAcquiresPerThread; ++i)
+            {
+                base::AutoLock auto_lock(*lock_);
+                ++*count_;
+            }
+        }
+
+    private:
+        base::Lock* lock_;
+        int* count_;
+    };
+
+    void TimeContended(int thread_count)
+    {
+        base::Lock lock;
+        int count = 0;
+        Incrementer incrementer(&lock, &count);
+        base::PlatformThreadHandle handles[kMaxThreads];
+
+        base::test::Timer timer;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            base::PlatformThread::Create(0, &incrementer, &handles[i]);
+        }
+        for (int i = 0; i < thread_count; ++i)
+        {
+            base::PlatformThread::Join(handles[i]);
+        }
+        double ms = timer.ElapsedMs();
+
+        int total = thread_count * kContendedAcquiresPerThread;
+        EXPECT(count == total);
+        char name[64];
+        _snprintf_s(name, sizeof(name), _TRUNCATE,
+            "AutoLock, %d threads", thread_count);
+        base::test::PrintCost(name, ms, total);
+    }
+
+}
+
+void RunLockPerfTests()
+{
+    TimeUncontended();
+    TimeContended(2);
+    TimeContended(4);
+    TimeContended(kMaxThreads);
+}
@@ -0,0 +1,187 @@
+#include "lock_profiler.h"
+
+#include <algorithm>
+
+#include "base/base_switches.h"
+#include "base/command_line.h"
+#include "base/stringprintf.h"
+
+namespace
+{
+    // Must be a power of two.
+    const size_t kMaxSites = 1024;
+
+    struct SiteSlot
+    {
+        volatile base::subtle::AtomicWord site;
+        volatile LONGLONG acquisitions;
+        volatile LONGLONG contentions;
+        volatile LONGLONG wait_ticks;
+        volatile LONGLONG hold_ticks;
+    };
+
+    SiteSlot g_sites[kMaxSites];
+
+    // Acquisitions whose site found the table full.
+    volatile LONGLONG g_dropped = 0;
+
+    // Returns the slot for |site|, claiming a free one if needed, or NULL when
+    // the table is full.
+    SiteSlot* FindOrInsertSite(const void* site)
+    {
+        base::subtle::AtomicWord key =
+            reinterpret_cast<base::subtle::AtomicWord>(site);
+        size_t index = (static_cast<size_t>(key) >> 4) * 2654435761u;
+        for (size_t probe = 0; probe < kMaxSites; ++probe)
+        {
+            SiteSlot* slot = &g_sites[(index + probe) & (kMaxSites - 1)];
+            base::subtle::AtomicWord current =
+                base::subtle::Acquire_Load(&slot->site);
+            if (current == key)
+            {
+                return slot;
+            }
+            if (current == 0)
+            {
+                current = base::subtle::Acquire_CompareAndSwap(&slot->site,
+                    0, key);
+                if (current == 0 || current == key)
+                {
+                    return slot;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    int64 TicksToMicroseconds(int64 ticks)
+    {
+        static LARGE_INTEGER frequency = { 0 };
+        if (frequency.QuadPart == 0)
+        {
+            QueryPerformanceFrequency(&frequency);
+        }
+        return ticks * 1000000 / frequency.QuadPart;
+    }
+
+    bool MoreWaitFirst(const base::LockProfiler::SiteStats& a,
+        const base::LockProfiler::SiteStats& b)
+    {
+        return a.wait_us > b.wait_us;
+    }
+
+}
+
+namespace base
+{
+    volatile subtle::Atomic32 LockProfiler::enabled_ = 0;
+
+    // static
+    void LockProfiler::InitFromCommandLine(const CommandLine& command_line)
+    {
+        if (command_line.HasSwitch(kLockProfiler))
+        {
+            SetEnabled(true);
+        }
+    }
+
+    // static
+    void LockProfiler::SetEnabled(bool enabled)
+    {
+        subtle::NoBarrier_Store(&enabled_, enabled ? 1 : 0);
+    }
+
+    // static
+    int64 LockProfiler::Now()
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return now.QuadPart;
+    }
+
+    // static
+    void LockProfiler::RecordAcquire(const void* site, bool contended,
+        int64 wait_ticks)
+    {
+        SiteSlot* slot = FindOrInsertSite(site);
+        if (!slot)
+        {
+            InterlockedIncrement64(&g_dropped);
+            return;
+        }
+        InterlockedIncrement64(&slot->acquisitions);
+        if (contended)
+        {
+            InterlockedIncrement64(&slot->contentions);
+            InterlockedExchangeAdd64(&slot->wait_ticks, wait_ticks);
+        }
+    }
+
+    // static
+    void LockProfiler::RecordHold(const void* site, int64 hold_ticks)
+    {
+        SiteSlot* slot = FindOrInsertSite(site);
+        if (slot)
+        {
+            InterlockedExchangeAdd64(&slot->hold_ticks, hold_ticks);
+        }
+    }
+
+    // static
+    void LockProfiler::GetSiteStats(std::vector<SiteStats>* stats)
+    {
+        for (size_t i = 0; i < kMaxSites; ++i)
+        {
+            const SiteSlot& slot = g_sites[i];
+            if (!subtle::Acquire_Load(&slot.site))
+            {
+                continue;
+            }
+            SiteStats entry;
+            entry.site = reinterpret_cast<const void*>(slot.site);
+            entry.acquisitions = slot.acquisitions;
+            entry.contentions = slot.contentions;
+            entry.wait_us = TicksToMicroseconds(slot.wait_ticks);
+            entry.hold_us = TicksToMicroseconds(slot.hold_ticks);
+            stats->push_back(entry);
+        }
+        std::sort(stats->begin(), stats->end(), MoreWaitFirst);
+    }
+
+    // static
+    void LockProfiler::WriteReport(std::string* output)
+    {
+        std::vector<SiteStats> stats;
+        GetSiteStats(&stats);
+
+        StringAppendF(output, "Lock contention by acquire site (%u sites, "
+            "%I64d acquisitions dropped)\n",
+            static_cast<unsigned>(stats.size()), g_dropped);
+        output->append("site                acquires   contended  "
+            "wait_us       hold_us       avg_hold_us\n");
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            const SiteStats& entry = stats[i];
+            int64 avg_hold = entry.acquisitions ?
+                entry.hold_us / entry.acquisitions : 0;
+            StringAppendF(output, "%-18p  %-9I64d  %-9I64d  %-12I64d  "
+                "%-12I64d  %I64d\n", entry.site, entry.acquisitions,
+                entry.contentions, entry.wait_us, entry.hold_us, avg_hold);
+        }
+    }
+
+    // static
+    void LockProfiler::Reset()
+    {
+        for (size_t i = 0; i < kMaxSites; ++i)
+        {
+            SiteSlot& slot = g_sites[i];
+            InterlockedExchange64(&slot.acquisitions, 0);
+            InterlockedExchange64(&slot.contentions, 0);
+            InterlockedExchange64(&slot.wait_ticks, 0);
+            InterlockedExchange64(&slot.hold_ticks, 0);
+        }
+        InterlockedExchange64(&g_dropped, 0);
+    }
+
+} //namespace base
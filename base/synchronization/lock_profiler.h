@@ -0,0 +1,71 @@
+#ifndef __base_lock_profiler_h__
+#define __base_lock_profiler_h__
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basic_types.h"
+
+class CommandLine;
+
+namespace base
+{
+    // LockProfiler collects contention statistics for every base::Lock, keyed
+    // by the call site that acquired it: number of acquisitions, how many of
+    // them had to wait, total wait time and total hold time.  It is off by
+    // default; run with --lock-profiler or call SetEnabled() to switch it on.
+    //
+    // The profiler is itself used from inside LockImpl, so it must never take
+    // a lock.  Statistics live in a fixed-size, open-addressed table updated
+    // with interlocked adds; sites that do not fit are counted as dropped.
+    class LockProfiler
+    {
+    public:
+        struct SiteStats
+        {
+            const void* site;
+            int64 acquisitions;
+            int64 contentions;
+            int64 wait_us;
+            int64 hold_us;
+        };
+
+        // Enables the profiler if |command_line| carries --lock-profiler.
+        static void InitFromCommandLine(const CommandLine& command_line);
+
+        static void SetEnabled(bool enabled);
+
+        static bool IsEnabled()
+        {
+            return subtle::NoBarrier_Load(&enabled_) != 0;
+        }
+
+        // Raw timestamp in performance counter ticks.
+        static int64 Now();
+
+        // Called by LockImpl.  |wait_ticks| and |hold_ticks| are differences of
+        // Now() values.
+        static void RecordAcquire(const void* site, bool contended,
+            int64 wait_ticks);
+        static void RecordHold(const void* site, int64 hold_ticks);
+
+        // Returns the statistics of every site seen so far, most waited on
+        // first.
+        static void GetSiteStats(std::vector<SiteStats>* stats);
+
+        // Writes a human readable table of GetSiteStats().
+        static void WriteReport(std::string* output);
+
+        // Zeroes all counters.  Sites stay registered.
+        static void Reset();
+
+    private:
+        static volatile subtle::Atomic32 enabled_;
+
+        DISALLOW_IMPLICIT_CONSTRUCTORS(LockProfiler);
+    };
+
+} //namespace base
+
+#endif //__base_lock_profiler_h__
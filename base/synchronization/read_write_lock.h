@@ -0,0 +1,73 @@
+#ifndef __base_read_write_lock_h__
+#define __base_read_write_lock_h__
+
+#include <windows.h>
+
+#include "base/basic_types.h"
+
+namespace base
+{
+    // A reader/writer lock for read-mostly tables, built on a slim
+    // reader/writer lock.  Any number of readers may hold it at once; a
+    // writer holds it alone.  It is not recursive in either mode, and a
+    // reader cannot upgrade to a writer.
+    class ReadWriteLock
+    {
+    public:
+        ReadWriteLock()
+        {
+            InitializeSRWLock(&native_handle_);
+        }
+        ~ReadWriteLock() {}
+
+        void ReadAcquire() { AcquireSRWLockShared(&native_handle_); }
+        void ReadRelease() { ReleaseSRWLockShared(&native_handle_); }
+
+        void WriteAcquire() { AcquireSRWLockExclusive(&native_handle_); }
+        void WriteRelease() { ReleaseSRWLockExclusive(&native_handle_); }
+
+    private:
+        SRWLOCK native_handle_;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadWriteLock);
+    };
+
+    class AutoReadLock
+    {
+    public:
+        explicit AutoReadLock(ReadWriteLock& lock) : lock_(lock)
+        {
+            lock_.ReadAcquire();
+        }
+
+        ~AutoReadLock()
+        {
+            lock_.ReadRelease();
+        }
+
+    private:
+        ReadWriteLock& lock_;
+        DISALLOW_COPY_AND_ASSIGN(AutoReadLock);
+    };
+
+    class AutoWriteLock
+    {
+    public:
+        explicit AutoWriteLock(ReadWriteLock& lock) : lock_(lock)
+        {
+            lock_.WriteAcquire();
+        }
+
+        ~AutoWriteLock()
+        {
+            lock_.WriteRelease();
+        }
+
+    private:
+        ReadWriteLock& lock_;
+        DISALLOW_COPY_AND_ASSIGN(AutoWriteLock);
+    };
+
+} //namespace base
+
+#endif //__base_read_write_lock_h__
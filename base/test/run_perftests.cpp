@@ -0,0 +1,82 @@
+// Timings of base, one group per class.  A console program, run by hand;
+// with arguments only the groups whose names contain one of them run.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/at_exit.h"
+#include "base/basic_types.h"
+
+void RunFileUtilPerfTests();
+void RunHistogramPerfTests();
+void RunImportantFileWriterPerfTests();
+void RunJSONReaderPerfTests();
+void RunLockPerfTests();
+void RunLoggingPerfTests();
+void RunMessageLoopPerfTests();
+void RunObserverListThreadSafePerfTests();
+void RunParallelFileWalkerPerfTests();
+void RunPicklePerfTests();
+void RunStatsTablePerfTests();
+void RunStringSearchPerfTests();
+void RunStringSplitPerfTests();
+void RunUTFStringConversionsPerfTests();
+
+namespace
+{
+
+    struct PerfGroup
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const PerfGroup kGroups[] =
+    {
+        { "file_util", RunFileUtilPerfTests },
+        { "histogram", RunHistogramPerfTests },
+        { "important_file_writer", RunImportantFileWriterPerfTests },
+        { "json_reader", RunJSONReaderPerfTests },
+        { "lock", RunLockPerfTests },
+        { "logging", RunLoggingPerfTests },
+        { "message_loop", RunMessageLoopPerfTests },
+        { "observer_list_threadsafe", RunObserverListThreadSafePerfTests },
+        { "parallel_file_walker", RunParallelFileWalkerPerfTests },
+        { "pickle", RunPicklePerfTests },
+        { "stats_table", RunStatsTablePerfTests },
+        { "string_search", RunStringSearchPerfTests },
+        { "string_split", RunStringSplitPerfTests },
+        { "utf_string_conversions", RunUTFStringConversionsPerfTests },
+    };
+
+    bool IsSelected(const char* name, int argc, char** argv)
+    {
+        if (argc < 2)
+        {
+            return true;
+        }
+        for (int i = 1; i < argc; ++i)
+        {
+            if (strstr(name, argv[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    base::AtExitManager exit_manager;
+    for (size_t i = 0; i < arraysize(kGroups); ++i)
+    {
+        if (IsSelected(kGroups[i].name, argc, argv))
+        {
+            printf("[%s]\n", kGroups[i].name);
+            kGroups[i].run();
+        }
+    }
+    return 0;
+}
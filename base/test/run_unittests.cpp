@@ -0,0 +1,75 @@
+// Checks of base, one group per class.  A console program without a test
+// framework, run by ctest: it prints each failed check and returns the
+// number of failures.  With arguments only the groups whose names contain
+// one of them run.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/at_exit.h"
+#include "base/basic_types.h"
+#include "base/test/test_util.h"
+
+void RunHistogramTests();
+void RunImportantFileWriterTests();
+void RunJSONReaderTests();
+void RunLoggingTests();
+void RunParallelFileWalkerTests();
+void RunPickleTests();
+void RunStringSearchTests();
+void RunStringSplitTests();
+void RunUTFStringConversionsTests();
+
+namespace
+{
+
+    struct TestGroup
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const TestGroup kGroups[] =
+    {
+        { "histogram", RunHistogramTests },
+        { "important_file_writer", RunImportantFileWriterTests },
+        { "json_reader", RunJSONReaderTests },
+        { "logging", RunLoggingTests },
+        { "parallel_file_walker", RunParallelFileWalkerTests },
+        { "pickle", RunPickleTests },
+        { "string_search", RunStringSearchTests },
+        { "string_split", RunStringSplitTests },
+        { "utf_string_conversions", RunUTFStringConversionsTests },
+    };
+
+    bool IsSelected(const char* name, int argc, char** argv)
+    {
+        if (argc < 2)
+        {
+            return true;
+        }
+        for (int i = 1; i < argc; ++i)
+        {
+            if (strstr(name, argv[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    base::AtExitManager exit_manager;
+    for (size_t i = 0; i < arraysize(kGroups); ++i)
+    {
+        if (IsSelected(kGroups[i].name, argc, argv))
+        {
+            printf("[%s]\n", kGroups[i].name);
+            kGroups[i].run();
+        }
+    }
+    return base::test::ReportFailures();
+}
@@ -0,0 +1,42 @@
+#include "test_util.h"
+
+namespace base
+{
+    namespace test
+    {
+
+        int& FailureCount()
+        {
+            static int failures = 0;
+            return failures;
+        }
+
+        int ReportFailures()
+        {
+            int failures = FailureCount();
+            if (failures)
+            {
+                fprintf(stderr, "%d checks failed\n", failures);
+            }
+            else
+            {
+                printf("all checks passed\n");
+            }
+            return failures;
+        }
+
+        void PrintRate(const char* name, double ms, double count,
+            const char* unit)
+        {
+            printf("%-36s %10.1f ms %12.0f %s/s\n", name, ms,
+                ms > 0 ? count / ms * 1000 : 0.0, unit);
+        }
+
+        void PrintCost(const char* name, double ms, double count)
+        {
+            printf("%-36s %10.1f ms %12.1f ns each\n", name, ms,
+                count > 0 ? ms * 1000000 / count : 0.0);
+        }
+
+    } //namespace test
+} //namespace base
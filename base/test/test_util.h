@@ -0,0 +1,59 @@
+#ifndef __base_test_util_h__
+#define __base_test_util_h__
+
+#include <stdio.h>
+
+#include "base/base_time.h"
+
+// Helpers for the console test programs: checks that count failures
+// without stopping, and timings printed as rates.  Neither needs a test
+// framework.
+
+namespace base
+{
+    namespace test
+    {
+
+        // Failed EXPECT()s so far in this process.
+        int& FailureCount();
+
+        // Prints the number of failed checks, or that all passed, and
+        // returns it, as the exit code of a unit test program.
+        int ReportFailures();
+
+        class Timer
+        {
+        public:
+            Timer() : start_(TimeTicks::HighResNow()) {}
+
+            double ElapsedMs() const
+            {
+                return (TimeTicks::HighResNow() - start_).InMillisecondsF();
+            }
+
+        private:
+            TimeTicks start_;
+        };
+
+        // One line of a timing report: |count| |unit|s took |ms|.
+        void PrintRate(const char* name, double ms, double count,
+            const char* unit);
+
+        // The same with the time per unit, for costs of nanoseconds.
+        void PrintCost(const char* name, double ms, double count);
+
+    } //namespace test
+} //namespace base
+
+#define EXPECT(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            ++base::test::FailureCount(); \
+            fprintf(stderr, "%s(%d): %s failed\n", __FILE__, __LINE__, \
+                #condition); \
+        } \
+    } while (false)
+
+#endif //__base_test_util_h__
@@ -0,0 +1,49 @@
+// Prints the threads and counters of a running process's StatsTable.
+//
+//   stats_dump <table name> [interval in ms]
+//
+// With an interval the table is printed again and again until the program
+// is stopped.  The table is mapped read-only, so the process that owns it is
+// not slowed down.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/metric/stats_table.h"
+#include "base/threading/platform_thread.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <table name> [interval in ms]\n", argv[0]);
+        return 1;
+    }
+
+    base::AtExitManager exit_manager;
+    base::StatsTableReader reader;
+    if (!reader.Open(argv[1]))
+    {
+        fprintf(stderr, "no StatsTable named %s\n", argv[1]);
+        return 1;
+    }
+
+    int interval_ms = argc > 2 ? atoi(argv[2]) : 0;
+    for (;;)
+    {
+        std::string snapshot;
+        reader.WriteSnapshot(&snapshot);
+        fputs(snapshot.c_str(), stdout);
+        fflush(stdout);
+        if (interval_ms <= 0)
+        {
+            break;
+        }
+        base::PlatformThread::Sleep(interval_ms);
+        fputs("\n", stdout);
+    }
+    return 0;
+}
@@ -1,7 +1,366 @@
 #include "utf_string_conversion_utils.h"
 
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <intrin.h>
+#include <string.h>
+
+#include "cpu.h"
 #include "icu/icu_utf.h"
 
+#pragma intrinsic(_BitScanForward)
+
+// The kernels below use SSE2, which every target of this tree has.  The
+// AVX2 versions are compiled into the same file, which VC++ allows without
+// /arch:AVX2, and only run once HasAVX2() has seen the CPU support them.
+
+namespace
+{
+    bool HasAVX2()
+    {
+        static const bool has_avx2 = base::CPU().has_avx2() != 0;
+        return has_avx2;
+    }
+
+    // Number of bytes of the sequence that starts with |lead|, which must
+    // be a valid lead byte.
+    inline size_t ValidSequenceLength(unsigned char lead)
+    {
+        return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    }
+
+    // Length of a sequence cut off at the end of |src|, which is well-formed
+    // UTF-8 apart from that, or 0 if |src| ends on a character boundary.
+    size_t IncompleteTailLength(const char* src, size_t src_len)
+    {
+        for (size_t back = 1; back <= 3 && back <= src_len; ++back)
+        {
+            unsigned char c = static_cast<unsigned char>(src[src_len - back]);
+            if ((c & 0xC0) != 0x80)
+            {
+                return ValidSequenceLength(c) > back ? back : 0;
+            }
+        }
+        return 0;
+    }
+
+    // Decodes the well-formed sequence at |src| into |dest| and returns the
+    // number of UTF-16 units written.  |*length| receives its byte count.
+    inline size_t DecodeValidSequence(const char* src, char16* dest,
+        size_t* length)
+    {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+        if (s[0] < 0x80)
+        {
+            *length = 1;
+            dest[0] = s[0];
+            return 1;
+        }
+        if (s[0] < 0xE0)
+        {
+            *length = 2;
+            dest[0] = static_cast<char16>(((s[0] & 0x1F) << 6) | (s[1] & 0x3F));
+            return 1;
+        }
+        if (s[0] < 0xF0)
+        {
+            *length = 3;
+            dest[0] = static_cast<char16>(((s[0] & 0x0F) << 12) |
+                ((s[1] & 0x3F) << 6) | (s[2] & 0x3F));
+            return 1;
+        }
+        *length = 4;
+        uint32 code_point = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) |
+            ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        dest[0] = static_cast<char16>((code_point >> 10) + 0xD7C0);
+        dest[1] = static_cast<char16>((code_point & 0x3FF) | 0xDC00);
+        return 2;
+    }
+
+    // Writes the character of the surrogate pair at |src| as UTF-8 to |dest|
+    // and returns 4, or returns 0 if |src| does not start with a pair.
+    inline size_t EncodeSurrogatePair(const char16* src, size_t src_len,
+        char* dest)
+    {
+        if (src_len < 2 || !CBU16_IS_LEAD(src[0]) || !CBU16_IS_TRAIL(src[1]))
+        {
+            return 0;
+        }
+        size_t written = 0;
+        CBU8_APPEND_UNSAFE(dest, written,
+            CBU16_GET_SUPPLEMENTARY(src[0], src[1]));
+        return written;
+    }
+
+    //------------------------------------------------------------------------
+    // SSE2
+
+    // Unsigned |a| >= |b| for each byte.
+    inline __m128i GreaterEqualU8(__m128i a, __m128i b)
+    {
+        return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+    }
+
+    inline __m128i Bytes(int value)
+    {
+        return _mm_set1_epi8(static_cast<char>(value));
+    }
+
+    // Flags each byte of |input| that breaks UTF-8, given the one, two and
+    // three bytes before it.  Checking that continuation bytes appear exactly
+    // where a lead byte asks for them, that C0, C1 and F5..FF never appear,
+    // and that the second byte after E0, ED, F0 and F4 is in range rejects
+    // every ill-formed sequence, including overlong forms and surrogates.
+    inline __m128i UTF8Errors(__m128i input, __m128i prev1, __m128i prev2,
+        __m128i prev3, bool reject_noncharacters)
+    {
+        __m128i is_continuation = _mm_cmpeq_epi8(
+            _mm_and_si128(input, Bytes(0xC0)), Bytes(0x80));
+        __m128i needs_continuation = _mm_or_si128(
+            GreaterEqualU8(prev1, Bytes(0xC0)),
+            _mm_or_si128(GreaterEqualU8(prev2, Bytes(0xE0)),
+                GreaterEqualU8(prev3, Bytes(0xF0))));
+        __m128i errors = _mm_xor_si128(is_continuation, needs_continuation);
+
+        errors = _mm_or_si128(errors, _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(input, Bytes(0xC0)),
+                _mm_cmpeq_epi8(input, Bytes(0xC1))),
+            GreaterEqualU8(input, Bytes(0xF5))));
+
+        __m128i at_least_a0 = GreaterEqualU8(input, Bytes(0xA0));
+        __m128i at_least_90 = GreaterEqualU8(input, Bytes(0x90));
+        errors = _mm_or_si128(errors, _mm_or_si128(
+            _mm_andnot_si128(at_least_a0, _mm_cmpeq_epi8(prev1, Bytes(0xE0))),
+            _mm_and_si128(at_least_a0, _mm_cmpeq_epi8(prev1, Bytes(0xED)))));
+        errors = _mm_or_si128(errors, _mm_or_si128(
+            _mm_andnot_si128(at_least_90, _mm_cmpeq_epi8(prev1, Bytes(0xF0))),
+            _mm_and_si128(at_least_90, _mm_cmpeq_epi8(prev1, Bytes(0xF4)))));
+
+        if (reject_noncharacters)
+        {
+            // U+xxFFFE and U+xxFFFF end in BF BE or BF BF, after EF or after
+            // a second byte whose low four bits are set.
+            __m128i ends_fffe = _mm_and_si128(
+                _mm_cmpeq_epi8(prev1, Bytes(0xBF)),
+                _mm_cmpeq_epi8(_mm_and_si128(input, Bytes(0xFE)), Bytes(0xBE)));
+            __m128i plane_end = _mm_or_si128(
+                _mm_cmpeq_epi8(prev2, Bytes(0xEF)),
+                _mm_cmpeq_epi8(_mm_and_si128(prev2, Bytes(0xCF)), Bytes(0x8F)));
+            errors = _mm_or_si128(errors, _mm_and_si128(ends_fffe, plane_end));
+
+            // U+FDD0..U+FDEF are EF B7 90..AF.
+            __m128i in_fdd0_block = _mm_and_si128(
+                _mm_cmpeq_epi8(prev2, Bytes(0xEF)),
+                _mm_cmpeq_epi8(prev1, Bytes(0xB7)));
+            errors = _mm_or_si128(errors, _mm_and_si128(in_fdd0_block,
+                _mm_andnot_si128(GreaterEqualU8(input, Bytes(0xB0)), at_least_90)));
+        }
+        return errors;
+    }
+
+    // Whether the 16 bytes of |input|, which follow those of |prev|, break
+    // UTF-8 anywhere.
+    inline bool HasUTF8Errors(__m128i input, __m128i prev,
+        bool reject_noncharacters)
+    {
+        // A block whose last three bytes reach these values starts a
+        // sequence that goes on in the next block.
+        const __m128i incomplete_limits = _mm_setr_epi8(-1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xEF),
+            static_cast<char>(0xDF), static_cast<char>(0xBF));
+        bool prev_incomplete = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_subs_epu8(prev, incomplete_limits), _mm_setzero_si128())) !=
+            0xFFFF;
+        if (!_mm_movemask_epi8(input) && !prev_incomplete)
+        {
+            return false;
+        }
+
+        __m128i prev1 = _mm_or_si128(_mm_slli_si128(input, 1),
+            _mm_srli_si128(prev, 15));
+        __m128i prev2 = _mm_or_si128(_mm_slli_si128(input, 2),
+            _mm_srli_si128(prev, 14));
+        __m128i prev3 = _mm_or_si128(_mm_slli_si128(input, 3),
+            _mm_srli_si128(prev, 13));
+        return _mm_movemask_epi8(UTF8Errors(input, prev1, prev2, prev3,
+            reject_noncharacters)) != 0;
+    }
+
+    size_t ValidateUTF8SSE2(const char* src, size_t src_len,
+        bool reject_noncharacters)
+    {
+        __m128i prev = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= src_len; i += 16)
+        {
+            __m128i input = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            if (HasUTF8Errors(input, prev, reject_noncharacters))
+            {
+                return i - IncompleteTailLength(src, i);
+            }
+            prev = input;
+        }
+
+        // The last few bytes, if any, padded with zeros, which turn a
+        // sequence cut off at the end into an error.
+        char tail[16] = { 0 };
+        memcpy(tail, src + i, src_len - i);
+        if (HasUTF8Errors(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(tail)), prev,
+            reject_noncharacters))
+        {
+            return i - IncompleteTailLength(src, i);
+        }
+        return src_len;
+    }
+
+    // Computes, for the eight bytes of |b0| widened to 16 bits, the UTF-16
+    // unit of a one, two or three byte sequence starting there, given the
+    // following bytes |b1| and |b2|.  Lanes of continuation bytes and of four
+    // byte leads hold garbage.
+    inline __m128i DecodeLanes(__m128i b0, __m128i b1, __m128i b2)
+    {
+        const __m128i low6 = _mm_set1_epi16(0x3F);
+        __m128i two = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(b0, _mm_set1_epi16(0x1F)), 6),
+            _mm_and_si128(b1, low6));
+        __m128i three = _mm_or_si128(_mm_or_si128(
+            _mm_slli_epi16(b0, 12),
+            _mm_slli_epi16(_mm_and_si128(b1, low6), 6)),
+            _mm_and_si128(b2, low6));
+        __m128i is_two = _mm_cmpgt_epi16(b0, _mm_set1_epi16(0xBF));
+        __m128i is_three = _mm_cmpgt_epi16(b0, _mm_set1_epi16(0xDF));
+        __m128i value = _mm_or_si128(_mm_and_si128(is_two, two),
+            _mm_andnot_si128(is_two, b0));
+        return _mm_or_si128(_mm_and_si128(is_three, three),
+            _mm_andnot_si128(is_three, value));
+    }
+
+    //------------------------------------------------------------------------
+    // AVX2
+
+    inline __m256i GreaterEqualU8(__m256i a, __m256i b)
+    {
+        return _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a);
+    }
+
+    inline __m256i Bytes256(int value)
+    {
+        return _mm256_set1_epi8(static_cast<char>(value));
+    }
+
+    // UTF8Errors() for 32 bytes.
+    inline __m256i UTF8Errors(__m256i input, __m256i prev1, __m256i prev2,
+        __m256i prev3, bool reject_noncharacters)
+    {
+        __m256i is_continuation = _mm256_cmpeq_epi8(
+            _mm256_and_si256(input, Bytes256(0xC0)), Bytes256(0x80));
+        __m256i needs_continuation = _mm256_or_si256(
+            GreaterEqualU8(prev1, Bytes256(0xC0)),
+            _mm256_or_si256(GreaterEqualU8(prev2, Bytes256(0xE0)),
+                GreaterEqualU8(prev3, Bytes256(0xF0))));
+        __m256i errors = _mm256_xor_si256(is_continuation, needs_continuation);
+
+        errors = _mm256_or_si256(errors, _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(input, Bytes256(0xC0)),
+                _mm256_cmpeq_epi8(input, Bytes256(0xC1))),
+            GreaterEqualU8(input, Bytes256(0xF5))));
+
+        __m256i at_least_a0 = GreaterEqualU8(input, Bytes256(0xA0));
+        __m256i at_least_90 = GreaterEqualU8(input, Bytes256(0x90));
+        errors = _mm256_or_si256(errors, _mm256_or_si256(
+            _mm256_andnot_si256(at_least_a0,
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xE0))),
+            _mm256_and_si256(at_least_a0,
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xED)))));
+        errors = _mm256_or_si256(errors, _mm256_or_si256(
+            _mm256_andnot_si256(at_least_90,
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xF0))),
+            _mm256_and_si256(at_least_90,
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xF4)))));
+
+        if (reject_noncharacters)
+        {
+            __m256i ends_fffe = _mm256_and_si256(
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xBF)),
+                _mm256_cmpeq_epi8(_mm256_and_si256(input, Bytes256(0xFE)),
+                    Bytes256(0xBE)));
+            __m256i plane_end = _mm256_or_si256(
+                _mm256_cmpeq_epi8(prev2, Bytes256(0xEF)),
+                _mm256_cmpeq_epi8(_mm256_and_si256(prev2, Bytes256(0xCF)),
+                    Bytes256(0x8F)));
+            errors = _mm256_or_si256(errors,
+                _mm256_and_si256(ends_fffe, plane_end));
+
+            __m256i in_fdd0_block = _mm256_and_si256(
+                _mm256_cmpeq_epi8(prev2, Bytes256(0xEF)),
+                _mm256_cmpeq_epi8(prev1, Bytes256(0xB7)));
+            errors = _mm256_or_si256(errors, _mm256_and_si256(in_fdd0_block,
+                _mm256_andnot_si256(GreaterEqualU8(input, Bytes256(0xB0)),
+                    at_least_90)));
+        }
+        return errors;
+    }
+
+    size_t ValidateUTF8AVX2(const char* src, size_t src_len,
+        bool reject_noncharacters)
+    {
+        const __m256i incomplete_limits = _mm256_setr_epi8(-1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xEF),
+            static_cast<char>(0xDF), static_cast<char>(0xBF));
+        const __m256i zero = _mm256_setzero_si256();
+
+        __m256i prev = zero;
+        size_t i = 0;
+        for (; i + 32 <= src_len; i += 32)
+        {
+            __m256i input = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i));
+            bool prev_incomplete = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_subs_epu8(prev, incomplete_limits), zero)) != -1;
+            if (!_mm256_movemask_epi8(input) && !prev_incomplete)
+            {
+                prev = input;
+                continue;
+            }
+
+            // The 16 bytes before |input|: the high half of |prev| and the
+            // low half of |input|.
+            __m256i carried = _mm256_permute2x128_si256(prev, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+            __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+            if (_mm256_movemask_epi8(UTF8Errors(input, prev1, prev2, prev3,
+                reject_noncharacters)))
+            {
+                break;
+            }
+            prev = input;
+        }
+        return i - IncompleteTailLength(src, i);
+    }
+
+    size_t CountLeadingASCIIAVX2(const char* src, size_t src_len)
+    {
+        size_t i = 0;
+        for (; i + 32 <= src_len; i += 32)
+        {
+            int mask = _mm256_movemask_epi8(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i)));
+            if (mask)
+            {
+                unsigned long first;
+                _BitScanForward(&first, static_cast<unsigned long>(mask));
+                return i + first;
+            }
+        }
+        return i;
+    }
+
+}
+
 namespace base
 {
 
@@ -72,6 +431,298 @@ namespace base
         return CBU16_MAX_LENGTH;
     }
 
+    size_t CountLeadingASCII(const char* src, size_t src_len)
+    {
+        size_t i = 0;
+        if (src_len >= 32 && HasAVX2())
+        {
+            i = CountLeadingASCIIAVX2(src, src_len);
+            if (i < src_len && static_cast<unsigned char>(src[i]) >= 0x80)
+            {
+                return i;
+            }
+        }
+        for (; i + 16 <= src_len; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            int mask = _mm_movemask_epi8(chunk);
+            if (mask)
+            {
+                unsigned long first;
+                _BitScanForward(&first, mask);
+                return i + first;
+            }
+        }
+        while (i < src_len && static_cast<unsigned char>(src[i]) < 0x80)
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    size_t CountLeadingASCII(const char16* src, size_t src_len)
+    {
+        const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= src_len; i += 8)
+        {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            __m128i ascii = _mm_cmpeq_epi16(
+                _mm_and_si128(chunk, non_ascii_bits), zero);
+            int mask = _mm_movemask_epi8(ascii) ^ 0xFFFF;
+            if (mask)
+            {
+                unsigned long first;
+                _BitScanForward(&first, mask);
+                return i + first / 2;
+            }
+        }
+        while (i < src_len && src[i] < 0x80)
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    void AppendASCII(const char* src, size_t src_len, string16* output)
+    {
+        size_t offset = output->length();
+        output->resize(offset + src_len);
+        char16* dest = &(*output)[offset];
+
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= src_len; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8),
+                _mm_unpackhi_epi8(chunk, zero));
+        }
+        for (; i < src_len; ++i)
+        {
+            dest[i] = static_cast<unsigned char>(src[i]);
+        }
+    }
+
+    void AppendASCII(const char16* src, size_t src_len, std::string* output)
+    {
+        size_t offset = output->length();
+        output->resize(offset + src_len);
+        char* dest = &(*output)[offset];
+
+        size_t i = 0;
+        for (; i + 16 <= src_len; i += 16)
+        {
+            __m128i low = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            __m128i high = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i + 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                _mm_packus_epi16(low, high));
+        }
+        for (; i < src_len; ++i)
+        {
+            dest[i] = static_cast<char>(src[i]);
+        }
+    }
+
+    size_t CountLeadingValidUTF8(const char* src, size_t src_len,
+        bool reject_noncharacters)
+    {
+        size_t valid = 0;
+        if (src_len >= 32 && HasAVX2())
+        {
+            valid = ValidateUTF8AVX2(src, src_len, reject_noncharacters);
+        }
+        return valid + ValidateUTF8SSE2(src + valid, src_len - valid,
+            reject_noncharacters);
+    }
+
+    size_t DecodeValidUTF8(const char* src, size_t src_len, char16* dest)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        char16* out = dest;
+        size_t i = 0;
+
+        // A block decodes the sequences that start in its 16 bytes, which
+        // may run two bytes past it; four byte sequences are done one by one.
+        while (i + 18 <= src_len)
+        {
+            __m128i input = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            if (!_mm_movemask_epi8(input))
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                    _mm_unpacklo_epi8(input, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8),
+                    _mm_unpackhi_epi8(input, zero));
+                out += 16;
+                i += 16;
+                continue;
+            }
+
+            __m128i next1 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i + 1));
+            __m128i next2 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i + 2));
+            char16 units[16];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(units), DecodeLanes(
+                _mm_unpacklo_epi8(input, zero), _mm_unpacklo_epi8(next1, zero),
+                _mm_unpacklo_epi8(next2, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(units + 8), DecodeLanes(
+                _mm_unpackhi_epi8(input, zero), _mm_unpackhi_epi8(next1, zero),
+                _mm_unpackhi_epi8(next2, zero)));
+
+            // Keep the units of the lead bytes, in order.
+            int continuations = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_and_si128(input, Bytes(0xC0)), Bytes(0x80)));
+            int four_byte_leads = _mm_movemask_epi8(
+                GreaterEqualU8(input, Bytes(0xF0)));
+            unsigned long leads = ~continuations & 0xFFFF;
+            unsigned long last = 0;
+            while (leads)
+            {
+                _BitScanForward(&last, leads);
+                leads &= leads - 1;
+                if (four_byte_leads & (1 << last))
+                {
+                    size_t length;
+                    out += DecodeValidSequence(src + i + last, out, &length);
+                }
+                else
+                {
+                    *out++ = units[last];
+                }
+            }
+            i += last + ValidSequenceLength(
+                static_cast<unsigned char>(src[i + last]));
+        }
+
+        while (i < src_len)
+        {
+            size_t length;
+            out += DecodeValidSequence(src + i, out, &length);
+            i += length;
+        }
+        return out - dest;
+    }
+
+    size_t EncodeUTF8UpToLoneSurrogate(const char16* src, size_t src_len,
+        char* dest, size_t* src_read)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i low6 = _mm_set1_epi16(0x3F);
+        const __m128i continuation = _mm_set1_epi16(0x80);
+        char* out = dest;
+        size_t i = 0;
+        while (i + 8 <= src_len)
+        {
+            __m128i units = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i));
+            __m128i one_byte = _mm_cmpeq_epi16(
+                _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xFF80))),
+                zero);
+            __m128i up_to_two_bytes = _mm_cmpeq_epi16(
+                _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))),
+                zero);
+            int surrogates = _mm_movemask_epi8(_mm_cmpeq_epi16(
+                _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))),
+                _mm_set1_epi16(static_cast<short>(0xD800))));
+            if (!surrogates && _mm_movemask_epi8(one_byte) == 0xFFFF)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+                    _mm_packus_epi16(units, units));
+                out += 8;
+                i += 8;
+                continue;
+            }
+
+            // Build the up to three bytes of each unit in a 32 bit word, so
+            // that each is written with one store and the output pointer
+            // moves on by the sequence length.
+            __m128i two_lead = _mm_or_si128(_mm_srli_epi16(units, 6),
+                _mm_set1_epi16(0xC0));
+            __m128i three_lead = _mm_or_si128(_mm_srli_epi16(units, 12),
+                _mm_set1_epi16(0xE0));
+            __m128i first = _mm_or_si128(
+                _mm_and_si128(one_byte, units),
+                _mm_andnot_si128(one_byte, _mm_or_si128(
+                    _mm_and_si128(up_to_two_bytes, two_lead),
+                    _mm_andnot_si128(up_to_two_bytes, three_lead))));
+            __m128i second = _mm_or_si128(_mm_and_si128(_mm_or_si128(
+                _mm_and_si128(up_to_two_bytes, units),
+                _mm_andnot_si128(up_to_two_bytes, _mm_srli_epi16(units, 6))),
+                low6), continuation);
+            __m128i third = _mm_or_si128(_mm_and_si128(units, low6),
+                continuation);
+            __m128i first_two = _mm_or_si128(first, _mm_slli_epi16(second, 8));
+
+            uint32 words[8];
+            uint16 lengths[8];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(words),
+                _mm_unpacklo_epi16(first_two, third));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(words + 4),
+                _mm_unpackhi_epi16(first_two, third));
+            // 3, less one for each mask that is set (all ones, so -1).
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lengths),
+                _mm_add_epi16(_mm_add_epi16(_mm_set1_epi16(3), one_byte),
+                    up_to_two_bytes));
+
+            unsigned long count = 8;
+            if (surrogates)
+            {
+                _BitScanForward(&count, surrogates);
+                count /= 2;
+            }
+            for (unsigned long j = 0; j < count; ++j)
+            {
+                memcpy(out, &words[j], 4);
+                out += lengths[j];
+            }
+            i += count;
+            if (count < 8)
+            {
+                // Pairs are written here, so that text made of them does not
+                // leave the loop at every character.
+                size_t pair = EncodeSurrogatePair(src + i, src_len - i, out);
+                if (!pair)
+                {
+                    *src_read = i;
+                    return out - dest;
+                }
+                out += pair;
+                i += 2;
+            }
+        }
+
+        while (i < src_len)
+        {
+            if (CBU16_IS_SURROGATE(src[i]))
+            {
+                size_t pair = EncodeSurrogatePair(src + i, src_len - i, out);
+                if (!pair)
+                {
+                    break;
+                }
+                out += pair;
+                i += 2;
+                continue;
+            }
+            size_t offset = 0;
+            CBU8_APPEND_UNSAFE(out, offset, src[i]);
+            out += offset;
+            ++i;
+        }
+        *src_read = i;
+        return out - dest;
+    }
+
     template<typename CHAR>
     void PrepareForUTF8Output(const CHAR* src,
         size_t src_len, std::string* output)
@@ -29,6 +29,40 @@ namespace base
 
     size_t WriteUnicodeCharacter(uint32 code_point, string16* output);
 
+    // Return the number of leading ASCII characters in |src|.  The input is
+    // scanned 16 bytes at a time with SSE2, or 32 with AVX2 where the CPU
+    // has it.
+    size_t CountLeadingASCII(const char* src, size_t src_len);
+    size_t CountLeadingASCII(const char16* src, size_t src_len);
+
+    // Return the length of a prefix of |src| that is well-formed UTF-8 and
+    // ends on a character boundary: all of it if it is valid.  Blocks of 16
+    // bytes (SSE2) or 32 (AVX2) are checked at once, so the prefix may stop
+    // up to a block short of the first error; callers decode the next
+    // character the slow way and call again.  With |reject_noncharacters|
+    // the noncharacters U+FDD0..U+FDEF and U+xxFFFE/U+xxFFFF end the prefix
+    // as well.
+    size_t CountLeadingValidUTF8(const char* src, size_t src_len,
+        bool reject_noncharacters);
+
+    // Convert |src|, which must be a prefix accepted by
+    // CountLeadingValidUTF8(), to UTF-16 at |dest|, which needs room for
+    // |src_len| units.  Returns the number of units written.
+    size_t DecodeValidUTF8(const char* src, size_t src_len, char16* dest);
+
+    // Convert the units of |src| up to the first surrogate that is not part
+    // of a pair, or all of them, to UTF-8 at |dest|, which needs room for
+    // 3 * |src_len| + 3 bytes.
+    // Stores the number of units read in |*src_read| and returns the number
+    // of bytes written.
+    size_t EncodeUTF8UpToLoneSurrogate(const char16* src, size_t src_len,
+        char* dest, size_t* src_read);
+
+    // Append |src_len| characters known to be ASCII to |output|, widening or
+    // narrowing them with SSE2.
+    void AppendASCII(const char* src, size_t src_len, string16* output);
+    void AppendASCII(const char16* src, size_t src_len, std::string* output);
+
     template<typename CHAR>
     void PrepareForUTF8Output(const CHAR* src, size_t src_len, std::string* output);
 
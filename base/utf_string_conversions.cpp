@@ -1,8 +1,14 @@
 #include "utf_string_conversions.h"
 
+#include <algorithm>
+
+#include "icu/icu_utf.h"
 #include "string_util.h"
 #include "utf_string_conversion_utils.h"
 
+using base::CountLeadingValidUTF8;
+using base::DecodeValidUTF8;
+using base::EncodeUTF8UpToLoneSurrogate;
 using base::PrepareForUTF8Output;
 using base::PrepareForUTF16Or32Output;
 using base::ReadUnicodeCharacter;
@@ -10,29 +16,135 @@ using base::WriteUnicodeCharacter;
 
 namespace
 {
-    template<typename SRC_CHAR, typename DEST_STRING>
-    bool ConvertUnicode(const SRC_CHAR* src,
-        size_t src_len, DEST_STRING* output)
+    // Input converted per step.  Each step is converted into a buffer on
+    // the stack and appended, so the output is never filled ahead of the
+    // conversion and only grows by what was written.
+    const size_t kConversionStep = 2048;
+
+    // Appends the conversion of |src| to |output|.  What the SIMD validator
+    // accepts is decoded in bulk; the character it stopped at is decoded
+    // the slow way, and written as U+FFFD if it is invalid.
+    bool ConvertUnicode(const char* src, size_t src_len, string16* output)
     {
+        // Never more units than bytes, and the last character of a step may
+        // run up to three bytes past it.
+        char16 buffer[kConversionStep + 3];
         bool success = true;
         int32 src_len32 = static_cast<int32>(src_len);
-        for (int32 i = 0; i < src_len32; i++)
+        size_t i = 0;
+        while (i < src_len)
         {
-            uint32 code_point;
-            if (ReadUnicodeCharacter(src, src_len32, &i, &code_point))
+            size_t step_end = std::min(src_len, i + kConversionStep);
+            size_t written = 0;
+            while (i < step_end)
             {
-                WriteUnicodeCharacter(code_point, output);
+                size_t valid = CountLeadingValidUTF8(src + i, step_end - i,
+                    false);
+                written += DecodeValidUTF8(src + i, valid, buffer + written);
+                i += valid;
+                if (i == step_end)
+                {
+                    break;
+                }
+
+                int32 char_index = static_cast<int32>(i);
+                uint32 code_point;
+                if (!ReadUnicodeCharacter(src, src_len32, &char_index,
+                    &code_point))
+                {
+                    code_point = 0xFFFD;
+                    success = false;
+                }
+                CBU16_APPEND_UNSAFE(buffer, written, code_point);
+                i = static_cast<size_t>(char_index) + 1;
             }
-            else
+            output->append(buffer, written);
+        }
+        return success;
+    }
+
+    bool ConvertUnicode(const char16* src, size_t src_len, std::string* output)
+    {
+        // At most three bytes per unit, and the encoder writes whole 32 bit
+        // words.  A lone surrogate becomes U+FFFD, and a pair cut by the end
+        // of a step four bytes, which fits either way.
+        char buffer[3 * kConversionStep + 3];
+        bool success = true;
+        int32 src_len32 = static_cast<int32>(src_len);
+        size_t i = 0;
+        while (i < src_len)
+        {
+            size_t step_end = std::min(src_len, i + kConversionStep);
+            size_t written = 0;
+            while (i < step_end)
             {
-                WriteUnicodeCharacter(0xFFFD, output);
-                success = false;
+                size_t read;
+                written += EncodeUTF8UpToLoneSurrogate(src + i, step_end - i,
+                    buffer + written, &read);
+                i += read;
+                if (i == step_end)
+                {
+                    break;
+                }
+
+                int32 char_index = static_cast<int32>(i);
+                uint32 code_point;
+                if (!ReadUnicodeCharacter(src, src_len32, &char_index,
+                    &code_point))
+                {
+                    code_point = 0xFFFD;
+                    success = false;
+                }
+                CBU8_APPEND_UNSAFE(buffer, written, code_point);
+                i = static_cast<size_t>(char_index) + 1;
             }
+            output->append(buffer, written);
         }
-
         return success;
     }
 
+    // Returns the number of bytes a sequence starting with |lead| should
+    // have, or 1 for bytes that cannot start a multi-byte sequence.
+    size_t UTF8SequenceLength(unsigned char lead)
+    {
+        if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            return 4;
+        }
+        if (lead >= 0xE0 && lead < 0xF0)
+        {
+            return 3;
+        }
+        if (lead >= 0xC2 && lead < 0xE0)
+        {
+            return 2;
+        }
+        return 1;
+    }
+
+    bool IsUTF8Trail(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    // Returns the length of a sequence cut off at the end of |src|, or 0 if
+    // |src| ends on a character boundary.
+    size_t IncompleteTailLength(const char* src, size_t src_len)
+    {
+        size_t tail = 0;
+        while (tail < 3 && tail < src_len && IsUTF8Trail(src[src_len - tail - 1]))
+        {
+            ++tail;
+        }
+        if (tail == src_len)
+        {
+            return 0;
+        }
+        size_t needed = UTF8SequenceLength(
+            static_cast<unsigned char>(src[src_len - tail - 1]));
+        return needed > tail + 1 ? tail + 1 : 0;
+    }
+
 }
 
 // UTF-8 <-> Wide --------------------------------------------------------------
@@ -110,6 +222,62 @@ std::string UTF16ToUTF8(const string16& utf16)
     return WideToUTF8(utf16);
 }
 
+// UTF8ToUTF16Stream -----------------------------------------------------------
+
+UTF8ToUTF16Stream::UTF8ToUTF16Stream() : pending_length_(0), had_errors_(false) {}
+
+bool UTF8ToUTF16Stream::Convert(const char* src, size_t src_len,
+    string16* output)
+{
+    bool success = true;
+
+    // Complete the sequence held back from the previous chunk first.  It only
+    // takes trail bytes, so a broken sequence does not swallow the next
+    // character.
+    if (pending_length_)
+    {
+        size_t needed = UTF8SequenceLength(
+            static_cast<unsigned char>(pending_[0]));
+        while (pending_length_ < needed && src_len && IsUTF8Trail(*src))
+        {
+            pending_[pending_length_++] = *src++;
+            --src_len;
+        }
+        if (pending_length_ < needed && !src_len)
+        {
+            return true; // Still incomplete, wait for more input.
+        }
+        success = ConvertUnicode(pending_, pending_length_, output);
+        pending_length_ = 0;
+    }
+
+    size_t tail = IncompleteTailLength(src, src_len);
+    if (!ConvertUnicode(src, src_len - tail, output))
+    {
+        success = false;
+    }
+    memcpy(pending_, src + src_len - tail, tail);
+    pending_length_ = tail;
+
+    if (!success)
+    {
+        had_errors_ = true;
+    }
+    return success;
+}
+
+bool UTF8ToUTF16Stream::Finish(string16* output)
+{
+    if (!pending_length_)
+    {
+        return true;
+    }
+    WriteUnicodeCharacter(0xFFFD, output);
+    pending_length_ = 0;
+    had_errors_ = true;
+    return false;
+}
+
 std::wstring ASCIIToWide(const base::StringPiece& ascii)
 {
     DCHECK(IsStringASCII(ascii)) << ascii;
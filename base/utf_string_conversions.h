@@ -1,6 +1,7 @@
 #ifndef __base_utf_string_conversions_h__
 #define __base_utf_string_conversions_h__
 
+#include "basic_types.h"
 #include "string_piece.h"
 #include "string16.h"
 
@@ -19,6 +20,34 @@ string16 UTF8ToUTF16(const std::string& utf8);
 bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output);
 std::string UTF16ToUTF8(const string16& utf16);
 
+// Converts UTF-8 that arrives in chunks, such as a file read block by block,
+// without splitting a character that straddles two chunks: the bytes of a
+// sequence cut off at the end of a chunk are held back until the next call.
+// Invalid input is replaced with U+FFFD, as UTF8ToUTF16() does.
+class UTF8ToUTF16Stream
+{
+public:
+    UTF8ToUTF16Stream();
+
+    // Appends the conversion of |src| to |output|.  Returns false if this
+    // chunk contained invalid input.
+    bool Convert(const char* src, size_t src_len, string16* output);
+
+    // Call at the end of the input.  A sequence still held back is incomplete
+    // and is written as U+FFFD, in which case false is returned.
+    bool Finish(string16* output);
+
+    // True if any chunk so far contained invalid input.
+    bool had_errors() const { return had_errors_; }
+
+private:
+    char pending_[4];
+    size_t pending_length_;
+    bool had_errors_;
+
+    DISALLOW_COPY_AND_ASSIGN(UTF8ToUTF16Stream);
+};
+
 std::wstring ASCIIToWide(const base::StringPiece& ascii);
 string16 ASCIIToUTF16(const base::StringPiece& ascii);
 
@@ -0,0 +1,125 @@
+// Throughput of IsStringUTF8() and of the UTF-8 <-> UTF-16 conversions on
+// 16 MB of ASCII, Latin, CJK and emoji text, next to UTF-8 decoded one
+// character at a time as the conversions did before they had SIMD paths.
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/string_util.h"
+#include "base/test/test_util.h"
+#include "base/utf_string_conversion_utils.h"
+#include "base/utf_string_conversions.h"
+
+namespace
+{
+
+    const size_t kTextBytes = 16 * 1024 * 1024;
+    const int kRepeats = 10;
+
+    // Code points to pick text from.  Latin text is mostly ASCII with an
+    // accented letter in about every eighth character.
+    struct Corpus
+    {
+        const char* name;
+        uint32 first;
+        uint32 count;
+        int ascii_per_character;
+    };
+
+    const Corpus kCorpora[] =
+    {
+        { "ASCII", 0x20, 0x5F, 0 },
+        { "Latin", 0xC0, 0x40, 7 },
+        { "CJK", 0x4E00, 0x5200, 0 },
+        { "emoji", 0x1F300, 0x300, 0 },
+    };
+
+    std::string MakeText(const Corpus& corpus)
+    {
+        unsigned int state = 1;
+        std::string text;
+        text.reserve(kTextBytes + 4);
+        while (text.length() < kTextBytes)
+        {
+            for (int i = 0; i < corpus.ascii_per_character; ++i)
+            {
+                text += static_cast<char>('a' + i);
+            }
+            state = state * 1103515245 + 12345;
+            base::WriteUnicodeCharacter(
+                corpus.first + (state >> 8) % corpus.count, &text);
+        }
+        return text;
+    }
+
+    void PrintMegabytes(const char* corpus, const char* what, double ms,
+        size_t bytes)
+    {
+        char name[64];
+        _snprintf_s(name, sizeof(name), _TRUNCATE, "%s, %s", what, corpus);
+        base::test::PrintRate(name, ms, kRepeats * bytes / (1024.0 * 1024.0),
+            "MB");
+    }
+
+    void TimeCorpus(const Corpus& corpus)
+    {
+        std::string utf8 = MakeText(corpus);
+
+        base::test::Timer validate_timer;
+        bool valid = true;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            valid = IsStringUTF8(utf8) && valid;
+        }
+        PrintMegabytes(corpus.name, "IsStringUTF8", validate_timer.ElapsedMs(),
+            utf8.length());
+        EXPECT(valid);
+
+        string16 utf16;
+        base::test::Timer decode_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            UTF8ToUTF16(utf8.data(), utf8.length(), &utf16);
+        }
+        PrintMegabytes(corpus.name, "UTF8ToUTF16", decode_timer.ElapsedMs(),
+            utf8.length());
+
+        std::string round_trip;
+        base::test::Timer encode_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            UTF16ToUTF8(utf16.data(), utf16.length(), &round_trip);
+        }
+        PrintMegabytes(corpus.name, "UTF16ToUTF8", encode_timer.ElapsedMs(),
+            utf8.length());
+        EXPECT(round_trip == utf8);
+
+        string16 slow;
+        int32 length = static_cast<int32>(utf8.length());
+        base::test::Timer slow_timer;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            slow.clear();
+            for (int32 j = 0; j < length; ++j)
+            {
+                uint32 code_point;
+                base::ReadUnicodeCharacter(utf8.data(), length, &j,
+                    &code_point);
+                base::WriteUnicodeCharacter(code_point, &slow);
+            }
+        }
+        PrintMegabytes(corpus.name, "one character at a time",
+            slow_timer.ElapsedMs(), utf8.length());
+        EXPECT(slow == utf16);
+    }
+
+}
+
+void RunUTFStringConversionsPerfTests()
+{
+    for (size_t i = 0; i < arraysize(kCorpora); ++i)
+    {
+        TimeCorpus(kCorpora[i]);
+    }
+}
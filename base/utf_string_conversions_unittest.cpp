@@ -0,0 +1,244 @@
+// Checks the SIMD paths of the UTF-8 <-> UTF-16 conversions and of
+// IsStringUTF8() against the same conversions done one character at a time,
+// on every kind of ill-formed sequence, at block and step boundaries, and on
+// text made of each kind of character.
+
+#include <string>
+
+#include "base/icu/icu_utf.h"
+#include "base/string_util.h"
+#include "base/test/test_util.h"
+#include "base/utf_string_conversion_utils.h"
+#include "base/utf_string_conversions.h"
+
+namespace
+{
+
+    const char* const kIllFormed[] =
+    {
+        "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xED\xA0\x80",
+        "\xED\xBF\xBF", "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",
+        "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\xFE", "\x80", "\xBF",
+        "\xC2", "\xE1\x80", "\xF1\x80\x80", "\xE1\x41", "\xF8\x88\x80\x80\x80",
+    };
+
+    const uint32 kNoncharacters[] =
+    {
+        0xFDD0, 0xFDEF, 0xFFFE, 0xFFFF, 0x1FFFE, 0xEFFFF, 0x10FFFF,
+    };
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    // Appends a character of the given kind: ASCII, two, three or four bytes,
+    // a noncharacter, or an ill-formed sequence.
+    void AppendCharacter(int kind, std::string* output)
+    {
+        uint32 code_point;
+        switch (kind)
+        {
+        case 0:
+            code_point = Random(0x80);
+            break;
+        case 1:
+            code_point = 0x80 + Random(0x800 - 0x80);
+            break;
+        case 2:
+            code_point = 0x4E00 + Random(0xA000 - 0x4E00);
+            break;
+        case 3:
+            // Any plane but the noncharacters at its end.
+            code_point = 0x10000 + Random(0x100000);
+            if ((code_point & 0xFFFE) == 0xFFFE)
+            {
+                code_point -= 2;
+            }
+            break;
+        case 4:
+            code_point = kNoncharacters[Random(arraysize(kNoncharacters))];
+            break;
+        default:
+            output->append(kIllFormed[Random(arraysize(kIllFormed))]);
+            return;
+        }
+        base::WriteUnicodeCharacter(code_point, output);
+    }
+
+    std::string RandomUTF8(size_t length, int kinds)
+    {
+        std::string text;
+        while (text.length() < length)
+        {
+            AppendCharacter(Random(kinds), &text);
+        }
+        return text;
+    }
+
+    template<typename SRC_CHAR, typename DEST_STRING>
+    bool SlowConvert(const SRC_CHAR* src, size_t src_len, DEST_STRING* output)
+    {
+        bool success = true;
+        int32 src_len32 = static_cast<int32>(src_len);
+        for (int32 i = 0; i < src_len32; ++i)
+        {
+            uint32 code_point;
+            if (!base::ReadUnicodeCharacter(src, src_len32, &i, &code_point))
+            {
+                code_point = 0xFFFD;
+                success = false;
+            }
+            base::WriteUnicodeCharacter(code_point, output);
+        }
+        return success;
+    }
+
+    bool SlowIsStringUTF8(const std::string& text)
+    {
+        const char* src = text.data();
+        int32 src_len = static_cast<int32>(text.length());
+        for (int32 i = 0; i < src_len;)
+        {
+            int32 code_point;
+            CBU8_NEXT(src, i, src_len, code_point);
+            if (!base::IsValidCharacter(code_point))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ExpectConvertsLikeSlowPath(const std::string& utf8)
+    {
+        string16 expected16;
+        bool expected16_success = SlowConvert(utf8.data(), utf8.length(),
+            &expected16);
+        string16 utf16;
+        EXPECT(UTF8ToUTF16(utf8.data(), utf8.length(), &utf16) ==
+            expected16_success);
+        EXPECT(utf16 == expected16);
+
+        std::string expected8;
+        SlowConvert(utf16.data(), utf16.length(), &expected8);
+        std::string round_trip;
+        EXPECT(UTF16ToUTF8(utf16.data(), utf16.length(), &round_trip));
+        EXPECT(round_trip == expected8);
+
+        EXPECT(IsStringUTF8(utf8) == SlowIsStringUTF8(utf8));
+    }
+
+    void TestIllFormed()
+    {
+        // Each ill-formed sequence at every offset of a 32 byte block, with
+        // valid text of each length on either side.
+        for (size_t i = 0; i < arraysize(kIllFormed); ++i)
+        {
+            for (size_t before = 0; before < 40; ++before)
+            {
+                std::string text = RandomUTF8(before, 4) + kIllFormed[i] +
+                    RandomUTF8(40, 4);
+                ExpectConvertsLikeSlowPath(text);
+                EXPECT(!IsStringUTF8(text));
+            }
+        }
+    }
+
+    void TestNoncharacters()
+    {
+        // Noncharacters convert, but are not accepted by IsStringUTF8().
+        for (size_t i = 0; i < arraysize(kNoncharacters); ++i)
+        {
+            for (size_t before = 0; before < 40; ++before)
+            {
+                std::string text = RandomUTF8(before, 3);
+                base::WriteUnicodeCharacter(kNoncharacters[i], &text);
+                text += RandomUTF8(40, 3);
+                ExpectConvertsLikeSlowPath(text);
+                EXPECT(!IsStringUTF8(text));
+            }
+        }
+
+        // Their neighbours are fine.
+        std::string text;
+        base::WriteUnicodeCharacter(0xFDCF, &text);
+        base::WriteUnicodeCharacter(0xFDF0, &text);
+        base::WriteUnicodeCharacter(0xFFFD, &text);
+        base::WriteUnicodeCharacter(0x10FFFD, &text);
+        EXPECT(IsStringUTF8(text + RandomUTF8(64, 4)));
+    }
+
+    void TestRandomText()
+    {
+        for (int i = 0; i < 20000; ++i)
+        {
+            ExpectConvertsLikeSlowPath(RandomUTF8(Random(300), 4 + Random(3)));
+        }
+
+        // Text made of one kind of character, and long enough to be
+        // converted in several steps.
+        for (int kind = 0; kind < 4; ++kind)
+        {
+            std::string text = RandomUTF8(300000, kind + 1);
+            ExpectConvertsLikeSlowPath(text);
+            EXPECT(IsStringUTF8(text));
+        }
+        ExpectConvertsLikeSlowPath(RandomUTF8(300000, 6));
+    }
+
+    void TestUnpairedSurrogates()
+    {
+        for (int i = 0; i < 20000; ++i)
+        {
+            string16 utf16;
+            size_t length = Random(200);
+            for (size_t j = 0; j < length; ++j)
+            {
+                unsigned int kind = Random(5);
+                utf16 += static_cast<char16>(kind == 0 ? Random(0x80) :
+                    kind == 1 ? 0x80 + Random(0x780) :
+                    kind == 2 ? 0x800 + Random(0xD000) :
+                    0xD800 + Random(0x800));
+            }
+            std::string expected;
+            bool expected_success = SlowConvert(utf16.data(), utf16.length(),
+                &expected);
+            std::string utf8;
+            EXPECT(UTF16ToUTF8(utf16.data(), utf16.length(), &utf8) ==
+                expected_success);
+            EXPECT(utf8 == expected);
+        }
+    }
+
+    void TestStream()
+    {
+        // Valid text split into two chunks at every position converts as a
+        // whole would.
+        std::string text = RandomUTF8(100, 4);
+        string16 expected = UTF8ToUTF16(text);
+        for (size_t split = 0; split <= text.length(); ++split)
+        {
+            UTF8ToUTF16Stream stream;
+            string16 utf16;
+            EXPECT(stream.Convert(text.data(), split, &utf16));
+            EXPECT(stream.Convert(text.data() + split, text.length() - split,
+                &utf16));
+            EXPECT(stream.Finish(&utf16));
+            EXPECT(utf16 == expected);
+        }
+    }
+
+}
+
+void RunUTFStringConversionsTests()
+{
+    TestIllFormed();
+    TestNoncharacters();
+    TestRandomText();
+    TestUnpairedSurrogates();
+    TestStream();
+}
@@ -115,6 +115,9 @@ namespace base
 
         virtual ~StringValue();
 
+        // The UTF-8 value, without copying it.
+        const std::string& GetString() const { return value_; }
+
         // Overridden from Value:
         virtual bool GetAsString(std::string* out_value) const;
         virtual bool GetAsString(string16* out_value) const;
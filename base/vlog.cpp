@@ -125,6 +125,7 @@ namespace base
     void VlogInfo::SetMaxVlogLevel(int level)
     {
         *min_log_level_ = -level;
+        InvalidateVlogLevelCaches();
     }
 
     int VlogInfo::GetMaxVlogLevel() const
@@ -0,0 +1,71 @@
+// Checks of the editor's text classes, one group per class.  A console
+// program without a test framework, run by ctest: it prints each failed
+// check and returns the number of failures.  With arguments only the groups
+// whose names contain one of them run.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/at_exit.h"
+#include "base/basic_types.h"
+#include "base/test/test_util.h"
+
+void RunCppLexerTests();
+void RunSelectionSetTests();
+void RunSyntaxHighlighterTests();
+void RunTextBufferTests();
+void RunTextEditTests();
+void RunTextSearchTests();
+void RunUndoHistoryTests();
+
+namespace
+{
+
+    struct TestGroup
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const TestGroup kGroups[] =
+    {
+        { "cpp_lexer", RunCppLexerTests },
+        { "selection_set", RunSelectionSetTests },
+        { "syntax_highlighter", RunSyntaxHighlighterTests },
+        { "text_buffer", RunTextBufferTests },
+        { "text_edit", RunTextEditTests },
+        { "text_search", RunTextSearchTests },
+        { "undo_history", RunUndoHistoryTests },
+    };
+
+    bool IsSelected(const char* name, int argc, char** argv)
+    {
+        if (argc < 2)
+        {
+            return true;
+        }
+        for (int i = 1; i < argc; ++i)
+        {
+            if (strstr(name, argv[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    base::AtExitManager exit_manager;
+    for (size_t i = 0; i < arraysize(kGroups); ++i)
+    {
+        if (IsSelected(kGroups[i].name, argc, argv))
+        {
+            printf("[%s]\n", kGroups[i].name);
+            kGroups[i].run();
+        }
+    }
+    return base::test::ReportFailures();
+}
@@ -0,0 +1,386 @@
+#include "cpp_lexer.h"
+
+#include <algorithm>
+
+namespace
+{
+
+    // The low kStateKindBits of a state are one of these.  Only a raw string
+    // keeps more: the length and a hash of its delimiter, which is all that
+    // is needed to find its end, since a line that could end it has the
+    // delimiter itself.
+    enum State
+    {
+        STATE_DEFAULT = ui::Lexer::kInitialState,
+        STATE_BLOCK_COMMENT,
+        // The previous line was a preprocessor line ending in a backslash.
+        STATE_PREPROCESSOR,
+        // The previous line ended in a "//" comment with a backslash.
+        STATE_LINE_COMMENT,
+        // The previous line ended in a string literal with a backslash.
+        STATE_STRING,
+        // Inside a raw string literal R"delimiter(...)delimiter".
+        STATE_RAW_STRING,
+    };
+
+    const int kStateKindBits = 4;
+    const int kStateKindMask = (1 << kStateKindBits) - 1;
+    // Raw string delimiters are at most 16 characters.
+    const size_t kMaxDelimiterLength = 16;
+    const int kDelimiterLengthBits = 5;
+    // What is left of a non-negative int.
+    const int kDelimiterHashBits = 31 - kStateKindBits - kDelimiterLengthBits;
+
+    // Sorted for the binary search in IsKeyword().
+    const char* const kKeywords[] =
+    {
+        "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch",
+        "char", "char16_t", "char32_t", "class", "const", "const_cast",
+        "constexpr", "continue", "decltype", "default", "delete", "do",
+        "double", "dynamic_cast", "else", "enum", "explicit", "export",
+        "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+        "int", "long", "mutable", "namespace", "new", "noexcept", "nullptr",
+        "operator", "private", "protected", "public", "register",
+        "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this",
+        "thread_local", "throw", "true", "try", "typedef", "typeid",
+        "typename", "union", "unsigned", "using", "virtual", "void",
+        "volatile", "wchar_t", "while",
+    };
+
+    bool KeywordLess(const char* keyword, const base::StringPiece& word)
+    {
+        return base::StringPiece(keyword) < word;
+    }
+
+    bool IsKeyword(const base::StringPiece& word)
+    {
+        const char* const* end = kKeywords + arraysize(kKeywords);
+        const char* const* found = std::lower_bound(kKeywords, end, word,
+            KeywordLess);
+        return found != end && base::StringPiece(*found) == word;
+    }
+
+    inline bool IsIdentifierStart(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+            (c & 0x80) != 0;
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool IsIdentifierChar(char c)
+    {
+        return IsIdentifierStart(c) || IsDigit(c);
+    }
+
+    inline bool IsExponent(char c)
+    {
+        return c == 'e' || c == 'E' || c == 'p' || c == 'P';
+    }
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\f' || c == '\v';
+    }
+
+    inline bool EndsWithBackslash(const base::StringPiece& line)
+    {
+        return !line.empty() && line[line.size() - 1] == '\\';
+    }
+
+    // Returns the offset just past the "*/" at or after |from|, or npos.
+    size_t FindCommentEnd(const base::StringPiece& line, size_t from)
+    {
+        size_t end = line.find("*/", from);
+        return end == base::StringPiece::npos ? end : end + 2;
+    }
+
+    // Returns the offset just past the |quote| closing a literal whose
+    // contents start at |from|, or npos if the line ends first.
+    size_t FindQuoteEnd(const base::StringPiece& line, size_t from, char quote)
+    {
+        size_t i = from;
+        while (i < line.size())
+        {
+            if (line[i] == quote)
+            {
+                return i + 1;
+            }
+            i += (line[i] == '\\') ? 2 : 1;
+        }
+        return base::StringPiece::npos;
+    }
+
+    // Prefixes that make a string literal raw.
+    bool IsRawStringPrefix(const base::StringPiece& word)
+    {
+        return word == "R" || word == "LR" || word == "uR" || word == "UR" ||
+            word == "u8R";
+    }
+
+    inline bool IsDelimiterChar(char c)
+    {
+        return c != '(' && c != ')' && c != '\\' && c != '"' &&
+            !IsSpace(c);
+    }
+
+    // FNV-1a, cut to kDelimiterHashBits.
+    int HashDelimiter(const base::StringPiece& delimiter)
+    {
+        uint32 hash = 2166136261U;
+        for (size_t i = 0; i < delimiter.size(); ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(delimiter[i])) *
+                16777619U;
+        }
+        return static_cast<int>(hash & ((1U << kDelimiterHashBits) - 1));
+    }
+
+    int RawStringState(const base::StringPiece& delimiter)
+    {
+        return STATE_RAW_STRING |
+            (static_cast<int>(delimiter.size()) << kStateKindBits) |
+            (HashDelimiter(delimiter) <<
+            (kStateKindBits + kDelimiterLengthBits));
+    }
+
+    // Returns the offset just past the )delimiter" at or after |from|
+    // that closes the raw string of |state|, or npos.  Delimiters are told
+    // apart by length and hash, so a different delimiter with the same hash
+    // would end the string early; with 2^22 hashes that does not happen in
+    // practice.
+    size_t FindRawStringEnd(const base::StringPiece& line, size_t from,
+        int state)
+    {
+        size_t delimiter_length = (state >> kStateKindBits) &
+            ((1 << kDelimiterLengthBits) - 1);
+        int hash = state >> (kStateKindBits + kDelimiterLengthBits);
+        for (size_t i = line.find(')', from); i != base::StringPiece::npos;
+            i = line.find(')', i + 1))
+        {
+            size_t quote = i + 1 + delimiter_length;
+            if (quote < line.size() && line[quote] == '"' &&
+                HashDelimiter(line.substr(i + 1, delimiter_length)) == hash)
+            {
+                return quote + 1;
+            }
+        }
+        return base::StringPiece::npos;
+    }
+
+    // Lexes the raw string literal whose prefix starts at |start| and whose
+    // opening quote is at |quote|.  Returns false, appending nothing, if no
+    // valid delimiter and "(" follow, so the quote starts a plain string.
+    // Otherwise appends the literal's run and sets |*end| past it and
+    // |*state| to the state at the end of the line.
+    bool LexRawString(const base::StringPiece& line, size_t start,
+        size_t quote, size_t* end, int* state, ui::StyleRuns* runs)
+    {
+        size_t open = quote + 1;
+        while (open < line.size() && open - quote - 1 <= kMaxDelimiterLength &&
+            IsDelimiterChar(line[open]))
+        {
+            ++open;
+        }
+        if (open == line.size() || line[open] != '(' ||
+            open - quote - 1 > kMaxDelimiterLength)
+        {
+            return false;
+        }
+
+        int raw_state = RawStringState(
+            line.substr(quote + 1, open - quote - 1));
+        size_t close = FindRawStringEnd(line, open + 1, raw_state);
+        if (close == base::StringPiece::npos)
+        {
+            ui::AppendStyleRun(ui::STYLE_STRING, line.size() - start, runs);
+            *end = line.size();
+            *state = raw_state;
+        }
+        else
+        {
+            ui::AppendStyleRun(ui::STYLE_STRING, close - start, runs);
+            *end = close;
+            *state = STATE_DEFAULT;
+        }
+        return true;
+    }
+
+}
+
+namespace ui
+{
+
+    int CppLexer::LexLine(const base::StringPiece& line, int state,
+        StyleRuns* runs) const
+    {
+        const size_t length = line.size();
+        size_t i = 0;
+
+        if (state == STATE_BLOCK_COMMENT)
+        {
+            size_t end = FindCommentEnd(line, 0);
+            if (end == base::StringPiece::npos)
+            {
+                AppendStyleRun(STYLE_COMMENT, length, runs);
+                return STATE_BLOCK_COMMENT;
+            }
+            AppendStyleRun(STYLE_COMMENT, end, runs);
+            i = end;
+        }
+        else if (state == STATE_PREPROCESSOR)
+        {
+            AppendStyleRun(STYLE_PREPROCESSOR, length, runs);
+            return EndsWithBackslash(line) ? STATE_PREPROCESSOR : STATE_DEFAULT;
+        }
+        else if (state == STATE_LINE_COMMENT)
+        {
+            AppendStyleRun(STYLE_COMMENT, length, runs);
+            return EndsWithBackslash(line) ? STATE_LINE_COMMENT : STATE_DEFAULT;
+        }
+        else if (state == STATE_STRING)
+        {
+            size_t end = FindQuoteEnd(line, 0, '"');
+            if (end == base::StringPiece::npos)
+            {
+                AppendStyleRun(STYLE_STRING, length, runs);
+                return EndsWithBackslash(line) ? STATE_STRING : STATE_DEFAULT;
+            }
+            AppendStyleRun(STYLE_STRING, end, runs);
+            i = end;
+        }
+        else if ((state & kStateKindMask) == STATE_RAW_STRING)
+        {
+            // Backslashes do not continue anything inside a raw string; it
+            // goes on until its delimiter.
+            size_t end = FindRawStringEnd(line, 0, state);
+            if (end == base::StringPiece::npos)
+            {
+                AppendStyleRun(STYLE_STRING, length, runs);
+                return state;
+            }
+            AppendStyleRun(STYLE_STRING, end, runs);
+            i = end;
+        }
+
+        bool line_start = (i == 0);
+        while (i < length)
+        {
+            char c = line[i];
+            size_t start = i;
+
+            if (IsSpace(c))
+            {
+                while (i < length && IsSpace(line[i]))
+                {
+                    ++i;
+                }
+                AppendStyleRun(STYLE_DEFAULT, i - start, runs);
+                continue;
+            }
+
+            if (c == '#' && line_start)
+            {
+                AppendStyleRun(STYLE_PREPROCESSOR, length - i, runs);
+                return EndsWithBackslash(line) ? STATE_PREPROCESSOR :
+                    STATE_DEFAULT;
+            }
+            line_start = false;
+
+            if (c == '/' && i + 1 < length && line[i + 1] == '/')
+            {
+                AppendStyleRun(STYLE_COMMENT, length - i, runs);
+                return EndsWithBackslash(line) ? STATE_LINE_COMMENT :
+                    STATE_DEFAULT;
+            }
+
+            if (c == '/' && i + 1 < length && line[i + 1] == '*')
+            {
+                size_t end = FindCommentEnd(line, i + 2);
+                if (end == base::StringPiece::npos)
+                {
+                    AppendStyleRun(STYLE_COMMENT, length - i, runs);
+                    return STATE_BLOCK_COMMENT;
+                }
+                AppendStyleRun(STYLE_COMMENT, end - i, runs);
+                i = end;
+                continue;
+            }
+
+            if (c == '"' || c == '\'')
+            {
+                // Up to the closing quote.  An unterminated literal ends with
+                // the line, unless a string goes on after a backslash.
+                TextStyle style = (c == '"') ? STYLE_STRING : STYLE_CHARACTER;
+                size_t end = FindQuoteEnd(line, i + 1, c);
+                if (end == base::StringPiece::npos)
+                {
+                    AppendStyleRun(style, length - start, runs);
+                    return (c == '"' && EndsWithBackslash(line)) ?
+                        STATE_STRING : STATE_DEFAULT;
+                }
+                AppendStyleRun(style, end - start, runs);
+                i = end;
+                continue;
+            }
+
+            if (IsDigit(c) || (c == '.' && i + 1 < length && IsDigit(line[i + 1])))
+            {
+                // Digits, letters for prefixes and suffixes, digit separators,
+                // the point and signed exponents.
+                ++i;
+                while (i < length)
+                {
+                    char d = line[i];
+                    if (IsIdentifierChar(d) || d == '.' || d == '\'')
+                    {
+                        ++i;
+                    }
+                    else if ((d == '+' || d == '-') && IsExponent(line[i - 1]))
+                    {
+                        ++i;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                AppendStyleRun(STYLE_NUMBER, i - start, runs);
+                continue;
+            }
+
+            if (IsIdentifierStart(c))
+            {
+                while (i < length && IsIdentifierChar(line[i]))
+                {
+                    ++i;
+                }
+                base::StringPiece word = line.substr(start, i - start);
+                if (i < length && line[i] == '"' && IsRawStringPrefix(word))
+                {
+                    int raw_state;
+                    if (LexRawString(line, start, i, &i, &raw_state, runs))
+                    {
+                        if (raw_state != STATE_DEFAULT)
+                        {
+                            return raw_state;
+                        }
+                        continue;
+                    }
+                }
+                AppendStyleRun(IsKeyword(word) ? STYLE_KEYWORD :
+                    STYLE_DEFAULT, i - start, runs);
+                continue;
+            }
+
+            AppendStyleRun(STYLE_OPERATOR, 1, runs);
+            ++i;
+        }
+        return STATE_DEFAULT;
+    }
+
+} //namespace ui
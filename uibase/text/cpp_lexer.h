@@ -0,0 +1,30 @@
+#ifndef __ui_base_cpp_lexer_h__
+#define __ui_base_cpp_lexer_h__
+
+#include "lexer.h"
+
+namespace ui
+{
+
+    // C and C++: comments, string and character literals, raw strings,
+    // numbers, keywords, preprocessor lines and operators.  Preprocessor
+    // lines, "//" comments and strings go on after a backslash at the end
+    // of a line; a raw string goes on until its delimiter, which is kept
+    // in the state.
+    class CppLexer : public Lexer
+    {
+    public:
+        CppLexer() {}
+
+        virtual int LexLine(const base::StringPiece& line, int state,
+            StyleRuns* runs) const;
+
+    private:
+        virtual ~CppLexer() {}
+
+        DISALLOW_COPY_AND_ASSIGN(CppLexer);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_cpp_lexer_h__
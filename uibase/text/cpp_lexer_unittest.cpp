@@ -0,0 +1,190 @@
+// Checks of CppLexer on what carries over from one line to the next: block
+// comments, "//" comments and strings continued by a backslash, and raw
+// strings, whose delimiter has to survive in the state; and that lexing
+// restarted at any line from its checkpointed state gives what lexing the
+// whole document gave.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "base/test/test_util.h"
+#include "uibase/text/cpp_lexer.h"
+
+namespace
+{
+
+    // One letter per byte: the style of each byte of a line.
+    std::string StyleLetters(const ui::StyleRuns& runs)
+    {
+        const char kLetters[] = "DCSHNKPO";
+        std::string letters;
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            letters.append(runs[i].length, kLetters[runs[i].style]);
+        }
+        return letters;
+    }
+
+    // Lexes |lines| from the initial state; returns the style letters of
+    // each line and, in |states|, the state each line starts with followed
+    // by the state at the end.
+    std::vector<std::string> Lex(const std::vector<std::string>& lines,
+        std::vector<int>* states)
+    {
+        scoped_refptr<ui::CppLexer> lexer(new ui::CppLexer);
+        std::vector<std::string> styles;
+        int state = ui::Lexer::kInitialState;
+        states->assign(1, state);
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            ui::StyleRuns runs;
+            state = lexer->LexLine(lines[i], state, &runs);
+            styles.push_back(StyleLetters(runs));
+            states->push_back(state);
+        }
+        return styles;
+    }
+
+    std::vector<std::string> Lines(const char* const* lines, size_t count)
+    {
+        return std::vector<std::string>(lines, lines + count);
+    }
+
+    void TestLineComments()
+    {
+        const char* const kLines[] =
+        {
+            "a; // one \\",
+            "two \\",
+            "three",
+            "b;",
+            "c; // no backslash",
+            "d;",
+        };
+        std::vector<int> states;
+        std::vector<std::string> styles = Lex(Lines(kLines,
+            arraysize(kLines)), &states);
+        EXPECT(styles[0] == "DODCCCCCCCC");
+        EXPECT(styles[1] == "CCCCC");
+        EXPECT(styles[2] == "CCCCC");
+        EXPECT(styles[3] == "DO");
+        EXPECT(styles[5] == "DO");
+        EXPECT(states[4] == ui::Lexer::kInitialState);
+        EXPECT(states[6] == ui::Lexer::kInitialState);
+    }
+
+    void TestStrings()
+    {
+        const char* const kLines[] =
+        {
+            "s = \"one\\",
+            "two\\",
+            "three\" + x;",
+            // Unterminated without a backslash: ends with the line.
+            "t = \"open",
+            "u;",
+            // A character literal is not continued.
+            "c = 'a\\",
+            "v;",
+            // Escaped quotes and backslashes inside.
+            "w = \"\\\"\\\\\" y;",
+        };
+        std::vector<int> states;
+        std::vector<std::string> styles = Lex(Lines(kLines,
+            arraysize(kLines)), &states);
+        EXPECT(styles[0] == "DDODSSSSS");
+        EXPECT(styles[1] == "SSSS");
+        EXPECT(styles[2] == "SSSSSSDODDO");
+        EXPECT(styles[3] == "DDODSSSSS");
+        EXPECT(styles[4] == "DO");
+        EXPECT(styles[5] == "DDODHHH");
+        EXPECT(styles[6] == "DO");
+        EXPECT(styles[7] == "DDODSSSSSSDDO");
+    }
+
+    void TestRawStrings()
+    {
+        const char* const kLines[] =
+        {
+            "a = R\"(one)\" + b;",
+            "c = R\"xy(\"quoted\" \\",
+            "// not a comment )x\" )y\" /* ",
+            ")xy\" d;",
+            "e = u8R\"--(\\)--\";",
+            // Too long a delimiter, or none before a space: not raw.
+            "f = R\"abcdefghijklmnopq(x)\";",
+            "g = R\" (x)\";",
+            "R;",
+        };
+        std::vector<int> states;
+        std::vector<std::string> styles = Lex(Lines(kLines,
+            arraysize(kLines)), &states);
+        EXPECT(styles[0] == "DDODSSSSSSSSDODDO");
+        EXPECT(styles[1] == "DDODSSSSSSSSSSSSSSS");
+        EXPECT(styles[2] == std::string(strlen(kLines[2]), 'S'));
+        EXPECT(styles[3] == "SSSSDDO");
+        EXPECT(styles[4] == "DDODSSSSSSSSSSSSO");
+        EXPECT(styles[5] == "DDODD" + std::string(22, 'S') + "O");
+        EXPECT(styles[6] == "DDODDSSSSSSO");
+        EXPECT(styles[7] == "DO");
+
+        // Inside a raw string the state is neither the initial one nor the
+        // highlighter's unknown state, and differs by delimiter.
+        EXPECT(states[2] > ui::Lexer::kInitialState);
+        EXPECT(states[2] == states[3]);
+        std::vector<int> other_states;
+        const char* const kOther[] = { "R\"xz(" };
+        Lex(Lines(kOther, arraysize(kOther)), &other_states);
+        EXPECT(other_states[1] > ui::Lexer::kInitialState);
+        EXPECT(other_states[1] != states[2]);
+    }
+
+    // Lexing each line on its own from its checkpointed start state gives
+    // the same runs and end state as lexing the document in one go.
+    void TestResumeFromCheckpoint()
+    {
+        const char* const kLines[] =
+        {
+            "#include <string>",
+            "#define LONG(x) \\",
+            "    (x) + 1",
+            "/* block",
+            "   comment */ int a = 0x1F; // note \\",
+            "   continued",
+            "const char* s = \"multi\\",
+            "line\";",
+            "const char* r = LR\"sql(",
+            "SELECT \"name\" FROM t; -- )sq\"",
+            "  )sql\"; char c = '\\'';",
+            "R\"(x)\" R\"(",
+            "",
+            ")\"",
+            "return 1.5e-3;",
+        };
+        std::vector<std::string> lines = Lines(kLines, arraysize(kLines));
+        std::vector<int> states;
+        std::vector<std::string> styles = Lex(lines, &states);
+
+        scoped_refptr<ui::CppLexer> lexer(new ui::CppLexer);
+        for (size_t i = lines.size(); i-- > 0;)
+        {
+            EXPECT(states[i] >= ui::Lexer::kInitialState);
+            ui::StyleRuns runs;
+            int end_state = lexer->LexLine(lines[i], states[i], &runs);
+            EXPECT(StyleLetters(runs) == styles[i]);
+            EXPECT(end_state == states[i + 1]);
+        }
+        EXPECT(states[lines.size()] == ui::Lexer::kInitialState);
+    }
+
+}
+
+void RunCppLexerTests()
+{
+    TestLineComments();
+    TestStrings();
+    TestRawStrings();
+    TestResumeFromCheckpoint();
+}
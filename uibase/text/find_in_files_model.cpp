@@ -0,0 +1,543 @@
+#include "find_in_files_model.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop_proxy.h"
+#include "base/parallel_file_walker.h"
+#include "base/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/utf_string_conversions.h"
+#include "uibase/models/table_model_observer.h"
+#include "line_breaks.h"
+#include "text_search.h"
+
+namespace
+{
+
+    const int kMaxThreadCount = 8;
+
+    // Files queued for the search threads before the walk waits.
+    const size_t kMaxQueuedFiles = 1024;
+
+    // Results not yet taken by the UI thread before the search threads
+    // wait.  A batch is never larger.
+    const size_t kMaxUndeliveredResults = 4096;
+
+    // Files up to this size are read, larger ones mapped.
+    const int64 kMaxReadSize = 256 * 1024;
+
+    // A mapped file is searched this much at a time, telling the mapping
+    // how far the search has got, so that it prefetches ahead of the search
+    // and lets go of what is behind it.
+    const size_t kMappedSearchWindow =
+        base::MemoryMappedFile::kReadAheadWindow / 4;
+
+    // A NUL in this many bytes at the start marks a file as binary, which is
+    // skipped.
+    const size_t kBinaryCheckLength = 8 * 1024;
+
+    // Bytes of a matching line kept for the row.
+    const size_t kMaxLineTextLength = 256;
+
+}
+
+namespace ui
+{
+
+    // Refcounted so that a model cancelled or destroyed mid-way does not
+    // pull the job from under the thread running it.
+    class FindInFilesModel::Job
+        : public base::RefCountedThreadSafe<FindInFilesModel::Job>,
+        public base::ParallelFileWalker::Filter,
+        public base::ParallelFileWalker::Sink
+    {
+    public:
+        Job(FindInFilesModel* model, const FilePath& root,
+            TextMatcher* matcher)
+            : model_(model),
+            root_(root),
+            matcher_(matcher),
+            origin_message_loop_proxy_(base::MessageLoopProxy::current()),
+            search_inline_(false),
+            cv_(&lock_),
+            files_searched_(0),
+            walk_done_(false),
+            finished_(false),
+            cancelled_(false),
+            delivery_posted_(false) {}
+
+        // Called on the origin thread.
+        void Detach()
+        {
+            model_ = NULL;
+            base::AutoLock lock(lock_);
+            cancelled_ = true;
+            cv_.Broadcast();
+        }
+
+        // Starts Run() on a thread of its own, or posts it to
+        // |file_message_loop_proxy| if there is none to be had.
+        void Start(base::MessageLoopProxy* file_message_loop_proxy)
+        {
+            Runner* runner = new Runner(this);
+            if (!base::PlatformThread::CreateNonJoinable(0, runner))
+            {
+                delete runner;
+                file_message_loop_proxy->PostTask(
+                    NewRunnableMethod(this, &Job::Run));
+            }
+        }
+
+        // Runs the whole search, blocking until it is done.
+        void Run()
+        {
+            ScopedVector<Worker> workers;
+            int thread_count = std::min(base::SysInfo::NumberOfProcessors(),
+                kMaxThreadCount);
+            for (int i = 0; i < thread_count; ++i)
+            {
+                Worker* worker = new Worker(this);
+                if (base::PlatformThread::Create(0, worker, worker->handle()))
+                {
+                    workers.push_back(worker);
+                }
+                else
+                {
+                    delete worker;
+                }
+            }
+            // No threads to be had; search each directory as it comes.
+            search_inline_ = workers.empty();
+
+            base::ParallelFileWalker walker(root_,
+                base::ParallelFileWalker::FILES,
+                base::ParallelFileWalker::UNORDERED);
+            walker.set_filter(this);
+            walker.Walk(this);
+
+            {
+                base::AutoLock lock(lock_);
+                walk_done_ = true;
+                cv_.Broadcast();
+            }
+            for (size_t i = 0; i < workers.size(); ++i)
+            {
+                base::PlatformThread::Join(*workers[i]->handle());
+            }
+
+            base::AutoLock lock(lock_);
+            finished_ = true;
+            PostDelivery();
+        }
+
+        // Overridden from base::ParallelFileWalker::Filter, on the walker's
+        // threads.  Hidden directories such as .git are left out.
+        virtual bool ShouldEnterDirectory(const FilePath& directory)
+        {
+            FilePath::StringType name = directory.BaseName().value();
+            return name.empty() || name[0] != FILE_PATH_LITERAL('.');
+        }
+
+        virtual bool ShouldReport(const base::ParallelFileWalker::Entry& entry)
+        {
+            return entry.size > 0;
+        }
+
+        // Overridden from base::ParallelFileWalker::Sink, on the thread
+        // running the job.
+        virtual bool OnEntries(
+            const std::vector<base::ParallelFileWalker::Entry>& entries)
+        {
+            {
+                base::AutoLock lock(lock_);
+                for (size_t i = 0; i < entries.size() && !cancelled_; ++i)
+                {
+                    while (!search_inline_ &&
+                        queued_.size() >= kMaxQueuedFiles && !cancelled_)
+                    {
+                        cv_.Wait();
+                    }
+                    queued_.push_back(entries[i]);
+                    cv_.Broadcast();
+                }
+            }
+            if (search_inline_)
+            {
+                RunWorker(true);
+            }
+
+            base::AutoLock lock(lock_);
+            return !cancelled_;
+        }
+
+    private:
+        friend class base::RefCountedThreadSafe<Job>;
+
+        // Runs the job on its own thread and goes away with it.
+        class Runner : public base::PlatformThread::Delegate
+        {
+        public:
+            explicit Runner(Job* job) : job_(job) {}
+
+            virtual void ThreadMain()
+            {
+                base::PlatformThread::SetName("FindInFilesWalk");
+                job_->Run();
+                delete this;
+            }
+
+        private:
+            scoped_refptr<Job> job_;
+
+            DISALLOW_COPY_AND_ASSIGN(Runner);
+        };
+
+        class Worker : public base::PlatformThread::Delegate
+        {
+        public:
+            explicit Worker(Job* job) : job_(job), handle_(NULL) {}
+
+            virtual void ThreadMain()
+            {
+                base::PlatformThread::SetName("FindInFiles");
+                job_->RunWorker(false);
+            }
+
+            base::PlatformThreadHandle* handle() { return &handle_; }
+
+        private:
+            Job* job_;
+            base::PlatformThreadHandle handle_;
+
+            DISALLOW_COPY_AND_ASSIGN(Worker);
+        };
+
+        ~Job() {}
+
+        // Searches queued files until the walk is done and the queue empty,
+        // or with |stop_when_idle| until the queue is empty.
+        void RunWorker(bool stop_when_idle)
+        {
+            std::string storage;
+            std::vector<Result> results;
+            base::AutoLock lock(lock_);
+            for (;;)
+            {
+                while (queued_.empty() && !walk_done_ && !cancelled_ &&
+                    !stop_when_idle)
+                {
+                    cv_.Wait();
+                }
+                if (queued_.empty() || cancelled_)
+                {
+                    break;
+                }
+
+                base::ParallelFileWalker::Entry entry = queued_.front();
+                queued_.pop_front();
+                // There is room for the walk again.
+                cv_.Broadcast();
+                {
+                    base::AutoUnlock unlock(lock_);
+                    SearchFile(entry, &storage, &results);
+                }
+                ++files_searched_;
+                if (results.empty())
+                {
+                    continue;
+                }
+
+                for (size_t added = 0; added < results.size(); )
+                {
+                    while (pending_.size() >= kMaxUndeliveredResults &&
+                        !cancelled_)
+                    {
+                        cv_.Wait();
+                    }
+                    if (cancelled_)
+                    {
+                        break;
+                    }
+                    size_t count = std::min(results.size() - added,
+                        kMaxUndeliveredResults - pending_.size());
+                    pending_.insert(pending_.end(), results.begin() + added,
+                        results.begin() + added + count);
+                    added += count;
+                    PostDelivery();
+                }
+                results.clear();
+            }
+        }
+
+        // Appends the lines of |entry| that match, reading the file into
+        // |storage| if it is small.  Runs without the lock.
+        void SearchFile(const base::ParallelFileWalker::Entry& entry,
+            std::string* storage, std::vector<Result>* results)
+        {
+            base::StringPiece text;
+            scoped_ptr<base::MemoryMappedFile> mapped_file;
+            if (entry.size <= kMaxReadSize)
+            {
+                storage->clear();
+                if (!file_util::ReadFileToString(entry.path, storage))
+                {
+                    return;
+                }
+                text = *storage;
+            }
+            else
+            {
+                mapped_file.reset(new base::MemoryMappedFile);
+                if (!mapped_file->Initialize(entry.path,
+                    base::MemoryMappedFile::ACCESS_SEQUENTIAL))
+                {
+                    return;
+                }
+                text.set(reinterpret_cast<const char*>(mapped_file->data()),
+                    mapped_file->length());
+            }
+            if (memchr(text.data(), '\0',
+                std::min(text.size(), kBinaryCheckLength)))
+            {
+                return;
+            }
+
+            const char* data = text.data();
+            int line = 0;
+            size_t line_start = 0;
+            Range match;
+            size_t from = 0;
+            // Start of the line holding |from|.
+            size_t from_line_start = 0;
+            while (from < text.size())
+            {
+                size_t limit = text.size();
+                if (mapped_file.get())
+                {
+                    mapped_file->ReadAhead(from);
+                    limit = std::min(limit, from + kMappedSearchWindow);
+                }
+                if (!matcher_->Find(text, from_line_start, from, limit,
+                    &match))
+                {
+                    // On to the next window, from the line it starts in.
+                    size_t last_break = FindLastLineBreak(
+                        base::StringPiece(data + from, limit - from),
+                        limit < text.size() && data[limit] == '\n');
+                    if (last_break != base::StringPiece::npos)
+                    {
+                        from_line_start = from + last_break + 1;
+                    }
+                    from = limit;
+                    continue;
+                }
+
+                // Count the lines up to the match, the way the editor breaks
+                // them (see line_breaks.h).
+                base::StringPiece before(data + line_start,
+                    match.start() - line_start);
+                size_t last_break = FindLastLineBreak(before,
+                    data[match.start()] == '\n');
+                if (last_break != base::StringPiece::npos)
+                {
+                    line += static_cast<int>(CountLineBreaks(
+                        before.substr(0, last_break + 1), false));
+                    line_start += last_break + 1;
+                }
+                size_t line_break = FindLineBreak(base::StringPiece(
+                    data + match.start(), text.size() - match.start()), 1,
+                    false);
+                size_t next_line = line_break != base::StringPiece::npos ?
+                    match.start() + line_break + 1 : text.size();
+                size_t line_end = line_break != base::StringPiece::npos ?
+                    next_line - 1 : next_line;
+                if (line_end > line_start && data[line_end - 1] == '\r')
+                {
+                    --line_end;
+                }
+
+                // Keep the part of a long line around the match.
+                size_t begin = line_start;
+                if (match.start() - begin > kMaxLineTextLength / 2)
+                {
+                    begin = match.start() - kMaxLineTextLength / 2;
+                }
+                size_t end = std::min(line_end, begin + kMaxLineTextLength);
+
+                results->push_back(Result());
+                Result& result = results->back();
+                result.path = entry.path;
+                result.line = line;
+                result.line_text.assign(data + begin, end - begin);
+                result.match = Range(match.start() - begin,
+                    std::min(match.end(), end) - begin);
+
+                // One row per line.
+                from = next_line;
+                from_line_start = next_line;
+            }
+        }
+
+        // Makes sure a Deliver() is on its way.  Called with the lock held.
+        void PostDelivery()
+        {
+            if (!delivery_posted_)
+            {
+                delivery_posted_ = true;
+                origin_message_loop_proxy_->PostTask(
+                    NewRunnableMethod(this, &Job::Deliver));
+            }
+        }
+
+        // Hands everything found so far to the model, on the origin thread.
+        void Deliver()
+        {
+            std::vector<Result> results;
+            bool finished;
+            int files_searched;
+            {
+                base::AutoLock lock(lock_);
+                results.swap(pending_);
+                delivery_posted_ = false;
+                finished = finished_;
+                files_searched = files_searched_;
+                cv_.Broadcast();
+            }
+
+            if (model_ && !results.empty())
+            {
+                model_->OnResults(&results);
+            }
+            // The observer may have cancelled the search.
+            if (model_ && finished)
+            {
+                model_->OnComplete(files_searched);
+            }
+        }
+
+        // Only touched on the origin thread.
+        FindInFilesModel* model_;
+
+        const FilePath root_;
+        scoped_ptr<TextMatcher> matcher_;
+        scoped_refptr<base::MessageLoopProxy> origin_message_loop_proxy_;
+        // Set before the walk starts, read on the thread running the job.
+        bool search_inline_;
+
+        // Guards everything below; |cv_| is signalled whenever a file is
+        // queued or taken, results are taken, or the search ends.
+        base::Lock lock_;
+        base::ConditionVariable cv_;
+        std::deque<base::ParallelFileWalker::Entry> queued_;
+        std::vector<Result> pending_;
+        int files_searched_;
+        bool walk_done_;
+        // All search threads are done.
+        bool finished_;
+        bool cancelled_;
+        bool delivery_posted_;
+
+        DISALLOW_COPY_AND_ASSIGN(Job);
+    };
+
+    FindInFilesModel::Result::Result() : line(0) {}
+
+    FindInFilesModel::Result::~Result() {}
+
+    FindInFilesModel::FindInFilesModel(
+        base::MessageLoopProxy* file_message_loop_proxy)
+        : file_message_loop_proxy_(file_message_loop_proxy),
+        observer_(NULL),
+        delegate_(NULL) {}
+
+    FindInFilesModel::~FindInFilesModel()
+    {
+        Cancel();
+    }
+
+    void FindInFilesModel::Start(const FilePath& root, TextMatcher* matcher)
+    {
+        DCHECK(matcher);
+        Cancel();
+        results_.clear();
+        if (observer_)
+        {
+            observer_->OnModelChanged();
+        }
+
+        job_ = new Job(this, root, matcher);
+        job_->Start(file_message_loop_proxy_);
+    }
+
+    void FindInFilesModel::Cancel()
+    {
+        if (job_)
+        {
+            job_->Detach();
+            job_ = NULL;
+        }
+    }
+
+    const FindInFilesModel::Result& FindInFilesModel::GetResult(int row) const
+    {
+        DCHECK(row >= 0 && row < static_cast<int>(results_.size()));
+        return results_[row];
+    }
+
+    int FindInFilesModel::RowCount()
+    {
+        return static_cast<int>(results_.size());
+    }
+
+    string16 FindInFilesModel::GetText(int row, int column_id)
+    {
+        const Result& result = GetResult(row);
+        switch (column_id)
+        {
+        case COLUMN_FILE:
+            return result.path.LossyDisplayName();
+        case COLUMN_LINE:
+            return base::IntToString16(result.line + 1);
+        case COLUMN_TEXT:
+            return UTF8ToUTF16(result.line_text);
+        default:
+            NOTREACHED();
+            return string16();
+        }
+    }
+
+    void FindInFilesModel::SetObserver(TableModelObserver* observer)
+    {
+        observer_ = observer;
+    }
+
+    void FindInFilesModel::OnResults(std::vector<Result>* results)
+    {
+        int start = static_cast<int>(results_.size());
+        results_.insert(results_.end(), results->begin(), results->end());
+        if (observer_)
+        {
+            observer_->OnItemsAdded(start, static_cast<int>(results->size()));
+        }
+    }
+
+    void FindInFilesModel::OnComplete(int files_searched)
+    {
+        job_ = NULL;
+        if (delegate_)
+        {
+            delegate_->OnSearchComplete(files_searched);
+        }
+    }
+
+} //namespace ui
@@ -0,0 +1,113 @@
+#ifndef __ui_base_find_in_files_model_h__
+#define __ui_base_find_in_files_model_h__
+
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "uibase/models/table_model.h"
+#include "uibase/range/range.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+}
+
+namespace ui
+{
+
+    class TextMatcher;
+
+    // Searches the files under a directory and collects the matching lines
+    // as the rows of a table.
+    //
+    // The search runs as a pipeline on a thread of its own, so that a long
+    // search does not hold up the file thread: a ParallelFileWalker lists
+    // the tree and feeds a bounded queue of files.  Worker threads read
+    // small files and map large ones, search them with the TextMatcher and
+    // queue their results.  The results reach the thread that called Start()
+    // in batches, the first as soon as there is one.  Each batch is one
+    // OnItemsAdded() for the observer.  Workers wait while too many results
+    // are undelivered and the walk waits while too many files are queued, so
+    // a slow UI thread slows the search down instead of piling up memory.
+    class FindInFilesModel : public TableModel
+    {
+    public:
+        enum ColumnID
+        {
+            COLUMN_FILE,
+            COLUMN_LINE,
+            COLUMN_TEXT,
+        };
+
+        // A matching line; only the first match in it is kept.
+        struct Result
+        {
+            Result();
+            ~Result();
+
+            FilePath path;
+            // From 0.
+            int line;
+            // The line, cut short if it is very long.
+            std::string line_text;
+            // The match in |line_text|.
+            Range match;
+        };
+
+        // Called on the thread that called Start().
+        class Delegate
+        {
+        public:
+            virtual ~Delegate() {}
+
+            // The search finished, all rows having been added.  Not called
+            // when it was cancelled.
+            virtual void OnSearchComplete(int files_searched) = 0;
+        };
+
+        // The walk runs on the thread of |file_message_loop_proxy| only when
+        // no thread can be started for it.
+        explicit FindInFilesModel(base::MessageLoopProxy* file_message_loop_proxy);
+        // Cancels a search still running.
+        virtual ~FindInFilesModel();
+
+        // Optional; |delegate| must outlive the search.
+        void set_delegate(Delegate* delegate) { delegate_ = delegate; }
+
+        // Clears the rows and searches the files under |root| with |matcher|,
+        // taking ownership of it.  Cancels a search still running.
+        void Start(const FilePath& root, TextMatcher* matcher);
+
+        // Stops the search, keeping the rows found so far.
+        void Cancel();
+
+        bool IsSearching() const { return job_ != NULL; }
+
+        const Result& GetResult(int row) const;
+
+        // Overridden from TableModel:
+        virtual int RowCount();
+        virtual string16 GetText(int row, int column_id);
+        virtual void SetObserver(TableModelObserver* observer);
+
+    private:
+        class Job;
+
+        // Called by |job_| with the next batch.
+        void OnResults(std::vector<Result>* results);
+        void OnComplete(int files_searched);
+
+        scoped_refptr<base::MessageLoopProxy> file_message_loop_proxy_;
+        TableModelObserver* observer_;
+        Delegate* delegate_;
+        std::vector<Result> results_;
+        scoped_refptr<Job> job_;
+
+        DISALLOW_COPY_AND_ASSIGN(FindInFilesModel);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_find_in_files_model_h__
@@ -0,0 +1,260 @@
+#include "huge_file_loader.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop_proxy.h"
+#include "base/string_util.h"
+#include "line_breaks.h"
+#include "text_buffer.h"
+
+namespace
+{
+
+    // Bytes paged in up front for the first screen.
+    const size_t kPreviewPrefetchLength = 1024 * 1024;
+
+    // Chunks indexed per task on the file thread.  Between tasks progress is
+    // reported and other file work gets a turn.
+    const size_t kChunksPerTask = 64;
+
+    inline bool IsUTF8Continuation(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+}
+
+namespace ui
+{
+
+    // Owns the mapping until the buffer takes it over, so that a loader
+    // destroyed mid-way does not pull it from under the file thread.
+    class HugeFileLoader::Indexer
+        : public base::RefCountedThreadSafe<HugeFileLoader::Indexer>
+    {
+    public:
+        Indexer(Delegate* delegate, base::MemoryMappedFile* file,
+            base::MessageLoopProxy* origin_message_loop_proxy,
+            base::MessageLoopProxy* file_message_loop_proxy)
+            : delegate_(delegate),
+            file_(file),
+            origin_message_loop_proxy_(origin_message_loop_proxy),
+            file_message_loop_proxy_(file_message_loop_proxy),
+            utf8_checked_(0),
+            is_utf8_(true),
+            cancelled_(0)
+        {
+            const char* data = reinterpret_cast<const char*>(file->data());
+            size_t length = file->length();
+            text_.set(data, length);
+            encoding_ = ENCODING_UTF8;
+            if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+            {
+                text_.set(data + 3, length - 3);
+                encoding_ = ENCODING_UTF8_BOM;
+            }
+            else if (length >= 2 && memcmp(data, "\xFF\xFE", 2) == 0)
+            {
+                encoding_ = ENCODING_UTF16LE;
+            }
+            else if (length >= 2 && memcmp(data, "\xFE\xFF", 2) == 0)
+            {
+                encoding_ = ENCODING_UTF16BE;
+            }
+        }
+
+        // Called on the origin thread.
+        void Start()
+        {
+            if (encoding_ == ENCODING_UTF16LE || encoding_ == ENCODING_UTF16BE)
+            {
+                origin_message_loop_proxy_->PostTask(
+                    NewRunnableMethod(this, &Indexer::ReportComplete));
+                return;
+            }
+            file_message_loop_proxy_->PostTask(
+                NewRunnableMethod(this, &Indexer::IndexChunks));
+        }
+
+        // Called on the origin thread.
+        void Cancel()
+        {
+            delegate_ = NULL;
+            base::subtle::NoBarrier_Store(&cancelled_, 1);
+        }
+
+        // Called on the origin thread.
+        const base::StringPiece& text() const { return text_; }
+
+    private:
+        friend class base::RefCountedThreadSafe<Indexer>;
+
+        ~Indexer() {}
+
+        // Runs on the file thread.
+        void IndexChunks()
+        {
+            if (base::subtle::NoBarrier_Load(&cancelled_))
+            {
+                return;
+            }
+
+            const size_t chunk_length = TextBuffer::kMaxPieceLength;
+            size_t start = chunk_line_breaks_.size() * chunk_length;
+            size_t end = std::min(text_.size(),
+                start + kChunksPerTask * chunk_length);
+            // Ask for the next batch while this one is counted.
+            size_t text_offset = text_.data() -
+                reinterpret_cast<const char*>(file_->data());
+            file_->WillNeed(text_offset + end, kChunksPerTask * chunk_length);
+
+            for (size_t offset = start; offset < end; offset += chunk_length)
+            {
+                base::StringPiece chunk = text_.substr(offset, chunk_length);
+                chunk_line_breaks_.push_back(static_cast<uint32>(
+                    CountLineBreaks(chunk, false)));
+            }
+            CheckUTF8(end);
+
+            origin_message_loop_proxy_->PostTask(NewRunnableMethod(this,
+                &Indexer::ReportProgress, static_cast<int64>(end)));
+            if (end < text_.size())
+            {
+                file_message_loop_proxy_->PostTask(
+                    NewRunnableMethod(this, &Indexer::IndexChunks));
+            }
+            else
+            {
+                origin_message_loop_proxy_->PostTask(
+                    NewRunnableMethod(this, &Indexer::ReportComplete));
+            }
+        }
+
+        // Checks the text up to |end| for UTF-8, leaving a sequence cut
+        // by |end| for the next call.  Runs on the file thread.
+        void CheckUTF8(size_t end)
+        {
+            if (!is_utf8_)
+            {
+                return;
+            }
+            if (end < text_.size())
+            {
+                for (int i = 0; i < 3 && end > utf8_checked_ &&
+                    IsUTF8Continuation(text_[end]); ++i)
+                {
+                    --end;
+                }
+            }
+            is_utf8_ = IsStringUTF8(
+                text_.substr(utf8_checked_, end - utf8_checked_));
+            utf8_checked_ = end;
+        }
+
+        // Run on the origin thread.
+        void ReportProgress(int64 bytes_indexed)
+        {
+            if (delegate_)
+            {
+                delegate_->OnLoadProgress(bytes_indexed, text_.size());
+            }
+        }
+
+        void ReportComplete()
+        {
+            if (!delegate_)
+            {
+                return;
+            }
+
+            Delegate* delegate = delegate_;
+            delegate_ = NULL;
+            TextBuffer* buffer = NULL;
+            if (encoding_ != ENCODING_UTF16LE && encoding_ != ENCODING_UTF16BE)
+            {
+                if (!is_utf8_)
+                {
+                    encoding_ = ENCODING_ANSI;
+                }
+                buffer = new TextBuffer(file_.release(), text_,
+                    chunk_line_breaks_);
+            }
+            text_.clear();
+            delegate->OnLoadComplete(buffer, encoding_);
+        }
+
+        // Only touched on the origin thread.
+        Delegate* delegate_;
+
+        scoped_ptr<base::MemoryMappedFile> file_;
+        base::StringPiece text_;
+        Encoding encoding_;
+        scoped_refptr<base::MessageLoopProxy> origin_message_loop_proxy_;
+        scoped_refptr<base::MessageLoopProxy> file_message_loop_proxy_;
+
+        // Only touched on the file thread until ReportComplete() is posted.
+        std::vector<uint32> chunk_line_breaks_;
+        size_t utf8_checked_;
+        bool is_utf8_;
+
+        base::subtle::Atomic32 cancelled_;
+
+        DISALLOW_COPY_AND_ASSIGN(Indexer);
+    };
+
+    HugeFileLoader::HugeFileLoader(Delegate* delegate,
+        base::MessageLoopProxy* file_message_loop_proxy)
+        : delegate_(delegate),
+        file_message_loop_proxy_(file_message_loop_proxy)
+    {
+        DCHECK(delegate_);
+    }
+
+    HugeFileLoader::~HugeFileLoader()
+    {
+        Cancel();
+    }
+
+    bool HugeFileLoader::Open(const FilePath& path)
+    {
+        Cancel();
+
+        scoped_ptr<base::MemoryMappedFile> file(new base::MemoryMappedFile);
+        if (!file->Initialize(path))
+        {
+            return false;
+        }
+        file->WillNeed(0, kPreviewPrefetchLength);
+
+        indexer_ = new Indexer(delegate_, file.release(),
+            base::MessageLoopProxy::current(), file_message_loop_proxy_);
+        indexer_->Start();
+        return true;
+    }
+
+    base::StringPiece HugeFileLoader::GetPreview(size_t max_length) const
+    {
+        if (!indexer_)
+        {
+            return base::StringPiece();
+        }
+        return indexer_->text().substr(0, max_length);
+    }
+
+    void HugeFileLoader::Cancel()
+    {
+        if (indexer_)
+        {
+            indexer_->Cancel();
+            indexer_ = NULL;
+        }
+    }
+
+} //namespace ui
@@ -0,0 +1,84 @@
+#ifndef __ui_base_huge_file_loader_h__
+#define __ui_base_huge_file_loader_h__
+
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+}
+
+namespace ui
+{
+
+    class TextBuffer;
+
+    // Opens a file of any size without reading it first.  Open() only maps
+    // the file, so the first screen can be painted from GetPreview() right
+    // away.  Meanwhile the file thread counts line breaks and checks the
+    // encoding chunk by chunk, reporting progress to the delegate on the
+    // thread that called Open(); once done the delegate gets a TextBuffer
+    // whose original text is the mapping itself.  Edits then go to the
+    // buffer's add buffer, the file is never copied.
+    class HugeFileLoader
+    {
+    public:
+        enum Encoding
+        {
+            ENCODING_UTF8,
+            // UTF-8 behind a byte order mark, which is left out of the text.
+            ENCODING_UTF8_BOM,
+            // Not valid UTF-8; the text is in the system code page.
+            ENCODING_ANSI,
+            // UTF-16 needs converting and is not indexed; the delegate gets
+            // no buffer and the file has to be loaded the normal way.
+            ENCODING_UTF16LE,
+            ENCODING_UTF16BE,
+        };
+
+        // Called on the thread that called Open().
+        class Delegate
+        {
+        public:
+            virtual ~Delegate() {}
+
+            virtual void OnLoadProgress(int64 bytes_indexed, int64 total) = 0;
+
+            // Takes ownership of |buffer|, which is NULL for UTF-16.
+            virtual void OnLoadComplete(TextBuffer* buffer,
+                Encoding encoding) = 0;
+        };
+
+        // |delegate| must outlive the loader.  The indexing runs on the
+        // thread of |file_message_loop_proxy|.
+        HugeFileLoader(Delegate* delegate,
+            base::MessageLoopProxy* file_message_loop_proxy);
+        // Cancels indexing that is still going on.
+        ~HugeFileLoader();
+
+        // Maps |path| and starts indexing it.  Returns false if the file
+        // cannot be mapped, which includes empty files.
+        bool Open(const FilePath& path);
+
+        // Up to |max_length| bytes from the start of the text, for painting
+        // before the load completes.  Empty before Open() and after
+        // OnLoadComplete().
+        base::StringPiece GetPreview(size_t max_length) const;
+
+        void Cancel();
+
+    private:
+        class Indexer;
+
+        Delegate* delegate_;
+        scoped_refptr<base::MessageLoopProxy> file_message_loop_proxy_;
+        scoped_refptr<Indexer> indexer_;
+
+        DISALLOW_COPY_AND_ASSIGN(HugeFileLoader);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_huge_file_loader_h__
@@ -0,0 +1,27 @@
+#include "lexer.h"
+
+namespace ui
+{
+
+    void AppendStyleRun(TextStyle style, size_t length, StyleRuns* runs)
+    {
+        const size_t kMaxRunLength = (1 << 24) - 1;
+        if (length > 0 && !runs->empty() && runs->back().style == style)
+        {
+            size_t room = kMaxRunLength - runs->back().length;
+            size_t grow = length < room ? length : room;
+            runs->back().length += static_cast<uint32>(grow);
+            length -= grow;
+        }
+        while (length > 0)
+        {
+            StyleRun run;
+            run.style = style;
+            run.length = static_cast<uint32>(
+                length < kMaxRunLength ? length : kMaxRunLength);
+            runs->push_back(run);
+            length -= run.length;
+        }
+    }
+
+} //namespace ui
@@ -0,0 +1,66 @@
+#ifndef __ui_base_lexer_h__
+#define __ui_base_lexer_h__
+
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+
+namespace ui
+{
+
+    enum TextStyle
+    {
+        STYLE_DEFAULT,
+        STYLE_COMMENT,
+        STYLE_STRING,
+        STYLE_CHARACTER,
+        STYLE_NUMBER,
+        STYLE_KEYWORD,
+        STYLE_PREPROCESSOR,
+        STYLE_OPERATOR,
+    };
+
+    // |length| bytes in one TextStyle.  A line is a sequence of runs; longer
+    // runs than fit in |length| are split.
+    struct StyleRun
+    {
+        uint32 length : 24;
+        uint32 style : 8;
+    };
+
+    typedef std::vector<StyleRun> StyleRuns;
+
+    // Appends |length| bytes of |style| to |runs|, growing the last run when
+    // it has the same style.
+    void AppendStyleRun(TextStyle style, size_t length, StyleRuns* runs);
+
+    // Styles text one line at a time.  Whatever a lexer needs to carry from
+    // one line to the next, such as being inside a block comment, is encoded
+    // in an int state, so that lexing can restart at any line whose start
+    // state is known.
+    //
+    // Lexers keep no other state: LexLine() is called on a background thread,
+    // possibly for several documents at once.  They are reference counted
+    // since a lexing job can still be running when its highlighter is gone.
+    class Lexer : public base::RefCountedThreadSafe<Lexer>
+    {
+    public:
+        // State at the start of a document.
+        static const int kInitialState = 0;
+
+        // Appends the runs for |line|, which has no line break, to |runs| and
+        // returns the state at its end.
+        virtual int LexLine(const base::StringPiece& line, int state,
+            StyleRuns* runs) const = 0;
+
+    protected:
+        friend class base::RefCountedThreadSafe<Lexer>;
+
+        virtual ~Lexer() {}
+    };
+
+} //namespace ui
+
+#endif //__ui_base_lexer_h__
@@ -0,0 +1,139 @@
+#include "line_breaks.h"
+
+#include <emmintrin.h>
+#include <intrin.h>
+
+#pragma intrinsic(_BitScanForward, _BitScanReverse)
+
+namespace
+{
+
+    inline unsigned int CountBits(unsigned int x)
+    {
+        x = x - ((x >> 1) & 0x55555555);
+        x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+        x = (x + (x >> 4)) & 0x0F0F0F0F;
+        return (x * 0x01010101) >> 24;
+    }
+
+    inline bool IsLineBreakAt(const char* data, size_t length, size_t i,
+        bool followed_by_lf)
+    {
+        if (data[i] == '\n')
+        {
+            return true;
+        }
+        if (data[i] != '\r')
+        {
+            return false;
+        }
+        return !(i + 1 < length ? data[i + 1] == '\n' : followed_by_lf);
+    }
+
+    // Bit i is set if byte i of the 16 at |data| ends a line break.  The
+    // byte after them must be readable.
+    inline unsigned int LineBreakMask(const char* data)
+    {
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i next = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(data + 1));
+        unsigned int lf_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf));
+        unsigned int cr_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, cr));
+        unsigned int next_lf_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(next, lf));
+        return lf_mask | (cr_mask & ~next_lf_mask);
+    }
+
+}
+
+namespace ui
+{
+
+    size_t CountLineBreaks(const base::StringPiece& text, bool followed_by_lf)
+    {
+        const char* data = text.data();
+        size_t length = text.size();
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 17 <= length; i += 16)
+        {
+            count += CountBits(LineBreakMask(data + i));
+        }
+        for (; i < length; ++i)
+        {
+            if (IsLineBreakAt(data, length, i, followed_by_lf))
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    size_t FindLineBreak(const base::StringPiece& text, size_t n,
+        bool followed_by_lf)
+    {
+        if (n == 0)
+        {
+            return base::StringPiece::npos;
+        }
+
+        const char* data = text.data();
+        size_t length = text.size();
+        size_t i = 0;
+        for (; i + 17 <= length; i += 16)
+        {
+            unsigned int mask = LineBreakMask(data + i);
+            unsigned int count = CountBits(mask);
+            if (n > count)
+            {
+                n -= count;
+                continue;
+            }
+            while (--n)
+            {
+                mask &= mask - 1;
+            }
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+            return i + bit;
+        }
+        for (; i < length; ++i)
+        {
+            if (IsLineBreakAt(data, length, i, followed_by_lf) && --n == 0)
+            {
+                return i;
+            }
+        }
+        return base::StringPiece::npos;
+    }
+
+    size_t FindLastLineBreak(const base::StringPiece& text,
+        bool followed_by_lf)
+    {
+        const char* data = text.data();
+        size_t length = text.size();
+        // The blocks FindLineBreak() would scan, the bytes after them first.
+        size_t blocks_end = length >= 17 ? (length - 1) / 16 * 16 : 0;
+        for (size_t i = length; i-- > blocks_end;)
+        {
+            if (IsLineBreakAt(data, length, i, followed_by_lf))
+            {
+                return i;
+            }
+        }
+        for (size_t i = blocks_end; i > 0;)
+        {
+            i -= 16;
+            unsigned int mask = LineBreakMask(data + i);
+            if (mask)
+            {
+                unsigned long bit;
+                _BitScanReverse(&bit, mask);
+                return i + bit;
+            }
+        }
+        return base::StringPiece::npos;
+    }
+
+} //namespace ui
@@ -0,0 +1,30 @@
+#ifndef __ui_base_line_breaks_h__
+#define __ui_base_line_breaks_h__
+
+#include "base/string_piece.h"
+
+// Line break scanning for the editor's line index.  A line ends at "\n",
+// "\r\n" or a lone "\r"; each break is counted once, at its last character.
+// Whether a "\r" at the very end of |text| is a break depends on what comes
+// after |text|, which the caller passes as |followed_by_lf|.
+//
+// The functions scan 16 bytes at a time with SSE2.
+
+namespace ui
+{
+
+    size_t CountLineBreaks(const base::StringPiece& text, bool followed_by_lf);
+
+    // Returns the offset of the last character of the |n|th line break in
+    // |text|, counting from 1, or StringPiece::npos if there are fewer.
+    size_t FindLineBreak(const base::StringPiece& text, size_t n,
+        bool followed_by_lf);
+
+    // Returns the offset of the last character of the last line break in
+    // |text|, or StringPiece::npos if there is none.
+    size_t FindLastLineBreak(const base::StringPiece& text,
+        bool followed_by_lf);
+
+} //namespace ui
+
+#endif //__ui_base_line_breaks_h__
@@ -0,0 +1,230 @@
+#include "selection_set.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "text_buffer.h"
+#include "text_edit.h"
+
+namespace
+{
+
+    bool RangeLess(const ui::Range& a, const ui::Range& b)
+    {
+        if (a.GetMin() != b.GetMin())
+        {
+            return a.GetMin() < b.GetMin();
+        }
+        return a.GetMax() < b.GetMax();
+    }
+
+    inline bool IsTrailByte(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    // Start of the character before |offset|.
+    size_t PreviousCharOffset(const ui::TextBuffer* buffer, size_t offset)
+    {
+        if (offset == 0)
+        {
+            return 0;
+        }
+        size_t start = offset - 1;
+        if (buffer->GetCharAt(start) == '\n' && start > 0 &&
+            buffer->GetCharAt(start - 1) == '\r')
+        {
+            return start - 1;
+        }
+        while (start > 0 && offset - start < 4 &&
+            IsTrailByte(buffer->GetCharAt(start)))
+        {
+            --start;
+        }
+        return start;
+    }
+
+    // End of the character after |offset|.
+    size_t NextCharOffset(const ui::TextBuffer* buffer, size_t offset)
+    {
+        size_t length = buffer->length();
+        if (offset >= length)
+        {
+            return length;
+        }
+        size_t end = offset + 1;
+        if (buffer->GetCharAt(offset) == '\r' && end < length &&
+            buffer->GetCharAt(end) == '\n')
+        {
+            return end + 1;
+        }
+        while (end < length && end - offset < 4 &&
+            IsTrailByte(buffer->GetCharAt(end)))
+        {
+            ++end;
+        }
+        return end;
+    }
+
+}
+
+namespace ui
+{
+
+    SelectionSet::SelectionSet() : ranges_(1, Range(0)) {}
+
+    SelectionSet::SelectionSet(const Range& range) : ranges_(1, range) {}
+
+    SelectionSet::~SelectionSet() {}
+
+    void SelectionSet::Add(const Range& range)
+    {
+        ranges_.push_back(range);
+        Normalize();
+    }
+
+    void SelectionSet::SetRanges(const std::vector<Range>& ranges)
+    {
+        if (ranges.empty())
+        {
+            ranges_.assign(1, Range(0));
+            return;
+        }
+        ranges_ = ranges;
+        Normalize();
+    }
+
+    void SelectionSet::ReplaceSelections(TextBuffer* buffer,
+        const base::StringPiece& text, TextEdit* edit)
+    {
+        std::vector<Range> ranges(ranges_);
+        Replace(buffer, ranges, std::vector<base::StringPiece>(1, text), edit);
+    }
+
+    void SelectionSet::ReplaceSelections(TextBuffer* buffer,
+        const std::vector<base::StringPiece>& texts, TextEdit* edit)
+    {
+        DCHECK_EQ(texts.size(), ranges_.size());
+        std::vector<Range> ranges(ranges_);
+        Replace(buffer, ranges, texts, edit);
+    }
+
+    void SelectionSet::DeleteBackward(TextBuffer* buffer, TextEdit* edit)
+    {
+        std::vector<Range> ranges;
+        ranges.reserve(ranges_.size());
+        size_t previous_end = 0;
+        for (size_t i = 0; i < ranges_.size(); ++i)
+        {
+            const Range& selection = ranges_[i];
+            Range range(selection.GetMin(), selection.GetMax());
+            if (selection.is_empty())
+            {
+                size_t start = PreviousCharOffset(buffer, selection.start());
+                range = Range(std::max(start, previous_end), selection.start());
+            }
+            previous_end = range.end();
+            ranges.push_back(range);
+        }
+        Replace(buffer, ranges,
+            std::vector<base::StringPiece>(1, base::StringPiece()), edit);
+    }
+
+    void SelectionSet::DeleteForward(TextBuffer* buffer, TextEdit* edit)
+    {
+        std::vector<Range> ranges;
+        ranges.reserve(ranges_.size());
+        for (size_t i = 0; i < ranges_.size(); ++i)
+        {
+            const Range& selection = ranges_[i];
+            Range range(selection.GetMin(), selection.GetMax());
+            if (selection.is_empty())
+            {
+                size_t end = NextCharOffset(buffer, selection.start());
+                if (i + 1 < ranges_.size())
+                {
+                    end = std::min(end, ranges_[i + 1].GetMin());
+                }
+                range = Range(selection.start(), end);
+            }
+            ranges.push_back(range);
+        }
+        Replace(buffer, ranges,
+            std::vector<base::StringPiece>(1, base::StringPiece()), edit);
+    }
+
+    void SelectionSet::Normalize()
+    {
+        std::sort(ranges_.begin(), ranges_.end(), RangeLess);
+
+        size_t count = 0;
+        for (size_t i = 0; i < ranges_.size(); ++i)
+        {
+            const Range& range = ranges_[i];
+            if (count > 0)
+            {
+                // Selections merge when they overlap, a caret when it
+                // touches another selection.
+                Range& last = ranges_[count - 1];
+                if (range.GetMin() < last.GetMax() ||
+                    (range.GetMin() == last.GetMax() &&
+                    (range.is_empty() || last.is_empty())))
+                {
+                    size_t max = std::max(last.GetMax(), range.GetMax());
+                    last = last.is_reversed() ? Range(max, last.GetMin()) :
+                        Range(last.GetMin(), max);
+                    continue;
+                }
+            }
+            ranges_[count++] = range;
+        }
+        ranges_.resize(count);
+    }
+
+    void SelectionSet::Replace(TextBuffer* buffer,
+        const std::vector<Range>& ranges,
+        const std::vector<base::StringPiece>& texts, TextEdit* edit)
+    {
+        DCHECK(texts.size() == 1 || texts.size() == ranges.size());
+
+        if (edit)
+        {
+            edit->set_selections_before(ranges_);
+            std::string old_text;
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                const base::StringPiece& text = texts[texts.size() == 1 ? 0 : i];
+                if (ranges[i].is_empty() && text.empty())
+                {
+                    continue;
+                }
+                old_text.clear();
+                buffer->GetText(ranges[i], &old_text);
+                edit->AddReplacement(ranges[i].GetMin(), old_text, text);
+            }
+        }
+
+        buffer->ReplaceRanges(ranges, texts);
+
+        // Each caret moves by what the replacements before it added or
+        // removed; |delta| wraps around when more was removed.
+        std::vector<Range> carets;
+        carets.reserve(ranges.size());
+        size_t delta = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            size_t text_length = texts[texts.size() == 1 ? 0 : i].size();
+            size_t start = ranges[i].GetMin() + delta;
+            carets.push_back(Range(start + text_length));
+            delta += text_length - (ranges[i].GetMax() - ranges[i].GetMin());
+        }
+        ranges_.swap(carets);
+        Normalize();
+
+        if (edit)
+        {
+            edit->set_selections_after(ranges_);
+        }
+    }
+
+} //namespace ui
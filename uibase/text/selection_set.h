@@ -0,0 +1,72 @@
+#ifndef __ui_base_selection_set_h__
+#define __ui_base_selection_set_h__
+
+#include <vector>
+
+#include "base/string_piece.h"
+#include "uibase/range/range.h"
+
+namespace ui
+{
+
+    class TextBuffer;
+    class TextEdit;
+
+    // The selections of a multi-cursor editor: Ranges sorted by start, none
+    // overlapping, at least one.  A Range keeps its direction; an empty one
+    // is a caret.
+    //
+    // Edits apply to every selection in one pass over the buffer (see
+    // TextBuffer::ReplaceRanges()), and the new carets are found by one
+    // sweep that carries the change in length so far, so typing at N
+    // carets costs about as much as typing once, not N times.
+    class SelectionSet
+    {
+    public:
+        // One caret at offset 0.
+        SelectionSet();
+        explicit SelectionSet(const Range& range);
+        ~SelectionSet();
+
+        size_t size() const { return ranges_.size(); }
+        const Range& at(size_t index) const { return ranges_[index]; }
+        const std::vector<Range>& ranges() const { return ranges_; }
+
+        // Adds |range|, merging it with the selections it overlaps.
+        void Add(const Range& range);
+
+        // Replaces all selections.  |ranges| need not be sorted; overlapping
+        // ones are merged.  An empty list leaves a caret at 0.
+        void SetRanges(const std::vector<Range>& ranges);
+
+        // Edits.  Each leaves a caret after the text it touched and, when
+        // |edit| is not NULL, fills it for undo.
+
+        // Replaces every selection with |text|: typing and plain pasting.
+        void ReplaceSelections(TextBuffer* buffer,
+            const base::StringPiece& text, TextEdit* edit);
+        // Replaces the i-th selection with texts[i], e.g. pasting one line
+        // per caret.
+        void ReplaceSelections(TextBuffer* buffer,
+            const std::vector<base::StringPiece>& texts, TextEdit* edit);
+
+        // Deletes the selections, and for carets the character before
+        // (backward) or after (forward) them.  A "\r\n" goes as one.
+        void DeleteBackward(TextBuffer* buffer, TextEdit* edit);
+        void DeleteForward(TextBuffer* buffer, TextEdit* edit);
+
+    private:
+        // Sorts |ranges_| and merges the overlapping ones.
+        void Normalize();
+
+        // Replaces |ranges|, sorted and not overlapping, with |texts| (one
+        // for all or one each) and puts carets after them.
+        void Replace(TextBuffer* buffer, const std::vector<Range>& ranges,
+            const std::vector<base::StringPiece>& texts, TextEdit* edit);
+
+        std::vector<Range> ranges_;
+    };
+
+} //namespace ui
+
+#endif //__ui_base_selection_set_h__
@@ -0,0 +1,212 @@
+// Checks of SelectionSet: that adding and setting selections keeps them
+// sorted with the overlapping ones merged, that typing and pasting at
+// several carets put each caret after its text, that deleting takes a
+// "\r\n" or a UTF-8 character as one, and that the TextEdit filled along
+// the way takes the text back.
+
+#include <string>
+#include <vector>
+
+#include "base/test/test_util.h"
+#include "uibase/text/selection_set.h"
+#include "uibase/text/text_buffer.h"
+#include "uibase/text/text_edit.h"
+
+namespace
+{
+
+    std::string Text(const ui::TextBuffer& buffer)
+    {
+        return buffer.GetText(ui::Range(0, buffer.length()));
+    }
+
+    void TestAddAndSetRanges()
+    {
+        ui::SelectionSet selections;
+        EXPECT(selections.size() == 1);
+        EXPECT(selections.at(0) == ui::Range(0));
+
+        selections.Add(ui::Range(5, 8));
+        EXPECT(selections.size() == 2);
+        // Overlapping selections merge, and so does a caret touching one.
+        selections.Add(ui::Range(7, 10));
+        selections.Add(ui::Range(10));
+        EXPECT(selections.size() == 2);
+        EXPECT(selections.at(1) == ui::Range(5, 10));
+        // Two selections that only touch stay apart, each with its
+        // direction.
+        selections.Add(ui::Range(12, 10));
+        EXPECT(selections.size() == 3);
+        EXPECT(selections.at(2) == ui::Range(12, 10));
+
+        std::vector<ui::Range> ranges;
+        ranges.push_back(ui::Range(20, 15));
+        ranges.push_back(ui::Range(3));
+        ranges.push_back(ui::Range(16, 25));
+        selections.SetRanges(ranges);
+        EXPECT(selections.size() == 2);
+        EXPECT(selections.at(0) == ui::Range(3));
+        EXPECT(selections.at(1) == ui::Range(25, 15));
+
+        selections.SetRanges(std::vector<ui::Range>());
+        EXPECT(selections.size() == 1);
+        EXPECT(selections.at(0) == ui::Range(0));
+    }
+
+    void TestTyping()
+    {
+        std::string text = "one\ntwo\nthree";
+        ui::TextBuffer buffer(&text);
+        ui::SelectionSet selections;
+        selections.Add(ui::Range(4));
+        selections.Add(ui::Range(8));
+
+        ui::TextEdit edit;
+        selections.ReplaceSelections(&buffer, "> ", &edit);
+        EXPECT(Text(buffer) == "> one\n> two\n> three");
+        EXPECT(selections.size() == 3);
+        EXPECT(selections.at(0) == ui::Range(2));
+        EXPECT(selections.at(1) == ui::Range(8));
+        EXPECT(selections.at(2) == ui::Range(14));
+        EXPECT(edit.replacements().size() == 3);
+        EXPECT(edit.replacements()[2].offset == 8);
+        EXPECT(edit.selections_before().size() == 3);
+        EXPECT(edit.selections_after() == selections.ranges());
+
+        // Typing on at the same carets folds into the first edit.
+        ui::TextEdit next;
+        selections.ReplaceSelections(&buffer, "x", &next);
+        EXPECT(Text(buffer) == "> xone\n> xtwo\n> xthree");
+        EXPECT(edit.CoalesceTyping(next));
+        EXPECT(edit.replacements()[1].new_text == "> x");
+
+        edit.Revert(&buffer);
+        EXPECT(Text(buffer) == "one\ntwo\nthree");
+        edit.Apply(&buffer);
+        EXPECT(Text(buffer) == "> xone\n> xtwo\n> xthree");
+    }
+
+    void TestPastingPerCaret()
+    {
+        std::string text = "a\nb\nc";
+        ui::TextBuffer buffer(&text);
+        std::vector<ui::Range> ranges;
+        ranges.push_back(ui::Range(0));
+        ranges.push_back(ui::Range(2));
+        ranges.push_back(ui::Range(4));
+        ui::SelectionSet selections;
+        selections.SetRanges(ranges);
+
+        std::vector<base::StringPiece> texts;
+        texts.push_back("1. ");
+        texts.push_back("22. ");
+        texts.push_back("");
+        ui::TextEdit edit;
+        selections.ReplaceSelections(&buffer, texts, &edit);
+        EXPECT(Text(buffer) == "1. a\n22. b\nc");
+        EXPECT(selections.size() == 3);
+        EXPECT(selections.at(1) == ui::Range(9));
+        EXPECT(selections.at(2) == ui::Range(11));
+        // Nothing replaced by nothing is left out of the edit.
+        EXPECT(edit.replacements().size() == 2);
+
+        edit.Revert(&buffer);
+        EXPECT(Text(buffer) == "a\nb\nc");
+    }
+
+    void TestReplacingSelections()
+    {
+        std::string text = "0123456";
+        ui::TextBuffer buffer(&text);
+        ui::SelectionSet selections(ui::Range(4, 1));
+        ui::TextEdit edit;
+        selections.ReplaceSelections(&buffer, "X", &edit);
+        EXPECT(Text(buffer) == "0X456");
+        EXPECT(selections.size() == 1);
+        EXPECT(selections.at(0) == ui::Range(2));
+        EXPECT(edit.replacements().size() == 1);
+        EXPECT(edit.replacements()[0].offset == 1);
+        EXPECT(edit.replacements()[0].old_text == "123");
+        EXPECT(edit.selections_before()[0] == ui::Range(4, 1));
+
+        edit.Revert(&buffer);
+        EXPECT(Text(buffer) == "0123456");
+    }
+
+    void TestDeleting()
+    {
+        // Backward over a "\r\n" and a plain character.
+        {
+            std::string text = "ab\r\ncd";
+            ui::TextBuffer buffer(&text);
+            ui::SelectionSet selections(ui::Range(4));
+            selections.Add(ui::Range(6));
+            ui::TextEdit edit;
+            selections.DeleteBackward(&buffer, &edit);
+            EXPECT(Text(buffer) == "abc");
+            EXPECT(selections.size() == 2);
+            EXPECT(selections.at(0) == ui::Range(2));
+            EXPECT(selections.at(1) == ui::Range(3));
+            edit.Revert(&buffer);
+            EXPECT(Text(buffer) == "ab\r\ncd");
+        }
+
+        // Backward over a two byte UTF-8 character.
+        {
+            std::string text = "a\xC3\xA9" "b";
+            ui::TextBuffer buffer(&text);
+            ui::SelectionSet selections(ui::Range(3));
+            selections.DeleteBackward(&buffer, NULL);
+            EXPECT(Text(buffer) == "ab");
+            EXPECT(selections.at(0) == ui::Range(1));
+        }
+
+        // At the start there is nothing to delete, and nothing to undo.
+        {
+            std::string text = "ab";
+            ui::TextBuffer buffer(&text);
+            ui::SelectionSet selections;
+            ui::TextEdit edit;
+            selections.DeleteBackward(&buffer, &edit);
+            EXPECT(Text(buffer) == "ab");
+            EXPECT(edit.empty());
+        }
+
+        // Forward over a "\r\n".
+        {
+            std::string text = "x\r\ny";
+            ui::TextBuffer buffer(&text);
+            ui::SelectionSet selections(ui::Range(1));
+            selections.DeleteForward(&buffer, NULL);
+            EXPECT(Text(buffer) == "xy");
+            EXPECT(selections.at(0) == ui::Range(1));
+        }
+
+        // Forward from neighbouring carets: each stops at the next one, and
+        // the carets end up merged.
+        {
+            std::string text = "abc";
+            ui::TextBuffer buffer(&text);
+            ui::SelectionSet selections;
+            selections.Add(ui::Range(1));
+            EXPECT(selections.size() == 2);
+            ui::TextEdit edit;
+            selections.DeleteForward(&buffer, &edit);
+            EXPECT(Text(buffer) == "c");
+            EXPECT(selections.size() == 1);
+            EXPECT(selections.at(0) == ui::Range(0));
+            edit.Revert(&buffer);
+            EXPECT(Text(buffer) == "abc");
+        }
+    }
+
+}
+
+void RunSelectionSetTests()
+{
+    TestAddAndSetRanges();
+    TestTyping();
+    TestPastingPerCaret();
+    TestReplacingSelections();
+    TestDeleting();
+}
@@ -0,0 +1,307 @@
+#include "syntax_highlighter.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "text_buffer.h"
+
+namespace
+{
+
+    // Lines per batch sent to the lexing thread.  The first batch after an
+    // edit also covers the visible lines, up to kMaxLinesPerJob.
+    const size_t kLinesPerJob = 2000;
+    const size_t kMaxLinesPerJob = 20000;
+
+    // Returns the end of the line starting at |start|, and in |next| where
+    // the line after it starts.
+    size_t FindLineEnd(const std::string& text, size_t start, size_t* next)
+    {
+        size_t end = text.find_first_of("\r\n", start);
+        if (end == std::string::npos)
+        {
+            *next = text.size();
+            return text.size();
+        }
+        *next = end + 1;
+        if (text[end] == '\r' && *next < text.size() && text[*next] == '\n')
+        {
+            ++*next;
+        }
+        return end;
+    }
+
+}
+
+namespace ui
+{
+
+    // Lexes a batch of lines on the lexing thread and hands the runs back.
+    class SyntaxHighlighter::Job
+        : public base::RefCountedThreadSafe<SyntaxHighlighter::Job>
+    {
+    public:
+        Job(SyntaxHighlighter* highlighter, const Lexer* lexer, int version,
+            size_t first_line, int start_state, std::string* text,
+            std::vector<int>* expected_states)
+            : highlighter_(highlighter),
+            lexer_(lexer),
+            origin_message_loop_proxy_(base::MessageLoopProxy::current()),
+            version_(version),
+            first_line_(first_line),
+            start_state_(start_state),
+            converged_(false)
+        {
+            text_.swap(*text);
+            expected_states_.swap(*expected_states);
+        }
+
+        // Called on the origin thread when the highlighter goes away.
+        void Detach() { highlighter_ = NULL; }
+
+        int version() const { return version_; }
+        size_t first_line() const { return first_line_; }
+        std::vector<StyleRuns>& runs() { return runs_; }
+        const std::vector<int>& end_states() const { return end_states_; }
+        bool converged() const { return converged_; }
+
+        // Runs on the lexing thread.
+        void Run()
+        {
+            size_t line_count = expected_states_.size();
+            runs_.resize(line_count);
+            end_states_.reserve(line_count);
+
+            int state = start_state_;
+            size_t start = 0;
+            for (size_t i = 0; i < line_count; ++i)
+            {
+                size_t next;
+                size_t end = FindLineEnd(text_, start, &next);
+                state = lexer_->LexLine(base::StringPiece(text_.data() + start,
+                    end - start), state, &runs_[i]);
+                end_states_.push_back(state);
+                start = next;
+
+                // The next line starts as it did before; it and everything
+                // after it keep their styles.
+                if (state == expected_states_[i])
+                {
+                    runs_.resize(i + 1);
+                    converged_ = true;
+                    break;
+                }
+            }
+
+            origin_message_loop_proxy_->PostTask(
+                NewRunnableMethod(this, &Job::Deliver));
+        }
+
+    private:
+        friend class base::RefCountedThreadSafe<Job>;
+
+        ~Job() {}
+
+        // Runs on the origin thread.
+        void Deliver()
+        {
+            if (highlighter_)
+            {
+                highlighter_->OnJobDone(this);
+            }
+        }
+
+        SyntaxHighlighter* highlighter_;
+        scoped_refptr<const Lexer> lexer_;
+        scoped_refptr<base::MessageLoopProxy> origin_message_loop_proxy_;
+
+        const int version_;
+        const size_t first_line_;
+        const int start_state_;
+        // The lines to lex, with their line breaks.
+        std::string text_;
+        // Per line, the state the next line started with in the last run,
+        // or kUnknownState.
+        std::vector<int> expected_states_;
+
+        std::vector<StyleRuns> runs_;
+        std::vector<int> end_states_;
+        bool converged_;
+
+        DISALLOW_COPY_AND_ASSIGN(Job);
+    };
+
+    SyntaxHighlighter::Line::Line()
+        : start_state(kUnknownState), needs_lex(true) {}
+
+    SyntaxHighlighter::Line::~Line() {}
+
+    SyntaxHighlighter::SyntaxHighlighter(const TextBuffer* buffer,
+        const Lexer* lexer, Delegate* delegate,
+        base::MessageLoopProxy* lex_message_loop_proxy)
+        : buffer_(buffer),
+        lexer_(lexer),
+        delegate_(delegate),
+        lex_message_loop_proxy_(lex_message_loop_proxy),
+        lines_(buffer->line_count()),
+        first_dirty_line_(0),
+        visible_end_line_(0),
+        version_(0)
+    {
+        lines_[0].start_state = Lexer::kInitialState;
+        ScheduleLex();
+    }
+
+    SyntaxHighlighter::~SyntaxHighlighter()
+    {
+        if (job_)
+        {
+            job_->Detach();
+        }
+    }
+
+    void SyntaxHighlighter::OnTextChanged(size_t first_line,
+        size_t old_line_count, size_t new_line_count)
+    {
+        DCHECK_LE(first_line + old_line_count, lines_.size());
+        DCHECK_GT(new_line_count, 0U);
+        ++version_;
+
+        int start_state = lines_[first_line].start_state;
+        // The replaced lines are reset where they are, so an edit that keeps
+        // the number of lines, such as typing, moves none of the lines after
+        // it.  The first line still starts in the same state.
+        size_t common = std::min(old_line_count, new_line_count);
+        for (size_t i = first_line; i < first_line + common; ++i)
+        {
+            Line& line = lines_[i];
+            line.start_state = kUnknownState;
+            line.needs_lex = true;
+            line.runs.clear();
+        }
+        if (new_line_count > old_line_count)
+        {
+            lines_.insert(lines_.begin() + first_line + old_line_count,
+                new_line_count - old_line_count, Line());
+        }
+        else if (old_line_count > new_line_count)
+        {
+            lines_.erase(lines_.begin() + first_line + new_line_count,
+                lines_.begin() + first_line + old_line_count);
+        }
+        lines_[first_line].start_state = start_state;
+        DCHECK_EQ(lines_.size(), buffer_->line_count());
+
+        if (first_dirty_line_ >= first_line + old_line_count)
+        {
+            first_dirty_line_ = first_dirty_line_ - old_line_count +
+                new_line_count;
+        }
+        first_dirty_line_ = std::min(first_dirty_line_, first_line);
+        ScheduleLex();
+    }
+
+    void SyntaxHighlighter::SetVisibleLines(size_t first_line,
+        size_t line_count)
+    {
+        visible_end_line_ = first_line + line_count;
+    }
+
+    const StyleRuns& SyntaxHighlighter::GetLineStyles(size_t line) const
+    {
+        return lines_[line].runs;
+    }
+
+    bool SyntaxHighlighter::IsLineStyled(size_t line) const
+    {
+        return line < first_dirty_line_;
+    }
+
+    bool SyntaxHighlighter::IsBusy() const
+    {
+        return first_dirty_line_ < lines_.size();
+    }
+
+    void SyntaxHighlighter::ScheduleLex()
+    {
+        if (job_ || !IsBusy())
+        {
+            return;
+        }
+
+        size_t first = first_dirty_line_;
+        size_t end = std::max(first + kLinesPerJob, visible_end_line_);
+        end = std::min(end, first + kMaxLinesPerJob);
+        end = std::min(end, lines_.size());
+
+        std::vector<int> expected_states(end - first);
+        for (size_t i = 0; i < expected_states.size(); ++i)
+        {
+            size_t next = first + i + 1;
+            int state = kUnknownState;
+            if (next < lines_.size() && !lines_[next].needs_lex)
+            {
+                state = lines_[next].start_state;
+            }
+            expected_states[i] = state;
+        }
+
+        size_t start_offset = buffer_->LineToOffset(first);
+        size_t end_offset = end < lines_.size() ?
+            buffer_->LineToOffset(end) : buffer_->length();
+        std::string text;
+        buffer_->GetText(Range(start_offset, end_offset), &text);
+
+        DCHECK_NE(lines_[first].start_state, kUnknownState);
+        job_ = new Job(this, lexer_.get(), version_, first,
+            lines_[first].start_state, &text, &expected_states);
+        lex_message_loop_proxy_->PostTask(
+            NewRunnableMethod(job_.get(), &Job::Run));
+    }
+
+    void SyntaxHighlighter::OnJobDone(Job* job)
+    {
+        DCHECK_EQ(job, job_.get());
+        scoped_refptr<Job> done(job_);
+        job_ = NULL;
+
+        if (done->version() != version_)
+        {
+            // The text changed under the job; start over from the new first
+            // dirty line.
+            ScheduleLex();
+            return;
+        }
+
+        size_t first = done->first_line();
+        std::vector<StyleRuns>& runs = done->runs();
+        const std::vector<int>& end_states = done->end_states();
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            Line& line = lines_[first + i];
+            line.runs.swap(runs[i]);
+            line.needs_lex = false;
+            if (first + i + 1 < lines_.size())
+            {
+                lines_[first + i + 1].start_state = end_states[i];
+            }
+        }
+
+        first_dirty_line_ = first + runs.size();
+        if (done->converged())
+        {
+            // Skip to the next edit, if any.
+            while (first_dirty_line_ < lines_.size() &&
+                !lines_[first_dirty_line_].needs_lex)
+            {
+                ++first_dirty_line_;
+            }
+        }
+
+        delegate_->OnStylesChanged(first, runs.size());
+        ScheduleLex();
+    }
+
+} //namespace ui
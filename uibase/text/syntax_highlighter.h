@@ -0,0 +1,107 @@
+#ifndef __ui_base_syntax_highlighter_h__
+#define __ui_base_syntax_highlighter_h__
+
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "lexer.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+}
+
+namespace ui
+{
+
+    class TextBuffer;
+
+    // Keeps the style runs of every line of a TextBuffer up to date, lexing
+    // on a background thread.
+    //
+    // The lexer state at the start of each line is kept as a checkpoint.
+    // After an edit, lexing restarts at the first changed line and goes on
+    // until a line ends in the state the next line was last seen to start
+    // with: from there on the old styles still hold.  Work is sent to the
+    // lexing thread in batches of lines, the first one reaching to the end of
+    // the visible lines, so that those get styled first.
+    //
+    // Must be used on one thread, which needs a MessageLoop; the delegate is
+    // called there.
+    class SyntaxHighlighter
+    {
+    public:
+        class Delegate
+        {
+        public:
+            virtual ~Delegate() {}
+
+            // Lines [first_line, first_line + line_count) have new styles.
+            virtual void OnStylesChanged(size_t first_line,
+                size_t line_count) = 0;
+        };
+
+        // |buffer| and |delegate| must outlive the highlighter; |lexer| is
+        // kept alive by it and by its lexing jobs.  Lexing starts right away.
+        SyntaxHighlighter(const TextBuffer* buffer, const Lexer* lexer,
+            Delegate* delegate, base::MessageLoopProxy* lex_message_loop_proxy);
+        ~SyntaxHighlighter();
+
+        // Tells the highlighter that lines [first_line, first_line +
+        // old_line_count) were replaced by |new_line_count| lines.  An edit
+        // within one line is 1 and 1.
+        void OnTextChanged(size_t first_line, size_t old_line_count,
+            size_t new_line_count);
+
+        void SetVisibleLines(size_t first_line, size_t line_count);
+
+        // The runs of |line|.  They can be out of date, or empty for a line
+        // not lexed yet; IsLineStyled() tells.
+        const StyleRuns& GetLineStyles(size_t line) const;
+        bool IsLineStyled(size_t line) const;
+
+        // True while lines are waiting to be lexed.
+        bool IsBusy() const;
+
+    private:
+        class Job;
+
+        struct Line
+        {
+            Line();
+            ~Line();
+
+            // Lexer state at the start of the line, or kUnknownState.
+            int start_state;
+            bool needs_lex;
+            StyleRuns runs;
+        };
+
+        static const int kUnknownState = -1;
+
+        // Sends the next batch of lines to the lexing thread, unless one is
+        // on its way already.
+        void ScheduleLex();
+
+        // Takes the results of |job|, if they still apply.
+        void OnJobDone(Job* job);
+
+        const TextBuffer* buffer_;
+        scoped_refptr<const Lexer> lexer_;
+        Delegate* delegate_;
+        scoped_refptr<base::MessageLoopProxy> lex_message_loop_proxy_;
+
+        std::vector<Line> lines_;
+        // No line before this one needs lexing.
+        size_t first_dirty_line_;
+        size_t visible_end_line_;
+        // Bumped by every edit; results of jobs started before are dropped.
+        int version_;
+        scoped_refptr<Job> job_;
+
+        DISALLOW_COPY_AND_ASSIGN(SyntaxHighlighter);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_syntax_highlighter_h__
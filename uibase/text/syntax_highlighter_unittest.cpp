@@ -0,0 +1,263 @@
+// Checks that SyntaxHighlighter, which restarts lexing after an edit from
+// the checkpointed state of the first changed line and stops where a line
+// ends in the state the next one started with, leaves every line styled as
+// lexing the whole text again would: after the first pass, after edits
+// that change what carries over to the next lines, such as opening a raw
+// string or continuing a "//" comment, and after random edits made while
+// jobs are still running.  An edit inside a line restyles that line only.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/message_loop.h"
+#include "base/test/test_util.h"
+#include "base/threading/thread.h"
+#include "uibase/text/cpp_lexer.h"
+#include "uibase/text/syntax_highlighter.h"
+#include "uibase/text/text_buffer.h"
+
+namespace
+{
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    // Quits the loop once no line is waiting to be lexed.
+    class IdleWaiter : public ui::SyntaxHighlighter::Delegate
+    {
+    public:
+        IdleWaiter() : highlighter_(NULL), changed_lines_(0) {}
+
+        void set_highlighter(ui::SyntaxHighlighter* highlighter)
+        {
+            highlighter_ = highlighter;
+        }
+
+        void WaitForIdle()
+        {
+            if (highlighter_->IsBusy())
+            {
+                MessageLoop::current()->Run();
+            }
+        }
+
+        virtual void OnStylesChanged(size_t first_line, size_t line_count)
+        {
+            changed_lines_ += line_count;
+            if (!highlighter_->IsBusy())
+            {
+                MessageLoop::current()->Quit();
+            }
+        }
+
+        size_t TakeChangedLines()
+        {
+            size_t changed_lines = changed_lines_;
+            changed_lines_ = 0;
+            return changed_lines;
+        }
+
+    private:
+        ui::SyntaxHighlighter* highlighter_;
+        size_t changed_lines_;
+    };
+
+    std::string StyleLetters(const ui::StyleRuns& runs)
+    {
+        const char kLetters[] = "DCSHNKPO";
+        std::string letters;
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            letters.append(runs[i].length, kLetters[runs[i].style]);
+        }
+        return letters;
+    }
+
+    // The highlighter's styles against lexing |model|, which has "\n"
+    // line breaks only, from the top.
+    void ExpectStylesMatch(const ui::SyntaxHighlighter& highlighter,
+        const std::string& model)
+    {
+        scoped_refptr<ui::CppLexer> lexer(new ui::CppLexer);
+        int state = ui::Lexer::kInitialState;
+        size_t line = 0;
+        size_t mismatches = 0;
+        size_t start = 0;
+        for (;;)
+        {
+            size_t end = model.find('\n', start);
+            if (end == std::string::npos)
+            {
+                end = model.size();
+            }
+            ui::StyleRuns runs;
+            state = lexer->LexLine(base::StringPiece(model.data() + start,
+                end - start), state, &runs);
+            if (!highlighter.IsLineStyled(line) || StyleLetters(runs) !=
+                StyleLetters(highlighter.GetLineStyles(line)))
+            {
+                ++mismatches;
+            }
+            ++line;
+            if (end == model.size())
+            {
+                break;
+            }
+            start = end + 1;
+        }
+        EXPECT(mismatches == 0);
+        EXPECT(!highlighter.IsBusy());
+    }
+
+    // Edits |buffer| and |model| alike and tells |highlighter| which lines
+    // changed.
+    void Replace(ui::TextBuffer* buffer, std::string* model,
+        ui::SyntaxHighlighter* highlighter, size_t start, size_t end,
+        const std::string& text)
+    {
+        size_t first_line = buffer->OffsetToLine(start);
+        size_t old_line_count = buffer->OffsetToLine(end) - first_line + 1;
+        buffer->Replace(ui::Range(start, end), text);
+        model->replace(start, end - start, text);
+        size_t new_line_count = buffer->OffsetToLine(start + text.size()) -
+            first_line + 1;
+        highlighter->OnTextChanged(first_line, old_line_count,
+            new_line_count);
+    }
+
+    std::string MakeDocument(size_t line_count)
+    {
+        const char* const kLines[] =
+        {
+            "#include <vector>",
+            "// Sums the values.",
+            "int Sum(const std::vector<int>& values)",
+            "{",
+            "    int total = 0; /* running",
+            "       total */",
+            "    const char* s = \"sum\";",
+            "    return total + 0x10;",
+            "}",
+        };
+        std::string text;
+        for (size_t i = 0; i < line_count; ++i)
+        {
+            text += kLines[i % arraysize(kLines)];
+            text += '\n';
+        }
+        text += "// end";
+        return text;
+    }
+
+    void TestEdits(base::MessageLoopProxy* lex_message_loop_proxy)
+    {
+        // More lines than one job takes.
+        std::string model = MakeDocument(9000);
+        std::string text = model;
+        ui::TextBuffer buffer(&text);
+        scoped_refptr<ui::CppLexer> lexer(new ui::CppLexer);
+        IdleWaiter waiter;
+        ui::SyntaxHighlighter highlighter(&buffer, lexer.get(), &waiter,
+            lex_message_loop_proxy);
+        waiter.set_highlighter(&highlighter);
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+        waiter.TakeChangedLines();
+
+        // Typing inside a line restyles that line only.
+        size_t line_start = buffer.LineToOffset(4000);
+        Replace(&buffer, &model, &highlighter, line_start, line_start, "x");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+        EXPECT(waiter.TakeChangedLines() == 1);
+
+        // Opening a raw string styles the rest of the text as string; its
+        // delimiter lives in the checkpoints, so only ")x\"" closes it.
+        line_start = buffer.LineToOffset(100);
+        Replace(&buffer, &model, &highlighter, line_start, line_start,
+            "R\"x(");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+        EXPECT(waiter.TakeChangedLines() >= buffer.line_count() - 100);
+        line_start = buffer.LineToOffset(200);
+        Replace(&buffer, &model, &highlighter, line_start, line_start,
+            ")\" )x\"");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+
+        // A backslash at the end of a "//" comment carries it to the next
+        // line, and taking it away undoes that.
+        size_t comment_line = 1000;
+        while (buffer.GetText(buffer.GetLineRange(comment_line)).find("//") !=
+            0)
+        {
+            ++comment_line;
+        }
+        size_t line_end = buffer.GetLineRange(comment_line).end();
+        Replace(&buffer, &model, &highlighter, line_end, line_end, "\\");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+        EXPECT(waiter.TakeChangedLines() == 2);
+        Replace(&buffer, &model, &highlighter, line_end, line_end + 1, "");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+
+        // Several lines replaced by more and by fewer.
+        size_t start = buffer.LineToOffset(3000);
+        size_t end = buffer.LineToOffset(3005);
+        Replace(&buffer, &model, &highlighter, start, end,
+            "a\n\"continued \\\nstring\"\nb\nc\nd\ne\nf\n");
+        start = buffer.LineToOffset(5000);
+        end = buffer.LineToOffset(5020);
+        Replace(&buffer, &model, &highlighter, start, end, "/*\n");
+        waiter.WaitForIdle();
+        ExpectStylesMatch(highlighter, model);
+
+        // Random edits, a few at a time while jobs are under way.
+        const char* const kSnippets[] =
+        {
+            "x", "\n", "\"", "\\", "//", "/*", "*/", "R\"(", ")\"", "R\"ab(",
+            ")ab\"", "'", "#", " ", "int", "\\\n",
+        };
+        for (int round = 0; round < 200; ++round)
+        {
+            int edits = 1 + Random(3);
+            for (int i = 0; i < edits; ++i)
+            {
+                size_t edit_start = Random(static_cast<unsigned int>(
+                    model.size() + 1));
+                size_t edit_end = std::min(model.size(),
+                    edit_start + Random(4) * Random(40));
+                std::string text = Random(4) ?
+                    kSnippets[Random(arraysize(kSnippets))] : "";
+                Replace(&buffer, &model, &highlighter, edit_start, edit_end,
+                    text);
+            }
+            waiter.WaitForIdle();
+            if (round % 20 == 0 || round == 199)
+            {
+                ExpectStylesMatch(highlighter, model);
+            }
+        }
+    }
+
+}
+
+void RunSyntaxHighlighterTests()
+{
+    MessageLoop loop;
+    base::Thread lex_thread("lex");
+    EXPECT(lex_thread.Start());
+    if (!lex_thread.IsRunning())
+    {
+        return;
+    }
+    TestEdits(lex_thread.message_loop_proxy());
+    lex_thread.Stop();
+}
@@ -0,0 +1,795 @@
+#include "text_buffer.h"
+
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "line_breaks.h"
+#include "uibase/range/range.h"
+
+namespace ui
+{
+
+    struct TextBuffer::Node
+    {
+        Node* left;
+        Node* right;
+        // Heap order of the treap: no node has a higher priority than its
+        // parent.  Random priorities keep the tree balanced on average.
+        uint32 priority;
+
+        // The piece: |length| bytes from |start| in one of the buffers.
+        bool in_add_buffer;
+        size_t start;
+        size_t length;
+        // Line breaks in the piece, as CountLineBreaks() counts them on
+        // their own, and whether it starts with "\n" or ends with "\r".
+        size_t line_breaks;
+        bool first_is_lf;
+        bool last_is_cr;
+
+        // The same for the text of the whole subtree.  A "\r\n" split
+        // between two pieces is counted once.
+        size_t subtree_length;
+        size_t subtree_pieces;
+        size_t subtree_line_breaks;
+        bool subtree_first_is_lf;
+        bool subtree_last_is_cr;
+    };
+
+    namespace
+    {
+
+        template<typename Node>
+        inline size_t SubtreeLength(const Node* node)
+        {
+            return node ? node->subtree_length : 0;
+        }
+
+        template<typename Node>
+        inline size_t SubtreePieces(const Node* node)
+        {
+            return node ? node->subtree_pieces : 0;
+        }
+
+        template<typename Node>
+        inline void Update(Node* node)
+        {
+            const Node* left = node->left;
+            const Node* right = node->right;
+            node->subtree_length = SubtreeLength(left) + node->length +
+                SubtreeLength(right);
+            node->subtree_pieces = SubtreePieces(left) + 1 +
+                SubtreePieces(right);
+
+            size_t line_breaks = node->line_breaks;
+            node->subtree_first_is_lf = node->first_is_lf;
+            node->subtree_last_is_cr = node->last_is_cr;
+            if (left)
+            {
+                line_breaks += left->subtree_line_breaks;
+                if (left->subtree_last_is_cr && node->first_is_lf)
+                {
+                    --line_breaks;
+                }
+                node->subtree_first_is_lf = left->subtree_first_is_lf;
+            }
+            if (right)
+            {
+                line_breaks += right->subtree_line_breaks;
+                if (node->last_is_cr && right->subtree_first_is_lf)
+                {
+                    --line_breaks;
+                }
+                node->subtree_last_is_cr = right->subtree_last_is_cr;
+            }
+            node->subtree_line_breaks = line_breaks;
+        }
+
+        // Line breaks of |node|'s subtree given whether the text after it
+        // starts with "\n", which makes a final "\r" part of a "\r\n".
+        template<typename Node>
+        inline size_t SubtreeLineBreaks(const Node* node, bool followed_by_lf)
+        {
+            if (!node)
+            {
+                return 0;
+            }
+            return node->subtree_line_breaks -
+                (node->subtree_last_is_cr && followed_by_lf ? 1 : 0);
+        }
+
+        // ReplaceRanges() edits one range at a time, at the cost of a few
+        // splits and merges each, when there are this many times more pieces
+        // than ranges; with fewer it is cheaper to rebuild the tree.
+        const size_t kPiecesPerRangeForSplitting = 8;
+
+        // A piece of new text in the add buffer, for ReplaceRanges().
+        struct Chunk
+        {
+            size_t start;
+            size_t length;
+            size_t line_breaks;
+        };
+
+        template<typename Node>
+        inline size_t PieceLineBreaks(const Node* node, bool followed_by_lf)
+        {
+            return node->line_breaks -
+                (node->last_is_cr && followed_by_lf ? 1 : 0);
+        }
+
+    }
+
+    // static
+    const size_t TextBuffer::kMaxPieceLength = 64 * 1024;
+
+    TextBuffer::TextBuffer() : root_(NULL), seed_(2463534242u) {}
+
+    TextBuffer::TextBuffer(std::string* text) : root_(NULL), seed_(2463534242u)
+    {
+        original_storage_.swap(*text);
+        original_.set(original_storage_.data(), original_storage_.size());
+        root_ = NewNodes(false, 0, original_.size());
+    }
+
+    TextBuffer::TextBuffer(base::MemoryMappedFile* file,
+        const base::StringPiece& text,
+        const std::vector<uint32>& chunk_line_breaks)
+        : mapped_file_(file),
+        original_(text),
+        root_(NULL),
+        seed_(2463534242u)
+    {
+        DCHECK_EQ(chunk_line_breaks.size(),
+            (text.size() + kMaxPieceLength - 1) / kMaxPieceLength);
+        for (size_t i = 0; i < chunk_line_breaks.size(); ++i)
+        {
+            size_t start = i * kMaxPieceLength;
+            root_ = Merge(root_, NewNode(false, start,
+                std::min(kMaxPieceLength, text.size() - start),
+                chunk_line_breaks[i]));
+        }
+    }
+
+    TextBuffer::~TextBuffer()
+    {
+        DeleteTree(root_);
+    }
+
+    size_t TextBuffer::length() const
+    {
+        return SubtreeLength(root_);
+    }
+
+    size_t TextBuffer::line_count() const
+    {
+        return SubtreeLineBreaks(root_, false) + 1;
+    }
+
+    size_t TextBuffer::LineToOffset(size_t line) const
+    {
+        DCHECK_LT(line, line_count());
+        if (line == 0)
+        {
+            return 0;
+        }
+
+        // Find the break ending line - 1; the line starts right after it.
+        size_t offset = 0;
+        bool followed_by_lf = false;
+        const Node* node = root_;
+        while (node)
+        {
+            size_t left_breaks = SubtreeLineBreaks(node->left,
+                node->first_is_lf);
+            if (line <= left_breaks)
+            {
+                followed_by_lf = node->first_is_lf;
+                node = node->left;
+                continue;
+            }
+            line -= left_breaks;
+            offset += SubtreeLength(node->left);
+
+            bool piece_followed_by_lf = node->right ?
+                node->right->subtree_first_is_lf : followed_by_lf;
+            size_t piece_breaks = PieceLineBreaks(node, piece_followed_by_lf);
+            if (line <= piece_breaks)
+            {
+                size_t found = FindLineBreak(
+                    base::StringPiece(GetPieceData(node), node->length), line,
+                    piece_followed_by_lf);
+                DCHECK_NE(found, base::StringPiece::npos);
+                return offset + found + 1;
+            }
+            line -= piece_breaks;
+            offset += node->length;
+            node = node->right;
+        }
+        NOTREACHED();
+        return length();
+    }
+
+    size_t TextBuffer::OffsetToLine(size_t offset) const
+    {
+        DCHECK_LE(offset, length());
+
+        // Count the breaks that end before |offset|.
+        size_t line = 0;
+        bool followed_by_lf = false;
+        const Node* node = root_;
+        while (node)
+        {
+            size_t left_length = SubtreeLength(node->left);
+            if (offset <= left_length)
+            {
+                followed_by_lf = node->first_is_lf;
+                node = node->left;
+                continue;
+            }
+            line += SubtreeLineBreaks(node->left, node->first_is_lf);
+            offset -= left_length;
+
+            bool piece_followed_by_lf = node->right ?
+                node->right->subtree_first_is_lf : followed_by_lf;
+            if (offset <= node->length)
+            {
+                const char* data = GetPieceData(node);
+                bool prefix_followed_by_lf = offset < node->length ?
+                    data[offset] == '\n' : piece_followed_by_lf;
+                line += CountLineBreaks(base::StringPiece(data, offset),
+                    prefix_followed_by_lf);
+                break;
+            }
+            line += PieceLineBreaks(node, piece_followed_by_lf);
+            offset -= node->length;
+            node = node->right;
+        }
+        return line;
+    }
+
+    Range TextBuffer::GetLineRange(size_t line) const
+    {
+        size_t start = LineToOffset(line);
+        if (line + 1 == line_count())
+        {
+            return Range(start, length());
+        }
+        size_t end = LineToOffset(line + 1) - 1;
+        if (end > start && GetCharAt(end) == '\n' && GetCharAt(end - 1) == '\r')
+        {
+            --end;
+        }
+        return Range(start, end);
+    }
+
+    void TextBuffer::Insert(size_t offset, const base::StringPiece& text)
+    {
+        DCHECK_LE(offset, length());
+        if (text.empty())
+        {
+            return;
+        }
+
+        Node* left;
+        Node* right;
+        Split(root_, offset, &left, &right);
+
+        // Typing appends to the add buffer right after the previous
+        // keystroke, so the piece before the caret usually just grows.
+        Node* last = left;
+        while (last && last->right)
+        {
+            last = last->right;
+        }
+        size_t start = add_.size();
+        add_.append(text.data(), text.size());
+        if (last && last->in_add_buffer && last->start + last->length == start &&
+            last->length + text.size() <= kMaxPieceLength)
+        {
+            ExtendLast(left, text.size());
+        }
+        else
+        {
+            left = Merge(left, NewNodes(true, start, text.size()));
+        }
+        root_ = Merge(left, right);
+    }
+
+    void TextBuffer::Delete(const Range& range)
+    {
+        size_t start = range.GetMin();
+        size_t end = range.GetMax();
+        DCHECK_LE(end, length());
+        if (start == end)
+        {
+            return;
+        }
+
+        Node* left;
+        Node* middle;
+        Node* right;
+        Split(root_, end, &left, &right);
+        Split(left, start, &left, &middle);
+        DeleteTree(middle);
+        root_ = Merge(left, right);
+    }
+
+    void TextBuffer::Replace(const Range& range, const base::StringPiece& text)
+    {
+        Delete(range);
+        Insert(range.GetMin(), text);
+    }
+
+    void TextBuffer::ReplaceRanges(const std::vector<Range>& ranges,
+        const base::StringPiece& text)
+    {
+        ReplaceRanges(ranges, std::vector<base::StringPiece>(1, text));
+    }
+
+    void TextBuffer::ReplaceRanges(const std::vector<Range>& ranges,
+        const std::vector<base::StringPiece>& texts)
+    {
+        DCHECK(texts.size() == 1 || texts.size() == ranges.size());
+        if (ranges.empty())
+        {
+            return;
+        }
+        if (ranges.size() == 1)
+        {
+            Replace(ranges[0], texts[0]);
+            return;
+        }
+
+        // Add the new text up front, cut into pieces.  Text used for every
+        // range is added and scanned for line breaks once.
+        std::vector<std::vector<Chunk> > chunks(texts.size());
+        for (size_t i = 0; i < texts.size(); ++i)
+        {
+            size_t start = add_.size();
+            add_.append(texts[i].data(), texts[i].size());
+            for (size_t offset = 0; offset < texts[i].size();
+                offset += kMaxPieceLength)
+            {
+                Chunk chunk;
+                chunk.start = start + offset;
+                chunk.length = std::min(kMaxPieceLength,
+                    texts[i].size() - offset);
+                chunk.line_breaks = CountLineBreaks(base::StringPiece(
+                    add_.data() + chunk.start, chunk.length), false);
+                chunks[i].push_back(chunk);
+            }
+        }
+
+        if (ranges.size() * kPiecesPerRangeForSplitting <
+            SubtreePieces(root_))
+        {
+            // Back to front, so that the offsets of the ranges still to do
+            // hold.
+            for (size_t i = ranges.size(); i-- > 0;)
+            {
+                Node* left;
+                Node* middle;
+                Node* right;
+                Split(root_, ranges[i].GetMax(), &left, &right);
+                Split(left, ranges[i].GetMin(), &left, &middle);
+                DeleteTree(middle);
+
+                const std::vector<Chunk>& text_chunks =
+                    chunks[texts.size() == 1 ? 0 : i];
+                for (size_t c = 0; c < text_chunks.size(); ++c)
+                {
+                    const Chunk& chunk = text_chunks[c];
+                    Node* last = left;
+                    while (last && last->right)
+                    {
+                        last = last->right;
+                    }
+                    if (last && last->in_add_buffer &&
+                        last->start + last->length == chunk.start &&
+                        last->length + chunk.length <= kMaxPieceLength)
+                    {
+                        ExtendLast(left, chunk.length);
+                    }
+                    else
+                    {
+                        left = Merge(left, NewNode(true, chunk.start,
+                            chunk.length, chunk.line_breaks));
+                    }
+                }
+                root_ = Merge(left, right);
+            }
+            return;
+        }
+
+        // One sweep over the pieces in order: keep what lies between the
+        // ranges, drop what lies inside them and put the new text in.
+        std::vector<Node*> pieces;
+        Flatten(root_, &pieces);
+        std::vector<Node*> result;
+        result.reserve(pieces.size() + 2 * ranges.size());
+        size_t p = 0;
+        // Offset of pieces[p] in the text.
+        size_t offset = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            size_t start = ranges[i].GetMin();
+            size_t end = ranges[i].GetMax();
+            DCHECK_GE(start, offset);
+
+            while (p < pieces.size() && offset + pieces[p]->length <= start)
+            {
+                offset += pieces[p]->length;
+                result.push_back(pieces[p++]);
+            }
+            if (p < pieces.size() && offset < start)
+            {
+                Node* tail = SplitPiece(pieces[p], start - offset);
+                result.push_back(pieces[p]);
+                pieces[p] = tail;
+                offset = start;
+            }
+
+            while (p < pieces.size() && offset + pieces[p]->length <= end)
+            {
+                offset += pieces[p]->length;
+                delete pieces[p++];
+            }
+            if (p < pieces.size() && offset < end)
+            {
+                Node* tail = SplitPiece(pieces[p], end - offset);
+                delete pieces[p];
+                pieces[p] = tail;
+                offset = end;
+            }
+            DCHECK_EQ(offset, end);
+
+            const std::vector<Chunk>& text_chunks =
+                chunks[texts.size() == 1 ? 0 : i];
+            for (size_t c = 0; c < text_chunks.size(); ++c)
+            {
+                const Chunk& chunk = text_chunks[c];
+                Node* last = result.empty() ? NULL : result.back();
+                if (last && last->in_add_buffer &&
+                    last->start + last->length == chunk.start &&
+                    last->length + chunk.length <= kMaxPieceLength)
+                {
+                    ExtendPiece(last, chunk.length);
+                }
+                else
+                {
+                    result.push_back(NewNode(true, chunk.start, chunk.length,
+                        chunk.line_breaks));
+                }
+            }
+        }
+        result.insert(result.end(), pieces.begin() + p, pieces.end());
+
+        root_ = BuildTree(result);
+    }
+
+    void TextBuffer::GetText(const Range& range, std::string* text) const
+    {
+        size_t start = range.GetMin();
+        size_t end = range.GetMax();
+        DCHECK_LE(end, length());
+
+        text->reserve(text->size() + end - start);
+        for (Iterator it(this, start); !it.IsAtEnd() && it.offset() < end;
+            it.Advance())
+        {
+            size_t count = std::min(it.chunk().size(), end - it.offset());
+            text->append(it.chunk().data(), count);
+        }
+    }
+
+    std::string TextBuffer::GetText(const Range& range) const
+    {
+        std::string text;
+        GetText(range, &text);
+        return text;
+    }
+
+    char TextBuffer::GetCharAt(size_t offset) const
+    {
+        DCHECK_LT(offset, length());
+        Iterator it(this, offset);
+        return it.chunk()[0];
+    }
+
+    TextBuffer::Node* TextBuffer::NewNode(bool in_add_buffer, size_t start,
+        size_t length, size_t line_breaks)
+    {
+        // xorshift32.
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+
+        Node* node = new Node;
+        node->left = NULL;
+        node->right = NULL;
+        node->priority = seed_;
+        node->in_add_buffer = in_add_buffer;
+        node->start = start;
+        node->length = length;
+        node->line_breaks = line_breaks;
+        const char* data = GetPieceData(node);
+        node->first_is_lf = data[0] == '\n';
+        node->last_is_cr = data[length - 1] == '\r';
+        Update(node);
+        return node;
+    }
+
+    TextBuffer::Node* TextBuffer::NewNodes(bool in_add_buffer, size_t start,
+        size_t length)
+    {
+        const char* data = in_add_buffer ? add_.data() : original_.data();
+        Node* tree = NULL;
+        for (size_t offset = 0; offset < length; offset += kMaxPieceLength)
+        {
+            size_t piece_length = std::min(kMaxPieceLength, length - offset);
+            size_t line_breaks = CountLineBreaks(base::StringPiece(
+                data + start + offset, piece_length), false);
+            tree = Merge(tree, NewNode(in_add_buffer, start + offset,
+                piece_length, line_breaks));
+        }
+        return tree;
+    }
+
+    // static
+    void TextBuffer::DeleteTree(Node* node)
+    {
+        if (node)
+        {
+            DeleteTree(node->left);
+            DeleteTree(node->right);
+            delete node;
+        }
+    }
+
+    void TextBuffer::Split(Node* node, size_t offset, Node** left,
+        Node** right)
+    {
+        if (!node)
+        {
+            *left = NULL;
+            *right = NULL;
+            return;
+        }
+
+        size_t left_length = SubtreeLength(node->left);
+        if (offset <= left_length)
+        {
+            Split(node->left, offset, left, &node->left);
+            Update(node);
+            *right = node;
+        }
+        else if (offset >= left_length + node->length)
+        {
+            Split(node->right, offset - left_length - node->length,
+                &node->right, right);
+            Update(node);
+            *left = node;
+        }
+        else
+        {
+            // |offset| falls inside this piece: keep the head here and put
+            // the tail in front of the right subtree.
+            Node* tail = SplitPiece(node, offset - left_length);
+            *right = Merge(tail, node->right);
+            node->right = NULL;
+            Update(node);
+            *left = node;
+        }
+    }
+
+    TextBuffer::Node* TextBuffer::SplitPiece(Node* node, size_t head_length)
+    {
+        // Only the shorter half is scanned for line breaks; the other half
+        // gets the rest.
+        size_t tail_length = node->length - head_length;
+        const char* data = GetPieceData(node);
+        bool split_crlf = data[head_length - 1] == '\r' &&
+            data[head_length] == '\n';
+        size_t head_breaks;
+        size_t tail_breaks;
+        if (head_length <= tail_length)
+        {
+            head_breaks = CountLineBreaks(
+                base::StringPiece(data, head_length), false);
+            tail_breaks = node->line_breaks - head_breaks +
+                (split_crlf ? 1 : 0);
+        }
+        else
+        {
+            tail_breaks = CountLineBreaks(
+                base::StringPiece(data + head_length, tail_length), false);
+            head_breaks = node->line_breaks - tail_breaks +
+                (split_crlf ? 1 : 0);
+        }
+
+        Node* tail = NewNode(node->in_add_buffer, node->start + head_length,
+            tail_length, tail_breaks);
+        node->length = head_length;
+        node->line_breaks = head_breaks;
+        node->last_is_cr = data[head_length - 1] == '\r';
+        return tail;
+    }
+
+    // static
+    TextBuffer::Node* TextBuffer::Merge(Node* left, Node* right)
+    {
+        if (!left)
+        {
+            return right;
+        }
+        if (!right)
+        {
+            return left;
+        }
+        if (left->priority > right->priority)
+        {
+            left->right = Merge(left->right, right);
+            Update(left);
+            return left;
+        }
+        right->left = Merge(left, right->left);
+        Update(right);
+        return right;
+    }
+
+    void TextBuffer::ExtendLast(Node* node, size_t length)
+    {
+        if (node->right)
+        {
+            ExtendLast(node->right, length);
+        }
+        else
+        {
+            ExtendPiece(node, length);
+        }
+        Update(node);
+    }
+
+    void TextBuffer::ExtendPiece(Node* node, size_t length)
+    {
+        // The piece ends where the new text starts in the add buffer.
+        const char* added = GetPieceData(node) + node->length;
+        node->line_breaks += CountLineBreaks(base::StringPiece(added, length),
+            false);
+        if (node->last_is_cr && added[0] == '\n')
+        {
+            --node->line_breaks;
+        }
+        node->length += length;
+        node->last_is_cr = added[length - 1] == '\r';
+    }
+
+    // static
+    void TextBuffer::Flatten(Node* node, std::vector<Node*>* pieces)
+    {
+        if (node)
+        {
+            Flatten(node->left, pieces);
+            pieces->push_back(node);
+            Flatten(node->right, pieces);
+        }
+    }
+
+    // static
+    TextBuffer::Node* TextBuffer::BuildTree(const std::vector<Node*>& pieces)
+    {
+        // The treap of a sequence with given priorities is its Cartesian
+        // tree, built left to right in linear time.  |spine| is the right
+        // spine of the tree so far, from the root down.
+        std::vector<Node*> spine;
+        for (size_t i = 0; i < pieces.size(); ++i)
+        {
+            Node* node = pieces[i];
+            node->left = NULL;
+            node->right = NULL;
+            while (!spine.empty() && spine.back()->priority < node->priority)
+            {
+                node->left = spine.back();
+                spine.pop_back();
+            }
+            if (!spine.empty())
+            {
+                spine.back()->right = node;
+            }
+            spine.push_back(node);
+        }
+        if (spine.empty())
+        {
+            return NULL;
+        }
+        UpdateTree(spine.front());
+        return spine.front();
+    }
+
+    // static
+    void TextBuffer::UpdateTree(Node* node)
+    {
+        if (node)
+        {
+            UpdateTree(node->left);
+            UpdateTree(node->right);
+            Update(node);
+        }
+    }
+
+    const char* TextBuffer::GetPieceData(const Node* node) const
+    {
+        return (node->in_add_buffer ? add_.data() : original_.data()) +
+            node->start;
+    }
+
+    TextBuffer::Iterator::Iterator(const TextBuffer* buffer, size_t offset)
+        : buffer_(buffer), node_(NULL), offset_(offset)
+    {
+        // Walk down to the piece holding |offset|, remembering the nodes
+        // passed on the left since they come next.
+        const Node* node = buffer->root_;
+        size_t remaining = offset;
+        while (node)
+        {
+            size_t left_length = SubtreeLength(node->left);
+            if (remaining < left_length)
+            {
+                stack_.push_back(node);
+                node = node->left;
+            }
+            else if (remaining < left_length + node->length)
+            {
+                SetNode(node, remaining - left_length);
+                return;
+            }
+            else
+            {
+                remaining -= left_length + node->length;
+                node = node->right;
+            }
+        }
+    }
+
+    TextBuffer::Iterator::~Iterator() {}
+
+    void TextBuffer::Iterator::Advance()
+    {
+        DCHECK(!IsAtEnd());
+        offset_ += chunk_.size();
+
+        const Node* next = node_->right;
+        if (next)
+        {
+            while (next->left)
+            {
+                stack_.push_back(next);
+                next = next->left;
+            }
+        }
+        else if (!stack_.empty())
+        {
+            next = stack_.back();
+            stack_.pop_back();
+        }
+
+        if (next)
+        {
+            SetNode(next, 0);
+        }
+        else
+        {
+            node_ = NULL;
+            chunk_.clear();
+        }
+    }
+
+    void TextBuffer::Iterator::SetNode(const Node* node, size_t skip)
+    {
+        node_ = node;
+        chunk_.set(buffer_->GetPieceData(node) + skip, node->length - skip);
+    }
+
+} //namespace ui
@@ -0,0 +1,184 @@
+#ifndef __ui_base_text_buffer_h__
+#define __ui_base_text_buffer_h__
+
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string_piece.h"
+#include "uibase/range/range.h"
+
+namespace base
+{
+    class MemoryMappedFile;
+}
+
+namespace ui
+{
+
+    // The text of a document, kept as a piece table: the original text is
+    // never modified, everything inserted since goes to the end of an
+    // append-only add buffer, and the current text is spelled out by a list
+    // of pieces of the two.  The pieces are held in a balanced tree (a treap
+    // ordered by offset, each node knowing the length of its subtree), so
+    // finding an offset, inserting and deleting all take O(log n) in the
+    // number of pieces.  Editing the middle of a huge document splits one
+    // piece and copies nothing but the inserted text.
+    //
+    // The tree doubles as the line index: every piece knows how many line
+    // breaks it holds and every node the total for its subtree, so mapping
+    // between lines and offsets is O(log n) plus a scan of one piece, and an
+    // edit only counts the breaks in the text it adds.  Lines end at "\n",
+    // "\r\n" or a lone "\r" (see line_breaks.h).
+    //
+    // Offsets are in bytes; the buffer does not look at the encoding.
+    class TextBuffer
+    {
+    public:
+        class Iterator;
+
+        // Pieces are at most this long, so that splitting one only rescans a
+        // bounded amount of text for its line breaks.  The original text is
+        // cut into pieces of exactly this length, the last one excepted.
+        static const size_t kMaxPieceLength;
+
+        TextBuffer();
+        // Takes over |text| as the original text, leaving |text| empty.
+        explicit TextBuffer(std::string* text);
+        // Takes over |file| and uses |text|, which lies in its view, as the
+        // original text without reading it.  |chunk_line_breaks| holds
+        // CountLineBreaks(chunk, false) for each kMaxPieceLength chunk of
+        // |text|, as counted ahead of time (see HugeFileLoader).
+        TextBuffer(base::MemoryMappedFile* file, const base::StringPiece& text,
+            const std::vector<uint32>& chunk_line_breaks);
+        ~TextBuffer();
+
+        size_t length() const;
+
+        // There is always at least one line; the last one has no break.
+        size_t line_count() const;
+
+        // Offset of the first character of |line|, which must be less than
+        // line_count().
+        size_t LineToOffset(size_t line) const;
+
+        // Line holding |offset|, which may be length().  An offset between
+        // the "\r" and the "\n" of a "\r\n" is on the line they end.
+        size_t OffsetToLine(size_t offset) const;
+
+        // Range of |line| without its line break.
+        Range GetLineRange(size_t line) const;
+
+        // |offset| must be at most length().
+        void Insert(size_t offset, const base::StringPiece& text);
+
+        // |range| may be reversed; it must lie within the text.
+        void Delete(const Range& range);
+        void Replace(const Range& range, const base::StringPiece& text);
+
+        // Replaces each of |ranges| with |text|, adding |text| to the add
+        // buffer once.  Many ranges are done in one pass over the pieces,
+        // few in a tree of many pieces one at a time in O(log n) each.  The
+        // ranges are in offsets of the text before the call, sorted and not
+        // overlapping; they may be reversed.
+        void ReplaceRanges(const std::vector<Range>& ranges,
+            const base::StringPiece& text);
+        // The same with texts[i] for ranges[i].
+        void ReplaceRanges(const std::vector<Range>& ranges,
+            const std::vector<base::StringPiece>& texts);
+
+        // Appends the text in |range| to |text|.
+        void GetText(const Range& range, std::string* text) const;
+        std::string GetText(const Range& range) const;
+
+        // |offset| must be less than length().
+        char GetCharAt(size_t offset) const;
+
+    private:
+        struct Node;
+
+        Node* NewNode(bool in_add_buffer, size_t start, size_t length,
+            size_t line_breaks);
+        // Makes a tree of pieces for a span of a buffer, cutting it up into
+        // pieces no longer than kMaxPieceLength.
+        Node* NewNodes(bool in_add_buffer, size_t start, size_t length);
+        static void DeleteTree(Node* node);
+
+        // Splits |node| into the first |offset| bytes and the rest, splitting
+        // the piece that straddles |offset| in two.
+        void Split(Node* node, size_t offset, Node** left, Node** right);
+        static Node* Merge(Node* left, Node* right);
+
+        // Cuts the piece of |node| down to |head_length| bytes and returns a
+        // new node for the rest.  Leaves the subtree totals alone.
+        Node* SplitPiece(Node* node, size_t head_length);
+
+        // Grows the last piece of |node| by the |length| bytes that follow
+        // it in the add buffer.
+        void ExtendLast(Node* node, size_t length);
+        // The same for the piece of |node| alone.
+        void ExtendPiece(Node* node, size_t length);
+
+        // Appends the nodes of |node|'s subtree to |pieces| in order.
+        static void Flatten(Node* node, std::vector<Node*>* pieces);
+        // Makes a treap of |pieces|, in that order, keeping their priorities.
+        static Node* BuildTree(const std::vector<Node*>& pieces);
+        static void UpdateTree(Node* node);
+
+        const char* GetPieceData(const Node* node) const;
+
+        // The original text, kept in |original_storage_| or in the view of
+        // |mapped_file_|.
+        std::string original_storage_;
+        scoped_ptr<base::MemoryMappedFile> mapped_file_;
+        base::StringPiece original_;
+
+        std::string add_;
+        Node* root_;
+        // State of the generator of treap priorities.
+        uint32 seed_;
+
+        DISALLOW_COPY_AND_ASSIGN(TextBuffer);
+    };
+
+    // Walks the text from an offset, one piece at a time, without copying.
+    // Any edit of the buffer invalidates the iterator and the chunks it
+    // returned.
+    //
+    //   for (TextBuffer::Iterator it(&buffer, 0); !it.IsAtEnd(); it.Advance())
+    //   {
+    //       Use(it.chunk());
+    //   }
+    class TextBuffer::Iterator
+    {
+    public:
+        Iterator(const TextBuffer* buffer, size_t offset);
+        ~Iterator();
+
+        bool IsAtEnd() const { return node_ == NULL; }
+
+        // The current piece; the first one starts at the offset given to the
+        // constructor.
+        const base::StringPiece& chunk() const { return chunk_; }
+
+        // Offset of chunk() in the text.
+        size_t offset() const { return offset_; }
+
+        void Advance();
+
+    private:
+        // Points chunk() at |node|'s piece from |skip| bytes on.
+        void SetNode(const Node* node, size_t skip);
+
+        const TextBuffer* buffer_;
+        const Node* node_;
+        // Ancestors still to visit, nearest last.
+        std::vector<const Node*> stack_;
+        base::StringPiece chunk_;
+        size_t offset_;
+    };
+
+} //namespace ui
+
+#endif //__ui_base_text_buffer_h__
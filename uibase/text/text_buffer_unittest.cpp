@@ -0,0 +1,248 @@
+// Checks of the TextBuffer piece tree and its line index against a plain
+// string.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/test/test_util.h"
+#include "uibase/text/text_buffer.h"
+
+namespace
+{
+
+    // Offsets where lines start in |text|, computed the slow way.
+    std::vector<size_t> GetLineStarts(const std::string& text)
+    {
+        std::vector<size_t> starts(1, 0);
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == '\n' ||
+                (text[i] == '\r' && (i + 1 == text.size() || text[i + 1] != '\n')))
+            {
+                starts.push_back(i + 1);
+            }
+        }
+        return starts;
+    }
+
+    // Checks the text of |buffer| and every line of its index against
+    // |model|; offsets are sampled on large texts.
+    void ExpectBufferEquals(const ui::TextBuffer& buffer,
+        const std::string& model)
+    {
+        EXPECT(buffer.length() == model.size());
+        EXPECT(buffer.GetText(ui::Range(0, buffer.length())) == model);
+
+        std::vector<size_t> starts = GetLineStarts(model);
+        EXPECT(buffer.line_count() == starts.size());
+        if (buffer.line_count() != starts.size())
+        {
+            return;
+        }
+        size_t step = std::max<size_t>(1, starts.size() / 1000);
+        for (size_t line = 0; line < starts.size(); line += step)
+        {
+            EXPECT(buffer.LineToOffset(line) == starts[line]);
+        }
+        step = std::max<size_t>(1, model.size() / 1000);
+        for (size_t offset = 0; offset <= model.size(); offset += step)
+        {
+            size_t line = std::upper_bound(starts.begin(), starts.end(),
+                offset) - starts.begin() - 1;
+            EXPECT(buffer.OffsetToLine(offset) == line);
+        }
+    }
+
+    std::string RandomText(size_t length)
+    {
+        static const char kAlphabet[] = "ab\r\n\r\nxyz";
+        std::string text;
+        for (size_t i = 0; i < length; ++i)
+        {
+            text += kAlphabet[rand() % (sizeof(kAlphabet) - 1)];
+        }
+        return text;
+    }
+
+    void TestEmpty()
+    {
+        ui::TextBuffer buffer;
+        EXPECT(buffer.length() == 0);
+        EXPECT(buffer.line_count() == 1);
+        EXPECT(buffer.LineToOffset(0) == 0);
+        EXPECT(buffer.OffsetToLine(0) == 0);
+        EXPECT(buffer.GetLineRange(0) == ui::Range(0, 0));
+    }
+
+    // A "\r\n" whose halves lie in different pieces is one line break.
+    void TestCRLFAcrossPieces()
+    {
+        std::string text("a\rb");
+        std::string model = text;
+        ui::TextBuffer buffer(&text);
+        ExpectBufferEquals(buffer, model);
+
+        // The "\n" goes to the add buffer, the "\r" stays in the original.
+        buffer.Insert(2, "\n");
+        model.insert(2, "\n");
+        ExpectBufferEquals(buffer, model);
+        EXPECT(buffer.line_count() == 2);
+        EXPECT(buffer.OffsetToLine(2) == 0);
+        EXPECT(buffer.GetLineRange(0) == ui::Range(0, 1));
+
+        // Splitting the pair makes two breaks of it again.
+        buffer.Insert(2, "x");
+        model.insert(2, "x");
+        ExpectBufferEquals(buffer, model);
+        EXPECT(buffer.line_count() == 3);
+
+        buffer.Delete(ui::Range(2, 3));
+        model.erase(2, 1);
+        ExpectBufferEquals(buffer, model);
+        EXPECT(buffer.line_count() == 2);
+
+        // Deleting the "\n" leaves a lone "\r", still a break.
+        buffer.Delete(ui::Range(2, 3));
+        model.erase(2, 1);
+        ExpectBufferEquals(buffer, model);
+        EXPECT(buffer.line_count() == 2);
+    }
+
+    // The original text is cut into pieces of kMaxPieceLength; a pair
+    // straddling the cut is one break.
+    void TestCRLFAcrossOriginalPieces()
+    {
+        std::string text(ui::TextBuffer::kMaxPieceLength + 2, 'x');
+        text[ui::TextBuffer::kMaxPieceLength - 1] = '\r';
+        text[ui::TextBuffer::kMaxPieceLength] = '\n';
+        std::string model = text;
+        ui::TextBuffer buffer(&text);
+        ExpectBufferEquals(buffer, model);
+        EXPECT(buffer.line_count() == 2);
+
+        // Typing a pair one character at a time.
+        for (int i = 0; i < 100; ++i)
+        {
+            const char* typed = (i % 2) ? "\n" : "\r";
+            buffer.Insert(5 + i, typed);
+            model.insert(5 + i, typed);
+        }
+        ExpectBufferEquals(buffer, model);
+    }
+
+    void TestReplaceRanges()
+    {
+        std::string text("one\r\ntwo\rthree\nfour\r\n");
+        std::string model = text;
+        ui::TextBuffer buffer(&text);
+
+        // Ranges next to each other, one reversed, and replacements that
+        // join and split "\r\n" pairs at their edges.
+        std::vector<ui::Range> ranges;
+        ranges.push_back(ui::Range(0, 3));
+        ranges.push_back(ui::Range(4, 4));
+        ranges.push_back(ui::Range(9, 5));
+        ranges.push_back(ui::Range(9, 10));
+        ranges.push_back(ui::Range(20, 21));
+        std::vector<base::StringPiece> texts;
+        texts.push_back("1\r");
+        texts.push_back("x");
+        texts.push_back("");
+        texts.push_back("\n");
+        texts.push_back("");
+        buffer.ReplaceRanges(ranges, texts);
+
+        for (size_t i = ranges.size(); i-- > 0;)
+        {
+            model.replace(ranges[i].GetMin(), ranges[i].length(),
+                texts[i].as_string());
+        }
+        ExpectBufferEquals(buffer, model);
+
+        // The same text for every range.
+        std::vector<ui::Range> all;
+        for (size_t i = 0; i + 2 <= buffer.length(); i += 3)
+        {
+            all.push_back(ui::Range(i, i + 2));
+        }
+        buffer.ReplaceRanges(all, "\r\n");
+        for (size_t i = all.size(); i-- > 0;)
+        {
+            model.replace(all[i].GetMin(), all[i].length(), "\r\n");
+        }
+        ExpectBufferEquals(buffer, model);
+    }
+
+    // Random edits of a text full of line breaks, with the index checked
+    // as it goes.
+    void TestRandomEdits()
+    {
+        srand(7);
+        std::string text = RandomText(300000);
+        std::string model = text;
+        ui::TextBuffer buffer(&text);
+        for (int i = 0; i < 5000; ++i)
+        {
+            size_t length = buffer.length();
+            int operation = rand() % 4;
+            if (operation < 2)
+            {
+                size_t offset = rand() % (length + 1);
+                std::string inserted = RandomText(rand() % 8 + 1);
+                buffer.Insert(offset, inserted);
+                model.insert(offset, inserted);
+            }
+            else if (operation == 2 && length)
+            {
+                size_t start = rand() % length;
+                size_t end = std::min(length, start + rand() % 8);
+                buffer.Delete(ui::Range(end, start));
+                model.erase(start, end - start);
+            }
+            else
+            {
+                std::vector<ui::Range> ranges;
+                size_t offset = 0;
+                while (ranges.size() < 20)
+                {
+                    // Leave a gap, so that no two ranges touch.
+                    offset += rand() % (length / 20 + 1) + 1;
+                    if (offset > length)
+                    {
+                        break;
+                    }
+                    size_t end = std::min(length, offset + rand() % 4);
+                    ranges.push_back(ui::Range(offset, end));
+                    offset = end;
+                }
+                std::string replacement = RandomText(rand() % 3);
+                buffer.ReplaceRanges(ranges, replacement);
+                for (size_t j = ranges.size(); j-- > 0;)
+                {
+                    model.replace(ranges[j].GetMin(), ranges[j].length(),
+                        replacement);
+                }
+            }
+            if (i % 500 == 0)
+            {
+                ExpectBufferEquals(buffer, model);
+            }
+        }
+        ExpectBufferEquals(buffer, model);
+    }
+
+}
+
+void RunTextBufferTests()
+{
+    srand(1);
+    TestEmpty();
+    TestCRLFAcrossPieces();
+    TestCRLFAcrossOriginalPieces();
+    TestReplaceRanges();
+    TestRandomEdits();
+}
@@ -0,0 +1,303 @@
+#include "text_edit.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "text_buffer.h"
+
+namespace
+{
+
+    bool HasLineBreak(const std::string& text)
+    {
+        return text.find_first_of("\r\n") != std::string::npos;
+    }
+
+    void AppendVarint(uint64 value, std::string* output)
+    {
+        while (value >= 0x80)
+        {
+            output->push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        output->push_back(static_cast<char>(value));
+    }
+
+    bool ReadVarint(const std::string& input, size_t* pos, uint64* value)
+    {
+        *value = 0;
+        for (int shift = 0; shift < 64 && *pos < input.size(); shift += 7)
+        {
+            uint8 byte = static_cast<uint8>(input[(*pos)++]);
+            *value |= static_cast<uint64>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Each range as the distance from the end of the previous one, then its
+    // length and direction.
+    void WriteRanges(const std::vector<ui::Range>& ranges, Pickle* pickle)
+    {
+        std::string encoded;
+        AppendVarint(ranges.size(), &encoded);
+        size_t previous_end = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            size_t min = ranges[i].GetMin();
+            size_t max = ranges[i].GetMax();
+            AppendVarint(min - previous_end, &encoded);
+            AppendVarint(static_cast<uint64>(max - min) << 1 |
+                (ranges[i].is_reversed() ? 1 : 0), &encoded);
+            previous_end = max;
+        }
+        pickle->WriteString(encoded);
+    }
+
+    bool ReadRanges(const Pickle& pickle, void** iter,
+        std::vector<ui::Range>* ranges)
+    {
+        std::string encoded;
+        if (!pickle.ReadString(iter, &encoded))
+        {
+            return false;
+        }
+        size_t pos = 0;
+        uint64 count;
+        if (!ReadVarint(encoded, &pos, &count) || count > encoded.size())
+        {
+            return false;
+        }
+        ranges->clear();
+        ranges->reserve(static_cast<size_t>(count));
+        size_t previous_end = 0;
+        for (uint64 i = 0; i < count; ++i)
+        {
+            uint64 gap;
+            uint64 length;
+            if (!ReadVarint(encoded, &pos, &gap) ||
+                !ReadVarint(encoded, &pos, &length))
+            {
+                return false;
+            }
+            size_t min = previous_end + static_cast<size_t>(gap);
+            size_t max = min + static_cast<size_t>(length >> 1);
+            ranges->push_back((length & 1) ? ui::Range(max, min) :
+                ui::Range(min, max));
+            previous_end = max;
+        }
+        return true;
+    }
+
+    // Replaces |ranges| with |texts| on |buffer|.  A text the same for all
+    // of them, as in typing at many carets or replacing all, goes to the add
+    // buffer once rather than once per range.
+    void ReplaceRanges(ui::TextBuffer* buffer,
+        const std::vector<ui::Range>& ranges,
+        const std::vector<base::StringPiece>& texts)
+    {
+        for (size_t i = 1; i < texts.size(); ++i)
+        {
+            if (texts[i] != texts[0])
+            {
+                buffer->ReplaceRanges(ranges, texts);
+                return;
+            }
+        }
+        if (!texts.empty())
+        {
+            buffer->ReplaceRanges(ranges, texts[0]);
+        }
+    }
+
+}
+
+namespace ui
+{
+
+    TextEdit::TextEdit() {}
+
+    TextEdit::~TextEdit() {}
+
+    void TextEdit::AddReplacement(size_t offset,
+        const base::StringPiece& old_text, const base::StringPiece& new_text)
+    {
+        DCHECK(replacements_.empty() || offset >=
+            replacements_.back().offset + replacements_.back().old_text.size());
+        replacements_.push_back(Replacement());
+        Replacement& replacement = replacements_.back();
+        replacement.offset = offset;
+        old_text.CopyToString(replacement.old_text);
+        new_text.CopyToString(replacement.new_text);
+    }
+
+    bool TextEdit::CoalesceTyping(const TextEdit& next)
+    {
+        if (next.replacements_.size() != replacements_.size() ||
+            selections_after_.size() != replacements_.size() ||
+            next.selections_before_ != selections_after_)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < replacements_.size(); ++i)
+        {
+            const Replacement& mine = replacements_[i];
+            const Replacement& theirs = next.replacements_[i];
+            if (mine.new_text.empty() || HasLineBreak(mine.new_text) ||
+                !theirs.old_text.empty() || theirs.new_text.empty() ||
+                HasLineBreak(theirs.new_text) ||
+                !selections_after_[i].is_empty() ||
+                theirs.offset != selections_after_[i].start())
+            {
+                return false;
+            }
+        }
+
+        // Each caret sat right after this edit's text, so the typing just
+        // extends it.
+        for (size_t i = 0; i < replacements_.size(); ++i)
+        {
+            replacements_[i].new_text.append(next.replacements_[i].new_text);
+        }
+        selections_after_ = next.selections_after_;
+        return true;
+    }
+
+    void TextEdit::WriteToPickle(Pickle* pickle) const
+    {
+        size_t count = replacements_.size();
+        bool same_old_text = true;
+        bool same_new_text = true;
+        std::string offsets;
+        size_t previous_end = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Replacement& replacement = replacements_[i];
+            AppendVarint(replacement.offset - previous_end, &offsets);
+            previous_end = replacement.offset + replacement.old_text.size();
+            same_old_text = same_old_text &&
+                replacement.old_text == replacements_[0].old_text;
+            same_new_text = same_new_text &&
+                replacement.new_text == replacements_[0].new_text;
+        }
+
+        pickle->WriteSize(count);
+        pickle->WriteString(offsets);
+        pickle->WriteBool(same_old_text);
+        for (size_t i = 0; i < (same_old_text ? std::min<size_t>(count, 1) :
+            count); ++i)
+        {
+            pickle->WriteString(replacements_[i].old_text);
+        }
+        pickle->WriteBool(same_new_text);
+        for (size_t i = 0; i < (same_new_text ? std::min<size_t>(count, 1) :
+            count); ++i)
+        {
+            pickle->WriteString(replacements_[i].new_text);
+        }
+        WriteRanges(selections_before_, pickle);
+        WriteRanges(selections_after_, pickle);
+    }
+
+    bool TextEdit::ReadFromPickle(const Pickle& pickle, void** iter)
+    {
+        size_t count;
+        std::string offsets;
+        if (!pickle.ReadSize(iter, &count) ||
+            !pickle.ReadString(iter, &offsets) || count > offsets.size())
+        {
+            return false;
+        }
+
+        replacements_.assign(count, Replacement());
+        bool same_text;
+        if (!pickle.ReadBool(iter, &same_text))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (same_text && i > 0)
+            {
+                replacements_[i].old_text = replacements_[0].old_text;
+            }
+            else if (!pickle.ReadString(iter, &replacements_[i].old_text))
+            {
+                return false;
+            }
+        }
+        if (!pickle.ReadBool(iter, &same_text))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (same_text && i > 0)
+            {
+                replacements_[i].new_text = replacements_[0].new_text;
+            }
+            else if (!pickle.ReadString(iter, &replacements_[i].new_text))
+            {
+                return false;
+            }
+        }
+
+        size_t pos = 0;
+        size_t previous_end = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64 gap;
+            if (!ReadVarint(offsets, &pos, &gap))
+            {
+                return false;
+            }
+            replacements_[i].offset = previous_end + static_cast<size_t>(gap);
+            previous_end = replacements_[i].offset +
+                replacements_[i].old_text.size();
+        }
+
+        return ReadRanges(pickle, iter, &selections_before_) &&
+            ReadRanges(pickle, iter, &selections_after_);
+    }
+
+    void TextEdit::Apply(TextBuffer* buffer) const
+    {
+        std::vector<Range> ranges;
+        std::vector<base::StringPiece> texts;
+        ranges.reserve(replacements_.size());
+        texts.reserve(replacements_.size());
+        for (size_t i = 0; i < replacements_.size(); ++i)
+        {
+            const Replacement& replacement = replacements_[i];
+            ranges.push_back(Range(replacement.offset,
+                replacement.offset + replacement.old_text.size()));
+            texts.push_back(replacement.new_text);
+        }
+        ReplaceRanges(buffer, ranges, texts);
+    }
+
+    void TextEdit::Revert(TextBuffer* buffer) const
+    {
+        std::vector<Range> ranges;
+        std::vector<base::StringPiece> texts;
+        ranges.reserve(replacements_.size());
+        texts.reserve(replacements_.size());
+        // Bytes added by the replacements so far, as an offset that wraps
+        // around when more was removed.
+        size_t delta = 0;
+        for (size_t i = 0; i < replacements_.size(); ++i)
+        {
+            const Replacement& replacement = replacements_[i];
+            size_t start = replacement.offset + delta;
+            ranges.push_back(Range(start, start + replacement.new_text.size()));
+            texts.push_back(replacement.old_text);
+            delta += replacement.new_text.size() - replacement.old_text.size();
+        }
+        ReplaceRanges(buffer, ranges, texts);
+    }
+
+} //namespace ui
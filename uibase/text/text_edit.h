@@ -0,0 +1,88 @@
+#ifndef __ui_base_text_edit_h__
+#define __ui_base_text_edit_h__
+
+#include <string>
+#include <vector>
+
+#include "base/string_piece.h"
+#include "uibase/range/range.h"
+
+class Pickle;
+
+namespace ui
+{
+
+    class TextBuffer;
+
+    // One change to a TextBuffer that undo and redo treat as a unit: text
+    // replaced at one or more places at once, with the selections before
+    // and after it so that they come back with the text.
+    class TextEdit
+    {
+    public:
+        struct Replacement
+        {
+            // In the text before the edit.
+            size_t offset;
+            std::string old_text;
+            std::string new_text;
+        };
+
+        TextEdit();
+        ~TextEdit();
+
+        // Replacements are added in order of offset and must not overlap.
+        void AddReplacement(size_t offset, const base::StringPiece& old_text,
+            const base::StringPiece& new_text);
+
+        const std::vector<Replacement>& replacements() const
+        {
+            return replacements_;
+        }
+        bool empty() const { return replacements_.empty(); }
+
+        const std::vector<Range>& selections_before() const
+        {
+            return selections_before_;
+        }
+        void set_selections_before(const std::vector<Range>& selections)
+        {
+            selections_before_ = selections;
+        }
+
+        const std::vector<Range>& selections_after() const
+        {
+            return selections_after_;
+        }
+        void set_selections_after(const std::vector<Range>& selections)
+        {
+            selections_after_ = selections;
+        }
+
+        // Folds |next|, made right after this edit, into it if |next| only
+        // types at the carets this edit left and neither of them has a line
+        // break.  Returns false, leaving this edit alone, otherwise.
+        bool CoalesceTyping(const TextEdit& next);
+
+        // Compact form for the undo history.  Offsets and selections are
+        // delta coded, and a text that is the same for every replacement,
+        // as in typing at many carets or replacing all, is written once.
+        void WriteToPickle(Pickle* pickle) const;
+        bool ReadFromPickle(const Pickle& pickle, void** iter);
+
+        // Makes the edit again on the text before it (redo).
+        void Apply(TextBuffer* buffer) const;
+
+        // Takes the edit back on the text after it (undo).  Each replacement
+        // has moved by what the ones before it added or removed.
+        void Revert(TextBuffer* buffer) const;
+
+    private:
+        std::vector<Replacement> replacements_;
+        std::vector<Range> selections_before_;
+        std::vector<Range> selections_after_;
+    };
+
+} //namespace ui
+
+#endif //__ui_base_text_edit_h__
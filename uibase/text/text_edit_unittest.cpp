@@ -0,0 +1,261 @@
+// Checks of TextEdit: that an edit read back from its pickle is the edit
+// that was written, whether its texts are shared or not, with reversed
+// selections and offsets past one varint byte; that a text shared by every
+// replacement is written once; that a cut short pickle is refused; which
+// typing CoalesceTyping() folds in; and that Apply() and Revert() redo and
+// undo the edit on a TextBuffer.
+
+#include <string>
+#include <vector>
+
+#include "base/pickle.h"
+#include "base/test/test_util.h"
+#include "uibase/text/text_buffer.h"
+#include "uibase/text/text_edit.h"
+
+namespace
+{
+
+    std::string Text(const ui::TextBuffer& buffer)
+    {
+        return buffer.GetText(ui::Range(0, buffer.length()));
+    }
+
+    bool SameEdit(const ui::TextEdit& a, const ui::TextEdit& b)
+    {
+        if (a.replacements().size() != b.replacements().size() ||
+            a.selections_before() != b.selections_before() ||
+            a.selections_after() != b.selections_after())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.replacements().size(); ++i)
+        {
+            const ui::TextEdit::Replacement& x = a.replacements()[i];
+            const ui::TextEdit::Replacement& y = b.replacements()[i];
+            if (x.offset != y.offset || x.old_text != y.old_text ||
+                x.new_text != y.new_text)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Pickles |edit|, reads it back into |read| and returns the pickle's
+    // size.
+    int RoundTrip(const ui::TextEdit& edit, ui::TextEdit* read)
+    {
+        Pickle pickle;
+        edit.WriteToPickle(&pickle);
+        void* iter = NULL;
+        EXPECT(read->ReadFromPickle(pickle, &iter));
+        return pickle.size();
+    }
+
+    // Typing |text| at |count| carets 1000 bytes apart, as it would be
+    // recorded, with |distinct| making each caret's text differ in its
+    // last byte.
+    ui::TextEdit MakeTyping(size_t count, const std::string& text,
+        bool distinct)
+    {
+        ui::TextEdit edit;
+        std::vector<ui::Range> before;
+        std::vector<ui::Range> after;
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::string typed = text;
+            if (distinct)
+            {
+                typed[typed.size() - 1] = static_cast<char>('a' + i % 26);
+            }
+            edit.AddReplacement(i * 1000, "", typed);
+            before.push_back(ui::Range(i * 1000));
+            after.push_back(ui::Range(i * (1000 + text.size()) +
+                text.size()));
+        }
+        edit.set_selections_before(before);
+        edit.set_selections_after(after);
+        return edit;
+    }
+
+    void TestPickle()
+    {
+        ui::TextEdit empty;
+        ui::TextEdit read;
+        RoundTrip(empty, &read);
+        EXPECT(read.empty());
+
+        // A replace all: one shared old text and one shared new text.
+        ui::TextEdit shared = MakeTyping(100, "0123456789", false);
+        int shared_size = RoundTrip(shared, &read);
+        EXPECT(SameEdit(shared, read));
+
+        ui::TextEdit distinct = MakeTyping(100, "0123456789", true);
+        int distinct_size = RoundTrip(distinct, &read);
+        EXPECT(SameEdit(distinct, read));
+        EXPECT(distinct_size - shared_size >= 99 * 10);
+
+        // Old and new texts of their own, reversed selections, offsets far
+        // apart.
+        ui::TextEdit edit;
+        edit.AddReplacement(3, "old", "new text");
+        edit.AddReplacement(200000, "", "inserted");
+        edit.AddReplacement(1000000, "removed", "");
+        std::vector<ui::Range> before;
+        before.push_back(ui::Range(6, 3));
+        before.push_back(ui::Range(200000));
+        before.push_back(ui::Range(1000000, 1000007));
+        edit.set_selections_before(before);
+        std::vector<ui::Range> after;
+        after.push_back(ui::Range(11));
+        after.push_back(ui::Range(200013));
+        after.push_back(ui::Range(1000013));
+        edit.set_selections_after(after);
+        RoundTrip(edit, &read);
+        EXPECT(SameEdit(edit, read));
+        EXPECT(read.selections_before()[0].is_reversed());
+    }
+
+    void TestBadPickle()
+    {
+        // Two replacements with texts of their own, but only one old text.
+        Pickle pickle;
+        pickle.WriteSize(2);
+        pickle.WriteString(std::string("\x01\x02", 2));
+        pickle.WriteBool(false);
+        pickle.WriteString("one");
+        ui::TextEdit read;
+        void* iter = NULL;
+        EXPECT(!read.ReadFromPickle(pickle, &iter));
+
+        // More replacements than the offsets could hold.
+        Pickle too_many;
+        too_many.WriteSize(1000);
+        too_many.WriteString(std::string("\x01", 1));
+        iter = NULL;
+        EXPECT(!read.ReadFromPickle(too_many, &iter));
+
+        // Everything but the selections after.
+        ui::TextEdit edit = MakeTyping(3, "abc", true);
+        Pickle full;
+        edit.WriteToPickle(&full);
+        iter = NULL;
+        size_t count;
+        std::string offsets;
+        EXPECT(full.ReadSize(&iter, &count));
+        EXPECT(full.ReadString(&iter, &offsets));
+        Pickle cut;
+        cut.WriteSize(count);
+        cut.WriteString(offsets);
+        cut.WriteBool(true);
+        cut.WriteString("");
+        cut.WriteBool(false);
+        cut.WriteString("aba");
+        cut.WriteString("abb");
+        cut.WriteString("abc");
+        cut.WriteString(std::string("\x00", 1));
+        iter = NULL;
+        EXPECT(!read.ReadFromPickle(cut, &iter));
+    }
+
+    // A caret's typing of |text| at |offset|, the caret then after it.
+    ui::TextEdit Typing(size_t offset, const std::string& old_text,
+        const std::string& text)
+    {
+        ui::TextEdit edit;
+        edit.AddReplacement(offset, old_text, text);
+        edit.set_selections_before(std::vector<ui::Range>(1,
+            ui::Range(offset, offset + old_text.size())));
+        edit.set_selections_after(std::vector<ui::Range>(1,
+            ui::Range(offset + text.size())));
+        return edit;
+    }
+
+    void TestCoalesceTyping()
+    {
+        ui::TextEdit edit = Typing(5, "", "a");
+        EXPECT(edit.CoalesceTyping(Typing(6, "", "b")));
+        EXPECT(edit.replacements()[0].new_text == "ab");
+        EXPECT(edit.selections_after()[0] == ui::Range(7));
+
+        // The caret moved.
+        EXPECT(!edit.CoalesceTyping(Typing(9, "", "c")));
+        // A line break, or something deleted, starts an edit of its own.
+        EXPECT(!edit.CoalesceTyping(Typing(7, "", "\n")));
+        EXPECT(!edit.CoalesceTyping(Typing(7, "", "c\r")));
+        ui::TextEdit deleting = Typing(6, "b", "");
+        deleting.set_selections_before(std::vector<ui::Range>(1,
+            ui::Range(7)));
+        EXPECT(!edit.CoalesceTyping(deleting));
+        EXPECT(edit.replacements()[0].new_text == "ab");
+
+        // Typing over a selection does not fold into the typing before it.
+        ui::TextEdit selected = Typing(7, "xy", "c");
+        EXPECT(!edit.CoalesceTyping(selected));
+
+        // Nor does typing after an edit with a line break.
+        ui::TextEdit line = Typing(0, "", "\n");
+        EXPECT(!line.CoalesceTyping(Typing(1, "", "a")));
+
+        // At several carets, only when all of them typed on.
+        ui::TextEdit many = MakeTyping(3, "ab", false);
+        std::vector<ui::Range> carets = many.selections_after();
+        ui::TextEdit fewer = Typing(carets[0].start(), "", "c");
+        fewer.set_selections_before(carets);
+        EXPECT(!many.CoalesceTyping(fewer));
+        ui::TextEdit next;
+        std::vector<ui::Range> after;
+        for (size_t i = 0; i < carets.size(); ++i)
+        {
+            next.AddReplacement(carets[i].start(), "", "c");
+            after.push_back(ui::Range(carets[i].start() + i + 1));
+        }
+        next.set_selections_before(carets);
+        next.set_selections_after(after);
+        EXPECT(many.CoalesceTyping(next));
+        EXPECT(many.replacements()[2].new_text == "abc");
+        EXPECT(many.selections_after() == after);
+    }
+
+    void TestApplyAndRevert()
+    {
+        std::string text = "alpha beta gamma";
+        ui::TextBuffer buffer(&text);
+        ui::TextEdit edit;
+        edit.AddReplacement(0, "alpha", "A");
+        edit.AddReplacement(6, "beta", "BETA!");
+        edit.AddReplacement(11, "gamma", "");
+        edit.Apply(&buffer);
+        EXPECT(Text(buffer) == "A BETA! ");
+        edit.Revert(&buffer);
+        EXPECT(Text(buffer) == "alpha beta gamma");
+
+        // One text for every replacement, both ways.
+        ui::TextEdit shared;
+        shared.AddReplacement(0, "", "--");
+        shared.AddReplacement(3, "", "--");
+        shared.AddReplacement(16, "", "--");
+        shared.Apply(&buffer);
+        EXPECT(Text(buffer) == "--alp--ha beta gamma--");
+        shared.Revert(&buffer);
+        EXPECT(Text(buffer) == "alpha beta gamma");
+
+        // The same from a pickle.
+        ui::TextEdit read;
+        RoundTrip(edit, &read);
+        read.Apply(&buffer);
+        EXPECT(Text(buffer) == "A BETA! ");
+        read.Revert(&buffer);
+        EXPECT(Text(buffer) == "alpha beta gamma");
+    }
+
+}
+
+void RunTextEditTests()
+{
+    TestPickle();
+    TestBadPickle();
+    TestCoalesceTyping();
+    TestApplyAndRevert();
+}
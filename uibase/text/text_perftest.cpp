@@ -0,0 +1,868 @@
+// Timings of the editor's text classes on a generated document: scanning
+// for line breaks and building the TextBuffer and its line index, in GB/s,
+// edits, line lookups, search throughput, typing at many carets and undo;
+// the time to first paint of a file opened through HugeFileLoader, next to
+// reading it whole; syntax highlighting of 16 MB of C++, a full lex and
+// the time from a keystroke to the visible lines being restyled;
+// TextRenderer frames while scrolling through lines of which some are very
+// long; resizing a soft-wrapped view, to the visible rows being wrapped
+// and painted and to every line being wrapped; and find in files over a
+// generated tree of 2000 files, or over a directory given as the second
+// argument, from the start to the first rows and to the end.  A console
+// program; the document size in MB, 100 by default, may be given as the
+// first argument.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/base_time.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/scoped_temp_dir.h"
+#include "base/sys_string_conversions.h"
+#include "base/threading/thread.h"
+#include "uibase/models/table_model_observer.h"
+#include "uibase/text/cpp_lexer.h"
+#include "uibase/text/find_in_files_model.h"
+#include "uibase/text/huge_file_loader.h"
+#include "uibase/text/line_breaks.h"
+#include "uibase/text/selection_set.h"
+#include "uibase/text/syntax_highlighter.h"
+#include "uibase/text/text_buffer.h"
+#include "uibase/text/text_edit.h"
+#include "uibase/text/text_renderer.h"
+#include "uibase/text/text_search.h"
+#include "uibase/text/undo_history.h"
+#include "uibase/text/wrap_layout.h"
+#include "uigfx/canvas_skia.h"
+#include "uigfx/font.h"
+
+namespace
+{
+
+    // Source-like text: lines of 0 to 119 characters, words of lower case
+    // letters, every tenth line ending in "\r\n".
+    std::string MakeDocument(size_t length)
+    {
+        std::string text;
+        text.reserve(length);
+        int line = 0;
+        while (text.size() < length)
+        {
+            int line_length = rand() % 120;
+            for (int i = 0; i < line_length; ++i)
+            {
+                text += (rand() % 6) ? static_cast<char>('a' + rand() % 26) : ' ';
+            }
+            text += (++line % 10) ? "\n" : "\r\n";
+        }
+        text.resize(length);
+        return text;
+    }
+
+    // rand() only goes up to 32767 with the Microsoft runtime.
+    size_t RandomBelow(size_t limit)
+    {
+        size_t value = (static_cast<size_t>(rand()) << 30) ^
+            (static_cast<size_t>(rand()) << 15) ^ rand();
+        return value % limit;
+    }
+
+    class Timer
+    {
+    public:
+        Timer() : start_(base::TimeTicks::HighResNow()) {}
+
+        double ElapsedMs() const
+        {
+            return (base::TimeTicks::HighResNow() - start_).InMillisecondsF();
+        }
+
+    private:
+        base::TimeTicks start_;
+    };
+
+    void PrintRate(const char* name, double ms, size_t count,
+        const char* unit)
+    {
+        printf("%-32s %10.1f ms %12.0f %s/s\n", name, ms,
+            ms > 0 ? count / ms * 1000 : 0.0, unit);
+    }
+
+    void PrintGigabytes(const char* name, double ms, size_t bytes)
+    {
+        printf("%-32s %10.1f ms %12.2f GB/s\n", name, ms,
+            ms > 0 ? bytes / (1024.0 * 1024.0 * 1024.0) / ms * 1000 : 0.0);
+    }
+
+    void RunSearch(const char* name, const ui::TextBuffer& buffer,
+        const ui::TextMatcher& matcher)
+    {
+        ui::TextSearcher searcher(&matcher);
+        std::vector<ui::Range> matches;
+        Timer timer;
+        searcher.FindAll(buffer, &matches);
+        double ms = timer.ElapsedMs();
+        PrintRate(name, ms, buffer.length() >> 20, "MB");
+        printf("%-32s %10u matches\n", "", static_cast<unsigned>(matches.size()));
+    }
+
+    // Quits the loop once the file is indexed.
+    class LoadWaiter : public ui::HugeFileLoader::Delegate
+    {
+    public:
+        LoadWaiter() : progress_reports_(0) {}
+
+        virtual void OnLoadProgress(int64 bytes_indexed, int64 total)
+        {
+            ++progress_reports_;
+        }
+
+        virtual void OnLoadComplete(ui::TextBuffer* buffer,
+            ui::HugeFileLoader::Encoding encoding)
+        {
+            buffer_.reset(buffer);
+            MessageLoop::current()->Quit();
+        }
+
+        int progress_reports() const { return progress_reports_; }
+        ui::TextBuffer* buffer() const { return buffer_.get(); }
+
+    private:
+        int progress_reports_;
+        scoped_ptr<ui::TextBuffer> buffer_;
+    };
+
+    // The first screen: the first kScreenLines lines of at most
+    // kScreenBytes, found the way a renderer would before the buffer
+    // exists.
+    const size_t kScreenLines = 60;
+    const size_t kScreenBytes = 64 * 1024;
+
+    size_t LayOutFirstScreen(const base::StringPiece& text)
+    {
+        size_t end = ui::FindLineBreak(text, kScreenLines, false);
+        return end == base::StringPiece::npos ? text.size() : end + 1;
+    }
+
+    // Time to first paint of |text| saved to a file: reading it whole and
+    // building a TextBuffer, the way files are opened otherwise, against
+    // HugeFileLoader, which paints from the mapping and indexes on the file
+    // thread.  The file was just written, so it is read from the system
+    // cache in both cases; from disk the difference is larger.
+    void TimeHugeFileLoad(const std::string& text)
+    {
+        ScopedTempDir temp_dir;
+        if (!temp_dir.CreateUniqueTempDir())
+        {
+            fprintf(stderr, "cannot create a temporary directory\n");
+            return;
+        }
+        FilePath path = temp_dir.path().Append(L"huge.txt");
+        if (base::WriteFile(path, text.data(), static_cast<int>(text.size())) !=
+            static_cast<int>(text.size()))
+        {
+            fprintf(stderr, "cannot write %s\n", path.MaybeAsASCII().c_str());
+            return;
+        }
+
+        Timer read_timer;
+        std::string contents;
+        if (!base::ReadFileToString(path, &contents))
+        {
+            fprintf(stderr, "cannot read the file back\n");
+            return;
+        }
+        ui::TextBuffer read_buffer(&contents);
+        size_t read_screen = LayOutFirstScreen(read_buffer.GetText(
+            ui::Range(0, std::min(read_buffer.length(), kScreenBytes))));
+        PrintRate("open by reading, first paint", read_timer.ElapsedMs(), 1,
+            "opens");
+
+        MessageLoop loop;
+        base::Thread file_thread("file");
+        if (!file_thread.Start())
+        {
+            fprintf(stderr, "cannot start the file thread\n");
+            return;
+        }
+        LoadWaiter waiter;
+        ui::HugeFileLoader loader(&waiter, file_thread.message_loop_proxy());
+        Timer open_timer;
+        if (!loader.Open(path))
+        {
+            fprintf(stderr, "cannot map the file\n");
+            return;
+        }
+        size_t mapped_screen = LayOutFirstScreen(
+            loader.GetPreview(kScreenBytes));
+        PrintRate("HugeFileLoader, first paint", open_timer.ElapsedMs(), 1,
+            "opens");
+        MessageLoop::current()->Run();
+        PrintRate("HugeFileLoader, indexed", open_timer.ElapsedMs(),
+            text.size() >> 20, "MB");
+        printf("%-32s %10d progress reports\n", "",
+            waiter.progress_reports());
+        file_thread.Stop();
+
+        if (mapped_screen != read_screen || !waiter.buffer() ||
+            waiter.buffer()->line_count() != read_buffer.line_count())
+        {
+            fprintf(stderr, "HugeFileLoader and reading disagree\n");
+        }
+    }
+
+    // C++ with the constructs that carry over to the next line: block
+    // comments, a "//" comment and a string continued by a backslash, a raw
+    // string over three lines and a continued preprocessor line.
+    std::string MakeSource(size_t length)
+    {
+        const char* const kLines[] =
+        {
+            "#define CHECK_SIZE(x) \\",
+            "    static_assert(sizeof(x) <= 64, \"too big\")",
+            "/* Walks the values, keeping a running total",
+            "   and the largest one seen. */",
+            "int Walk(const std::vector<int>& values, int* largest)",
+            "{",
+            "    int total = 0; // long comment \\",
+            "        continued",
+            "    const char* query = R\"sql(SELECT \"total\"",
+            "        FROM values WHERE id = ?",
+            "    )sql\";",
+            "    const char* message = \"total: \\",
+            "%d\";",
+            "    for (size_t i = 0; i < values.size(); ++i)",
+            "        total += values[i] * 0x10 + 'a';",
+            "    return total;",
+            "}",
+        };
+        std::string text;
+        text.reserve(length + 128);
+        for (size_t i = 0; text.size() < length; ++i)
+        {
+            text += kLines[i % arraysize(kLines)];
+            text += '\n';
+        }
+        return text;
+    }
+
+    // Runs the loop until a line is styled.
+    class StyleWaiter : public ui::SyntaxHighlighter::Delegate
+    {
+    public:
+        StyleWaiter() : highlighter_(NULL), line_(0) {}
+
+        void set_highlighter(ui::SyntaxHighlighter* highlighter)
+        {
+            highlighter_ = highlighter;
+        }
+
+        void WaitForLine(size_t line)
+        {
+            line_ = line;
+            if (!highlighter_->IsLineStyled(line_))
+            {
+                MessageLoop::current()->Run();
+            }
+        }
+
+        virtual void OnStylesChanged(size_t first_line, size_t line_count)
+        {
+            if (highlighter_->IsLineStyled(line_))
+            {
+                MessageLoop::current()->Quit();
+            }
+        }
+
+    private:
+        ui::SyntaxHighlighter* highlighter_;
+        size_t line_;
+    };
+
+    // CppLexer over every line on this thread, then SyntaxHighlighter doing
+    // the same on a lexing thread.  Then keystrokes in the middle of the
+    // text, each timed until the visible lines around it are styled again,
+    // and opening a raw string at the top, which restyles everything after
+    // it: the time until the visible lines and until all lines are done.
+    void TimeHighlighting()
+    {
+        const size_t kSourceBytes = 16 * 1024 * 1024;
+        const size_t kVisibleLines = 60;
+        std::string source = MakeSource(kSourceBytes);
+        scoped_refptr<ui::CppLexer> lexer(new ui::CppLexer);
+
+        Timer lex_timer;
+        int state = ui::Lexer::kInitialState;
+        size_t runs_total = 0;
+        for (size_t start = 0; start < source.size();)
+        {
+            size_t end = source.find('\n', start);
+            ui::StyleRuns runs;
+            state = lexer->LexLine(base::StringPiece(source.data() + start,
+                end - start), state, &runs);
+            runs_total += runs.size();
+            start = end + 1;
+        }
+        PrintRate("CppLexer, full lex", lex_timer.ElapsedMs(),
+            source.size() >> 20, "MB");
+
+        MessageLoop loop;
+        base::Thread lex_thread("lex");
+        if (!lex_thread.Start())
+        {
+            fprintf(stderr, "cannot start the lexing thread\n");
+            return;
+        }
+        ui::TextBuffer buffer(&source);
+        {
+            StyleWaiter waiter;
+            Timer highlight_timer;
+            ui::SyntaxHighlighter highlighter(&buffer, lexer.get(), &waiter,
+                lex_thread.message_loop_proxy());
+            waiter.set_highlighter(&highlighter);
+            waiter.WaitForLine(buffer.line_count() - 1);
+            PrintRate("SyntaxHighlighter, full lex",
+                highlight_timer.ElapsedMs(), buffer.length() >> 20, "MB");
+
+            const int kKeystrokes = 1000;
+            size_t line = buffer.line_count() / 2;
+            highlighter.SetVisibleLines(line - kVisibleLines / 2,
+                kVisibleLines);
+            Timer keystroke_timer;
+            for (int i = 0; i < kKeystrokes; ++i)
+            {
+                buffer.Insert(buffer.GetLineRange(line).end(), "x");
+                highlighter.OnTextChanged(line, 1, 1);
+                waiter.WaitForLine(line + kVisibleLines / 2 - 1);
+            }
+            PrintRate("keystroke to restyle", keystroke_timer.ElapsedMs(),
+                kKeystrokes, "keystrokes");
+
+            highlighter.SetVisibleLines(0, kVisibleLines);
+            Timer open_timer;
+            buffer.Insert(0, "R\"never(");
+            highlighter.OnTextChanged(0, 1, 1);
+            waiter.WaitForLine(kVisibleLines - 1);
+            double visible_ms = open_timer.ElapsedMs();
+            waiter.WaitForLine(buffer.line_count() - 1);
+            double all_ms = open_timer.ElapsedMs();
+            printf("%-32s %10.1f ms visible %10.1f ms all\n",
+                "opening a raw string", visible_ms, all_ms);
+        }
+        lex_thread.Stop();
+
+        // Keeps the lexing from being optimized away.
+        if (runs_total == 0)
+        {
+            fprintf(stderr, "no style runs\n");
+        }
+    }
+
+    // Frames of a 1280 x 960 TextRenderer scrolled a line at a time, as
+    // with the wheel or a held arrow key, and a page at a time, over lines
+    // of 40 to 120 characters with one of 64 KB every 50 lines.  The first
+    // draws one new row a frame, the second every row; both only shape as
+    // much of a long line as fits the viewport.
+    void TimeScrolling()
+    {
+        const size_t kLines = 20000;
+        const size_t kLongLineLength = 64 * 1024;
+        std::string text;
+        for (size_t line = 0; line < kLines; ++line)
+        {
+            size_t length = (line % 50 == 49) ? kLongLineLength :
+                40 + rand() % 81;
+            for (size_t i = 0; i < length; ++i)
+            {
+                text += (rand() % 6) ? static_cast<char>('a' + rand() % 26) :
+                    ' ';
+            }
+            text += '\n';
+        }
+        ui::TextBuffer buffer(&text);
+
+        const int kWidth = 1280;
+        const int kHeight = 960;
+        ui::TextRenderer renderer(&buffer, gfx::Font());
+        renderer.SetSize(kWidth, kHeight);
+        gfx::CanvasSkia canvas(kWidth, kHeight, true);
+        renderer.Paint(&canvas, 0, 0);
+
+        const int kLineFrames = 5000;
+        Timer line_timer;
+        for (int frame = 1; frame <= kLineFrames; ++frame)
+        {
+            renderer.ScrollToLine(frame);
+            renderer.Paint(&canvas, 0, 0);
+        }
+        PrintRate("scroll by line", line_timer.ElapsedMs(), kLineFrames,
+            "frames");
+
+        size_t rows = renderer.row_count();
+        int page_frames = 0;
+        Timer page_timer;
+        for (size_t line = 0; line + rows < buffer.line_count(); line += rows)
+        {
+            renderer.ScrollToLine(line);
+            renderer.Paint(&canvas, 0, 0);
+            ++page_frames;
+        }
+        PrintRate("scroll by page", page_timer.ElapsedMs(), page_frames,
+            "frames");
+    }
+
+    // Quits the loop once no line is waiting to be wrapped.
+    class WrapWaiter : public ui::WrapLayout::Delegate
+    {
+    public:
+        WrapWaiter() : layout_(NULL) {}
+
+        void set_layout(ui::WrapLayout* layout) { layout_ = layout; }
+
+        void WaitForIdle()
+        {
+            if (layout_->IsBusy())
+            {
+                MessageLoop::current()->Run();
+            }
+        }
+
+        virtual void OnRowsChanged(size_t first_line, size_t line_count)
+        {
+            if (!layout_->IsBusy())
+            {
+                MessageLoop::current()->Quit();
+            }
+        }
+
+    private:
+        ui::WrapLayout* layout_;
+    };
+
+    // Resizing a soft-wrapped view of 32 MB of text, alternately 1280 and
+    // 640 pixels wide: each timed until the visible rows are wrapped and
+    // painted, the rest of the lines keeping their old row counts, and the
+    // last until the layout thread has wrapped every line.
+    void TimeResize()
+    {
+        const int kResizes = 20;
+        const int kHeight = 960;
+        std::string text = MakeDocument(32 * 1024 * 1024);
+        ui::TextBuffer buffer(&text);
+
+        MessageLoop loop;
+        base::Thread layout_thread("layout");
+        if (!layout_thread.Start())
+        {
+            fprintf(stderr, "cannot start the layout thread\n");
+            return;
+        }
+        {
+            gfx::Font font;
+            WrapWaiter waiter;
+            ui::WrapLayout layout(&buffer, font, &waiter,
+                layout_thread.message_loop_proxy());
+            waiter.set_layout(&layout);
+            ui::TextRenderer renderer(&buffer, font);
+            gfx::CanvasSkia canvas(1280, kHeight, true);
+            size_t first_line = buffer.line_count() / 2;
+            renderer.ScrollToLine(first_line);
+            layout.SetFirstVisibleLine(first_line);
+
+            std::vector<uint32> wrap_points;
+            size_t wrap_point_count = 0;
+            Timer resize_timer;
+            for (int i = 0; i < kResizes; ++i)
+            {
+                int width = (i % 2) ? 640 : 1280;
+                layout.SetWidth(width);
+                renderer.SetSize(width, kHeight);
+                size_t rows = 0;
+                for (size_t line = first_line; rows < renderer.row_count() &&
+                    line < buffer.line_count(); ++line)
+                {
+                    layout.GetWrapPoints(line, &wrap_points);
+                    wrap_point_count += wrap_points.size();
+                    rows += wrap_points.size() + 1;
+                }
+                renderer.Paint(&canvas, 0, 0);
+            }
+            PrintRate("resize to paint", resize_timer.ElapsedMs(), kResizes,
+                "resizes");
+
+            Timer wrap_timer;
+            waiter.WaitForIdle();
+            PrintRate("wrapping all lines", wrap_timer.ElapsedMs(),
+                buffer.length() >> 20, "MB");
+            printf("%-32s %10u rows %10u wrap points\n", "",
+                static_cast<unsigned>(layout.row_count()),
+                static_cast<unsigned>(wrap_point_count));
+        }
+        layout_thread.Stop();
+    }
+
+    // Quits the loop when the search is done, noting when the first rows
+    // came in.
+    class SearchWaiter : public ui::TableModelObserver,
+        public ui::FindInFilesModel::Delegate
+    {
+    public:
+        SearchWaiter() : first_rows_ms_(0), batches_(0), rows_(0),
+            files_searched_(0) {}
+
+        virtual void OnModelChanged() {}
+        virtual void OnItemsChanged(int start, int length) {}
+        virtual void OnItemsAdded(int start, int length)
+        {
+            if (batches_++ == 0)
+            {
+                first_rows_ms_ = timer_.ElapsedMs();
+            }
+            rows_ += length;
+        }
+        virtual void OnItemsRemoved(int start, int length) {}
+
+        virtual void OnSearchComplete(int files_searched)
+        {
+            files_searched_ = files_searched;
+            MessageLoop::current()->Quit();
+        }
+
+        const Timer& timer() const { return timer_; }
+        double first_rows_ms() const { return first_rows_ms_; }
+        int batches() const { return batches_; }
+        int rows() const { return rows_; }
+        int files_searched() const { return files_searched_; }
+
+    private:
+        Timer timer_;
+        double first_rows_ms_;
+        int batches_;
+        int rows_;
+        int files_searched_;
+    };
+
+    // A tree like a source checkout: 40 directories of 50 files, most of 1
+    // to 32 KB and every 200th of 4 MB, so that the search reads some and
+    // maps others.  Every 10th file has a line with "FIND_THIS" on it.
+    // Returns how many such lines there are, or -1 if the tree could not be
+    // written.
+    int MakeTree(const FilePath& root)
+    {
+        const int kDirectories = 40;
+        const int kFilesPerDirectory = 50;
+        int lines = 0;
+        for (int d = 0; d < kDirectories; ++d)
+        {
+            wchar_t name[32];
+            _snwprintf_s(name, arraysize(name), _TRUNCATE, L"dir%d", d);
+            FilePath directory = root.Append(name);
+            if (!base::CreateDirectory(directory))
+            {
+                return -1;
+            }
+            for (int f = 0; f < kFilesPerDirectory; ++f)
+            {
+                int index = d * kFilesPerDirectory + f;
+                std::string text = MakeDocument(index % 200 == 199 ?
+                    4 * 1024 * 1024 : 1024 + RandomBelow(31 * 1024));
+                if (index % 10 == 0)
+                {
+                    size_t offset = text.find('\n',
+                        RandomBelow(text.size()));
+                    offset = offset == std::string::npos ? 0 : offset + 1;
+                    text.insert(offset, "FIND_THIS once\n");
+                    ++lines;
+                }
+                _snwprintf_s(name, arraysize(name), _TRUNCATE, L"file%d.cc",
+                    f);
+                if (base::WriteFile(directory.Append(name), text.data(),
+                    static_cast<int>(text.size())) !=
+                    static_cast<int>(text.size()))
+                {
+                    return -1;
+                }
+            }
+        }
+        return lines;
+    }
+
+    // Searches |root| with |matcher| through FindInFilesModel and prints
+    // the time to the first rows and to the end.  |expected_rows| is -1
+    // when not known.
+    void RunFindInFiles(const char* name, const FilePath& root,
+        ui::TextMatcher* matcher, base::MessageLoopProxy* file_proxy,
+        int expected_rows)
+    {
+        ui::FindInFilesModel model(file_proxy);
+        SearchWaiter waiter;
+        model.SetObserver(&waiter);
+        model.set_delegate(&waiter);
+        model.Start(root, matcher);
+        MessageLoop::current()->Run();
+        double ms = waiter.timer().ElapsedMs();
+        printf("%-32s %10.1f ms first rows %10.1f ms all\n", name,
+            waiter.first_rows_ms(), ms);
+        printf("%-32s %10d files %8d rows %6d batches\n", "",
+            waiter.files_searched(), waiter.rows(), waiter.batches());
+        if (expected_rows >= 0 && waiter.rows() != expected_rows)
+        {
+            fprintf(stderr, "%s found %d rows, not %d\n", name,
+                waiter.rows(), expected_rows);
+        }
+    }
+
+    // The find in files pipeline, walking, reading or mapping and searching
+    // on its threads, with the rows coming back to this one in batches:
+    // the time to the first rows and to the end, for a literal and a regex.
+    // Over |root| if it is not empty, else over a generated tree.
+    void TimeFindInFiles(const FilePath& root)
+    {
+        ScopedTempDir temp_dir;
+        FilePath search_root = root;
+        int expected_rows = -1;
+        if (search_root.empty())
+        {
+            if (!temp_dir.CreateUniqueTempDir())
+            {
+                fprintf(stderr, "cannot create a temporary directory\n");
+                return;
+            }
+            search_root = temp_dir.path();
+            expected_rows = MakeTree(search_root);
+            if (expected_rows < 0)
+            {
+                fprintf(stderr, "cannot write the tree to search\n");
+                return;
+            }
+        }
+
+        MessageLoop loop;
+        base::Thread file_thread("file");
+        if (!file_thread.Start())
+        {
+            fprintf(stderr, "cannot start the file thread\n");
+            return;
+        }
+        RunFindInFiles("find in files, literal", search_root,
+            new ui::LiteralMatcher("FIND_THIS", false),
+            file_thread.message_loop_proxy(), expected_rows);
+        RunFindInFiles("find in files, regex", search_root,
+            new ui::RegexMatcher("^FIND_TH[A-Z]+ ", false),
+            file_thread.message_loop_proxy(), expected_rows);
+        file_thread.Stop();
+    }
+
+    // Puts |caret_count| carets evenly over |buffer|.
+    ui::SelectionSet MakeCarets(const ui::TextBuffer& buffer,
+        size_t caret_count)
+    {
+        std::vector<ui::Range> carets;
+        size_t step = buffer.length() / caret_count;
+        for (size_t i = 0; i < caret_count; ++i)
+        {
+            carets.push_back(ui::Range(i * step));
+        }
+        ui::SelectionSet selections;
+        selections.SetRanges(carets);
+        return selections;
+    }
+
+    // Typing and deleting at many carets, each keystroke one edit of the
+    // buffer filling a TextEdit for undo.
+    void TimeMultiCaretTyping(ui::TextBuffer* buffer)
+    {
+        const size_t kCarets = 10000;
+        const int kKeystrokes = 200;
+        ui::SelectionSet selections = MakeCarets(*buffer, kCarets);
+
+        Timer typing_timer;
+        for (int i = 0; i < kKeystrokes; ++i)
+        {
+            ui::TextEdit edit;
+            selections.ReplaceSelections(buffer, "x", &edit);
+        }
+        PrintRate("typing at 10000 carets", typing_timer.ElapsedMs(),
+            kKeystrokes, "keystrokes");
+
+        Timer delete_timer;
+        for (int i = 0; i < kKeystrokes; ++i)
+        {
+            ui::TextEdit edit;
+            selections.DeleteBackward(buffer, &edit);
+        }
+        PrintRate("deleting at 10000 carets", delete_timer.ElapsedMs(),
+            kKeystrokes, "keystrokes");
+    }
+
+    // Recording typing and a replace-all in an UndoHistory, without
+    // compression, and undoing all of it.
+    void TimeUndo(ui::TextBuffer* buffer)
+    {
+        ui::UndoHistory history(NULL);
+        const int kKeystrokes = 100000;
+        ui::SelectionSet caret = MakeCarets(*buffer, 1);
+        Timer record_timer;
+        for (int i = 0; i < kKeystrokes; ++i)
+        {
+            ui::TextEdit edit;
+            caret.ReplaceSelections(buffer, (i % 50 == 49) ? "\n" : "y",
+                &edit);
+            history.Record(edit);
+        }
+        PrintRate("recording typing", record_timer.ElapsedMs(), kKeystrokes,
+            "keystrokes");
+
+        ui::SelectionSet selections;
+        std::vector<ui::Range> ranges;
+        for (size_t offset = 0; offset + 4 < buffer->length(); offset += 64)
+        {
+            ranges.push_back(ui::Range(offset, offset + 4));
+        }
+        selections.SetRanges(ranges);
+        Timer replace_timer;
+        ui::TextEdit edit;
+        selections.ReplaceSelections(buffer, "abc", &edit);
+        history.Record(edit);
+        PrintRate("recording replace-all", replace_timer.ElapsedMs(),
+            ranges.size(), "ranges");
+        printf("%-32s %10u KB held\n", "",
+            static_cast<unsigned>(history.byte_size() >> 10));
+
+        int undone = 0;
+        Timer undo_timer;
+        std::vector<ui::Range> restored;
+        while (history.Undo(buffer, &restored))
+        {
+            ++undone;
+        }
+        PrintRate("undo all", undo_timer.ElapsedMs(), undone, "entries");
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 100;
+    if (megabytes == 0)
+    {
+        megabytes = 100;
+    }
+    base::AtExitManager exit_manager;
+    srand(1);
+    std::string text = MakeDocument(megabytes << 20);
+    size_t length = text.size();
+
+    TimeHugeFileLoad(text);
+    TimeHighlighting();
+    TimeScrolling();
+    TimeResize();
+    TimeFindInFiles(argc > 2 ?
+        FilePath(base::SysNativeMBToWide(argv[2])) : FilePath());
+
+    // The scan alone, which bounds what building the index can reach.
+    Timer scan_timer;
+    size_t breaks = ui::CountLineBreaks(text, false);
+    PrintGigabytes("CountLineBreaks", scan_timer.ElapsedMs(), length);
+
+    Timer build_timer;
+    ui::TextBuffer buffer(&text);
+    PrintGigabytes("build with line index", build_timer.ElapsedMs(), length);
+    printf("%-32s %10u lines\n", "",
+        static_cast<unsigned>(buffer.line_count()));
+    if (buffer.line_count() != breaks + 1)
+    {
+        fprintf(stderr, "line index and scan disagree\n");
+    }
+
+    const int kLookups = 1000000;
+    size_t sum = 0;
+    Timer line_timer;
+    for (int i = 0; i < kLookups; ++i)
+    {
+        sum += buffer.LineToOffset(RandomBelow(buffer.line_count()));
+    }
+    PrintRate("LineToOffset", line_timer.ElapsedMs(), kLookups, "lookups");
+    Timer offset_timer;
+    for (int i = 0; i < kLookups; ++i)
+    {
+        sum += buffer.OffsetToLine(RandomBelow(buffer.length()));
+    }
+    PrintRate("OffsetToLine", offset_timer.ElapsedMs(), kLookups, "lookups");
+
+    // Typing: short inserts near each other, with a few deletes.
+    const int kEdits = 200000;
+    size_t caret = buffer.length() / 2;
+    Timer typing_timer;
+    for (int i = 0; i < kEdits; ++i)
+    {
+        if (i % 8 == 7)
+        {
+            buffer.Delete(ui::Range(caret - 1, caret));
+            --caret;
+        }
+        else
+        {
+            buffer.Insert(caret, (i % 40) ? "x" : "\n");
+            ++caret;
+        }
+    }
+    PrintRate("typing", typing_timer.ElapsedMs(), kEdits, "edits");
+
+    // Edits scattered over the document, each splitting a piece.
+    Timer random_timer;
+    for (int i = 0; i < kEdits; ++i)
+    {
+        size_t offset = RandomBelow(buffer.length());
+        if (i % 2)
+        {
+            buffer.Insert(offset, "word\n");
+        }
+        else
+        {
+            buffer.Delete(ui::Range(offset,
+                std::min(buffer.length(), offset + 3)));
+        }
+    }
+    PrintRate("scattered edits", random_timer.ElapsedMs(), kEdits, "edits");
+
+    // One replace-all style edit of many ranges.
+    std::vector<ui::Range> ranges;
+    size_t step = std::max<size_t>(8, buffer.length() / 100000);
+    for (size_t offset = 0; offset + 4 < buffer.length(); offset += step)
+    {
+        ranges.push_back(ui::Range(offset, offset + 4));
+    }
+    Timer replace_timer;
+    buffer.ReplaceRanges(ranges, "abc");
+    PrintRate("ReplaceRanges", replace_timer.ElapsedMs(), ranges.size(),
+        "ranges");
+
+    // Searches walk the pieces left by the edits above.
+    RunSearch("find literal", buffer, ui::LiteralMatcher("qzx", false));
+    RunSearch("find literal, ignoring case", buffer,
+        ui::LiteralMatcher("QZX", true));
+    RunSearch("find regex", buffer, ui::RegexMatcher("q[a-z]x ", false));
+
+    // A regex replace-all with a group reference, filling a TextEdit.
+    ui::RegexMatcher replace_matcher("([a-z])q", false);
+    ui::TextSearcher replacer(&replace_matcher);
+    ui::TextEdit replace_edit;
+    Timer replace_all_timer;
+    size_t replaced = replacer.ReplaceAll(&buffer, "Q$1", &replace_edit);
+    PrintRate("replace all, regex", replace_all_timer.ElapsedMs(), replaced,
+        "matches");
+
+    TimeMultiCaretTyping(&buffer);
+    TimeUndo(&buffer);
+
+    // Keeps the lookups from being optimized away.
+    return sum == 1 ? 1 : 0;
+}
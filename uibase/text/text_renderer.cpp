@@ -0,0 +1,470 @@
+#include "text_renderer.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/utf_string_conversions.h"
+#include "SkBitmap.h"
+#include "uigfx/canvas_skia.h"
+#include "syntax_highlighter.h"
+#include "text_buffer.h"
+
+namespace
+{
+
+    // Shaped lines kept in the cache; a few screens' worth.
+    const size_t kMaxCachedLayouts = 4096;
+
+    const int kTabWidth = 4;
+
+    // Characters shaped past what the viewport holds at the font's average
+    // width, for lines of narrower characters.
+    const size_t kShapeMargin = 64;
+
+    inline bool IsUTF8Continuation(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    // 64-bit FNV-1a over the text and the style runs.
+    uint64 HashLine(const std::string& text, const ui::StyleRuns& styles)
+    {
+        uint64 hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            hash = (hash ^ static_cast<uint8>(text[i])) * 1099511628211ULL;
+        }
+        for (size_t i = 0; i < styles.size(); ++i)
+        {
+            hash = (hash ^ styles[i].length) * 1099511628211ULL;
+            hash = (hash ^ styles[i].style) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    bool SameStyles(const ui::StyleRuns& a, const ui::StyleRuns& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].length != b[i].length || a[i].style != b[i].style)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Converts |text| to UTF-16, expanding tabs.  |column| is the column
+    // |text| starts at and is moved past it.
+    void ExpandTabs(const base::StringPiece& text, int* column,
+        string16* output)
+    {
+        string16 converted;
+        UTF8ToUTF16(text.data(), text.size(), &converted);
+        output->reserve(converted.size());
+        for (size_t i = 0; i < converted.size(); ++i)
+        {
+            if (converted[i] == L'\t')
+            {
+                int spaces = kTabWidth - *column % kTabWidth;
+                output->append(spaces, L' ');
+                *column += spaces;
+            }
+            else
+            {
+                output->push_back(converted[i]);
+                ++*column;
+            }
+        }
+    }
+
+}
+
+namespace ui
+{
+
+    TextRenderer::Layout::Layout() : key(0), width(0) {}
+
+    TextRenderer::Layout::~Layout() {}
+
+    TextRenderer::TextRenderer(const TextBuffer* buffer, const gfx::Font& font)
+        : buffer_(buffer),
+        highlighter_(NULL),
+        font_(font),
+        line_height_(font.GetHeight()),
+        background_color_(SK_ColorWHITE),
+        dc_(CreateCompatibleDC(NULL)),
+        old_font_(NULL),
+        width_(0),
+        height_(0),
+        first_line_(0)
+    {
+        old_font_ = SelectObject(dc_, font_.GetNativeFont());
+
+        style_colors_[STYLE_DEFAULT] = SK_ColorBLACK;
+        style_colors_[STYLE_COMMENT] = SkColorSetRGB(0, 128, 0);
+        style_colors_[STYLE_STRING] = SkColorSetRGB(163, 21, 21);
+        style_colors_[STYLE_CHARACTER] = SkColorSetRGB(163, 21, 21);
+        style_colors_[STYLE_NUMBER] = SkColorSetRGB(9, 134, 88);
+        style_colors_[STYLE_KEYWORD] = SkColorSetRGB(0, 0, 255);
+        style_colors_[STYLE_PREPROCESSOR] = SkColorSetRGB(128, 128, 128);
+        style_colors_[STYLE_OPERATOR] = SK_ColorBLACK;
+    }
+
+    TextRenderer::~TextRenderer()
+    {
+        SelectObject(dc_, old_font_);
+        ClearCache();
+    }
+
+    void TextRenderer::SetHighlighter(const SyntaxHighlighter* highlighter)
+    {
+        highlighter_ = highlighter;
+        InvalidateAll();
+    }
+
+    void TextRenderer::SetStyleColor(TextStyle style, SkColor color)
+    {
+        style_colors_[style] = color;
+        InvalidateAll();
+    }
+
+    void TextRenderer::SetBackgroundColor(SkColor color)
+    {
+        background_color_ = color;
+        InvalidateAll();
+    }
+
+    void TextRenderer::SetFont(const gfx::Font& font)
+    {
+        font_ = font;
+        line_height_ = font_.GetHeight();
+        SelectObject(dc_, font_.GetNativeFont());
+        // Glyphs and advances belong to the old font.
+        ClearCache();
+        SetSize(width_, height_);
+    }
+
+    void TextRenderer::SetSize(int width, int height)
+    {
+        width_ = width;
+        height_ = height;
+        size_t rows = 0;
+        if (width > 0 && height > 0)
+        {
+            rows = (height + line_height_ - 1) / line_height_;
+            backing_.reset(new gfx::CanvasSkia(width,
+                static_cast<int>(rows) * line_height_, true));
+        }
+        else
+        {
+            backing_.reset();
+        }
+        row_dirty_.assign(rows, true);
+    }
+
+    void TextRenderer::ScrollToLine(size_t line)
+    {
+        if (line == first_line_)
+        {
+            return;
+        }
+
+        size_t rows = row_dirty_.size();
+        size_t distance = line > first_line_ ? line - first_line_ :
+            first_line_ - line;
+        if (!backing_.get() || distance >= rows)
+        {
+            first_line_ = line;
+            InvalidateAll();
+            return;
+        }
+
+        // Move the rows still in view and draw only the uncovered ones.
+        int dy = static_cast<int>(distance) * line_height_;
+        const SkBitmap& bitmap = backing_->getDevice()->accessBitmap(true);
+        if (line > first_line_)
+        {
+            bitmap.scrollRect(NULL, 0, -dy);
+            for (size_t row = 0; row + distance < rows; ++row)
+            {
+                row_dirty_[row] = row_dirty_[row + distance];
+            }
+            for (size_t row = rows - distance; row < rows; ++row)
+            {
+                row_dirty_[row] = true;
+            }
+        }
+        else
+        {
+            bitmap.scrollRect(NULL, 0, dy);
+            for (size_t row = rows; row-- > distance;)
+            {
+                row_dirty_[row] = row_dirty_[row - distance];
+            }
+            for (size_t row = 0; row < distance; ++row)
+            {
+                row_dirty_[row] = true;
+            }
+        }
+        first_line_ = line;
+    }
+
+    void TextRenderer::InvalidateLines(size_t first_line, size_t line_count)
+    {
+        size_t end = first_line_ + row_dirty_.size();
+        if (first_line < end && line_count < end - first_line)
+        {
+            end = first_line + line_count;
+        }
+        for (size_t line = std::max(first_line, first_line_); line < end; ++line)
+        {
+            row_dirty_[line - first_line_] = true;
+        }
+    }
+
+    void TextRenderer::OnTextChanged(size_t first_line, size_t old_line_count,
+        size_t new_line_count)
+    {
+        if (old_line_count == new_line_count)
+        {
+            InvalidateLines(first_line, new_line_count);
+        }
+        else
+        {
+            // The lines below moved.
+            InvalidateFromLine(first_line);
+        }
+    }
+
+    void TextRenderer::Paint(gfx::Canvas* canvas, int x, int y)
+    {
+        if (!backing_.get())
+        {
+            return;
+        }
+
+        for (size_t row = 0; row < row_dirty_.size(); ++row)
+        {
+            if (row_dirty_[row])
+            {
+                PaintRow(row);
+                row_dirty_[row] = false;
+            }
+        }
+
+        const SkBitmap& bitmap = backing_->getDevice()->accessBitmap(false);
+        canvas->DrawBitmapInt(bitmap, 0, 0, width_, height_,
+            x, y, width_, height_, false);
+    }
+
+    void TextRenderer::InvalidateFromLine(size_t line)
+    {
+        for (size_t row = line > first_line_ ? line - first_line_ : 0;
+            row < row_dirty_.size(); ++row)
+        {
+            row_dirty_[row] = true;
+        }
+    }
+
+    void TextRenderer::InvalidateAll()
+    {
+        row_dirty_.assign(row_dirty_.size(), true);
+    }
+
+    void TextRenderer::ClearCache()
+    {
+        for (LayoutList::iterator i = layouts_.begin(); i != layouts_.end(); ++i)
+        {
+            delete *i;
+        }
+        layouts_.clear();
+        layout_map_.clear();
+    }
+
+    const TextRenderer::Layout* TextRenderer::GetLayout(size_t line)
+    {
+        Range range = buffer_->GetLineRange(line);
+        size_t length = static_cast<size_t>(width_ /
+            std::max(1, font_.GetAverageCharacterWidth())) + kShapeMargin;
+        for (;;)
+        {
+            const Layout* layout = GetPrefixLayout(line, range, length);
+            // Narrow characters, or characters of several bytes, can leave
+            // the prefix short of the viewport; take twice as much then.
+            if (layout->text.size() == range.length() ||
+                layout->width >= width_)
+            {
+                return layout;
+            }
+            length *= 2;
+        }
+    }
+
+    const TextRenderer::Layout* TextRenderer::GetPrefixLayout(size_t line,
+        const Range& range, size_t length)
+    {
+        if (length < range.length())
+        {
+            while (length > 0 && IsUTF8Continuation(
+                buffer_->GetCharAt(range.start() + length)))
+            {
+                --length;
+            }
+        }
+        else
+        {
+            length = range.length();
+        }
+        std::string text;
+        buffer_->GetText(Range(range.start(), range.start() + length), &text);
+
+        // Styles can lag behind the text until the highlighter catches up;
+        // fit them to the text.
+        StyleRuns styles;
+        size_t styled = 0;
+        if (highlighter_)
+        {
+            const StyleRuns& runs = highlighter_->GetLineStyles(line);
+            for (size_t i = 0; i < runs.size() && styled < text.size(); ++i)
+            {
+                size_t length = std::min<size_t>(runs[i].length,
+                    text.size() - styled);
+                AppendStyleRun(static_cast<TextStyle>(runs[i].style), length,
+                    &styles);
+                styled += length;
+            }
+        }
+        AppendStyleRun(STYLE_DEFAULT, text.size() - styled, &styles);
+
+        uint64 key = HashLine(text, styles);
+        LayoutMap::iterator found = layout_map_.find(key);
+        if (found != layout_map_.end())
+        {
+            Layout* layout = *found->second;
+            if (layout->text == text && SameStyles(layout->styles, styles))
+            {
+                layouts_.splice(layouts_.begin(), layouts_, found->second);
+                return layout;
+            }
+            // A hash collision; the new line takes the slot.
+            delete layout;
+            layouts_.erase(found->second);
+            layout_map_.erase(found);
+        }
+
+        Layout* layout = Shape(text, styles);
+        layout->key = key;
+        layouts_.push_front(layout);
+        layout_map_[key] = layouts_.begin();
+
+        if (layouts_.size() > kMaxCachedLayouts)
+        {
+            Layout* oldest = layouts_.back();
+            layout_map_.erase(oldest->key);
+            layouts_.pop_back();
+            delete oldest;
+        }
+        return layout;
+    }
+
+    TextRenderer::Layout* TextRenderer::Shape(const std::string& text,
+        const StyleRuns& styles)
+    {
+        Layout* layout = new Layout;
+        layout->text = text;
+        layout->styles = styles;
+
+        size_t offset = 0;
+        int column = 0;
+        for (size_t i = 0; i < styles.size(); ++i)
+        {
+            string16 run_text;
+            ExpandTabs(base::StringPiece(text.data() + offset,
+                styles[i].length), &column, &run_text);
+            offset += styles[i].length;
+            if (run_text.empty())
+            {
+                continue;
+            }
+
+            std::vector<wchar_t> glyphs(run_text.size());
+            std::vector<int> advances(run_text.size());
+            GCP_RESULTSW results = { sizeof(results) };
+            results.lpGlyphs = &glyphs[0];
+            results.lpDx = &advances[0];
+            results.nGlyphs = static_cast<UINT>(glyphs.size());
+            if (!GetCharacterPlacementW(dc_, run_text.c_str(),
+                static_cast<int>(run_text.size()), 0, &results, 0))
+            {
+                continue;
+            }
+
+            GlyphRun run;
+            run.start = layout->glyphs.size();
+            run.length = results.nGlyphs;
+            run.style = static_cast<TextStyle>(styles[i].style);
+            layout->glyphs.insert(layout->glyphs.end(), glyphs.begin(),
+                glyphs.begin() + run.length);
+            layout->advances.insert(layout->advances.end(), advances.begin(),
+                advances.begin() + run.length);
+            layout->runs.push_back(run);
+            for (size_t g = 0; g < run.length; ++g)
+            {
+                layout->width += advances[g];
+            }
+        }
+        return layout;
+    }
+
+    void TextRenderer::PaintRow(size_t row)
+    {
+        int y = static_cast<int>(row) * line_height_;
+        backing_->FillRectInt(background_color_, 0, y, width_, line_height_);
+
+        size_t line = first_line_ + row;
+        if (line >= buffer_->line_count())
+        {
+            return;
+        }
+
+        const Layout* layout = GetLayout(line);
+        if (layout->runs.empty())
+        {
+            return;
+        }
+
+        {
+            skia::ScopedPlatformPaint scoped_platform_paint(backing_.get());
+            HDC dc = scoped_platform_paint.GetPlatformSurface();
+            SetBkMode(dc, TRANSPARENT);
+            HGDIOBJ old_font = SelectObject(dc, font_.GetNativeFont());
+
+            int x = 0;
+            for (size_t i = 0; i < layout->runs.size() && x < width_; ++i)
+            {
+                const GlyphRun& run = layout->runs[i];
+                SkColor color = style_colors_[run.style];
+                SetTextColor(dc, RGB(SkColorGetR(color), SkColorGetG(color),
+                    SkColorGetB(color)));
+                ExtTextOutW(dc, x, y, ETO_GLYPH_INDEX, NULL,
+                    &layout->glyphs[run.start], static_cast<UINT>(run.length),
+                    &layout->advances[run.start]);
+                for (size_t g = run.start; g < run.start + run.length; ++g)
+                {
+                    x += layout->advances[g];
+                }
+            }
+
+            SelectObject(dc, old_font);
+        }
+
+        // GDI clears the alpha of what it draws.
+        skia::MakeOpaque(backing_.get(), 0, y, width_, line_height_);
+    }
+
+} //namespace ui
@@ -0,0 +1,149 @@
+#ifndef __ui_base_text_renderer_h__
+#define __ui_base_text_renderer_h__
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/win/scoped_hdc.h"
+#include "SkColor.h"
+#include "uibase/range/range.h"
+#include "uigfx/font.h"
+#include "lexer.h"
+
+namespace gfx
+{
+    class Canvas;
+    class CanvasSkia;
+}
+
+namespace ui
+{
+
+    class SyntaxHighlighter;
+    class TextBuffer;
+
+    // Paints the visible lines of a TextBuffer, one row per line.
+    //
+    // Rows are drawn into a backing bitmap the size of the viewport and only
+    // redrawn when invalidated.  Scrolling moves the rows already drawn with
+    // SkBitmap::scrollRect() and draws just the lines scrolled into view, so
+    // the cost of a frame depends on the viewport, not on the document.
+    //
+    // Lines are shaped into glyphs with GDI once and cached by content and
+    // styles, so a line drawn again, or one with the same text, costs a
+    // lookup.  Only the part of a line that fits the viewport, with a
+    // margin, is fetched and shaped, so a very long line costs no more than
+    // a short one.
+    class TextRenderer
+    {
+    public:
+        // |buffer| must outlive the renderer.
+        TextRenderer(const TextBuffer* buffer, const gfx::Font& font);
+        ~TextRenderer();
+
+        // Styles come from |highlighter| when set; it must outlive the
+        // renderer.
+        void SetHighlighter(const SyntaxHighlighter* highlighter);
+
+        void SetStyleColor(TextStyle style, SkColor color);
+        void SetBackgroundColor(SkColor color);
+        void SetFont(const gfx::Font& font);
+
+        void SetSize(int width, int height);
+
+        // Makes |line| the first visible line.
+        void ScrollToLine(size_t line);
+        size_t first_line() const { return first_line_; }
+
+        // Rows in the viewport, counting a partly visible last one.
+        size_t row_count() const { return row_dirty_.size(); }
+        int line_height() const { return line_height_; }
+
+        // Lines [first_line, first_line + line_count) need redrawing, e.g.
+        // for new styles.
+        void InvalidateLines(size_t first_line, size_t line_count);
+
+        // Lines [first_line, first_line + old_line_count) were replaced by
+        // |new_line_count| lines.
+        void OnTextChanged(size_t first_line, size_t old_line_count,
+            size_t new_line_count);
+
+        // Redraws the invalid rows and copies the viewport to |canvas| at
+        // (x, y).
+        void Paint(gfx::Canvas* canvas, int x, int y);
+
+    private:
+        // Glyphs of one style run.
+        struct GlyphRun
+        {
+            size_t start;
+            size_t length;
+            TextStyle style;
+        };
+
+        // A shaped line, or the start of one, kept with the text and styles
+        // it was made from.
+        struct Layout
+        {
+            Layout();
+            ~Layout();
+
+            uint64 key;
+            std::string text;
+            StyleRuns styles;
+            std::vector<wchar_t> glyphs;
+            std::vector<int> advances;
+            std::vector<GlyphRun> runs;
+            // Sum of |advances|.
+            int width;
+        };
+
+        typedef std::list<Layout*> LayoutList;
+        typedef std::map<uint64, LayoutList::iterator> LayoutMap;
+
+        void InvalidateFromLine(size_t line);
+        void InvalidateAll();
+        void ClearCache();
+
+        // Returns a layout of as much of |line| as fills the viewport, from
+        // the cache or shaped on a miss.
+        const Layout* GetLayout(size_t line);
+        // The same for the first |length| bytes of |line|, which spans
+        // |range|, or fewer so as not to split a character.
+        const Layout* GetPrefixLayout(size_t line, const Range& range,
+            size_t length);
+        Layout* Shape(const std::string& text, const StyleRuns& styles);
+
+        void PaintRow(size_t row);
+
+        const TextBuffer* buffer_;
+        const SyntaxHighlighter* highlighter_;
+
+        gfx::Font font_;
+        int line_height_;
+        SkColor style_colors_[STYLE_OPERATOR + 1];
+        SkColor background_color_;
+
+        // Memory DC with |font_| selected, for shaping.
+        base::win::ScopedHDC dc_;
+        HGDIOBJ old_font_;
+
+        int width_;
+        int height_;
+        scoped_ptr<gfx::CanvasSkia> backing_;
+        size_t first_line_;
+        std::vector<bool> row_dirty_;
+
+        // Most recently used first.
+        LayoutList layouts_;
+        LayoutMap layout_map_;
+
+        DISALLOW_COPY_AND_ASSIGN(TextRenderer);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_text_renderer_h__
@@ -0,0 +1,646 @@
+#include "text_search.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/string_search.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "base/threading/platform_thread.h"
+#include "line_breaks.h"
+#include "text_buffer.h"
+#include "text_edit.h"
+
+namespace
+{
+
+    const int kMaxThreadCount = 8;
+
+    // Segments are at least this long, so that threads are not started for
+    // small documents and a boundary rarely falls into a match.
+    const size_t kMinSegmentLength = 4 * 1024 * 1024;
+
+    // Segments per thread; more than one evens out the work where matches
+    // are denser in some parts.
+    const size_t kSegmentsPerThread = 4;
+
+    // Unfinished text carried across pieces is searched as is once it gets
+    // this long, so a huge line without a break does not pile up; regex
+    // matches across such a cut are lost.
+    const size_t kMaxPendingLength = 1024 * 1024;
+
+    // The part of a line std::regex is given to search at once; its
+    // backtracking recurses about once per character it takes in.
+    // Successive parts overlap by half.
+    const size_t kMaxRegexTextLength = 4 * 1024;
+
+    // Finds where the line starting at |begin| ends, before its break, and
+    // where the next one starts; both are |end| on the last line.
+    void FindLineEnd(const char* begin, const char* end,
+        const char** line_end, const char** next_line)
+    {
+        size_t line_break = ui::FindLineBreak(
+            base::StringPiece(begin, end - begin), 1, false);
+        if (line_break == base::StringPiece::npos)
+        {
+            *line_end = end;
+            *next_line = end;
+            return;
+        }
+        *line_end = begin + line_break;
+        *next_line = *line_end + 1;
+        if (**line_end == '\n' && *line_end != begin &&
+            (*line_end)[-1] == '\r')
+        {
+            --*line_end;
+        }
+    }
+
+    // Start of the line holding |offset| in |text|, looking for line breaks
+    // from |line_start|, the start of a line before it, on.
+    size_t FindLineStart(const base::StringPiece& text, size_t line_start,
+        size_t offset)
+    {
+        // An offset on the "\n" of a "\r\n" is still on the line it ends.
+        bool followed_by_lf = offset < text.size() && text[offset] == '\n';
+        size_t line_break = ui::FindLastLineBreak(base::StringPiece(
+            text.data() + line_start, offset - line_start), followed_by_lf);
+        return line_break == base::StringPiece::npos ? line_start :
+            line_start + line_break + 1;
+    }
+
+    // Formats |replacement| for the matches from |*next| on that lie in
+    // |line|, which starts at |line_offset|, appending the results to
+    // |texts|.
+    void FormatLine(const ui::TextMatcher& matcher,
+        const base::StringPiece& line, size_t line_offset,
+        const std::vector<ui::Range>& matches,
+        const base::StringPiece& replacement, size_t* next,
+        std::vector<std::string>* texts)
+    {
+        // Matches do not take in the "\r" of a "\r\n".
+        base::StringPiece text(line);
+        if (!text.empty() && text[text.size() - 1] == '\r')
+        {
+            text.remove_suffix(1);
+        }
+        std::string result;
+        for (; *next < matches.size() &&
+            matches[*next].start() < line_offset + text.size(); ++*next)
+        {
+            ui::Range match(matches[*next].start() - line_offset,
+                matches[*next].end() - line_offset);
+            matcher.FormatReplacement(text, match, replacement, &result);
+            texts->push_back(result);
+        }
+    }
+
+    // Fills |texts| with what |matcher| makes of |replacement| for each of
+    // |matches|, reading the lines that hold them in one pass over
+    // |buffer|.
+    void FormatReplacements(const ui::TextBuffer& buffer,
+        const ui::TextMatcher& matcher, const std::vector<ui::Range>& matches,
+        const base::StringPiece& replacement, std::vector<std::string>* texts)
+    {
+        texts->reserve(matches.size());
+        std::string line;
+        size_t line_offset = 0;
+        size_t next = 0;
+        for (ui::TextBuffer::Iterator it(&buffer, 0);
+            !it.IsAtEnd() && next < matches.size(); it.Advance())
+        {
+            const base::StringPiece& chunk = it.chunk();
+            // A "\r" ending the chunk is half of a "\r\n" when the next
+            // chunk starts with the "\n".
+            size_t chunk_end = it.offset() + chunk.size();
+            bool followed_by_lf = chunk_end < buffer.length() &&
+                buffer.GetCharAt(chunk_end) == '\n';
+            size_t pos = 0;
+            while (pos != chunk.size())
+            {
+                size_t line_break = ui::FindLineBreak(chunk.substr(pos), 1,
+                    followed_by_lf);
+                if (line_break == base::StringPiece::npos)
+                {
+                    line.append(chunk.data() + pos, chunk.size() - pos);
+                    break;
+                }
+                line.append(chunk.data() + pos, line_break);
+                FormatLine(matcher, line, line_offset, matches, replacement,
+                    &next, texts);
+                pos += line_break + 1;
+                line_offset = it.offset() + pos;
+                line.clear();
+            }
+        }
+        if (next < matches.size())
+        {
+            FormatLine(matcher, line, line_offset, matches, replacement,
+                &next, texts);
+        }
+    }
+
+}
+
+namespace ui
+{
+
+    LiteralMatcher::LiteralMatcher(const std::string& needle,
+        bool ignore_ascii_case)
+        : needle_(needle), ignore_ascii_case_(ignore_ascii_case) {}
+
+    bool LiteralMatcher::Find(const base::StringPiece& text,
+        size_t line_start, size_t from, size_t limit, Range* match) const
+    {
+        if (needle_.empty() || from >= limit)
+        {
+            return false;
+        }
+
+        // Nothing past the last place a match may start needs looking at.
+        base::StringPiece haystack = text.substr(0,
+            std::min(text.size(), limit + needle_.size() - 1));
+        size_t pos = ignore_ascii_case_ ?
+            base::FindStringIgnoringASCIICase(haystack, needle_, from) :
+            base::FindString(haystack, needle_, from);
+        if (pos == base::StringPiece::npos || pos >= limit)
+        {
+            return false;
+        }
+        *match = Range(pos, pos + needle_.size());
+        return true;
+    }
+
+    size_t LiteralMatcher::GetTailLength(const base::StringPiece& text) const
+    {
+        return needle_.empty() ? 0 : std::min(text.size(), needle_.size() - 1);
+    }
+
+    size_t LiteralMatcher::GetHeadLength(const base::StringPiece& text) const
+    {
+        return GetTailLength(text);
+    }
+
+    bool LiteralMatcher::NeedsFormatting(
+        const base::StringPiece& replacement) const
+    {
+        return false;
+    }
+
+    void LiteralMatcher::FormatReplacement(const base::StringPiece& line,
+        const Range& match, const base::StringPiece& replacement,
+        std::string* result) const
+    {
+        result->assign(replacement.data(), replacement.size());
+    }
+
+    RegexMatcher::RegexMatcher(const std::string& pattern, bool ignore_case)
+        : valid_(true)
+    {
+        std::regex::flag_type flags = std::regex::ECMAScript;
+        if (ignore_case)
+        {
+            flags |= std::regex::icase;
+        }
+        try
+        {
+            regex_.assign(pattern, flags);
+        }
+        catch (const std::regex_error&)
+        {
+            valid_ = false;
+        }
+    }
+
+    bool RegexMatcher::Find(const base::StringPiece& text,
+        size_t line_start, size_t from, size_t limit, Range* match) const
+    {
+        if (!valid_)
+        {
+            return false;
+        }
+
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        const char* line_begin = begin + line_start;
+        const char* pos = begin + from;
+        while (pos < begin + limit)
+        {
+            const char* line_end;
+            const char* next_line;
+            FindLineEnd(line_begin, end, &line_end, &next_line);
+
+            std::cmatch result;
+            while (pos <= line_end && pos < begin + limit)
+            {
+                std::regex_constants::match_flag_type flags =
+                    (pos != line_begin) ?
+                    std::regex_constants::match_prev_avail :
+                    std::regex_constants::match_default;
+                const char* text_end = line_end;
+                if (static_cast<size_t>(line_end - pos) > kMaxRegexTextLength)
+                {
+                    text_end = pos + kMaxRegexTextLength;
+                    flags |= std::regex_constants::match_not_eol;
+                }
+                bool found = false;
+                try
+                {
+                    found = std::regex_search(pos, text_end, result, regex_,
+                        flags);
+                }
+                catch (const std::regex_error&)
+                {
+                    // Too complex for the engine; taken as no match.
+                }
+                if (!found)
+                {
+                    if (text_end == line_end)
+                    {
+                        break;
+                    }
+                    pos += kMaxRegexTextLength / 2;
+                    continue;
+                }
+                size_t start = result[0].first - begin;
+                if (start >= limit)
+                {
+                    return false;
+                }
+                if (result.length(0) > 0)
+                {
+                    // A match in the second half that runs to a cut may go on
+                    // past it; look again from where it starts.
+                    if (result[0].second == text_end && text_end != line_end &&
+                        static_cast<size_t>(result[0].first - pos) >
+                        kMaxRegexTextLength / 2)
+                    {
+                        pos = result[0].first;
+                        continue;
+                    }
+                    *match = Range(start, start + result.length(0));
+                    return true;
+                }
+                // Empty matches are of no use to find; look on from the next
+                // character.
+                pos = result[0].first + 1;
+            }
+
+            line_begin = next_line;
+            pos = next_line;
+        }
+        return false;
+    }
+
+    size_t RegexMatcher::GetTailLength(const base::StringPiece& text) const
+    {
+        size_t line_break = FindLastLineBreak(text, false);
+        return line_break == base::StringPiece::npos ? text.size() :
+            text.size() - line_break - 1;
+    }
+
+    size_t RegexMatcher::GetHeadLength(const base::StringPiece& text) const
+    {
+        size_t line_break = FindLineBreak(text, 1, false);
+        return line_break == base::StringPiece::npos ? text.size() :
+            line_break + 1;
+    }
+
+    bool RegexMatcher::NeedsFormatting(
+        const base::StringPiece& replacement) const
+    {
+        return valid_ && replacement.find('$') != base::StringPiece::npos;
+    }
+
+    void RegexMatcher::FormatReplacement(const base::StringPiece& line,
+        const Range& match, const base::StringPiece& replacement,
+        std::string* result) const
+    {
+        result->clear();
+        const char* start = line.data() + match.start();
+        const char* end = line.data() + line.size();
+        std::regex_constants::match_flag_type flags =
+            std::regex_constants::match_continuous;
+        if (match.start() != 0)
+        {
+            flags |= std::regex_constants::match_prev_avail;
+        }
+        if (static_cast<size_t>(end - start) > kMaxRegexTextLength)
+        {
+            end = start + kMaxRegexTextLength;
+            flags |= std::regex_constants::match_not_eol;
+        }
+        std::cmatch groups;
+        try
+        {
+            if (std::regex_search(start, end, groups, regex_, flags))
+            {
+                groups.format(std::back_inserter(*result), replacement.data(),
+                    replacement.data() + replacement.size());
+                return;
+            }
+        }
+        catch (const std::regex_error&)
+        {
+        }
+        // The match could not be made again; the replacement goes in as it
+        // is.
+        result->assign(replacement.data(), replacement.size());
+    }
+
+    // Searches the segments handed out by a shared counter until none are
+    // left.
+    class TextSearcher::Worker : public base::PlatformThread::Delegate
+    {
+    public:
+        struct Segment
+        {
+            size_t start;
+            size_t end;
+            std::vector<Range> matches;
+        };
+
+        Worker(const TextSearcher* searcher, const TextBuffer* buffer,
+            std::vector<Segment>* segments, size_t* next_segment,
+            base::Lock* lock)
+            : searcher_(searcher),
+            buffer_(buffer),
+            segments_(segments),
+            next_segment_(next_segment),
+            lock_(lock),
+            handle_(NULL) {}
+
+        virtual void ThreadMain()
+        {
+            base::PlatformThread::SetName("TextSearcher");
+            Run();
+        }
+
+        void Run()
+        {
+            for (;;)
+            {
+                size_t index;
+                {
+                    base::AutoLock lock(*lock_);
+                    if (*next_segment_ == segments_->size())
+                    {
+                        return;
+                    }
+                    index = (*next_segment_)++;
+                }
+                Segment& segment = (*segments_)[index];
+                searcher_->SearchSegment(*buffer_, segment.start,
+                    segment.start, segment.end, &segment.matches);
+            }
+        }
+
+        base::PlatformThreadHandle* handle() { return &handle_; }
+
+    private:
+        const TextSearcher* searcher_;
+        const TextBuffer* buffer_;
+        std::vector<Segment>* segments_;
+        size_t* next_segment_;
+        base::Lock* lock_;
+        base::PlatformThreadHandle handle_;
+
+        DISALLOW_COPY_AND_ASSIGN(Worker);
+    };
+
+    TextSearcher::TextSearcher(const TextMatcher* matcher)
+        : matcher_(matcher),
+        thread_count_(std::min(base::SysInfo::NumberOfProcessors(),
+            kMaxThreadCount))
+    {
+        DCHECK(matcher_);
+    }
+
+    TextSearcher::~TextSearcher() {}
+
+    void TextSearcher::set_thread_count(int thread_count)
+    {
+        thread_count_ = std::max(thread_count, 1);
+    }
+
+    void TextSearcher::FindAll(const TextBuffer& buffer,
+        std::vector<Range>* matches)
+    {
+        DCHECK(matches);
+        size_t length = buffer.length();
+        size_t segment_length = std::max(kMinSegmentLength,
+            length / (thread_count_ * kSegmentsPerThread) + 1);
+        if (thread_count_ == 1 || length <= segment_length)
+        {
+            SearchSegment(buffer, 0, 0, length, matches);
+            return;
+        }
+
+        // Cut at line starts where there are any, so that a regex sees the
+        // start of a segment as the start of a line it really is.
+        std::vector<Worker::Segment> segments;
+        for (size_t start = 0; start < length; )
+        {
+            size_t end = start + segment_length;
+            if (end >= length)
+            {
+                end = length;
+            }
+            else
+            {
+                size_t line_start = buffer.LineToOffset(
+                    buffer.OffsetToLine(end));
+                if (line_start > start)
+                {
+                    end = line_start;
+                }
+            }
+            segments.push_back(Worker::Segment());
+            segments.back().start = start;
+            segments.back().end = end;
+            start = end;
+        }
+
+        base::Lock lock;
+        size_t next_segment = 0;
+        int thread_count = std::min(thread_count_,
+            static_cast<int>(segments.size()));
+        ScopedVector<Worker> workers;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            Worker* worker = new Worker(this, &buffer, &segments,
+                &next_segment, &lock);
+            if (base::PlatformThread::Create(0, worker, worker->handle()))
+            {
+                workers.push_back(worker);
+            }
+            else
+            {
+                delete worker;
+            }
+        }
+        // Search along rather than wait; with no threads to be had this does
+        // all of it.
+        Worker(this, &buffer, &segments, &next_segment, &lock).Run();
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            base::PlatformThread::Join(*workers[i]->handle());
+        }
+
+        // Each segment was searched as if the text began there.  Where the
+        // last match so far runs into a segment, its own first matches may
+        // overlap it, and a single pass would have gone on from the end of
+        // it; search that segment again from there.
+        size_t previous_end = 0;
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            const Worker::Segment& segment = segments[i];
+            if (previous_end > segment.start && !segment.matches.empty() &&
+                segment.matches.front().start() < previous_end)
+            {
+                if (previous_end < segment.end)
+                {
+                    SearchSegment(buffer, segment.start, previous_end,
+                        segment.end, matches);
+                }
+            }
+            else
+            {
+                matches->insert(matches->end(), segment.matches.begin(),
+                    segment.matches.end());
+            }
+            if (!matches->empty())
+            {
+                previous_end = std::max(previous_end, matches->back().end());
+            }
+        }
+    }
+
+    size_t TextSearcher::ReplaceAll(TextBuffer* buffer,
+        const base::StringPiece& replacement, TextEdit* edit)
+    {
+        DCHECK(buffer);
+        std::vector<Range> matches;
+        FindAll(*buffer, &matches);
+        if (matches.empty())
+        {
+            return 0;
+        }
+
+        std::vector<std::string> texts;
+        if (matcher_->NeedsFormatting(replacement))
+        {
+            FormatReplacements(*buffer, *matcher_, matches, replacement,
+                &texts);
+        }
+
+        if (edit)
+        {
+            std::string old_text;
+            for (size_t i = 0; i < matches.size(); ++i)
+            {
+                old_text.clear();
+                buffer->GetText(matches[i], &old_text);
+                edit->AddReplacement(matches[i].start(), old_text,
+                    texts.empty() ? replacement : texts[i]);
+            }
+        }
+        if (texts.empty())
+        {
+            buffer->ReplaceRanges(matches, replacement);
+        }
+        else
+        {
+            std::vector<base::StringPiece> pieces(texts.begin(), texts.end());
+            buffer->ReplaceRanges(matches, pieces);
+        }
+        return matches.size();
+    }
+
+    void TextSearcher::SearchSegment(const TextBuffer& buffer, size_t start,
+        size_t from, size_t end, std::vector<Range>* matches) const
+    {
+        // Text from |pending_offset| on, copied out of the pieces searched so
+        // far, where a match may start and run on into the next piece.
+        std::string pending;
+        size_t pending_offset = start;
+        for (TextBuffer::Iterator it(&buffer, start); !it.IsAtEnd();
+            it.Advance())
+        {
+            const base::StringPiece& chunk = it.chunk();
+            if (!pending.empty())
+            {
+                size_t head = matcher_->GetHeadLength(chunk);
+                if (head == chunk.size() &&
+                    pending.size() + chunk.size() < kMaxPendingLength)
+                {
+                    // A match in |pending| might reach past this piece too.
+                    pending.append(chunk.data(), chunk.size());
+                    continue;
+                }
+                // Matches starting in the head itself are settled here too
+                // when they cannot run past it, as at the end of a line.
+                base::StringPiece head_text(chunk.data(), head);
+                size_t limit = pending.size() + head -
+                    matcher_->GetTailLength(head_text);
+                pending.append(chunk.data(), head);
+                bool more = SearchText(pending, pending_offset, limit, end,
+                    &from, matches);
+                pending.clear();
+                if (!more)
+                {
+                    return;
+                }
+                from = std::max(from, pending_offset + limit);
+            }
+            if (it.offset() >= end)
+            {
+                // Only read on to finish the matches starting before |end|.
+                return;
+            }
+
+            size_t tail = matcher_->GetTailLength(chunk);
+            if (!SearchText(chunk, it.offset(), chunk.size() - tail, end,
+                &from, matches))
+            {
+                return;
+            }
+            if (tail > 0)
+            {
+                pending.assign(chunk.data() + chunk.size() - tail, tail);
+                pending_offset = it.offset() + chunk.size() - tail;
+            }
+        }
+        if (!pending.empty())
+        {
+            SearchText(pending, pending_offset, pending.size(), end, &from,
+                matches);
+        }
+    }
+
+    bool TextSearcher::SearchText(const base::StringPiece& text,
+        size_t text_offset, size_t limit, size_t end, size_t* from,
+        std::vector<Range>* matches) const
+    {
+        size_t pos = (*from > text_offset) ? *from - text_offset : 0;
+        size_t line_start = FindLineStart(text, 0, pos);
+        Range match;
+        while (pos < limit &&
+            matcher_->Find(text, line_start, pos, limit, &match))
+        {
+            if (text_offset + match.start() >= end)
+            {
+                return false;
+            }
+            matches->push_back(Range(text_offset + match.start(),
+                text_offset + match.end()));
+            pos = match.end();
+            *from = text_offset + pos;
+            line_start = FindLineStart(text, line_start, pos);
+        }
+        return true;
+    }
+
+} //namespace ui
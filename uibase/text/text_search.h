@@ -0,0 +1,168 @@
+#ifndef __ui_base_text_search_h__
+#define __ui_base_text_search_h__
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/string_piece.h"
+#include "uibase/range/range.h"
+
+namespace ui
+{
+
+    class TextBuffer;
+    class TextEdit;
+
+    // Finds matches in text for TextSearcher.  Matchers are const once
+    // built and are used from several threads at once.
+    class TextMatcher
+    {
+    public:
+        virtual ~TextMatcher() {}
+
+        // Finds the first non-empty match in |text| that starts in [from,
+        // limit); it may run on to the end of |text|.  |text| is taken to
+        // end where the document or a line does.  |line_start| is where the
+        // line holding |from| starts, the start of |text| counting as one,
+        // so that the matcher need not look back for it.
+        virtual bool Find(const base::StringPiece& text, size_t line_start,
+            size_t from, size_t limit, Range* match) const = 0;
+
+        // Bytes at the end of |text| where a match could start and run past
+        // it: matches starting before are found in |text| alone.
+        virtual size_t GetTailLength(const base::StringPiece& text) const = 0;
+
+        // Bytes at the start of |text|, following a tail, that a match
+        // starting in the tail can reach.  All of |text| means it might
+        // reach further.
+        virtual size_t GetHeadLength(const base::StringPiece& text) const = 0;
+
+        // Whether |replacement|, as the user typed it, has to be formatted
+        // for each match.  If not it goes in as it is, added to the buffer
+        // once, and no line is read for it.
+        virtual bool NeedsFormatting(
+            const base::StringPiece& replacement) const = 0;
+
+        // Puts in |result| the text that replaces |match| in |line|, a line
+        // without its break.  Only called when NeedsFormatting() is true.
+        virtual void FormatReplacement(const base::StringPiece& line,
+            const Range& match, const base::StringPiece& replacement,
+            std::string* result) const = 0;
+    };
+
+    // A plain string, optionally ignoring ASCII case (see string_search.h).
+    class LiteralMatcher : public TextMatcher
+    {
+    public:
+        LiteralMatcher(const std::string& needle, bool ignore_ascii_case);
+
+        virtual bool Find(const base::StringPiece& text, size_t line_start,
+            size_t from, size_t limit, Range* match) const;
+        virtual size_t GetTailLength(const base::StringPiece& text) const;
+        virtual size_t GetHeadLength(const base::StringPiece& text) const;
+        virtual bool NeedsFormatting(
+            const base::StringPiece& replacement) const;
+        virtual void FormatReplacement(const base::StringPiece& line,
+            const Range& match, const base::StringPiece& replacement,
+            std::string* result) const;
+
+    private:
+        const std::string needle_;
+        const bool ignore_ascii_case_;
+
+        DISALLOW_COPY_AND_ASSIGN(LiteralMatcher);
+    };
+
+    // An ECMAScript regular expression, matched one line at a time: matches
+    // never span a line break, and ^ and $ are the ends of lines.  Lines end
+    // where the editor's do, at "\n", "\r\n" or a lone "\r" (see
+    // line_breaks.h).
+    //
+    // std::regex backtracks on the stack, so it sees at most 4 KB of a line
+    // from where it is searching; on longer lines $ does not match at such
+    // a cut, and matches longer than 2 KB may be cut short or missed.  A
+    // search the engine gives up on, with std::regex_error, finds nothing in
+    // that part of the line.  The replacement of ReplaceAll() may use $1, $&
+    // and the like; one without a "$" goes in as it is.
+    class RegexMatcher : public TextMatcher
+    {
+    public:
+        RegexMatcher(const std::string& pattern, bool ignore_case);
+
+        // False if the pattern did not compile; such a matcher finds
+        // nothing.
+        bool IsValid() const { return valid_; }
+
+        virtual bool Find(const base::StringPiece& text, size_t line_start,
+            size_t from, size_t limit, Range* match) const;
+        virtual size_t GetTailLength(const base::StringPiece& text) const;
+        virtual size_t GetHeadLength(const base::StringPiece& text) const;
+        virtual bool NeedsFormatting(
+            const base::StringPiece& replacement) const;
+        virtual void FormatReplacement(const base::StringPiece& line,
+            const Range& match, const base::StringPiece& replacement,
+            std::string* result) const;
+
+    private:
+        std::regex regex_;
+        bool valid_;
+
+        DISALLOW_COPY_AND_ASSIGN(RegexMatcher);
+    };
+
+    // Finds all matches in a TextBuffer without copying it out.
+    //
+    // The document is cut into segments searched on worker threads, each
+    // walking the buffer's pieces in place.  Only text around the end of a
+    // piece, where a match may continue into the next, is copied.  The
+    // results are merged in document order.  Matches do not overlap; where
+    // one runs across a segment boundary the next segment is searched again
+    // from its end, as a single pass would.
+    class TextSearcher
+    {
+    public:
+        // |matcher| must outlive the searcher.
+        explicit TextSearcher(const TextMatcher* matcher);
+        ~TextSearcher();
+
+        // Defaults to the number of processors, at most 8.
+        void set_thread_count(int thread_count);
+
+        // Appends the matches in |buffer| to |matches| in order.  Blocks
+        // until done; |buffer| must not change meanwhile.
+        void FindAll(const TextBuffer& buffer, std::vector<Range>* matches);
+
+        // Replaces every match with |replacement|, formatted by the matcher
+        // for each if it needs to be, as one edit (see
+        // TextBuffer::ReplaceRanges()) and returns how many there were.
+        // Fills the replacements of |edit|, if not NULL, for undo; its
+        // selections are left to the caller.
+        size_t ReplaceAll(TextBuffer* buffer,
+            const base::StringPiece& replacement, TextEdit* edit);
+
+    private:
+        class Worker;
+
+        // Appends the matches starting in [from, end) to |matches|, as if
+        // the text began at |start|, which is at most |from|.
+        void SearchSegment(const TextBuffer& buffer, size_t start, size_t from,
+            size_t end, std::vector<Range>* matches) const;
+
+        // Appends the matches starting in [max(*from, text_offset), limit)
+        // of |text|, which lies at |text_offset|, moving |*from| past each.
+        // Returns false once a match starts at |end| or later.
+        bool SearchText(const base::StringPiece& text, size_t text_offset,
+            size_t limit, size_t end, size_t* from,
+            std::vector<Range>* matches) const;
+
+        const TextMatcher* matcher_;
+        int thread_count_;
+
+        DISALLOW_COPY_AND_ASSIGN(TextSearcher);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_text_search_h__
@@ -0,0 +1,159 @@
+// Checks of TextSearcher with its matchers: that a regex sees lines where
+// the editor has them, a lone "\r" ending one as "\n" and "\r\n" do, also
+// when the text is cut into many pieces; that its tail and head lengths
+// stop at the same breaks; and that ReplaceAll() formats a regex
+// replacement with "$" in it for each match and puts any other replacement
+// in as it is.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/test/test_util.h"
+#include "uibase/text/text_buffer.h"
+#include "uibase/text/text_edit.h"
+#include "uibase/text/text_search.h"
+
+namespace
+{
+
+    unsigned int random_state = 1;
+
+    unsigned int Random(unsigned int range)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        return (random_state >> 8) % range;
+    }
+
+    std::string Text(const ui::TextBuffer& buffer)
+    {
+        return buffer.GetText(ui::Range(0, buffer.length()));
+    }
+
+    std::vector<ui::Range> FindAll(const ui::TextMatcher& matcher,
+        const std::string& text)
+    {
+        std::string copy = text;
+        ui::TextBuffer buffer(&copy);
+        ui::TextSearcher searcher(&matcher);
+        std::vector<ui::Range> matches;
+        searcher.FindAll(buffer, &matches);
+        return matches;
+    }
+
+    void TestRegexLines()
+    {
+        ui::RegexMatcher matcher("^b.*$", false);
+        EXPECT(matcher.IsValid());
+        std::vector<ui::Range> matches = FindAll(matcher,
+            "a\rbx\r\nby\nbz");
+        EXPECT(matches.size() == 3);
+        if (matches.size() == 3)
+        {
+            EXPECT(matches[0] == ui::Range(2, 4));
+            EXPECT(matches[1] == ui::Range(6, 8));
+            EXPECT(matches[2] == ui::Range(9, 11));
+        }
+
+        // A line ending in a lone "\r", and one ending the text with it.
+        matches = FindAll(ui::RegexMatcher("x$", false), "ax\rbx\r");
+        EXPECT(matches.size() == 2);
+
+        // Many lines ending in "\r", in pieces of the buffer's length.
+        std::string text;
+        char line[32];
+        const int kLines = 100000;
+        for (int i = 0; i < kLines; ++i)
+        {
+            _snprintf_s(line, sizeof(line), _TRUNCATE, "k%d\r", i);
+            text += line;
+        }
+        std::string copy = text;
+        ui::TextBuffer buffer(&copy);
+        EXPECT(buffer.line_count() == kLines + 1);
+        ui::RegexMatcher line_matcher("^k[0-9]+$", false);
+        ui::TextSearcher searcher(&line_matcher);
+        searcher.set_thread_count(1);
+        std::vector<ui::Range> all;
+        searcher.FindAll(buffer, &all);
+        EXPECT(all.size() == kLines);
+    }
+
+    // The tail and head lengths against a byte at a time model, on texts
+    // long enough for the 16 byte blocks.
+    void TestTailAndHead()
+    {
+        ui::RegexMatcher matcher("a", false);
+        const char kBytes[] = { 'a', 'a', 'a', '\r', '\n' };
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string text;
+            size_t length = Random(70);
+            for (size_t i = 0; i < length; ++i)
+            {
+                text += kBytes[Random(arraysize(kBytes))];
+            }
+
+            size_t last = text.find_last_of("\r\n");
+            size_t tail = last == std::string::npos ? text.size() :
+                text.size() - last - 1;
+            EXPECT(matcher.GetTailLength(text) == tail);
+
+            size_t head = text.size();
+            for (size_t i = 0; i < text.size(); ++i)
+            {
+                if (text[i] == '\n' || (text[i] == '\r' &&
+                    (i + 1 == text.size() || text[i + 1] != '\n')))
+                {
+                    head = i + 1;
+                    break;
+                }
+            }
+            EXPECT(matcher.GetHeadLength(text) == head);
+        }
+    }
+
+    std::string ReplaceAll(const ui::TextMatcher& matcher,
+        const std::string& text, const char* replacement)
+    {
+        std::string copy = text;
+        ui::TextBuffer buffer(&copy);
+        ui::TextSearcher searcher(&matcher);
+        ui::TextEdit edit;
+        searcher.ReplaceAll(&buffer, replacement, &edit);
+        std::string result = Text(buffer);
+        edit.Revert(&buffer);
+        EXPECT(Text(buffer) == text);
+        return result;
+    }
+
+    void TestReplaceAll()
+    {
+        const std::string text = "a\rbx\r\nby\nbz";
+        ui::RegexMatcher regex("b(.)", false);
+        EXPECT(regex.NeedsFormatting("<$1>"));
+        EXPECT(!regex.NeedsFormatting("<1>"));
+        EXPECT(ReplaceAll(regex, text, "<$1$&>") ==
+            "a\r<xbx>\r\n<yby>\n<zbz>");
+        EXPECT(ReplaceAll(regex, text, "<1>") == "a\r<1>\r\n<1>\n<1>");
+
+        ui::LiteralMatcher literal("b", false);
+        EXPECT(!literal.NeedsFormatting("$1"));
+        EXPECT(ReplaceAll(literal, text, "$1") == "a\r$1x\r\n$1y\n$1z");
+
+        // A pattern that does not compile finds nothing to replace.
+        ui::RegexMatcher invalid("(", false);
+        EXPECT(!invalid.IsValid());
+        EXPECT(!invalid.NeedsFormatting("$1"));
+        EXPECT(ReplaceAll(invalid, text, "$1") == text);
+    }
+
+}
+
+void RunTextSearchTests()
+{
+    TestRegexLines();
+    TestTailAndHead();
+    TestReplaceAll();
+}
@@ -0,0 +1,431 @@
+#include "undo_history.h"
+
+#include <windows.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "base/pickle.h"
+#include "text_edit.h"
+
+namespace
+{
+
+    const size_t kDefaultByteBudget = 64 * 1024 * 1024;
+
+    // The newest entries are the likeliest to be undone; they stay as they
+    // are.
+    const size_t kRecentEntries = 16;
+
+    // Smaller entries are not worth compressing.
+    const size_t kMinCompressSize = 1024;
+
+    // Compression is LZNT1 from ntdll, which every Windows has.
+    const USHORT kCompressionFormat =
+        COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD;
+
+    typedef LONG (WINAPI* RtlGetCompressionWorkSpaceSizePtr)(USHORT format,
+        PULONG buffer_workspace_size, PULONG fragment_workspace_size);
+    typedef LONG (WINAPI* RtlCompressBufferPtr)(USHORT format,
+        PUCHAR uncompressed, ULONG uncompressed_size, PUCHAR compressed,
+        ULONG compressed_size, ULONG chunk_size, PULONG final_size,
+        PVOID workspace);
+    typedef LONG (WINAPI* RtlDecompressBufferPtr)(USHORT format,
+        PUCHAR uncompressed, ULONG uncompressed_size, PUCHAR compressed,
+        ULONG compressed_size, PULONG final_size);
+
+    // Returns false when |input| does not get smaller.
+    bool Compress(const std::string& input, std::string* output)
+    {
+        HMODULE module = GetModuleHandle(L"ntdll.dll");
+        RtlGetCompressionWorkSpaceSizePtr get_workspace_size =
+            reinterpret_cast<RtlGetCompressionWorkSpaceSizePtr>(
+            GetProcAddress(module, "RtlGetCompressionWorkSpaceSize"));
+        RtlCompressBufferPtr compress_buffer =
+            reinterpret_cast<RtlCompressBufferPtr>(
+            GetProcAddress(module, "RtlCompressBuffer"));
+        if (!get_workspace_size || !compress_buffer || input.empty())
+        {
+            return false;
+        }
+
+        ULONG workspace_size = 0;
+        ULONG fragment_workspace_size = 0;
+        if (get_workspace_size(kCompressionFormat, &workspace_size,
+            &fragment_workspace_size) < 0)
+        {
+            return false;
+        }
+        std::vector<char> workspace(workspace_size);
+
+        output->resize(input.size());
+        ULONG compressed_size = 0;
+        LONG status = compress_buffer(kCompressionFormat,
+            reinterpret_cast<PUCHAR>(const_cast<char*>(input.data())),
+            static_cast<ULONG>(input.size()),
+            reinterpret_cast<PUCHAR>(&(*output)[0]),
+            static_cast<ULONG>(output->size()), 4096, &compressed_size,
+            workspace.empty() ? NULL : &workspace[0]);
+        if (status < 0 || compressed_size == 0 ||
+            compressed_size >= input.size())
+        {
+            return false;
+        }
+        output->resize(compressed_size);
+        return true;
+    }
+
+    bool Decompress(const std::string& input, size_t size,
+        std::string* output)
+    {
+        HMODULE module = GetModuleHandle(L"ntdll.dll");
+        RtlDecompressBufferPtr decompress_buffer =
+            reinterpret_cast<RtlDecompressBufferPtr>(
+            GetProcAddress(module, "RtlDecompressBuffer"));
+        if (!decompress_buffer)
+        {
+            return false;
+        }
+
+        output->resize(size);
+        ULONG final_size = 0;
+        LONG status = decompress_buffer(kCompressionFormat,
+            reinterpret_cast<PUCHAR>(&(*output)[0]),
+            static_cast<ULONG>(size),
+            reinterpret_cast<PUCHAR>(const_cast<char*>(input.data())),
+            static_cast<ULONG>(input.size()), &final_size);
+        return status >= 0 && final_size == size;
+    }
+
+    // Roughly what |edit| would take pickled.
+    size_t EstimateSize(const ui::TextEdit& edit)
+    {
+        const std::vector<ui::TextEdit::Replacement>& replacements =
+            edit.replacements();
+        size_t size = 4 * (replacements.size() +
+            edit.selections_before().size() + edit.selections_after().size());
+        for (size_t i = 0; i < replacements.size(); ++i)
+        {
+            size += replacements[i].old_text.size() +
+                replacements[i].new_text.size();
+        }
+        return size;
+    }
+
+    template<typename Entry>
+    bool IdLess(const Entry& entry, int id)
+    {
+        return entry.id < id;
+    }
+
+}
+
+namespace ui
+{
+
+    // Compresses one entry's data on the compression thread.
+    class UndoHistory::CompressJob
+        : public base::RefCountedThreadSafe<UndoHistory::CompressJob>
+    {
+    public:
+        CompressJob(UndoHistory* history, int id, const std::string& data)
+            : history_(history),
+            origin_message_loop_proxy_(base::MessageLoopProxy::current()),
+            id_(id),
+            input_(data),
+            succeeded_(false) {}
+
+        // Called on the origin thread when the history goes away.
+        void Detach() { history_ = NULL; }
+
+        int id() const { return id_; }
+        bool succeeded() const { return succeeded_; }
+        std::string* output() { return &output_; }
+
+        // Runs on the compression thread.
+        void Run()
+        {
+            succeeded_ = Compress(input_, &output_);
+            input_.clear();
+            origin_message_loop_proxy_->PostTask(
+                NewRunnableMethod(this, &CompressJob::Deliver));
+        }
+
+    private:
+        friend class base::RefCountedThreadSafe<CompressJob>;
+
+        ~CompressJob() {}
+
+        void Deliver()
+        {
+            if (history_)
+            {
+                history_->OnCompressed(this);
+            }
+        }
+
+        UndoHistory* history_;
+        scoped_refptr<base::MessageLoopProxy> origin_message_loop_proxy_;
+        const int id_;
+        std::string input_;
+        std::string output_;
+        bool succeeded_;
+
+        DISALLOW_COPY_AND_ASSIGN(CompressJob);
+    };
+
+    UndoHistory::Entry::Entry() : id(0), compressed(false), size(0) {}
+
+    UndoHistory::Entry::~Entry() {}
+
+    UndoHistory::UndoHistory(
+        base::MessageLoopProxy* compress_message_loop_proxy)
+        : compress_message_loop_proxy_(compress_message_loop_proxy),
+        byte_budget_(kDefaultByteBudget),
+        entry_bytes_(0),
+        next_id_(0),
+        next_compress_id_(0) {}
+
+    UndoHistory::~UndoHistory()
+    {
+        if (compress_job_)
+        {
+            compress_job_->Detach();
+        }
+    }
+
+    void UndoHistory::set_byte_budget(size_t bytes)
+    {
+        byte_budget_ = bytes;
+        EnforceBudget();
+    }
+
+    size_t UndoHistory::byte_size() const
+    {
+        return entry_bytes_ + (live_edit_.get() ? EstimateSize(*live_edit_) : 0);
+    }
+
+    void UndoHistory::Record(const TextEdit& edit)
+    {
+        if (edit.empty())
+        {
+            return;
+        }
+
+        for (EntryList::iterator i = redo_.begin(); i != redo_.end(); ++i)
+        {
+            entry_bytes_ -= i->data.size();
+        }
+        redo_.clear();
+
+        if (!live_edit_.get() || !live_edit_->CoalesceTyping(edit))
+        {
+            CloseLiveEdit();
+            live_edit_.reset(new TextEdit(edit));
+        }
+        EnforceBudget();
+    }
+
+    void UndoHistory::BreakCoalescing()
+    {
+        CloseLiveEdit();
+    }
+
+    bool UndoHistory::CanUndo() const
+    {
+        return live_edit_.get() != NULL || !undo_.empty();
+    }
+
+    bool UndoHistory::CanRedo() const
+    {
+        return !redo_.empty();
+    }
+
+    bool UndoHistory::Undo(TextBuffer* buffer, std::vector<Range>* selections)
+    {
+        CloseLiveEdit();
+        if (undo_.empty())
+        {
+            return false;
+        }
+
+        TextEdit edit;
+        bool loaded = LoadEntry(undo_.back(), &edit);
+        MoveLastEntry(&undo_, &redo_);
+        if (!loaded)
+        {
+            NOTREACHED();
+            return false;
+        }
+
+        edit.Revert(buffer);
+        *selections = edit.selections_before();
+        return true;
+    }
+
+    bool UndoHistory::Redo(TextBuffer* buffer, std::vector<Range>* selections)
+    {
+        if (redo_.empty())
+        {
+            return false;
+        }
+
+        TextEdit edit;
+        bool loaded = LoadEntry(redo_.back(), &edit);
+        MoveLastEntry(&redo_, &undo_);
+        if (!loaded)
+        {
+            NOTREACHED();
+            return false;
+        }
+
+        edit.Apply(buffer);
+        *selections = edit.selections_after();
+        return true;
+    }
+
+    void UndoHistory::Clear()
+    {
+        undo_.clear();
+        redo_.clear();
+        entry_bytes_ = 0;
+        live_edit_.reset();
+    }
+
+    void UndoHistory::CloseLiveEdit()
+    {
+        if (!live_edit_.get())
+        {
+            return;
+        }
+        PushEntry(*live_edit_, &undo_);
+        live_edit_.reset();
+        EnforceBudget();
+        ScheduleCompression();
+    }
+
+    void UndoHistory::PushEntry(const TextEdit& edit, EntryList* list)
+    {
+        Pickle pickle;
+        edit.WriteToPickle(&pickle);
+
+        list->push_back(Entry());
+        Entry& entry = list->back();
+        entry.id = next_id_++;
+        entry.size = pickle.size();
+        entry.data.assign(static_cast<const char*>(pickle.data()),
+            pickle.size());
+        entry_bytes_ += entry.data.size();
+    }
+
+    // static
+    void UndoHistory::MoveLastEntry(EntryList* from, EntryList* to)
+    {
+        Entry& entry = from->back();
+        to->push_back(Entry());
+        Entry& moved = to->back();
+        moved.id = entry.id;
+        moved.compressed = entry.compressed;
+        moved.size = entry.size;
+        moved.data.swap(entry.data);
+        from->pop_back();
+    }
+
+    bool UndoHistory::LoadEntry(const Entry& entry, TextEdit* edit) const
+    {
+        std::string decompressed;
+        const std::string* data = &entry.data;
+        if (entry.compressed)
+        {
+            if (!Decompress(entry.data, entry.size, &decompressed))
+            {
+                return false;
+            }
+            data = &decompressed;
+        }
+
+        Pickle pickle(data->data(), static_cast<int>(data->size()));
+        void* iter = NULL;
+        return edit->ReadFromPickle(pickle, &iter);
+    }
+
+    void UndoHistory::EnforceBudget()
+    {
+        // Oldest undo first, then the redo farthest away.  The entry next
+        // to the current text stays.
+        size_t live_size = live_edit_.get() ? EstimateSize(*live_edit_) : 0;
+        while (entry_bytes_ + live_size > byte_budget_)
+        {
+            size_t remaining = undo_.size() + redo_.size() +
+                (live_edit_.get() ? 1 : 0);
+            if (remaining <= 1)
+            {
+                break;
+            }
+            EntryList* list = !undo_.empty() ? &undo_ : &redo_;
+            entry_bytes_ -= list->front().data.size();
+            list->pop_front();
+        }
+    }
+
+    void UndoHistory::ScheduleCompression()
+    {
+        if (compress_job_ || !compress_message_loop_proxy_ ||
+            undo_.size() <= kRecentEntries)
+        {
+            return;
+        }
+
+        // Ids grow along |undo_|; look from where the last search stopped.
+        EntryList::iterator end = undo_.end() -
+            static_cast<ptrdiff_t>(kRecentEntries);
+        EntryList::iterator i = std::lower_bound(undo_.begin(), end,
+            next_compress_id_, IdLess<Entry>);
+        for (; i != end; ++i)
+        {
+            next_compress_id_ = i->id + 1;
+            if (!i->compressed && i->data.size() >= kMinCompressSize)
+            {
+                compress_job_ = new CompressJob(this, i->id, i->data);
+                compress_message_loop_proxy_->PostTask(
+                    NewRunnableMethod(compress_job_.get(), &CompressJob::Run));
+                return;
+            }
+        }
+    }
+
+    void UndoHistory::OnCompressed(CompressJob* job)
+    {
+        DCHECK_EQ(job, compress_job_.get());
+        scoped_refptr<CompressJob> done(compress_job_);
+        compress_job_ = NULL;
+
+        // The entry may have been dropped, or moved to the redo list.
+        Entry* entry = NULL;
+        EntryList::iterator i = std::lower_bound(undo_.begin(), undo_.end(),
+            done->id(), IdLess<Entry>);
+        if (i != undo_.end() && i->id == done->id())
+        {
+            entry = &*i;
+        }
+        for (EntryList::iterator j = redo_.begin();
+            !entry && j != redo_.end(); ++j)
+        {
+            if (j->id == done->id())
+            {
+                entry = &*j;
+            }
+        }
+
+        if (entry && !entry->compressed && done->succeeded())
+        {
+            entry_bytes_ -= entry->data.size();
+            entry->data.swap(*done->output());
+            entry->compressed = true;
+            entry_bytes_ += entry->data.size();
+        }
+        ScheduleCompression();
+    }
+
+} //namespace ui
@@ -0,0 +1,119 @@
+#ifndef __ui_base_undo_history_h__
+#define __ui_base_undo_history_h__
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "uibase/range/range.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+}
+
+namespace ui
+{
+
+    class TextBuffer;
+    class TextEdit;
+
+    // Undo and redo for a TextBuffer, within a byte budget.
+    //
+    // Edits are kept as TextEdits pickled into their compact form; only the
+    // newest one stays live, so that typing can be folded into it (see
+    // TextEdit::CoalesceTyping()).  Entries older than the most recent few
+    // are compressed on a background thread.  When the history outgrows its
+    // budget the oldest entries are dropped; the newest one always stays.
+    //
+    // Must be used on one thread, which needs a MessageLoop.
+    class UndoHistory
+    {
+    public:
+        // Compression runs on |compress_message_loop_proxy|; with NULL,
+        // nothing is compressed.
+        explicit UndoHistory(base::MessageLoopProxy* compress_message_loop_proxy);
+        ~UndoHistory();
+
+        // Bytes the history may use, 64 MB by default.
+        size_t byte_budget() const { return byte_budget_; }
+        void set_byte_budget(size_t bytes);
+
+        // Bytes held now, compressed entries counted at their compressed
+        // size and the live edit by the text it holds.
+        size_t byte_size() const;
+
+        // Records |edit|, which has just been made to the buffer.  Clears
+        // the redo list.
+        void Record(const TextEdit& edit);
+
+        // Keeps the next edit from being folded into the last one, e.g.
+        // when the caret was moved.
+        void BreakCoalescing();
+
+        bool CanUndo() const;
+        bool CanRedo() const;
+
+        // Reverts or reapplies one entry on |buffer| and sets |selections|
+        // to what they were at that point.  Return false when there is
+        // nothing to undo or redo.
+        bool Undo(TextBuffer* buffer, std::vector<Range>* selections);
+        bool Redo(TextBuffer* buffer, std::vector<Range>* selections);
+
+        void Clear();
+
+    private:
+        class CompressJob;
+
+        struct Entry
+        {
+            Entry();
+            ~Entry();
+
+            int id;
+            bool compressed;
+            // Size of the pickle in |data| once uncompressed.
+            size_t size;
+            std::string data;
+        };
+
+        typedef std::deque<Entry> EntryList;
+
+        // Pickles the live edit into an entry on the undo list.
+        void CloseLiveEdit();
+
+        void PushEntry(const TextEdit& edit, EntryList* list);
+        static void MoveLastEntry(EntryList* from, EntryList* to);
+        bool LoadEntry(const Entry& entry, TextEdit* edit) const;
+
+        // Drops the oldest entries while over budget.
+        void EnforceBudget();
+
+        // Compresses the next entry that is old enough, unless a job is on
+        // its way already.
+        void ScheduleCompression();
+        void OnCompressed(CompressJob* job);
+
+        scoped_refptr<base::MessageLoopProxy> compress_message_loop_proxy_;
+        size_t byte_budget_;
+
+        // Oldest first; the ends of both are next to the current text.
+        EntryList undo_;
+        EntryList redo_;
+        // Bytes in |data| of all entries.
+        size_t entry_bytes_;
+        int next_id_;
+        // Entries before this id were already looked at for compression.
+        int next_compress_id_;
+
+        scoped_ptr<TextEdit> live_edit_;
+        scoped_refptr<CompressJob> compress_job_;
+
+        DISALLOW_COPY_AND_ASSIGN(UndoHistory);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_undo_history_h__
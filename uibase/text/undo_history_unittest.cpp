@@ -0,0 +1,213 @@
+// Checks of UndoHistory: that entries old enough to be compressed on the
+// compression thread come back intact, every one of them undone and then
+// redone with the text and selections it had; that the byte budget drops
+// the oldest entries; and that typing coalesced into one entry is undone
+// in one step.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/message_loop.h"
+#include "base/test/test_util.h"
+#include "base/threading/thread.h"
+#include "uibase/text/selection_set.h"
+#include "uibase/text/text_buffer.h"
+#include "uibase/text/text_edit.h"
+#include "uibase/text/undo_history.h"
+
+namespace
+{
+
+    std::string Text(const ui::TextBuffer& buffer)
+    {
+        return buffer.GetText(ui::Range(0, buffer.length()));
+    }
+
+    // About 2 KB of lines that differ by |entry|: large enough to be
+    // compressed, and compressing well.
+    std::string MakeBlock(int entry)
+    {
+        std::string block;
+        char line[64];
+        for (int i = 0; i < 64; ++i)
+        {
+            _snprintf_s(line, sizeof(line), _TRUNCATE,
+                "entry %d, line %d of the block\n", entry, i);
+            block += line;
+        }
+        return block;
+    }
+
+    // Appends |entry|'s block at the end of |buffer| as an edit of its own
+    // and records it.  Returns the selections before it.
+    std::vector<ui::Range> AppendBlock(ui::TextBuffer* buffer,
+        ui::UndoHistory* history, int entry)
+    {
+        ui::SelectionSet selections(ui::Range(buffer->length()));
+        ui::TextEdit edit;
+        selections.ReplaceSelections(buffer, MakeBlock(entry), &edit);
+        history->Record(edit);
+        history->BreakCoalescing();
+        return edit.selections_before();
+    }
+
+    // Runs the loop until the history stops shrinking, the compression
+    // jobs being done, or two seconds have gone by.
+    void WaitForCompression(const ui::UndoHistory& history)
+    {
+        size_t size = history.byte_size();
+        int unchanged = 0;
+        for (int i = 0; i < 200 && unchanged < 5; ++i)
+        {
+            MessageLoop::current()->PostDelayedTask(new MessageLoop::QuitTask,
+                10);
+            MessageLoop::current()->Run();
+            unchanged = history.byte_size() == size ? unchanged + 1 : 0;
+            size = history.byte_size();
+        }
+    }
+
+    void TestCompressedRoundTrip(base::MessageLoopProxy* compress_proxy)
+    {
+        const int kEntries = 40;
+        ui::TextBuffer buffer;
+        ui::UndoHistory history(compress_proxy);
+        std::vector<std::string> texts(1, Text(buffer));
+        std::vector<std::vector<ui::Range> > selections_before;
+        for (int i = 0; i < kEntries; ++i)
+        {
+            selections_before.push_back(AppendBlock(&buffer, &history, i));
+            texts.push_back(Text(buffer));
+        }
+        size_t uncompressed_size = history.byte_size();
+        EXPECT(uncompressed_size >= kEntries * 1024);
+
+        // All but the 16 newest entries are compressed, to well under
+        // their size.
+        WaitForCompression(history);
+        EXPECT(history.byte_size() < uncompressed_size * 3 / 4);
+
+        std::vector<ui::Range> selections;
+        for (int i = kEntries; i > 0; --i)
+        {
+            EXPECT(history.Undo(&buffer, &selections));
+            EXPECT(Text(buffer) == texts[i - 1]);
+            EXPECT(selections == selections_before[i - 1]);
+        }
+        EXPECT(!history.CanUndo());
+        EXPECT(!history.Undo(&buffer, &selections));
+
+        for (int i = 1; i <= kEntries; ++i)
+        {
+            EXPECT(history.Redo(&buffer, &selections));
+            EXPECT(Text(buffer) == texts[i]);
+            EXPECT(selections.size() == 1);
+            EXPECT(selections[0] == ui::Range(texts[i].size()));
+        }
+        EXPECT(!history.CanRedo());
+
+        // Undoing again after the entries went back and forth between the
+        // lists, and compression had time to go on.
+        WaitForCompression(history);
+        for (int i = kEntries; i > kEntries - 20; --i)
+        {
+            EXPECT(history.Undo(&buffer, &selections));
+            EXPECT(Text(buffer) == texts[i - 1]);
+        }
+
+        // A new edit drops what could be redone.
+        AppendBlock(&buffer, &history, kEntries);
+        EXPECT(!history.CanRedo());
+    }
+
+    void TestBudget()
+    {
+        const int kEntries = 20;
+        ui::TextBuffer buffer;
+        ui::UndoHistory history(NULL);
+        history.set_byte_budget(10 * 1024);
+        std::vector<std::string> texts(1, Text(buffer));
+        for (int i = 0; i < kEntries; ++i)
+        {
+            AppendBlock(&buffer, &history, i);
+            texts.push_back(Text(buffer));
+            EXPECT(history.byte_size() <= history.byte_budget());
+        }
+
+        // Only the newest entries are left, and undo as they were.
+        std::vector<ui::Range> selections;
+        int undone = 0;
+        while (history.Undo(&buffer, &selections))
+        {
+            ++undone;
+            EXPECT(Text(buffer) == texts[kEntries - undone]);
+        }
+        EXPECT(undone >= 3);
+        EXPECT(undone < kEntries);
+
+        // However small the budget, the newest entry stays.
+        history.set_byte_budget(1);
+        EXPECT(history.CanRedo());
+        EXPECT(history.Redo(&buffer, &selections));
+        EXPECT(!history.CanRedo());
+        EXPECT(Text(buffer) == texts[kEntries - undone + 1]);
+    }
+
+    void TestCoalescedTyping()
+    {
+        std::string text = "say ";
+        ui::TextBuffer buffer(&text);
+        ui::UndoHistory history(NULL);
+        ui::SelectionSet selections(ui::Range(4));
+        const char* const kKeys[] = { "h", "e", "l", "l", "o" };
+        for (size_t i = 0; i < arraysize(kKeys); ++i)
+        {
+            ui::TextEdit edit;
+            selections.ReplaceSelections(&buffer, kKeys[i], &edit);
+            history.Record(edit);
+        }
+        EXPECT(Text(buffer) == "say hello");
+
+        std::vector<ui::Range> restored;
+        EXPECT(history.Undo(&buffer, &restored));
+        EXPECT(Text(buffer) == "say ");
+        EXPECT(restored.size() == 1);
+        EXPECT(restored[0] == ui::Range(4));
+        EXPECT(!history.CanUndo());
+
+        EXPECT(history.Redo(&buffer, &restored));
+        EXPECT(Text(buffer) == "say hello");
+        EXPECT(restored[0] == ui::Range(9));
+
+        // A line break ends the word; the typing after it is undone apart.
+        selections.SetRanges(restored);
+        ui::TextEdit line_break;
+        selections.ReplaceSelections(&buffer, "\n", &line_break);
+        history.Record(line_break);
+        ui::TextEdit typing;
+        selections.ReplaceSelections(&buffer, "x", &typing);
+        history.Record(typing);
+        EXPECT(history.Undo(&buffer, &restored));
+        EXPECT(Text(buffer) == "say hello\n");
+        EXPECT(history.Undo(&buffer, &restored));
+        EXPECT(Text(buffer) == "say hello");
+    }
+
+}
+
+void RunUndoHistoryTests()
+{
+    MessageLoop loop;
+    base::Thread compress_thread("compress");
+    EXPECT(compress_thread.Start());
+    if (!compress_thread.IsRunning())
+    {
+        return;
+    }
+    TestCompressedRoundTrip(compress_thread.message_loop_proxy());
+    TestBudget();
+    TestCoalescedTyping();
+    compress_thread.Stop();
+}
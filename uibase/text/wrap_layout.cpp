@@ -0,0 +1,619 @@
+#include "wrap_layout.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "base/win/scoped_hdc.h"
+#include "uigfx/font.h"
+#include "text_buffer.h"
+
+namespace
+{
+
+    // Lines per batch sent to the layout thread.
+    const size_t kLinesPerJob = 10000;
+
+    // Edits replacing up to this many lines lay them out right away.
+    const size_t kMaxSyncLines = 256;
+
+    // Lines whose wrap points are kept; more than a few screens' worth
+    // means the view scrolled far, and the cache starts over.
+    const size_t kMaxCachedLines = 4096;
+
+    const int kTabSpaces = 4;
+
+    // In WrapLayout::job_lines_, a line of the job that was edited since.
+    const size_t kNoLine = static_cast<size_t>(-1);
+
+    // Returns the end of the line starting at |start|, and in |next| where
+    // the line after it starts.
+    size_t FindLineEnd(const std::string& text, size_t start, size_t* next)
+    {
+        size_t end = text.find_first_of("\r\n", start);
+        if (end == std::string::npos)
+        {
+            *next = text.size();
+            return text.size();
+        }
+        *next = end + 1;
+        if (text[end] == '\r' && *next < text.size() && text[*next] == '\n')
+        {
+            ++*next;
+        }
+        return end;
+    }
+
+    // Returns the length of the UTF-8 sequence at |text| and its code point
+    // in |code_point|.  A broken sequence ends at the first bad byte.
+    size_t DecodeUTF8(const char* text, size_t length, uint32* code_point)
+    {
+        uint8 lead = static_cast<uint8>(text[0]);
+        size_t count = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 :
+            (lead >= 0xC0) ? 2 : 1;
+        uint32 c = (count == 1) ? lead : (lead & (0x7F >> count));
+        for (size_t i = 1; i < count; ++i)
+        {
+            if (i == length || (static_cast<uint8>(text[i]) & 0xC0) != 0x80)
+            {
+                *code_point = 0xFFFD;
+                return i;
+            }
+            c = (c << 6) | (static_cast<uint8>(text[i]) & 0x3F);
+        }
+        *code_point = c;
+        return count;
+    }
+
+    // East Asian wide and fullwidth characters, roughly as wcwidth() has
+    // them.
+    bool IsWideCharacter(uint32 c)
+    {
+        return (c >= 0x1100 && c <= 0x115F) ||
+            (c >= 0x2E80 && c <= 0xA4CF && c != 0x303F) ||
+            (c >= 0xAC00 && c <= 0xD7A3) ||
+            (c >= 0xF900 && c <= 0xFAFF) ||
+            (c >= 0xFE30 && c <= 0xFE4F) ||
+            (c >= 0xFF00 && c <= 0xFF60) ||
+            (c >= 0xFFE0 && c <= 0xFFE6) ||
+            (c >= 0x20000 && c <= 0x3FFFD);
+    }
+
+    void MeasureFont(const gfx::Font& font, ui::WrapLayout::Metrics* metrics)
+    {
+        int average_width = font.GetAverageCharacterWidth();
+        base::win::ScopedHDC dc(CreateCompatibleDC(NULL));
+        HGDIOBJ old_font = SelectObject(dc, font.GetNativeFont());
+        INT widths[128];
+        if (!GetCharWidth32W(dc, 0, 127, widths))
+        {
+            std::fill(widths, widths + 128, average_width);
+        }
+        SelectObject(dc, old_font);
+
+        std::copy(widths, widths + 128, metrics->ascii_widths);
+        metrics->other_width = average_width;
+        metrics->wide_width = 2 * average_width;
+        metrics->tab_width = std::max(1, kTabSpaces * widths[' ']);
+    }
+
+}
+
+namespace ui
+{
+
+    // Counts the rows of a batch of lines on the layout thread and hands
+    // them back.
+    class WrapLayout::Job : public base::RefCountedThreadSafe<WrapLayout::Job>
+    {
+    public:
+        Job(WrapLayout* layout, const Metrics& metrics, int width, int version,
+            size_t line_count, std::string* text)
+            : layout_(layout),
+            origin_message_loop_proxy_(base::MessageLoopProxy::current()),
+            metrics_(metrics),
+            width_(width),
+            version_(version),
+            line_count_(line_count)
+        {
+            text_.swap(*text);
+        }
+
+        // Called on the origin thread when the layout goes away.
+        void Detach() { layout_ = NULL; }
+
+        int version() const { return version_; }
+        const std::vector<uint32>& rows() const { return rows_; }
+
+        // Runs on the layout thread.
+        void Run()
+        {
+            rows_.reserve(line_count_);
+            size_t start = 0;
+            for (size_t i = 0; i < line_count_; ++i)
+            {
+                size_t next;
+                size_t end = FindLineEnd(text_, start, &next);
+                rows_.push_back(static_cast<uint32>(WrapLine(
+                    base::StringPiece(text_.data() + start, end - start),
+                    metrics_, width_, NULL)));
+                start = next;
+            }
+
+            origin_message_loop_proxy_->PostTask(
+                NewRunnableMethod(this, &Job::Deliver));
+        }
+
+    private:
+        friend class base::RefCountedThreadSafe<Job>;
+
+        ~Job() {}
+
+        // Runs on the origin thread.
+        void Deliver()
+        {
+            if (layout_)
+            {
+                layout_->OnJobDone(this);
+            }
+        }
+
+        WrapLayout* layout_;
+        scoped_refptr<base::MessageLoopProxy> origin_message_loop_proxy_;
+
+        const Metrics metrics_;
+        const int width_;
+        const int version_;
+        const size_t line_count_;
+        // The lines to lay out, with their line breaks.
+        std::string text_;
+
+        std::vector<uint32> rows_;
+
+        DISALLOW_COPY_AND_ASSIGN(Job);
+    };
+
+    WrapLayout::Metrics::Metrics()
+        : other_width(0), wide_width(0), tab_width(1)
+    {
+        std::fill(ascii_widths, ascii_widths + 128, 0);
+    }
+
+    WrapLayout::WrapLayout(const TextBuffer* buffer, const gfx::Font& font,
+        Delegate* delegate, base::MessageLoopProxy* layout_message_loop_proxy)
+        : buffer_(buffer),
+        delegate_(delegate),
+        layout_message_loop_proxy_(layout_message_loop_proxy),
+        width_(0),
+        rows_(buffer->line_count(), 1),
+        stale_(buffer->line_count(), false),
+        stale_count_(0),
+        first_stale_line_(buffer->line_count()),
+        next_layout_line_(0),
+        version_(0)
+    {
+        MeasureFont(font, &metrics_);
+        BuildTree();
+    }
+
+    WrapLayout::~WrapLayout()
+    {
+        if (job_)
+        {
+            job_->Detach();
+        }
+    }
+
+    void WrapLayout::SetFont(const gfx::Font& font)
+    {
+        MeasureFont(font, &metrics_);
+        InvalidateAll();
+    }
+
+    void WrapLayout::SetWidth(int width)
+    {
+        if (width == width_)
+        {
+            return;
+        }
+        width_ = width;
+        InvalidateAll();
+    }
+
+    void WrapLayout::OnTextChanged(size_t first_line, size_t old_line_count,
+        size_t new_line_count)
+    {
+        DCHECK_LE(first_line + old_line_count, rows_.size());
+        DCHECK_GT(new_line_count, 0U);
+
+        // The job on its way keeps the rows it counts for lines the edit
+        // did not touch, moved like the wrap points below.
+        for (size_t i = 0; i < job_lines_.size(); ++i)
+        {
+            size_t& line = job_lines_[i];
+            if (line == kNoLine || line < first_line)
+            {
+                continue;
+            }
+            line = line < first_line + old_line_count ? kNoLine :
+                line - old_line_count + new_line_count;
+        }
+
+        // Only the edited lines lose their wrap points; those of the lines
+        // after move with them.
+        WrapPointMap::iterator edited_end =
+            wrap_points_.lower_bound(first_line + old_line_count);
+        if (old_line_count != new_line_count)
+        {
+            WrapPointMap moved;
+            for (WrapPointMap::iterator i = edited_end;
+                i != wrap_points_.end(); ++i)
+            {
+                moved[i->first - old_line_count + new_line_count].swap(
+                    i->second);
+            }
+            wrap_points_.erase(wrap_points_.lower_bound(first_line),
+                wrap_points_.end());
+            wrap_points_.insert(moved.begin(), moved.end());
+        }
+        else
+        {
+            wrap_points_.erase(wrap_points_.lower_bound(first_line),
+                edited_end);
+        }
+
+        for (size_t i = first_line; i < first_line + old_line_count; ++i)
+        {
+            if (stale_[i])
+            {
+                stale_[i] = false;
+                --stale_count_;
+            }
+        }
+        if (old_line_count != new_line_count)
+        {
+            rows_.erase(rows_.begin() + first_line,
+                rows_.begin() + first_line + old_line_count);
+            rows_.insert(rows_.begin() + first_line, new_line_count, 1);
+            stale_.erase(stale_.begin() + first_line,
+                stale_.begin() + first_line + old_line_count);
+            stale_.insert(stale_.begin() + first_line, new_line_count, false);
+            BuildTree();
+        }
+        DCHECK_EQ(rows_.size(), buffer_->line_count());
+
+        if (first_stale_line_ >= first_line + old_line_count)
+        {
+            first_stale_line_ = first_stale_line_ - old_line_count +
+                new_line_count;
+        }
+        else
+        {
+            first_stale_line_ = std::min(first_stale_line_, first_line);
+        }
+        if (next_layout_line_ >= first_line + old_line_count)
+        {
+            next_layout_line_ = next_layout_line_ - old_line_count +
+                new_line_count;
+        }
+        else
+        {
+            next_layout_line_ = std::min(next_layout_line_, first_line);
+        }
+
+        if (width_ <= 0)
+        {
+            // Every line is one row, the new ones already are.
+            return;
+        }
+        for (size_t i = first_line; i < first_line + new_line_count; ++i)
+        {
+            if (new_line_count <= kMaxSyncLines)
+            {
+                SetLineRows(i, LayOutLine(i, NULL));
+            }
+            else
+            {
+                stale_[i] = true;
+                ++stale_count_;
+            }
+        }
+        if (new_line_count > kMaxSyncLines)
+        {
+            first_stale_line_ = std::min(first_stale_line_, first_line);
+        }
+        ScheduleLayout();
+    }
+
+    void WrapLayout::SetFirstVisibleLine(size_t line)
+    {
+        next_layout_line_ = std::min(line, rows_.size());
+    }
+
+    size_t WrapLayout::row_count() const
+    {
+        return LineToRow(rows_.size());
+    }
+
+    size_t WrapLayout::LineToRow(size_t line) const
+    {
+        DCHECK_LE(line, rows_.size());
+        size_t row = 0;
+        for (size_t i = line; i > 0; i -= i & (~i + 1))
+        {
+            row += tree_[i];
+        }
+        return row;
+    }
+
+    size_t WrapLayout::RowToLine(size_t row, size_t* row_in_line) const
+    {
+        DCHECK_LT(row, row_count());
+        size_t step = 1;
+        while (step * 2 < tree_.size())
+        {
+            step *= 2;
+        }
+
+        // Find the most lines whose rows add up to no more than |row|; the
+        // line after them holds it.
+        size_t line = 0;
+        for (; step > 0; step /= 2)
+        {
+            if (line + step < tree_.size() && tree_[line + step] <= row)
+            {
+                line += step;
+                row -= tree_[line];
+            }
+        }
+        if (row_in_line)
+        {
+            *row_in_line = row;
+        }
+        return line;
+    }
+
+    void WrapLayout::GetWrapPoints(size_t line,
+        std::vector<uint32>* wrap_points)
+    {
+        DCHECK(wrap_points);
+        WrapPointMap::const_iterator i = wrap_points_.find(line);
+        if (i != wrap_points_.end())
+        {
+            *wrap_points = i->second;
+            return;
+        }
+
+        if (wrap_points_.size() >= kMaxCachedLines)
+        {
+            wrap_points_.clear();
+        }
+        std::vector<uint32>& cached = wrap_points_[line];
+        SetLineRows(line, LayOutLine(line, &cached));
+        *wrap_points = cached;
+    }
+
+    bool WrapLayout::IsBusy() const
+    {
+        return stale_count_ > 0;
+    }
+
+    // static
+    size_t WrapLayout::WrapLine(const base::StringPiece& line,
+        const Metrics& metrics, int width, std::vector<uint32>* wrap_points)
+    {
+        if (width <= 0)
+        {
+            return 1;
+        }
+
+        size_t rows = 1;
+        size_t row_start = 0;
+        // Where the row can break, after its last space or tab, and the x
+        // there.
+        size_t break_pos = 0;
+        int break_x = 0;
+        int x = 0;
+        for (size_t i = 0; i < line.size(); )
+        {
+            uint8 c = static_cast<uint8>(line[i]);
+            size_t length = 1;
+            int advance;
+            if (c == '\t')
+            {
+                advance = metrics.tab_width - x % metrics.tab_width;
+            }
+            else if (c < 0x80)
+            {
+                advance = metrics.ascii_widths[c];
+            }
+            else
+            {
+                uint32 code_point;
+                length = DecodeUTF8(line.data() + i, line.size() - i,
+                    &code_point);
+                advance = IsWideCharacter(code_point) ? metrics.wide_width :
+                    metrics.other_width;
+            }
+
+            // Spaces may run past the edge; a row never starts with them.
+            bool is_space = (c == ' ' || c == '\t');
+            if (!is_space && x + advance > width && i > row_start)
+            {
+                size_t wrap = (break_pos > row_start) ? break_pos : i;
+                x = (wrap == i) ? 0 : x - break_x;
+                row_start = wrap;
+                ++rows;
+                if (wrap_points)
+                {
+                    wrap_points->push_back(static_cast<uint32>(wrap));
+                }
+            }
+
+            x += advance;
+            i += length;
+            if (is_space)
+            {
+                break_pos = i;
+                break_x = x;
+            }
+        }
+        return rows;
+    }
+
+    size_t WrapLayout::LayOutLine(size_t line,
+        std::vector<uint32>* wrap_points)
+    {
+        std::string text;
+        buffer_->GetText(buffer_->GetLineRange(line), &text);
+        return WrapLine(text, metrics_, width_, wrap_points);
+    }
+
+    void WrapLayout::SetLineRows(size_t line, size_t rows)
+    {
+        AddToTree(line, rows - rows_[line]);
+        rows_[line] = static_cast<uint32>(rows);
+        if (stale_[line])
+        {
+            stale_[line] = false;
+            --stale_count_;
+        }
+    }
+
+    void WrapLayout::InvalidateAll()
+    {
+        ++version_;
+        wrap_points_.clear();
+        if (width_ <= 0)
+        {
+            std::fill(rows_.begin(), rows_.end(), 1);
+            stale_.assign(stale_.size(), false);
+            stale_count_ = 0;
+            first_stale_line_ = stale_.size();
+            BuildTree();
+            return;
+        }
+
+        stale_.assign(stale_.size(), true);
+        stale_count_ = stale_.size();
+        first_stale_line_ = 0;
+        ScheduleLayout();
+    }
+
+    void WrapLayout::BuildTree()
+    {
+        size_t count = rows_.size();
+        tree_.assign(count + 1, 0);
+        for (size_t i = 1; i <= count; ++i)
+        {
+            tree_[i] += rows_[i - 1];
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= count)
+            {
+                tree_[parent] += tree_[i];
+            }
+        }
+    }
+
+    void WrapLayout::AddToTree(size_t line, size_t delta)
+    {
+        for (size_t i = line + 1; i < tree_.size(); i += i & (~i + 1))
+        {
+            tree_[i] += delta;
+        }
+    }
+
+    void WrapLayout::ScheduleLayout()
+    {
+        if (job_ || !IsBusy())
+        {
+            return;
+        }
+
+        size_t first = std::max(next_layout_line_, first_stale_line_);
+        while (first < stale_.size() && !stale_[first])
+        {
+            ++first;
+        }
+        if (first >= stale_.size())
+        {
+            // Nothing left below; go on from the top.
+            first = first_stale_line_;
+            while (!stale_[first])
+            {
+                ++first;
+            }
+            first_stale_line_ = first;
+        }
+        size_t end = std::min(first + kLinesPerJob, stale_.size());
+
+        size_t start_offset = buffer_->LineToOffset(first);
+        size_t end_offset = end < stale_.size() ?
+            buffer_->LineToOffset(end) : buffer_->length();
+        std::string text;
+        buffer_->GetText(Range(start_offset, end_offset), &text);
+
+        job_lines_.resize(end - first);
+        for (size_t i = 0; i < job_lines_.size(); ++i)
+        {
+            job_lines_[i] = first + i;
+        }
+        job_ = new Job(this, metrics_, width_, version_, end - first, &text);
+        layout_message_loop_proxy_->PostTask(
+            NewRunnableMethod(job_.get(), &Job::Run));
+    }
+
+    void WrapLayout::OnJobDone(Job* job)
+    {
+        DCHECK_EQ(job, job_.get());
+        scoped_refptr<Job> done(job_);
+        job_ = NULL;
+        std::vector<size_t> lines;
+        lines.swap(job_lines_);
+
+        if (done->version() != version_)
+        {
+            // The width or the font changed under the job; start over.
+            ScheduleLayout();
+            return;
+        }
+
+        // Lines edited since the job was sent, and lines laid out here in
+        // the meantime, keep what they have.
+        const std::vector<uint32>& rows = done->rows();
+        size_t first = kNoLine;
+        size_t end = 0;
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            size_t line = lines[i];
+            if (line == kNoLine || !stale_[line])
+            {
+                continue;
+            }
+            SetLineRows(line, rows[i]);
+            first = std::min(first, line);
+            end = line + 1;
+        }
+        for (size_t i = lines.size(); i > 0; --i)
+        {
+            if (lines[i - 1] != kNoLine)
+            {
+                next_layout_line_ = lines[i - 1] + 1;
+                break;
+            }
+        }
+        while (first_stale_line_ < stale_.size() &&
+            !stale_[first_stale_line_])
+        {
+            ++first_stale_line_;
+        }
+
+        if (first < end)
+        {
+            delegate_->OnRowsChanged(first, end - first);
+        }
+        ScheduleLayout();
+    }
+
+} //namespace ui
@@ -0,0 +1,181 @@
+#ifndef __ui_base_wrap_layout_h__
+#define __ui_base_wrap_layout_h__
+
+#include <map>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+
+namespace base
+{
+    class MessageLoopProxy;
+}
+
+namespace gfx
+{
+    class Font;
+}
+
+namespace ui
+{
+
+    class TextBuffer;
+
+    // Soft wrap for a TextBuffer: where each line breaks into visual rows at
+    // a view width, and a running total of rows to map between rows and
+    // lines in O(log n).
+    //
+    // Only the number of rows of each line is kept for the whole document;
+    // the wrap points themselves are worked out when asked for, which is
+    // for the visible lines, and cached.  After a width or font change every
+    // line keeps its old row count as an estimate while the lines are laid
+    // out again on a background thread in batches, starting from the
+    // visible ones.  An edit lays out the lines it touched right away when
+    // there are few of them, and leaves the batch under way to finish for
+    // the other lines.  Inserting or removing lines costs a linear
+    // rebuild of the row totals.
+    //
+    // Rows break after the last space or tab that fits, or between
+    // characters in a word longer than the width.  Widths come from the
+    // font for ASCII; other characters take the average width, East Asian
+    // wide ones twice that.  Tabs stop every four spaces.
+    //
+    // Must be used on one thread, which needs a MessageLoop; the delegate is
+    // called there.
+    class WrapLayout
+    {
+    public:
+        class Delegate
+        {
+        public:
+            virtual ~Delegate() {}
+
+            // Lines [first_line, first_line + line_count) were laid out in
+            // the background and may span a different number of rows.
+            virtual void OnRowsChanged(size_t first_line,
+                size_t line_count) = 0;
+        };
+
+        // Character widths of a font, in pixels.
+        struct Metrics
+        {
+            Metrics();
+
+            int ascii_widths[128];
+            int other_width;
+            int wide_width;
+            int tab_width;
+        };
+
+        // |buffer| and |delegate| must outlive the layout.  Lines do not wrap
+        // until SetWidth() is called.
+        WrapLayout(const TextBuffer* buffer, const gfx::Font& font,
+            Delegate* delegate,
+            base::MessageLoopProxy* layout_message_loop_proxy);
+        ~WrapLayout();
+
+        void SetFont(const gfx::Font& font);
+
+        // Width rows wrap at; 0 or less turns wrapping off.
+        void SetWidth(int width);
+        int width() const { return width_; }
+
+        // Tells the layout that lines [first_line, first_line +
+        // old_line_count) were replaced by |new_line_count| lines.  An edit
+        // within one line is 1 and 1.
+        void OnTextChanged(size_t first_line, size_t old_line_count,
+            size_t new_line_count);
+
+        // Background layout goes on from |line| down, then from the top.
+        void SetFirstVisibleLine(size_t line);
+
+        // Rows in the document, lines not laid out yet counted by their
+        // estimate.
+        size_t row_count() const;
+
+        size_t GetLineRows(size_t line) const { return rows_[line]; }
+
+        // First row of |line|, which may be line_count() for the row after
+        // the last.
+        size_t LineToRow(size_t line) const;
+
+        // Line holding |row|, which must be less than row_count(), and in
+        // |row_in_line|, if not NULL, which of its rows it is.
+        size_t RowToLine(size_t row, size_t* row_in_line) const;
+
+        // Puts in |wrap_points| the offsets in |line| where its second and
+        // later rows start.  Lays the line out now if it is not, correcting
+        // its row count.
+        void GetWrapPoints(size_t line, std::vector<uint32>* wrap_points);
+
+        bool IsLineLaidOut(size_t line) const { return !stale_[line]; }
+
+        // True while lines are waiting to be laid out.
+        bool IsBusy() const;
+
+        // Returns the rows |line| wraps into at |width|, and the offsets of
+        // all but the first in |wrap_points| if not NULL.
+        static size_t WrapLine(const base::StringPiece& line,
+            const Metrics& metrics, int width,
+            std::vector<uint32>* wrap_points);
+
+    private:
+        class Job;
+
+        typedef std::map<size_t, std::vector<uint32> > WrapPointMap;
+
+        // Lays out |line| on this thread; returns its rows.
+        size_t LayOutLine(size_t line, std::vector<uint32>* wrap_points);
+        void SetLineRows(size_t line, size_t rows);
+
+        // Drops all layouts after a width or font change, keeping the row
+        // counts as estimates.
+        void InvalidateAll();
+
+        // Row totals, a Fenwick tree over |rows_|.
+        void BuildTree();
+        // Adds |delta| to the rows of |line|; a decrease wraps around.
+        void AddToTree(size_t line, size_t delta);
+
+        // Sends the next batch of stale lines to the layout thread, unless
+        // one is on its way already.
+        void ScheduleLayout();
+
+        // Takes the results of |job|, if they still apply.
+        void OnJobDone(Job* job);
+
+        const TextBuffer* buffer_;
+        Delegate* delegate_;
+        scoped_refptr<base::MessageLoopProxy> layout_message_loop_proxy_;
+
+        Metrics metrics_;
+        int width_;
+
+        std::vector<uint32> rows_;
+        // Lines whose row count is an estimate.
+        std::vector<bool> stale_;
+        size_t stale_count_;
+        // No line before this one is stale.
+        size_t first_stale_line_;
+        std::vector<size_t> tree_;
+
+        WrapPointMap wrap_points_;
+        // Background layout looks for stale lines from here on first.
+        size_t next_layout_line_;
+
+        // Bumped by every width or font change; results of jobs started
+        // before are dropped.
+        int version_;
+        scoped_refptr<Job> job_;
+        // Where each line |job_| lays out is now, edits having moved it
+        // since the job was sent.
+        std::vector<size_t> job_lines_;
+
+        DISALLOW_COPY_AND_ASSIGN(WrapLayout);
+    };
+
+} //namespace ui
+
+#endif //__ui_base_wrap_layout_h__
@@ -3,9 +3,12 @@
 
 #include "base/basic_types.h"
 #include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/debug/task_profiler.h"
 #include "base/message_loop.h"
 #include "base/path_service.h"
 #include "base/process_util.h"
+#include "base/synchronization/lock_profiler.h"
 #include "base/memory/singleton.h"
 #include "uibase/resource/resource_bundle.h"
 #include "uiview/focus/accelerator_handler.h"
@@ -94,6 +97,12 @@ public:
     {
         base::EnableTerminationOnHeapCorruption();
 
+        CommandLine::Init(0, NULL);
+        base::debug::TaskProfiler::InitFromCommandLine(
+            *CommandLine::ForCurrentProcess());
+        base::LockProfiler::InitFromCommandLine(
+            *CommandLine::ForCurrentProcess());
+
         FilePath res_dll;
         PathService::Get(base::DIR_EXE, &res_dll);
 